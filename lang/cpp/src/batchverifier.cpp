@@ -0,0 +1,128 @@
+/*
+  batchverifier.cpp - verifies many signatures with several engines at once
+  Copyright (c) 2020 g10 Code GmbH
+
+  This file is part of GPGME++.
+
+  GPGME++ is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  GPGME++ is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with GPGME++; see the file COPYING.LIB.  If not, write to the
+  Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#ifdef HAVE_CONFIG_H
+ #include "config.h"
+#endif
+
+#include "batchverifier.h"
+
+#include "context.h"
+#include "context_p.h"
+#include "data.h"
+#include "data_p.h"
+#include "verificationresult.h"
+
+#include <gpgme.h>
+
+using namespace GpgME;
+
+class BatchVerifier::Private
+{
+public:
+    Private(Context *c, unsigned int jobs)
+        : ctx(c), maxJobs(jobs) {}
+
+    Context *const ctx;
+    unsigned int maxJobs;
+    // the added signatures and signed texts; the signed text is null
+    // for opaque signatures
+    std::vector<Data> signatures;
+    std::vector<Data> signedTexts;
+};
+
+BatchVerifier::BatchVerifier(Context *ctx, unsigned int maxJobs)
+    : d(new Private(ctx, maxJobs))
+{
+}
+
+BatchVerifier::~BatchVerifier()
+{
+}
+
+unsigned int BatchVerifier::maxJobs() const
+{
+    return d->maxJobs;
+}
+
+void BatchVerifier::setMaxJobs(unsigned int maxJobs)
+{
+    d->maxJobs = maxJobs;
+}
+
+void BatchVerifier::addDetachedSignature(const Data &signature, const Data &signedText)
+{
+    d->signatures.push_back(signature);
+    d->signedTexts.push_back(signedText);
+}
+
+void BatchVerifier::addOpaqueSignature(const Data &signedData)
+{
+    d->signatures.push_back(signedData);
+    d->signedTexts.push_back(Data::null);
+}
+
+unsigned int BatchVerifier::size() const
+{
+    return d->signatures.size();
+}
+
+void BatchVerifier::clear()
+{
+    d->signatures.clear();
+    d->signedTexts.clear();
+}
+
+std::vector<VerificationResult> BatchVerifier::run(Error &err)
+{
+    const unsigned int count = d->signatures.size();
+    std::vector<VerificationResult> results;
+
+    if (!d->ctx) {
+        err = Error::fromCode(GPG_ERR_INV_VALUE);
+        return results;
+    }
+
+    gpgme_ctx_t ctx = d->ctx->impl()->ctx;
+    std::vector<gpgme_data_t> sigs;
+    std::vector<gpgme_data_t> texts;
+    sigs.reserve(count);
+    texts.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        sigs.push_back(d->signatures[i].impl() ? d->signatures[i].impl()->data : nullptr);
+        texts.push_back(d->signedTexts[i].impl() ? d->signedTexts[i].impl()->data : nullptr);
+    }
+    std::vector<gpgme_verify_result_t> res(count, nullptr);
+    std::vector<gpgme_error_t> errs(count, 0);
+
+    err = Error(gpgme_op_verify_batch(ctx, count, sigs.data(), texts.data(),
+                                      res.data(), errs.data(), d->maxJobs));
+
+    results.reserve(count);
+    for (unsigned int i = 0; i < count; ++i) {
+        results.push_back(VerificationResult(ctx, res[i], Error(errs[i])));
+        if (res[i]) {
+            gpgme_result_unref(res[i]);
+        }
+    }
+    return results;
+}
@@ -0,0 +1,90 @@
+/*
+  batchverifier.h - verifies many signatures with several engines at once
+  Copyright (c) 2020 g10 Code GmbH
+
+  This file is part of GPGME++.
+
+  GPGME++ is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Library General Public
+  License as published by the Free Software Foundation; either
+  version 2 of the License, or (at your option) any later version.
+
+  GPGME++ is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+  GNU Library General Public License for more details.
+
+  You should have received a copy of the GNU Library General Public License
+  along with GPGME++; see the file COPYING.LIB.  If not, write to the
+  Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+  Boston, MA 02110-1301, USA.
+*/
+
+#ifndef __GPGMEPP_BATCHVERIFIER_H__
+#define __GPGMEPP_BATCHVERIFIER_H__
+
+#include "gpgmepp_export.h"
+
+#include "error.h"
+
+#include <memory>
+#include <vector>
+
+namespace GpgME
+{
+
+class Context;
+class Data;
+class VerificationResult;
+
+/** Verifies many signatures using several engine processes at once.
+ *
+ * The signatures are collected with addDetachedSignature() and
+ * addOpaqueSignature() and verified by run(), which returns the
+ * results in the order the signatures were added. The engine, the
+ * protocol and the flags relevant for verifying are taken from the
+ * context given to the constructor; its results are not changed.
+ *
+ * The Data objects are referenced until clear() is called or the
+ * batch verifier is destroyed. They must not be used by other
+ * operations while run() is running.
+ */
+class GPGMEPP_EXPORT BatchVerifier
+{
+public:
+    /** Creates a batch verifier for @p ctx, which must outlive it,
+     * that runs up to @p maxJobs engine processes at once. If
+     * @p maxJobs is 0, one process per CPU is used. */
+    explicit BatchVerifier(Context *ctx, unsigned int maxJobs = 0);
+    ~BatchVerifier();
+
+    BatchVerifier(const BatchVerifier &) = delete;
+    BatchVerifier &operator=(const BatchVerifier &) = delete;
+
+    unsigned int maxJobs() const;
+    void setMaxJobs(unsigned int maxJobs);
+
+    /** Adds the detached signature @p signature of @p signedText. */
+    void addDetachedSignature(const Data &signature, const Data &signedText);
+    /** Adds the normal or cleartext signature @p signedData. The
+     * plaintext is discarded. */
+    void addOpaqueSignature(const Data &signedData);
+
+    /** Returns the number of added signatures. */
+    unsigned int size() const;
+    /** Removes all added signatures. */
+    void clear();
+
+    /** Verifies all added signatures and returns one result per
+     * signature. The error of each operation is available from the
+     * result. @p err is set if the batch could not be run. */
+    std::vector<VerificationResult> run(Error &err);
+
+private:
+    class Private;
+    const std::unique_ptr<Private> d;
+};
+
+}
+
+#endif // __GPGMEPP_BATCHVERIFIER_H__
@@ -105,6 +105,24 @@ std::vector<Component> Component::load(Error &returnedError)
     return result;
 }
 
+// static
+Component Component::load(const char *name, Error &returnedError)
+{
+    gpgme_ctx_t ctx_native = nullptr;
+    if (const gpgme_error_t err = gpgme_new(&ctx_native)) {
+        returnedError = Error(err);
+        return Component();
+    }
+    const shared_gpgme_ctx_t ctx(ctx_native, &gpgme_release);
+
+    gpgme_conf_comp_t conf_native = nullptr;
+    if (const gpgme_error_t err = gpgme_op_conf_load_component(ctx_native, name, &conf_native)) {
+        returnedError = Error(err);
+        return Component();
+    }
+    return Component(shared_gpgme_conf_comp_t(conf_native, &gpgme_conf_release));
+}
+
 Error Component::save() const
 {
 
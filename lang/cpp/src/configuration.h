@@ -120,6 +120,9 @@ public:
     }
 
     static std::vector<Component> load(Error &err);
+    /* Loads only the component @p name, which is cheaper than loading
+       all components.  Returns a null Component on error. */
+    static Component load(const char *name, Error &err);
     Error save() const;
 
     const char *name() const;
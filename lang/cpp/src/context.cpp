@@ -521,6 +521,26 @@ Key Context::nextKey(GpgME::Error &e)
     return Key(key, false);
 }
 
+std::vector<Key> Context::keys(const std::vector<std::string> &fingerprints, GpgME::Error &e, bool secret)
+{
+    d->lastop = Private::KeyList;
+    std::vector<const char *> fprs;
+    fprs.reserve(fingerprints.size() + 1);
+    for (const std::string &fpr : fingerprints) {
+        fprs.push_back(fpr.c_str());
+    }
+    fprs.push_back(nullptr);
+    std::vector<gpgme_key_t> keys(fingerprints.size() + 1, nullptr);
+    e = Error(d->lasterr = gpgme_get_keys(d->ctx, fprs.data(), keys.data(),
+                                          secret ? GPGME_GET_KEYS_SECRET : 0));
+    std::vector<Key> result;
+    result.reserve(fingerprints.size());
+    for (size_t i = 0; i < fingerprints.size(); ++i) {
+        result.push_back(Key(keys[i], false));
+    }
+    return result;
+}
+
 KeyListResult Context::endKeyListing()
 {
     d->lasterr = gpgme_op_keylist_end(d->ctx);
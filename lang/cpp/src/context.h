@@ -170,6 +170,10 @@ public:
     KeyListResult keyListResult() const;
 
     Key key(const char *fingerprint, GpgME::Error &e, bool secret = false);
+    /** Returns the keys for all @p fingerprints using a single keylist
+     * operation. The returned vector has one entry per fingerprint;
+     * the entry is a null key if no unique key was found. */
+    std::vector<Key> keys(const std::vector<std::string> &fingerprints, GpgME::Error &e, bool secret = false);
 
     //
     // Key Generation
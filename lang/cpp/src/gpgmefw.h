@@ -75,4 +75,7 @@ typedef struct _gpgme_tofu_info *gpgme_tofu_info_t;
 struct _gpgme_op_query_swdb_result;
 typedef struct _gpgme_op_query_swdb_result *gpgme_query_swdb_result_t;
 
+struct _gpgme_op_verify_result;
+typedef struct _gpgme_op_verify_result *gpgme_verify_result_t;
+
 #endif // __GPGMEPP_GPGMEFW_H__
@@ -44,6 +44,21 @@ const GpgME::Key::Null GpgME::Key::null;
 namespace GpgME
 {
 
+gpgme_user_id_t _detail::nextItem(gpgme_user_id_t uid)
+{
+    return uid->next;
+}
+
+gpgme_sub_key_t _detail::nextItem(gpgme_sub_key_t subkey)
+{
+    return subkey->next;
+}
+
+gpgme_key_sig_t _detail::nextItem(gpgme_key_sig_t sig)
+{
+    return sig->next;
+}
+
 Key::Key() : key() {}
 
 Key::Key(const Null &) : key() {}
@@ -122,6 +137,16 @@ std::vector<Subkey> Key::subkeys() const
     return v;
 }
 
+Key::UserIDRange Key::userIDRange() const
+{
+    return key ? UserIDRange(key, nullptr, key->uids) : UserIDRange();
+}
+
+Key::SubkeyRange Key::subkeyRange() const
+{
+    return key ? SubkeyRange(key, nullptr, key->subkeys) : SubkeyRange();
+}
+
 Key::OwnerTrust Key::ownerTrust() const
 {
     if (!key) {
@@ -341,7 +366,9 @@ const Key &Key::mergeWith(const Key &other)
                 mysk->is_cardkey |= hissk->is_cardkey;
                 mysk->secret |= hissk->secret;
                 if (hissk->keygrip && !mysk->keygrip) {
-                    mysk->keygrip = strdup(hissk->keygrip);
+                    // The key is released in one go, thus the copy
+                    // must come from the key's own memory.
+                    mysk->keygrip = gpgme_key_strdup(me, hissk->keygrip);
                 }
                 break;
             }
@@ -665,6 +692,11 @@ std::vector<UserID::Signature> UserID::signatures() const
     return v;
 }
 
+UserID::SignatureRange UserID::signatureRange() const
+{
+    return uid ? SignatureRange(key, uid, uid->signatures) : SignatureRange();
+}
+
 const char *UserID::id() const
 {
     return uid ? uid->uid : nullptr ;
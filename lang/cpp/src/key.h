@@ -35,6 +35,8 @@
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <iterator>
+#include <cstddef>
 
 namespace GpgME
 {
@@ -47,6 +49,102 @@ class TofuInfo;
 
 typedef std::shared_ptr< std::remove_pointer<gpgme_key_t>::type > shared_gpgme_key_t;
 
+namespace _detail
+{
+/* The gpgme structures are opaque here. */
+GPGMEPP_EXPORT gpgme_user_id_t nextItem(gpgme_user_id_t uid);
+GPGMEPP_EXPORT gpgme_sub_key_t nextItem(gpgme_sub_key_t subkey);
+GPGMEPP_EXPORT gpgme_key_sig_t nextItem(gpgme_key_sig_t sig);
+
+/*! A lightweight view of one of the linked lists of a key (the user
+ *  IDs, the subkeys or the signatures of a user ID).  Unlike the
+ *  std::vector returned by e.g. Key::userIDs() it does not allocate;
+ *  the view holds one reference to the key and the iterators walk the
+ *  list of the underlying gpgme structures.  Dereferencing an
+ *  iterator creates the wrapper object for the current item. */
+template <typename T, typename Node>
+class KeyItemRange
+{
+public:
+    class const_iterator
+    {
+    public:
+        typedef std::forward_iterator_tag iterator_category;
+        typedef T value_type;
+        typedef std::ptrdiff_t difference_type;
+        typedef const T *pointer;
+        typedef T reference;
+
+        const_iterator() : range(nullptr), node(nullptr) {}
+
+        T operator*() const
+        {
+            return range->make(node);
+        }
+
+        /*! Returns the gpgme structure of the current item. */
+        Node impl() const
+        {
+            return node;
+        }
+
+        const_iterator &operator++()
+        {
+            node = nextItem(node);
+            return *this;
+        }
+        const_iterator operator++(int)
+        {
+            const_iterator tmp = *this;
+            node = nextItem(node);
+            return tmp;
+        }
+
+        bool operator==(const const_iterator &other) const
+        {
+            return node == other.node;
+        }
+        bool operator!=(const const_iterator &other) const
+        {
+            return node != other.node;
+        }
+
+    private:
+        friend class KeyItemRange;
+        const_iterator(const KeyItemRange *r, Node n) : range(r), node(n) {}
+
+        const KeyItemRange *range;
+        Node node;
+    };
+    typedef const_iterator iterator;
+
+    KeyItemRange() : key(), uid(nullptr), first(nullptr) {}
+    KeyItemRange(const shared_gpgme_key_t &k, gpgme_user_id_t u, Node f)
+        : key(f ? k : shared_gpgme_key_t()), uid(u), first(f) {}
+
+    const_iterator begin() const
+    {
+        return const_iterator(this, first);
+    }
+    const_iterator end() const
+    {
+        return const_iterator(this, nullptr);
+    }
+
+    bool empty() const
+    {
+        return !first;
+    }
+
+private:
+    T make(Node n) const;
+
+    shared_gpgme_key_t key;
+    gpgme_user_id_t uid;
+    Node first;
+};
+} // namespace _detail
+
 //
 // class Key
 //
@@ -93,6 +191,14 @@ public:
     std::vector<UserID> userIDs() const;
     std::vector<Subkey> subkeys() const;
 
+    typedef _detail::KeyItemRange<UserID, gpgme_user_id_t> UserIDRange;
+    typedef _detail::KeyItemRange<Subkey, gpgme_sub_key_t> SubkeyRange;
+
+    /*! Allocation-free alternatives to userIDs() and subkeys() for
+     *  range-based for loops.  The views keep the key alive. */
+    UserIDRange userIDRange() const;
+    SubkeyRange subkeyRange() const;
+
     bool isRevoked() const;
     bool isExpired() const;
     bool isDisabled() const;
@@ -359,6 +465,10 @@ public:
     Signature signature(unsigned int index) const;
     std::vector<Signature> signatures() const;
 
+    typedef _detail::KeyItemRange<Signature, gpgme_key_sig_t> SignatureRange;
+    /*! Allocation-free alternative to signatures(). */
+    SignatureRange signatureRange() const;
+
     const char *id() const;
     const char *name() const;
     const char *email() const;
@@ -518,6 +628,27 @@ private:
     gpgme_key_sig_t sig;
 };
 
+namespace _detail
+{
+template <>
+inline UserID KeyItemRange<UserID, gpgme_user_id_t>::make(gpgme_user_id_t n) const
+{
+    return UserID(key, n);
+}
+
+template <>
+inline Subkey KeyItemRange<Subkey, gpgme_sub_key_t>::make(gpgme_sub_key_t n) const
+{
+    return Subkey(key, n);
+}
+
+template <>
+inline UserID::Signature KeyItemRange<UserID::Signature, gpgme_key_sig_t>::make(gpgme_key_sig_t n) const
+{
+    return UserID::Signature(key, uid, n);
+}
+} // namespace _detail
+
 GPGMEPP_EXPORT std::ostream &operator<<(std::ostream &os, const UserID &uid);
 GPGMEPP_EXPORT std::ostream &operator<<(std::ostream &os, const Subkey &subkey);
 GPGMEPP_EXPORT std::ostream &operator<<(std::ostream &os, const Key &key);
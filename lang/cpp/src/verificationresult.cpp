@@ -139,13 +139,23 @@ GpgME::VerificationResult::VerificationResult(gpgme_ctx_t ctx, const Error &erro
     init(ctx);
 }
 
+GpgME::VerificationResult::VerificationResult(gpgme_ctx_t ctx, gpgme_verify_result_t result, const Error &error)
+    : GpgME::Result(error), d()
+{
+    init(ctx, result);
+}
+
 void GpgME::VerificationResult::init(gpgme_ctx_t ctx)
 {
     if (!ctx) {
         return;
     }
-    gpgme_verify_result_t res = gpgme_op_verify_result(ctx);
-    if (!res) {
+    init(ctx, gpgme_op_verify_result(ctx));
+}
+
+void GpgME::VerificationResult::init(gpgme_ctx_t ctx, gpgme_verify_result_t res)
+{
+    if (!ctx || !res) {
         return;
     }
     d.reset(new Private(res));
@@ -50,6 +50,9 @@ public:
     VerificationResult();
     VerificationResult(gpgme_ctx_t ctx, int error);
     VerificationResult(gpgme_ctx_t ctx, const Error &error);
+    /** Creates a result from @p result, which is not owned by the
+     * result, for an operation with the protocol of @p ctx. */
+    VerificationResult(gpgme_ctx_t ctx, gpgme_verify_result_t result, const Error &error);
     explicit VerificationResult(const Error &err);
 
     const VerificationResult &operator=(VerificationResult other)
@@ -76,6 +79,7 @@ public:
     class Private;
 private:
     void init(gpgme_ctx_t ctx);
+    void init(gpgme_ctx_t ctx, gpgme_verify_result_t res);
     std::shared_ptr<Private> d;
 };
 
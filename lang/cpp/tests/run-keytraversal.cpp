@@ -0,0 +1,197 @@
+/*
+    run-keytraversal.cpp
+
+    This file is part of GpgMEpp's test suite.
+    Copyright (c) 2020 g10 Code GmbH
+
+    GPGME++ is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    GPGME++ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with GPGME++; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+
+/* This lists the keys once and then walks over their subkeys, user
+ * IDs and key signatures many times, once with the std::vector
+ * returned by Key::subkeys(), Key::userIDs() and UserID::signatures()
+ * and once with the allocation-free range views.  Example (from
+ * tests/gpg):
+ *
+ *   GNUPGHOME=. ../../lang/cpp/tests/run-keytraversal --repeat 10000
+ */
+
+#ifdef HAVE_CONFIG_H
+ #include "config.h"
+#endif
+
+#include "context.h"
+#include "key.h"
+
+#include <memory>
+#include <iostream>
+#include <vector>
+
+#include <string.h>
+#include <stdlib.h>
+#include <sys/time.h>
+
+using namespace GpgME;
+
+static double
+timestamp ()
+{
+    struct timeval tv;
+
+    gettimeofday (&tv, nullptr);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static unsigned long
+walk_vectors (const std::vector<Key> &keys)
+{
+    unsigned long sum = 0;
+
+    for (const Key &key : keys) {
+        for (const Subkey &subkey : key.subkeys()) {
+            sum += subkey.length();
+        }
+        for (const UserID &uid : key.userIDs()) {
+            sum += uid.validity();
+            for (const UserID::Signature &sig : uid.signatures()) {
+                sum += sig.certClass();
+            }
+        }
+    }
+    return sum;
+}
+
+static unsigned long
+walk_ranges (const std::vector<Key> &keys)
+{
+    unsigned long sum = 0;
+
+    for (const Key &key : keys) {
+        for (const Subkey &subkey : key.subkeyRange()) {
+            sum += subkey.length();
+        }
+        for (const UserID &uid : key.userIDRange()) {
+            sum += uid.validity();
+            for (const UserID::Signature &sig : uid.signatureRange()) {
+                sum += sig.certClass();
+            }
+        }
+    }
+    return sum;
+}
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: run-keytraversal [options] [pattern]\n\n"
+         "Options:\n"
+         "  --repeat N       walk over the keys N times (default: 1000)\n"
+         "  --cms            use the CMS protocol\n"
+         , stderr);
+  exit (ex);
+}
+
+int
+main (int argc, char **argv)
+{
+    int last_argc = -1;
+    Protocol protocol = OpenPGP;
+    int repeat = 1000;
+
+    if (argc) {
+        argc--; argv++;
+    }
+
+    while (argc && last_argc != argc ) {
+        last_argc = argc;
+        if (!strcmp (*argv, "--")) {
+            argc--; argv++;
+            break;
+        } else if (!strcmp (*argv, "--help")) {
+            show_usage (0);
+        } else if (!strcmp (*argv, "--repeat")) {
+            argc--; argv++;
+            if (!argc) {
+                show_usage (1);
+            }
+            repeat = atoi (*argv);
+            argc--; argv++;
+        } else if (!strcmp (*argv, "--cms")) {
+            protocol = CMS;
+            argc--; argv++;
+        } else if (!strncmp (*argv, "--", 2)) {
+            show_usage (1);
+        }
+    }
+
+    if (argc > 1 || repeat < 1) {
+        show_usage (1);
+    }
+
+    GpgME::initializeLibrary();
+    auto ctx = std::unique_ptr<Context> (Context::createForProtocol(protocol));
+    if (!ctx) {
+        std::cerr << "Failed to get Context";
+        return -1;
+    }
+    ctx->setKeyListMode (KeyListMode::Local | KeyListMode::Signatures);
+    Error err = ctx->startKeyListing (argc ? *argv : nullptr);
+    if (err) {
+        std::cout << "Error: " << err.asString() << "\n";
+        return -1;
+    }
+    std::vector<Key> keys;
+    unsigned long items = 0;
+    for (;;) {
+        Key key = ctx->nextKey(err);
+        if (err || key.isNull()) {
+            break;
+        }
+        items += key.numSubkeys();
+        for (const UserID &uid : key.userIDRange()) {
+            items += 1 + uid.numSignatures();
+        }
+        keys.push_back(key);
+    }
+
+    const unsigned long expected = walk_vectors(keys);
+    if (walk_ranges(keys) != expected) {
+        std::cerr << "run-keytraversal: vectors and ranges differ\n";
+        return 1;
+    }
+
+    double start = timestamp();
+    unsigned long sum = 0;
+    for (int i = 0; i < repeat; i++) {
+        sum += walk_vectors(keys);
+    }
+    const double vectorTime = timestamp() - start;
+
+    start = timestamp();
+    for (int i = 0; i < repeat; i++) {
+        sum -= walk_ranges(keys);
+    }
+    const double rangeTime = timestamp() - start;
+
+    const double n = double(items) * repeat;
+    printf ("keys=%zu items=%lu repeat=%d\n", keys.size(), items, repeat);
+    printf ("vectors %.3fs %.1fns/item\n", vectorTime,
+            n ? vectorTime * 1e9 / n : 0.0);
+    printf ("ranges  %.3fs %.1fns/item\n", rangeTime,
+            n ? rangeTime * 1e9 / n : 0.0);
+
+    return sum ? 1 : 0;
+}
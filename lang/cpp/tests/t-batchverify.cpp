@@ -0,0 +1,175 @@
+/*
+    t-batchverify.cpp
+
+    This file is part of GpgMEpp's test suite.
+    Copyright (c) 2020 g10 Code GmbH
+
+    GPGME++ is free software; you can redistribute it and/or
+    modify it under the terms of the GNU Library General Public
+    License as published by the Free Software Foundation; either
+    version 2 of the License, or (at your option) any later version.
+
+    GPGME++ is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU Library General Public License for more details.
+
+    You should have received a copy of the GNU Library General Public License
+    along with GPGME++; see the file COPYING.LIB.  If not, write to the
+    Free Software Foundation, Inc., 51 Franklin Street, Fifth Floor,
+    Boston, MA 02110-1301, USA.
+*/
+#ifdef HAVE_CONFIG_H
+ #include "config.h"
+#endif
+
+#include "context.h"
+#include "data.h"
+#include "batchverifier.h"
+#include "verificationresult.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+using namespace GpgME;
+
+static const char alphaFpr[] = "A0FF4590BB6122EDEF6E3C542D727CC768697734";
+
+static const char text[] = "Just GNU it!\n";
+static const char forgedText[] = "Just GNU it?\n";
+static const char detachedSig[] =
+"-----BEGIN PGP SIGNATURE-----\n"
+"\n"
+"iN0EABECAJ0FAjoS+i9FFIAAAAAAAwA5YmFyw7bDpMO8w58gZGFzIHdhcmVuIFVt\n"
+"bGF1dGUgdW5kIGpldHp0IGVpbiBwcm96ZW50JS1aZWljaGVuNRSAAAAAAAgAJGZv\n"
+"b2Jhci4xdGhpcyBpcyBhIG5vdGF0aW9uIGRhdGEgd2l0aCAyIGxpbmVzGhpodHRw\n"
+"Oi8vd3d3Lmd1Lm9yZy9wb2xpY3kvAAoJEC1yfMdoaXc0JBIAoIiLlUsvpMDOyGEc\n"
+"dADGKXF/Hcb+AKCJWPphZCphduxSvrzH0hgzHdeQaA==\n"
+"=nts1\n"
+"-----END PGP SIGNATURE-----\n";
+static const char opaqueSig[] =
+"-----BEGIN PGP MESSAGE-----\n"
+"\n"
+"owGbwMvMwCSoW1RzPCOz3IRxjXQSR0lqcYleSUWJTZOvjVdpcYmCu1+oQmaJIleH\n"
+"GwuDIBMDGysTSIqBi1MApi+nlGGuwDeHao53HBr+FoVGP3xX+kvuu9fCMJvl6IOf\n"
+"y1kvP4y+8D5a11ang0udywsA\n"
+"=Crq6\n"
+"-----END PGP MESSAGE-----\n";
+
+// The items of the batch: a good detached signature, a detached
+// signature of a forged text and a good opaque signature.
+static const unsigned int numItems = 7;
+
+static void fail(const char *what, unsigned int item, const Error &err)
+{
+    std::cerr << "t-batchverify: " << what << " (item " << item << "): "
+              << err.asString() << std::endl;
+    exit(1);
+}
+
+static void checkResults(const std::vector<VerificationResult> &results,
+                         bool canceled)
+{
+    if (results.size() != numItems) {
+        fail("wrong number of results", results.size(), Error());
+    }
+    for (unsigned int i = 0; i < numItems; ++i) {
+        const VerificationResult &res = results[i];
+        if (canceled) {
+            if (res.error().code() != GPG_ERR_CANCELED) {
+                fail("item not canceled", i, res.error());
+            }
+            continue;
+        }
+        if (res.error()) {
+            fail("verification failed", i, res.error());
+        }
+        if (res.numSignatures() != 1) {
+            fail("wrong number of signatures", i, Error());
+        }
+        const Signature sig = res.signature(0);
+        if (strcmp(sig.fingerprint(), alphaFpr)
+            && strcmp(sig.fingerprint(), alphaFpr + 24)) {
+            fail("wrong fingerprint", i, Error());
+        }
+        const int expected = i % 3 == 1 ? GPG_ERR_BAD_SIGNATURE
+                                        : GPG_ERR_NO_ERROR;
+        if (sig.status().code() != expected) {
+            fail("wrong signature status", i, sig.status());
+        }
+    }
+}
+
+static void addItems(BatchVerifier &verifier)
+{
+    for (unsigned int i = 0; i < numItems; ++i) {
+        switch (i % 3) {
+        case 0:
+        case 1:
+            verifier.addDetachedSignature(
+                Data(detachedSig, strlen(detachedSig), true),
+                i % 3 ? Data(forgedText, strlen(forgedText), true)
+                      : Data(text, strlen(text), true));
+            break;
+        default:
+            verifier.addOpaqueSignature(Data(opaqueSig, strlen(opaqueSig), true));
+            break;
+        }
+    }
+}
+
+int
+main (int argc, char **argv)
+{
+    (void)argc;
+    (void)argv;
+
+    GpgME::initializeLibrary();
+
+    std::unique_ptr<Context> ctx(Context::createForProtocol(OpenPGP));
+    if (!ctx) {
+        fail("no context", 0, Error());
+    }
+
+    // Fewer jobs than items so that the job contexts are reused.
+    BatchVerifier verifier(ctx.get(), 2);
+    addItems(verifier);
+
+    Error err;
+    checkResults(verifier.run(err), false);
+    if (err) {
+        fail("batch failed", 0, err);
+    }
+
+    // A cancel issued before the batch is started cancels it, with
+    // both ways of canceling.
+    err = ctx->cancelPendingOperationImmediately();
+    if (err) {
+        fail("cancel failed", 0, err);
+    }
+    checkResults(verifier.run(err), true);
+    if (err) {
+        fail("canceled batch failed", 0, err);
+    }
+    err = ctx->cancelPendingOperation();
+    if (err) {
+        fail("cancel failed", 0, err);
+    }
+    checkResults(verifier.run(err), true);
+    if (err) {
+        fail("canceled batch failed", 0, err);
+    }
+
+    // The cancel does not affect the next batch.  The data of the
+    // first batch has been read.
+    verifier.clear();
+    addItems(verifier);
+    checkResults(verifier.run(err), false);
+    if (err) {
+        fail("batch failed", 0, err);
+    }
+
+    return 0;
+}
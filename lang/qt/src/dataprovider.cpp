@@ -99,10 +99,23 @@ ssize_t QByteArrayDataProvider::write(const void *buffer, size_t bufSize)
         Error::setSystemError(GPG_ERR_EINVAL);
         return -1;
     }
-    if (mOff >= mArray.size()) {
-        resizeAndInit(mArray, mOff + bufSize);
+    if (mOff == mArray.size()) {
+        // The common case of appending: grow the capacity
+        // geometrically and don't clear the new bytes first.
+        const qint64 newSize = mOff + bufSize;
+        if (newSize > mArray.capacity()) {
+            mArray.reserve(static_cast<int>(qMax(newSize, qMax(qint64(4096), 2 * qint64(mArray.capacity())))));
+        }
+        mArray.append(static_cast<const char *>(buffer), bufSize);
+        if (mArray.size() != newSize) {
+            Error::setSystemError(GPG_ERR_EIO);
+            return -1;
+        }
+        mOff = newSize;
+        return bufSize;
     }
-    if (mOff >= mArray.size()) {
+    if (static_cast<size_t>(mOff) + bufSize > static_cast<size_t>(mArray.size())
+        && !resizeAndInit(mArray, mOff + bufSize)) {
         Error::setSystemError(GPG_ERR_EIO);
         return -1;
     }
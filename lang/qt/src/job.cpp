@@ -109,6 +109,18 @@ GpgME::Context *QGpgME::Job::context(QGpgME::Job *job)
     return QGpgME::g_context_map.value (job, nullptr);
 }
 
+/* static */
+void QGpgME::Job::setMaxRunningJobs(GpgME::Protocol protocol, int count)
+{
+    _detail::JobScheduler::instance()->setMaxRunningJobs(protocol, count);
+}
+
+/* static */
+int QGpgME::Job::maxRunningJobs(GpgME::Protocol protocol)
+{
+    return _detail::JobScheduler::instance()->maxRunningJobs(protocol);
+}
+
 #define make_job_subclass_ext(x,y)                \
     QGpgME::x::x( QObject * parent ) : y( parent ) {} \
     QGpgME::x::~x() {}
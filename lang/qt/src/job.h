@@ -43,8 +43,10 @@
 
 #ifdef BUILDING_QGPGME
 # include "error.h"
+# include "global.h"
 #else
 # include <gpgme++/error.h>
+# include <gpgme++/global.h>
 #endif
 
 class QWidget;
@@ -95,6 +97,20 @@ public:
      */
     static GpgME::Context *context(Job *job);
 
+    /** Limit the number of jobs for @p protocol which run at the same time.
+     *
+     * The jobs of all protocols share a pool of worker threads which
+     * grows as needed; by default all jobs run right away.  Jobs which
+     * are started while @p count jobs of their protocol are running are
+     * queued and run in the order in which they were started.  A
+     * @p count of zero or less removes the limit.  This does not affect
+     * jobs which are already running.
+     */
+    static void setMaxRunningJobs(GpgME::Protocol protocol, int count);
+
+    /** The limit set with setMaxRunningJobs() or zero if there is none. */
+    static int maxRunningJobs(GpgME::Protocol protocol);
+
 public Q_SLOTS:
     virtual void slotCancel() = 0;
 
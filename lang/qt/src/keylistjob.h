@@ -100,8 +100,24 @@ public:
     /** Add a flag to the keylistmode used. */
     virtual void addMode(GpgME::KeyListMode mode) = 0;
 
+    /**
+      Pass the listed keys in batches through the nextKeys() signal
+      while the keys are listed instead of with the result.  A batch
+      is emitted after \a batchSize keys or, if \a interval is not
+      zero, when a key arrives \a interval milliseconds after the
+      last batch.  The first key is emitted right away.  If the slots
+      connected to nextKeys() are slower than the listing, the
+      listing waits until they caught up.
+
+      In this mode the keys are not kept until the end: the result()
+      signal carries no keys and nextKey() is not emitted.  A \a batchSize of zero
+      switches this mode off.  This must be called before start().
+    */
+    virtual void setKeyBatching(unsigned int batchSize, unsigned int interval = 100);
+
 Q_SIGNALS:
     void nextKey(const GpgME::Key &key);
+    void nextKeys(const std::vector<GpgME::Key> &keys);
     void result(const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &keys = std::vector<GpgME::Key>(), const QString &auditLogAsHtml = QString(), const GpgME::Error &auditLogError = GpgME::Error());
 };
 
@@ -97,7 +97,24 @@ public:
     */
     virtual GpgME::KeyListResult exec(std::vector<GpgME::Key> &pub, std::vector<GpgME::Key> &sec, bool mergeKeys = false) = 0;
 
+    /**
+      Pass the listed keys in batches through the nextKeys() signal
+      while the keys are listed instead of with the result.  A batch
+      is emitted after \a batchSize keys or, if \a interval is not
+      zero, when a key arrives \a interval milliseconds after the
+      last batch.  The first key is emitted right away.  If the slots
+      connected to nextKeys() are slower than the listing, the
+      listing waits until they caught up.
+
+      In this mode the keys are not kept until the end: the result()
+      signal carries no keys and the keys are not sorted.  This mode
+      requires GnuPG 2.1 or later.  A \a batchSize of zero switches
+      this mode off.  This must be called before start().
+    */
+    virtual void setKeyBatching(unsigned int batchSize, unsigned int interval = 100);
+
 Q_SIGNALS:
+    void nextKeys(const std::vector<GpgME::Key> &keys);
     void result(const GpgME::KeyListResult &result, const std::vector<GpgME::Key> &pub = std::vector<GpgME::Key>(), const std::vector<GpgME::Key> &sec = std::vector<GpgME::Key>(), const QString &auditLogAsHtml = QString(), const GpgME::Error &auditLogError = GpgME::Error());
 };
 
@@ -70,8 +70,8 @@ static QGpgMEDecryptJob::result_type decrypt(Context *ctx, QThread *thread,
     const _detail::ToThreadMover ctMover(cipherText, thread);
     const _detail::ToThreadMover ptMover(plainText,  thread);
 
-    QGpgME::QIODeviceDataProvider in(cipherText);
-    const Data indata(&in);
+    _detail::IODeviceData in(cipherText, _detail::IODeviceData::Input);
+    const Data &indata = in.data();
 
     if (!plainText) {
         QGpgME::QByteArrayDataProvider out;
@@ -82,8 +82,8 @@ static QGpgMEDecryptJob::result_type decrypt(Context *ctx, QThread *thread,
         const QString log = _detail::audit_log_as_html(ctx, ae);
         return std::make_tuple(res, out.data(), log, ae);
     } else {
-        QGpgME::QIODeviceDataProvider out(plainText);
-        Data outdata(&out);
+        _detail::IODeviceData out(plainText, _detail::IODeviceData::Output);
+        Data &outdata = out.data();
 
         const DecryptionResult res = ctx->decrypt(indata, outdata);
         Error ae;
@@ -76,8 +76,8 @@ static QGpgMEDecryptVerifyJob::result_type decrypt_verify(Context *ctx, QThread
     const _detail::ToThreadMover ctMover(cipherText, thread);
     const _detail::ToThreadMover ptMover(plainText,  thread);
 
-    QGpgME::QIODeviceDataProvider in(cipherText);
-    const Data indata(&in);
+    _detail::IODeviceData in(cipherText, _detail::IODeviceData::Input);
+    const Data &indata = in.data();
 
     if (!plainText) {
         QGpgME::QByteArrayDataProvider out;
@@ -89,8 +89,8 @@ static QGpgMEDecryptVerifyJob::result_type decrypt_verify(Context *ctx, QThread
         qCDebug(QGPGME_LOG) << "End no plainText. Error: " << ae;
         return std::make_tuple(res.first, res.second, out.data(), log, ae);
     } else {
-        QGpgME::QIODeviceDataProvider out(plainText);
-        Data outdata(&out);
+        _detail::IODeviceData out(plainText, _detail::IODeviceData::Output);
+        Data &outdata = out.data();
 
         const std::pair<DecryptionResult, VerificationResult> res = ctx->decryptAndVerify(indata, outdata);
         Error ae;
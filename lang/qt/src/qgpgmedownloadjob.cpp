@@ -80,8 +80,8 @@ static QGpgMEDownloadJob::result_type download(Context *ctx, QThread *thread, co
 
     const _detail::ToThreadMover kdMover(keyData, thread);
 
-    QGpgME::QIODeviceDataProvider dp(keyData);
-    Data data(&dp);
+    _detail::IODeviceData dp(keyData, _detail::IODeviceData::Output);
+    Data &data = dp.data();
 
     const _detail::PatternConverter pc(fpr);
 
@@ -80,8 +80,8 @@ static QGpgMEEncryptJob::result_type encrypt(Context *ctx, QThread *thread,
     const _detail::ToThreadMover ctMover(cipherText, thread);
     const _detail::ToThreadMover ptMover(plainText,  thread);
 
-    QGpgME::QIODeviceDataProvider in(plainText);
-    const Data indata(&in);
+    _detail::IODeviceData in(plainText, _detail::IODeviceData::Input);
+    const Data &indata = in.data();
 
     if (!cipherText) {
         QGpgME::QByteArrayDataProvider out;
@@ -96,8 +96,8 @@ static QGpgMEEncryptJob::result_type encrypt(Context *ctx, QThread *thread,
         const QString log = _detail::audit_log_as_html(ctx, ae);
         return std::make_tuple(res, out.data(), log, ae);
     } else {
-        QGpgME::QIODeviceDataProvider out(cipherText);
-        Data outdata(&out);
+        _detail::IODeviceData out(cipherText, _detail::IODeviceData::Output);
+        Data &outdata = out.data();
 
         if (outputIsBsse64Encoded) {
             outdata.setEncoding(Data::Base64Encoding);
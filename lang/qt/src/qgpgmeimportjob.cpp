@@ -59,8 +59,8 @@ QGpgMEImportJob::~QGpgMEImportJob() {}
 
 static QGpgMEImportJob::result_type import_qba(Context *ctx, const QByteArray &certData)
 {
-    QGpgME::QByteArrayDataProvider dp(certData);
-    Data data(&dp);
+    // the bound argument keeps the array alive; no need to copy it
+    const Data data(certData.constData(), certData.size(), false);
 
     const ImportResult res = ctx->importKeys(data);
     Error ae;
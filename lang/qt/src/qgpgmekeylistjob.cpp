@@ -56,14 +56,20 @@ using namespace GpgME;
 
 QGpgMEKeyListJob::QGpgMEKeyListJob(Context *context)
     : mixin_type(context),
-      mResult(), mSecretOnly(false)
+      mResult(), mSecretOnly(false), mBatchSize(0), mBatchInterval(0)
 {
     lateInitialization();
 }
 
-QGpgMEKeyListJob::~QGpgMEKeyListJob() {}
+QGpgMEKeyListJob::~QGpgMEKeyListJob()
+{
+    if (mBatcher) {
+        mBatcher->cancel();
+    }
+}
 
-static KeyListResult do_list_keys(Context *ctx, const QStringList &pats, std::vector<Key> &keys, bool secretOnly)
+static KeyListResult do_list_keys(Context *ctx, const QStringList &pats, std::vector<Key> &keys, bool secretOnly,
+                                  const std::shared_ptr<_detail::KeyBatcher> &batcher)
 {
 
     const _detail::PatternConverter pc(pats);
@@ -73,22 +79,31 @@ static KeyListResult do_list_keys(Context *ctx, const QStringList &pats, std::ve
     }
 
     Error err;
-    do {
-        keys.push_back(ctx->nextKey(err));
-    } while (!err);
-
-    keys.pop_back();
+    Q_FOREVER {
+        const Key key = ctx->nextKey(err);
+        if (err) {
+            break;
+        }
+        if (!batcher) {
+            keys.push_back(key);
+        } else if (!batcher->add(key)) {
+            // don't wait for the remaining keys
+            ctx->cancelPendingOperationImmediately();
+            return KeyListResult(Error::fromCode(GPG_ERR_CANCELED));
+        }
+    }
 
     const KeyListResult result = ctx->endKeyListing();
     ctx->cancelPendingOperation();
     return result;
 }
 
-static QGpgMEKeyListJob::result_type list_keys(Context *ctx, QStringList pats, bool secretOnly)
+static QGpgMEKeyListJob::result_type list_keys_chunked(Context *ctx, QStringList pats, bool secretOnly,
+                                                       const std::shared_ptr<_detail::KeyBatcher> &batcher)
 {
     if (pats.size() < 2) {
         std::vector<Key> keys;
-        const KeyListResult r = do_list_keys(ctx, pats, keys, secretOnly);
+        const KeyListResult r = do_list_keys(ctx, pats, keys, secretOnly, batcher);
         return std::make_tuple(r, keys, QString(), Error());
     }
 
@@ -107,7 +122,7 @@ retry:
     keys.reserve(pats.size());
     KeyListResult result;
     do {
-        const KeyListResult this_result = do_list_keys(ctx, pats.mid(0, chunkSize), keys, secretOnly);
+        const KeyListResult this_result = do_list_keys(ctx, pats.mid(0, chunkSize), keys, secretOnly, batcher);
         if (this_result.error().code() == GPG_ERR_LINE_TOO_LONG) {
             // got LINE_TOO_LONG, try a smaller chunksize:
             chunkSize /= 2;
@@ -133,17 +148,33 @@ retry:
     return std::make_tuple(result, keys, QString(), Error());
 }
 
+static QGpgMEKeyListJob::result_type list_keys(Context *ctx, QStringList pats, bool secretOnly,
+                                               const std::shared_ptr<_detail::KeyBatcher> &batcher)
+{
+    const QGpgMEKeyListJob::result_type r = list_keys_chunked(ctx, pats, secretOnly, batcher);
+    if (batcher) {
+        // emit the last batch before the result
+        batcher->flush();
+    }
+    return r;
+}
+
 Error QGpgMEKeyListJob::start(const QStringList &patterns, bool secretOnly)
 {
     mSecretOnly = secretOnly;
-    run(std::bind(&list_keys, std::placeholders::_1, patterns, secretOnly));
+    if (mBatchSize) {
+        mBatcher = std::make_shared<_detail::KeyBatcher>(jobTask(), [this](const std::vector<Key> &keys) {
+            Q_EMIT nextKeys(keys);
+        }, mBatchSize, mBatchInterval);
+    }
+    run(std::bind(&list_keys, std::placeholders::_1, patterns, secretOnly, mBatcher));
     return Error();
 }
 
 KeyListResult QGpgMEKeyListJob::exec(const QStringList &patterns, bool secretOnly, std::vector<Key> &keys)
 {
     mSecretOnly = secretOnly;
-    const result_type r = list_keys(context(), patterns, secretOnly);
+    const result_type r = list_keys(context(), patterns, secretOnly, std::shared_ptr<_detail::KeyBatcher>());
     resultHook(r);
     keys = std::get<1>(r);
     return std::get<0>(r);
@@ -161,6 +192,26 @@ void QGpgMEKeyListJob::addMode(KeyListMode mode)
 {
     context()->addKeyListMode(mode);
 }
+
+void QGpgMEKeyListJob::setKeyBatching(unsigned int batchSize, unsigned int interval)
+{
+    mBatchSize = batchSize;
+    mBatchInterval = interval;
+}
+
+void QGpgMEKeyListJob::slotCancel()
+{
+    // wake up a listing which waits for the receiver
+    if (mBatcher) {
+        mBatcher->cancel();
+    }
+    mixin_type::slotCancel();
+}
+
+/* For ABI compat not pure virtual. */
+void KeyListJob::setKeyBatching(unsigned int, unsigned int)
+{
+}
 #if 0
 void QGpgMEKeyListJob::showErrorDialog(QWidget *parent, const QString &caption) const
 {
@@ -77,11 +77,20 @@ public:
 
     void addMode(GpgME::KeyListMode mode) Q_DECL_OVERRIDE;
 
+    /* from KeyListJob */
+    void setKeyBatching(unsigned int batchSize, unsigned int interval) Q_DECL_OVERRIDE;
+
+    /* from Job */
+    void slotCancel() Q_DECL_OVERRIDE;
+
     /* from ThreadedJobMixin */
     void resultHook(const result_type &result) Q_DECL_OVERRIDE;
 private:
     GpgME::KeyListResult mResult;
     bool mSecretOnly;
+    unsigned int mBatchSize;
+    unsigned int mBatchInterval;
+    std::shared_ptr<_detail::KeyBatcher> mBatcher;
 };
 
 }
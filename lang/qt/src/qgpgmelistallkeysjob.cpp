@@ -57,12 +57,17 @@ using namespace GpgME;
 
 QGpgMEListAllKeysJob::QGpgMEListAllKeysJob(Context *context)
     : mixin_type(context),
-      mResult()
+      mResult(), mBatchSize(0), mBatchInterval(0)
 {
     lateInitialization();
 }
 
-QGpgMEListAllKeysJob::~QGpgMEListAllKeysJob() {}
+QGpgMEListAllKeysJob::~QGpgMEListAllKeysJob()
+{
+    if (mBatcher) {
+        mBatcher->cancel();
+    }
+}
 
 namespace {
 
@@ -137,7 +142,8 @@ static QGpgMEListAllKeysJob::result_type list_keys_legacy(Context *ctx, bool mer
     return std::make_tuple(r, merged, sec, QString(), Error());
 }
 
-static KeyListResult do_list_keys(Context *ctx, std::vector<Key> &keys)
+static KeyListResult do_list_keys(Context *ctx, std::vector<Key> &keys,
+                                  const std::shared_ptr<_detail::KeyBatcher> &batcher)
 {
     const unsigned int keyListMode = ctx->keyListMode();
     ctx->addKeyListMode(KeyListMode::WithSecret);
@@ -149,11 +155,20 @@ static KeyListResult do_list_keys(Context *ctx, std::vector<Key> &keys)
     }
 
     Error err;
-    do {
-        keys.push_back(ctx->nextKey(err));
-    } while (!err);
-
-    keys.pop_back();
+    Q_FOREVER {
+        const Key key = ctx->nextKey(err);
+        if (err) {
+            break;
+        }
+        if (!batcher) {
+            keys.push_back(key);
+        } else if (!batcher->add(key)) {
+            // don't wait for the remaining keys
+            ctx->cancelPendingOperationImmediately();
+            ctx->setKeyListMode(keyListMode);
+            return KeyListResult(Error::fromCode(GPG_ERR_CANCELED));
+        }
+    }
 
     const KeyListResult result = ctx->endKeyListing();
     ctx->setKeyListMode(keyListMode);
@@ -162,14 +177,20 @@ static KeyListResult do_list_keys(Context *ctx, std::vector<Key> &keys)
     return result;
 }
 
-static QGpgMEListAllKeysJob::result_type list_keys(Context *ctx, bool mergeKeys)
+static QGpgMEListAllKeysJob::result_type list_keys(Context *ctx, bool mergeKeys,
+                                                   const std::shared_ptr<_detail::KeyBatcher> &batcher)
 {
     if (GpgME::engineInfo(GpgME::GpgEngine).engineVersion() < "2.1.0") {
         return list_keys_legacy(ctx, mergeKeys);
     }
 
     std::vector<Key> keys;
-    KeyListResult r = do_list_keys(ctx, keys);
+    KeyListResult r = do_list_keys(ctx, keys, batcher);
+    if (batcher) {
+        // emit the last batch before the result
+        batcher->flush();
+        return std::make_tuple(r, std::vector<Key>(), std::vector<Key>(), QString(), Error());
+    }
     std::sort(keys.begin(), keys.end(), ByFingerprint<std::less>());
 
     std::vector<Key> sec;
@@ -182,13 +203,18 @@ static QGpgMEListAllKeysJob::result_type list_keys(Context *ctx, bool mergeKeys)
 
 Error QGpgMEListAllKeysJob::start(bool mergeKeys)
 {
-    run(std::bind(&list_keys, std::placeholders::_1, mergeKeys));
+    if (mBatchSize) {
+        mBatcher = std::make_shared<_detail::KeyBatcher>(jobTask(), [this](const std::vector<Key> &keys) {
+            Q_EMIT nextKeys(keys);
+        }, mBatchSize, mBatchInterval);
+    }
+    run(std::bind(&list_keys, std::placeholders::_1, mergeKeys, mBatcher));
     return Error();
 }
 
 KeyListResult QGpgMEListAllKeysJob::exec(std::vector<Key> &pub, std::vector<Key> &sec, bool mergeKeys)
 {
-    const result_type r = list_keys(context(), mergeKeys);
+    const result_type r = list_keys(context(), mergeKeys, std::shared_ptr<_detail::KeyBatcher>());
     resultHook(r);
     pub = std::get<1>(r);
     sec = std::get<2>(r);
@@ -200,6 +226,26 @@ void QGpgMEListAllKeysJob::resultHook(const result_type &tuple)
     mResult = std::get<0>(tuple);
 }
 
+void QGpgMEListAllKeysJob::setKeyBatching(unsigned int batchSize, unsigned int interval)
+{
+    mBatchSize = batchSize;
+    mBatchInterval = interval;
+}
+
+void QGpgMEListAllKeysJob::slotCancel()
+{
+    // wake up a listing which waits for the receiver
+    if (mBatcher) {
+        mBatcher->cancel();
+    }
+    mixin_type::slotCancel();
+}
+
+/* For ABI compat not pure virtual. */
+void ListAllKeysJob::setKeyBatching(unsigned int, unsigned int)
+{
+}
+
 #if 0
 void QGpgMEListAllKeysJob::showErrorDialog(QWidget *parent, const QString &caption) const
 {
@@ -75,11 +75,20 @@ public:
     /* from ListAllKeysJob */
     GpgME::KeyListResult exec(std::vector<GpgME::Key> &pub, std::vector<GpgME::Key> &sec, bool mergeKeys) Q_DECL_OVERRIDE;
 
+    /* from ListAllKeysJob */
+    void setKeyBatching(unsigned int batchSize, unsigned int interval) Q_DECL_OVERRIDE;
+
+    /* from Job */
+    void slotCancel() Q_DECL_OVERRIDE;
+
     /* from ThreadedJobMixin */
     void resultHook(const result_type &result) Q_DECL_OVERRIDE;
 
 private:
     GpgME::KeyListResult mResult;
+    unsigned int mBatchSize;
+    unsigned int mBatchInterval;
+    std::shared_ptr<_detail::KeyBatcher> mBatcher;
 };
 
 }
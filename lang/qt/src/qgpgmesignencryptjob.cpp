@@ -77,8 +77,8 @@ static QGpgMESignEncryptJob::result_type sign_encrypt(Context *ctx, QThread *thr
     const _detail::ToThreadMover ctMover(cipherText, thread);
     const _detail::ToThreadMover ptMover(plainText, thread);
 
-    QGpgME::QIODeviceDataProvider in(plainText);
-    const Data indata(&in);
+    _detail::IODeviceData in(plainText, _detail::IODeviceData::Input);
+    const Data &indata = in.data();
 
     ctx->clearSigningKeys();
     Q_FOREACH (const Key &signer, signers)
@@ -100,8 +100,8 @@ static QGpgMESignEncryptJob::result_type sign_encrypt(Context *ctx, QThread *thr
         const QString log = _detail::audit_log_as_html(ctx, ae);
         return std::make_tuple(res.first, res.second, out.data(), log, ae);
     } else {
-        QGpgME::QIODeviceDataProvider out(cipherText);
-        Data outdata(&out);
+        _detail::IODeviceData out(cipherText, _detail::IODeviceData::Output);
+        Data &outdata = out.data();
 
         if (outputIsBsse64Encoded) {
             outdata.setEncoding(Data::Base64Encoding);
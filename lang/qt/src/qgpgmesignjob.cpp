@@ -80,8 +80,8 @@ static QGpgMESignJob::result_type sign(Context *ctx, QThread *thread,
     const _detail::ToThreadMover ptMover(plainText, thread);
     const _detail::ToThreadMover sgMover(signature, thread);
 
-    QGpgME::QIODeviceDataProvider in(plainText);
-    const Data indata(&in);
+    _detail::IODeviceData in(plainText, _detail::IODeviceData::Input);
+    const Data &indata = in.data();
 
     ctx->clearSigningKeys();
     Q_FOREACH (const Key &signer, signers)
@@ -103,8 +103,8 @@ static QGpgMESignJob::result_type sign(Context *ctx, QThread *thread,
         const QString log = _detail::audit_log_as_html(ctx, ae);
         return std::make_tuple(res, out.data(), log, ae);
     } else {
-        QGpgME::QIODeviceDataProvider out(signature);
-        Data outdata(&out);
+        _detail::IODeviceData out(signature, _detail::IODeviceData::Output);
+        Data &outdata = out.data();
 
         if (outputIsBsse64Encoded) {
             outdata.setEncoding(Data::Base64Encoding);
@@ -66,11 +66,11 @@ static QGpgMEVerifyDetachedJob::result_type verify_detached(Context *ctx, QThrea
     const _detail::ToThreadMover sgMover(signature,  thread);
     const _detail::ToThreadMover sdMover(signedData, thread);
 
-    QGpgME::QIODeviceDataProvider sigDP(signature);
-    Data sig(&sigDP);
+    _detail::IODeviceData sigIO(signature, _detail::IODeviceData::Input);
+    Data &sig = sigIO.data();
 
-    QGpgME::QIODeviceDataProvider dataDP(signedData);
-    Data data(&dataDP);
+    _detail::IODeviceData dataIO(signedData, _detail::IODeviceData::Input);
+    Data &data = dataIO.data();
 
     const VerificationResult res = ctx->verifyDetachedSignature(sig, data);
     Error ae;
@@ -81,11 +81,9 @@ static QGpgMEVerifyDetachedJob::result_type verify_detached(Context *ctx, QThrea
 
 static QGpgMEVerifyDetachedJob::result_type verify_detached_qba(Context *ctx, const QByteArray &signature, const QByteArray &signedData)
 {
-    QGpgME::QByteArrayDataProvider sigDP(signature);
-    Data sig(&sigDP);
-
-    QGpgME::QByteArrayDataProvider dataDP(signedData);
-    Data data(&dataDP);
+    // the bound arguments keep the arrays alive; no need to copy them
+    const Data sig(signature.constData(), signature.size(), false);
+    const Data data(signedData.constData(), signedData.size(), false);
 
     const VerificationResult res = ctx->verifyDetachedSignature(sig, data);
     Error ae;
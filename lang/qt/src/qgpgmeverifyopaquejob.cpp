@@ -69,8 +69,8 @@ static QGpgMEVerifyOpaqueJob::result_type verify_opaque(Context *ctx, QThread *t
     const _detail::ToThreadMover ptMover(plainText,  thread);
     const _detail::ToThreadMover sdMover(signedData, thread);
 
-    QGpgME::QIODeviceDataProvider in(signedData);
-    const Data indata(&in);
+    _detail::IODeviceData in(signedData, _detail::IODeviceData::Input);
+    const Data &indata = in.data();
 
     if (!plainText) {
         QGpgME::QByteArrayDataProvider out;
@@ -81,8 +81,8 @@ static QGpgMEVerifyOpaqueJob::result_type verify_opaque(Context *ctx, QThread *t
         const QString log = _detail::audit_log_as_html(ctx, ae);
         return std::make_tuple(res, out.data(), log, ae);
     } else {
-        QGpgME::QIODeviceDataProvider out(plainText);
-        Data outdata(&out);
+        _detail::IODeviceData out(plainText, _detail::IODeviceData::Output);
+        Data &outdata = out.data();
 
         const VerificationResult res = ctx->verifyOpaqueSignature(indata, outdata);
         Error ae;
@@ -45,10 +45,19 @@
 #include <QString>
 #include <QStringList>
 #include <QByteArray>
+#include <QBuffer>
+#include <QFileDevice>
+#include <QWaitCondition>
 
 
 #include <algorithm>
 #include <iterator>
+#include <list>
+#include <map>
+
+#ifndef Q_OS_WIN
+# include <unistd.h>
+#endif
 
 using namespace QGpgME;
 using namespace GpgME;
@@ -193,3 +202,457 @@ _detail::PatternConverter::~PatternConverter()
 {
     delete [] m_patterns;
 }
+
+_detail::IODeviceData::IODeviceData(const std::shared_ptr<QIODevice> &io, Direction direction)
+    : m_io(io), m_provider(), m_array(), m_pos(-1), m_fd(-1), m_data(GpgME::Data::null)
+{
+    assert(io);
+
+    if (direction == Input) {
+        const QBuffer *const buffer = qobject_cast<QBuffer *>(io.get());
+        if (buffer && buffer->isOpen() && !buffer->isWritable()) {
+            // a shallow copy keeps the bytes alive
+            m_array = buffer->data();
+            m_pos = qMin(buffer->pos(), static_cast<qint64>(m_array.size()));
+            m_data = Data(m_array.constData() + m_pos, m_array.size() - m_pos, false);
+            return;
+        }
+    }
+
+#ifndef Q_OS_WIN
+    QFileDevice *const file = qobject_cast<QFileDevice *>(io.get());
+    if (file && file->handle() >= 0 && !file->isSequential() && !file->isTextModeEnabled()
+        && (direction == Input ? file->isReadable() : file->isWritable())) {
+        // QFileDevice reads ahead and buffers writes; hand over the
+        // file at the logical position, also for writing because a
+        // readable file may have read ahead
+        if (file->flush()
+            && ::lseek(file->handle(), file->pos(), SEEK_SET) == file->pos()) {
+            m_fd = file->handle();
+            m_data = Data(m_fd);
+            return;
+        }
+    }
+#endif
+
+    m_provider.reset(new QIODeviceDataProvider(io));
+    m_data = Data(m_provider.get());
+}
+
+_detail::IODeviceData::~IODeviceData()
+{
+    if (m_pos >= 0) {
+        // let the buffer know how much the engine consumed
+        const off_t consumed = m_data.seek(0, SEEK_CUR);
+        if (consumed > 0) {
+            m_io->seek(m_pos + consumed);
+        }
+    }
+    m_data = GpgME::Data::null;
+#ifndef Q_OS_WIN
+    if (m_fd >= 0) {
+        // let the device know where the engine left the file
+        const off_t pos = ::lseek(m_fd, 0, SEEK_CUR);
+        if (pos >= 0) {
+            m_io->seek(pos);
+        }
+    }
+#endif
+}
+
+QEvent::Type _detail::FunctionEvent::eventType()
+{
+    static const QEvent::Type type = static_cast<QEvent::Type>(QEvent::registerEventType());
+    return type;
+}
+
+namespace
+{
+/* A thread of the pool.  It waits for functions to run and does not
+   need an event loop.  A worker which was idle for some time asks
+   the scheduler whether it is still needed.  */
+class Worker : public QThread
+{
+public:
+    Worker() : QThread(), m_quit(false), protocol(UnknownProtocol) {}
+
+    void setFunction(const std::function<void()> &function,
+                     const std::function<void()> &cancel)
+    {
+        const QMutexLocker locker(&m_mutex);
+        m_function = function;
+        m_cancel = cancel;
+        m_cond.wakeOne();
+    }
+
+    /* Cancel the function being run, if any.  */
+    void cancel()
+    {
+        std::function<void()> function;
+        {
+            const QMutexLocker locker(&m_mutex);
+            function = m_cancel;
+        }
+        if (function) {
+            function();
+        }
+    }
+
+    void quit()
+    {
+        const QMutexLocker locker(&m_mutex);
+        m_quit = true;
+        m_cond.wakeOne();
+    }
+
+private:
+    void run() Q_DECL_OVERRIDE;
+
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    std::function<void()> m_function;
+    std::function<void()> m_cancel;
+    bool m_quit;
+
+public:
+    /* The protocol of the job the worker is assigned to.  Protected
+       by the lock of the scheduler.  */
+    Protocol protocol;
+};
+}
+
+class _detail::JobScheduler::Private
+{
+public:
+    struct Item {
+        quint64 id;
+        Protocol protocol;
+        StartFunction start;
+    };
+
+    Private() : keepWorkers(qMax(QThread::idealThreadCount(), 2)), nextId(1), stopped(false) {}
+
+    bool limitReached(Protocol protocol) const
+    {
+        const std::map<Protocol, int>::const_iterator limit = limits.find(protocol);
+        if (limit == limits.end()) {
+            return false;
+        }
+        const std::map<Protocol, int>::const_iterator count = running.find(protocol);
+        return count != running.end() && count->second >= limit->second;
+    }
+
+    void dispatch();
+
+    QMutex mutex;
+    /* The number of workers which are kept when they are idle.  */
+    const int keepWorkers;
+    quint64 nextId;
+    bool stopped;
+    std::list<Item> queue;
+    std::vector<Worker *> workers;
+    std::vector<Worker *> idle;
+    /* Workers which have been retired but not yet deleted.  */
+    std::vector<Worker *> retired;
+    std::map<Protocol, int> running;
+    std::map<Protocol, int> limits;
+};
+
+/* Assign queued jobs to idle workers.  A new worker is created if all
+   are busy; the number of running jobs is only limited per protocol
+   by setMaxRunningJobs().  A fixed number of workers could deadlock
+   if all of them run jobs waiting for a job which is still queued.
+   The start functions are called without the lock because they lock
+   the job.  */
+void _detail::JobScheduler::Private::dispatch()
+{
+    std::vector<std::pair<StartFunction, QThread *> > starts;
+    std::vector<Worker *> finished;
+    {
+        const QMutexLocker locker(&mutex);
+        if (stopped) {
+            return;
+        }
+        finished.swap(retired);
+        std::list<Item>::iterator it = queue.begin();
+        while (it != queue.end()) {
+            if (limitReached(it->protocol)) {
+                ++it;
+                continue;
+            }
+            Worker *worker;
+            if (!idle.empty()) {
+                worker = idle.back();
+                idle.pop_back();
+            } else {
+                worker = new Worker;
+                workers.push_back(worker);
+                worker->start();
+            }
+            worker->protocol = it->protocol;
+            running[it->protocol]++;
+            starts.push_back(std::make_pair(it->start, worker));
+            it = queue.erase(it);
+        }
+    }
+    for (const std::pair<StartFunction, QThread *> &start : starts) {
+        start.first(start.second);
+    }
+    // a retired worker has left its loop and does not dispatch
+    for (Worker *worker : finished) {
+        worker->wait();
+        delete worker;
+    }
+}
+
+/* The time in milliseconds after which an idle worker is stopped if
+   there are more than keepWorkers.  */
+static const unsigned long IdleTimeout = 30000;
+
+/* The time in milliseconds to wait for a canceled job at shutdown.  */
+static const unsigned long ShutdownTimeout = 3000;
+
+void _detail::JobScheduler::shutdown()
+{
+    std::vector<Worker *> all;
+    std::vector<Worker *> finished;
+    {
+        const QMutexLocker locker(&d->mutex);
+        d->stopped = true;
+        all.swap(d->workers);
+        finished.swap(d->retired);
+        d->idle.clear();
+    }
+    for (Worker *worker : finished) {
+        worker->wait();
+        delete worker;
+    }
+    for (Worker *worker : all) {
+        worker->cancel();
+        worker->quit();
+    }
+    for (Worker *worker : all) {
+        // A worker which is still blocked, e.g. by an I/O device,
+        // is left to the end of the process.
+        if (worker->wait(ShutdownTimeout)) {
+            delete worker;
+        }
+    }
+}
+
+void Worker::run()
+{
+    Q_FOREVER {
+        std::function<void()> function;
+        {
+            QMutexLocker locker(&m_mutex);
+            while (!m_function && !m_quit) {
+                if (!m_cond.wait(&m_mutex, IdleTimeout) && !m_function && !m_quit) {
+                    // the scheduler may assign a job meanwhile
+                    locker.unlock();
+                    const bool retired = _detail::JobScheduler::instance()->retire(this);
+                    locker.relock();
+                    if (retired) {
+                        return;
+                    }
+                }
+            }
+            if (m_quit) {
+                return;
+            }
+            function.swap(m_function);
+        }
+        function();
+        {
+            const QMutexLocker locker(&m_mutex);
+            m_cancel = nullptr;
+        }
+        _detail::JobScheduler::instance()->release(this);
+    }
+}
+
+static void stopJobScheduler()
+{
+    _detail::JobScheduler::instance()->shutdown();
+}
+
+_detail::JobScheduler *_detail::JobScheduler::instance()
+{
+    // never deleted because jobs may outlive the application object
+    static JobScheduler *const scheduler = []() {
+        qAddPostRoutine(stopJobScheduler);
+        return new JobScheduler;
+    }();
+    return scheduler;
+}
+
+_detail::JobScheduler::JobScheduler()
+    : d(new Private)
+{
+}
+
+_detail::JobScheduler::~JobScheduler()
+{
+    delete d;
+}
+
+quint64 _detail::JobScheduler::enqueue(Protocol protocol, const StartFunction &start)
+{
+    quint64 id;
+    {
+        const QMutexLocker locker(&d->mutex);
+        id = d->nextId++;
+        const Private::Item item = { id, protocol, start };
+        d->queue.push_back(item);
+    }
+    d->dispatch();
+    return id;
+}
+
+bool _detail::JobScheduler::dequeue(quint64 id)
+{
+    const QMutexLocker locker(&d->mutex);
+    for (std::list<Private::Item>::iterator it = d->queue.begin(); it != d->queue.end(); ++it) {
+        if (it->id == id) {
+            d->queue.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
+void _detail::JobScheduler::runOn(QThread *worker, const std::function<void()> &function,
+                                  const std::function<void()> &cancel)
+{
+    static_cast<Worker *>(worker)->setFunction(function, cancel);
+}
+
+void _detail::JobScheduler::release(QThread *thread)
+{
+    Worker *const worker = static_cast<Worker *>(thread);
+    {
+        const QMutexLocker locker(&d->mutex);
+        d->running[worker->protocol]--;
+        worker->protocol = UnknownProtocol;
+        // a worker released after shutdown just finishes
+        if (std::find(d->workers.begin(), d->workers.end(), worker) != d->workers.end()) {
+            d->idle.push_back(worker);
+        }
+    }
+    d->dispatch();
+}
+
+bool _detail::JobScheduler::retire(QThread *thread)
+{
+    Worker *const worker = static_cast<Worker *>(thread);
+    const QMutexLocker locker(&d->mutex);
+    if (d->stopped || static_cast<int>(d->workers.size()) <= d->keepWorkers) {
+        return false;
+    }
+    const std::vector<Worker *>::iterator it = std::find(d->idle.begin(), d->idle.end(), worker);
+    if (it == d->idle.end()) {
+        return false;
+    }
+    d->idle.erase(it);
+    d->workers.erase(std::find(d->workers.begin(), d->workers.end(), worker));
+    d->retired.push_back(worker);
+    return true;
+}
+
+int _detail::JobScheduler::maxRunningJobs(Protocol protocol) const
+{
+    const QMutexLocker locker(&d->mutex);
+    const std::map<Protocol, int>::const_iterator it = d->limits.find(protocol);
+    return it == d->limits.end() ? 0 : it->second;
+}
+
+void _detail::JobScheduler::setMaxRunningJobs(Protocol protocol, int count)
+{
+    {
+        const QMutexLocker locker(&d->mutex);
+        if (count > 0) {
+            d->limits[protocol] = count;
+        } else {
+            d->limits.erase(protocol);
+        }
+    }
+    // a higher limit may allow to start queued jobs
+    d->dispatch();
+}
+
+/* The number of batches the receiver may fall behind.  */
+static const unsigned int MaxPendingKeyBatches = 4;
+
+_detail::KeyBatcher::KeyBatcher(const std::shared_ptr<JobTask> &task, const DeliverFunction &deliver,
+                                unsigned int batchSize, unsigned int interval)
+    : m_task(task),
+      m_deliver(deliver),
+      m_batchSize(qMax(batchSize, 1u)),
+      m_interval(interval),
+      m_batch(),
+      m_timer(),
+      m_first(true),
+      m_pending(0),
+      m_canceled(false)
+{
+    m_batch.reserve(m_batchSize);
+    m_timer.start();
+}
+
+bool _detail::KeyBatcher::add(const Key &key)
+{
+    m_batch.push_back(key);
+    if (m_first || m_batch.size() >= m_batchSize
+        || (m_interval && m_timer.elapsed() >= m_interval)) {
+        m_first = false;
+        return flush();
+    }
+    return true;
+}
+
+bool _detail::KeyBatcher::flush()
+{
+    {
+        const QMutexLocker locker(&m_mutex);
+        while (m_pending >= MaxPendingKeyBatches && !m_canceled) {
+            m_cond.wait(&m_mutex);
+        }
+        if (m_canceled) {
+            return false;
+        }
+        if (m_batch.empty()) {
+            return true;
+        }
+        m_pending++;
+    }
+
+    const std::shared_ptr<std::vector<Key> > batch(new std::vector<Key>);
+    batch->swap(m_batch);
+    m_batch.reserve(m_batchSize);
+    m_timer.restart();
+
+    const std::shared_ptr<KeyBatcher> self = shared_from_this();
+    if (!m_task->post([self, batch]() {
+            self->m_deliver(*batch);
+            self->delivered();
+        })) {
+        // the job is gone
+        cancel();
+        return false;
+    }
+    return true;
+}
+
+void _detail::KeyBatcher::delivered()
+{
+    const QMutexLocker locker(&m_mutex);
+    m_pending--;
+    m_cond.wakeAll();
+}
+
+void _detail::KeyBatcher::cancel()
+{
+    const QMutexLocker locker(&m_mutex);
+    m_canceled = true;
+    m_cond.wakeAll();
+}
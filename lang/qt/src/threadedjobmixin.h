@@ -35,17 +35,25 @@
 #ifndef __QGPGME_THREADEDJOBMIXING_H__
 #define __QGPGME_THREADEDJOBMIXING_H__
 
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QEvent>
 #include <QMutex>
 #include <QMutexLocker>
 #include <QThread>
 #include <QString>
 #include <QIODevice>
+#include <QWaitCondition>
 
 #ifdef BUILDING_QGPGME
 # include "context.h"
+# include "data.h"
+# include "key.h"
 # include "interfaces/progressprovider.h"
 #else
 # include <gpgme++/context.h>
+# include <gpgme++/data.h>
+# include <gpgme++/key.h>
 # include <gpgme++/interfaces/progressprovider.h>
 #endif
 
@@ -53,9 +61,14 @@
 
 #include <cassert>
 #include <functional>
+#include <memory>
+#include <type_traits>
+#include <vector>
 
 namespace QGpgME
 {
+class QIODeviceDataProvider;
+
 namespace _detail
 {
 
@@ -91,33 +104,191 @@ public:
     }
 };
 
-template <typename T_result>
-class Thread : public QThread
+/* The data object for an input or an output device of a job.  Where
+   possible the device is not accessed through the callbacks of a
+   QIODeviceDataProvider: the contents of a read-only QBuffer are used
+   without copying them and files are passed by their file descriptor
+   so that the engine can use them directly.  */
+class IODeviceData
 {
 public:
-    explicit Thread(QObject *parent = Q_NULLPTR) : QThread(parent) {}
+    enum Direction {
+        Input,
+        Output
+    };
+
+    IODeviceData(const std::shared_ptr<QIODevice> &io, Direction direction);
+    ~IODeviceData();
 
-    void setFunction(const std::function<T_result()> &function)
+    GpgME::Data &data()
     {
-        const QMutexLocker locker(&m_mutex);
-        m_function = function;
+        return m_data;
     }
 
-    T_result result() const
+private:
+    IODeviceData(const IODeviceData &) = delete;
+    IODeviceData &operator=(const IODeviceData &) = delete;
+
+    const std::shared_ptr<QIODevice> m_io;
+    std::unique_ptr<QIODeviceDataProvider> m_provider;
+    QByteArray m_array;
+    qint64 m_pos;  // the position of the QBuffer or -1
+    int m_fd;
+    GpgME::Data m_data;
+};
+
+/* An event which runs a function in the thread of its receiver. */
+class FunctionEvent : public QEvent
+{
+public:
+    explicit FunctionEvent(const std::function<void()> &function)
+        : QEvent(eventType()), m_function(function) {}
+
+    static QEvent::Type eventType();
+
+    void run() const
     {
-        const QMutexLocker locker(&m_mutex);
-        return m_result;
+        m_function();
     }
 
 private:
-    void run() Q_DECL_OVERRIDE {
-        const QMutexLocker locker(&m_mutex);
-        m_result = m_function();
+    const std::function<void()> m_function;
+};
+
+/* The job scheduler runs the operations of the threaded jobs on a
+   process wide pool of worker threads.  The pool grows when all
+   workers are busy, thus a job waiting for the user or for another
+   job does not block the others.  Idle workers are reused; those
+   exceeding one per core are stopped after a while.  Queued jobs are
+   started in FIFO order, unless the limit of running jobs of their
+   protocol set by the application is reached; then the next job of
+   another protocol is started.  */
+class JobScheduler
+{
+public:
+    /* Called with the worker assigned to a queued job.  The job must
+       pass the operation to runOn() or the worker to release().  */
+    typedef std::function<void(QThread *worker)> StartFunction;
+
+    static JobScheduler *instance();
+
+    quint64 enqueue(GpgME::Protocol protocol, const StartFunction &start);
+    bool dequeue(quint64 id);
+
+    /* Run FUNCTION on WORKER.  CANCEL is called from another thread
+       to stop FUNCTION if the scheduler is shut down meanwhile.  */
+    void runOn(QThread *worker, const std::function<void()> &function,
+               const std::function<void()> &cancel);
+    void release(QThread *worker);
+
+    /* Called by an idle WORKER; returns true if it shall stop.  */
+    bool retire(QThread *worker);
+
+    int maxRunningJobs(GpgME::Protocol protocol) const;
+    void setMaxRunningJobs(GpgME::Protocol protocol, int count);
+
+    /* Cancel the running jobs and stop the workers; called when the
+       application object is destroyed.  */
+    void shutdown();
+
+private:
+    class Private;
+    JobScheduler();
+    ~JobScheduler();
+    Private *const d;
+};
+
+/* The state of the operation of a job which is shared with the job
+   scheduler.  The job pointer is cleared when the job is destroyed so
+   that no events are posted to it afterwards.  */
+class JobTask
+{
+public:
+    enum State {
+        Idle,
+        Queued,
+        Assigned,
+        Running,
+        Finished
+    };
+
+    JobTask() : job(nullptr), state(Idle), id(0), worker(nullptr), canceled(false) {}
+
+    /* Post FUNCTION to the job; returns false if the job is gone.  */
+    bool post(const std::function<void()> &function)
+    {
+        const QMutexLocker locker(&mutex);
+        if (!job) {
+            return false;
+        }
+        QCoreApplication::postEvent(job, new FunctionEvent(function));
+        return true;
     }
+
+    QMutex mutex;
+    QObject *job;
+    State state;
+    quint64 id;
+    QThread *worker;
+    bool canceled;
+};
+
+/* Set the first element of a result tuple to a canceled error if it
+   can be constructed from an error.  */
+template <typename T>
+typename std::enable_if<std::is_constructible<T, GpgME::Error>::value>::type
+set_canceled(T &t)
+{
+    t = T(GpgME::Error::fromCode(GPG_ERR_CANCELED));
+}
+
+template <typename T>
+typename std::enable_if<!std::is_constructible<T, GpgME::Error>::value>::type
+set_canceled(T &)
+{
+}
+
+/* Collects the keys listed in the worker thread of a key listing job
+   and passes them in batches to the thread of the job.  A batch is
+   passed on when it has the given size or the given number of
+   milliseconds passed since the last batch; the first key is passed
+   on right away.  If the receiver falls behind, the worker waits
+   until it caught up instead of piling up the keys.  */
+class KeyBatcher : public std::enable_shared_from_this<KeyBatcher>
+{
+public:
+    /* Called in the thread of the job for each batch.  */
+    typedef std::function<void(const std::vector<GpgME::Key> &)> DeliverFunction;
+
+    KeyBatcher(const std::shared_ptr<JobTask> &task, const DeliverFunction &deliver,
+               unsigned int batchSize, unsigned int interval);
+
+    /* Add KEY to the current batch.  Returns false if the listing
+       has been canceled.  */
+    bool add(const GpgME::Key &key);
+
+    /* Pass on the current batch.  Returns false if the listing has
+       been canceled.  */
+    bool flush();
+
+    /* Cancel the listing and wake up a waiting worker.  */
+    void cancel();
+
 private:
-    mutable QMutex m_mutex;
-    std::function<T_result()> m_function;
-    T_result m_result;
+    void delivered();
+
+    const std::shared_ptr<JobTask> m_task;
+    const DeliverFunction m_deliver;
+    const unsigned int m_batchSize;
+    const unsigned int m_interval;
+    std::vector<GpgME::Key> m_batch;
+    QElapsedTimer m_timer;
+    bool m_first;
+
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    unsigned int m_pending;
+    bool m_canceled;
 };
 
 template <typename T_base, typename T_result = std::tuple<GpgME::Error, QString, GpgME::Error> >
@@ -148,15 +319,14 @@ protected:
                   "Last result type not a GpgME::Error");
 
     explicit ThreadedJobMixin(GpgME::Context *ctx)
-        : T_base(nullptr), m_ctx(ctx), m_thread(), m_auditLog(), m_auditLogError()
+        : T_base(nullptr), m_ctx(ctx), m_task(new JobTask), m_auditLog(), m_auditLogError()
     {
     }
 
     void lateInitialization()
     {
         assert(m_ctx);
-        QObject::connect(&m_thread, &QThread::finished, this,
-                         &mixin_type::slotFinished);
+        m_task->job = this;
         m_ctx->setProgressProvider(this);
         QGpgME::g_context_map.insert(this, m_ctx.get());
     }
@@ -164,53 +334,66 @@ protected:
     ~ThreadedJobMixin()
     {
         QGpgME::g_context_map.remove(this);
+        JobTask::State state;
+        quint64 id;
+        QThread *worker;
+        {
+            const QMutexLocker locker(&m_task->mutex);
+            m_task->job = nullptr;
+            state = m_task->state;
+            id = m_task->id;
+            worker = m_task->worker;
+        }
+        // Don't call the scheduler with the lock held; it may start
+        // other jobs.  If the job has been dispatched meanwhile, the
+        // start function sees that the job is gone.
+        if (state == JobTask::Queued) {
+            JobScheduler::instance()->dequeue(id);
+        } else if (state == JobTask::Assigned) {
+            // the start event is dropped with this object
+            JobScheduler::instance()->release(worker);
+        }
     }
 
     template <typename T_binder>
     void run(const T_binder &func)
     {
-        m_thread.setFunction(std::bind(func, this->context()));
-        m_thread.start();
+        schedule(std::bind(func, this->context()), {});
     }
     template <typename T_binder>
     void run(const T_binder &func, const std::shared_ptr<QIODevice> &io)
     {
-        if (io) {
-            io->moveToThread(&m_thread);
-        }
-        // the arguments passed here to the functor are stored in a QThread, and are not
+        // the arguments passed here to the functor are stored in the job, and are not
         // necessarily destroyed (living outside the UI thread) at the time the result signal
         // is emitted and the signal receiver wants to clean up IO devices.
         // To avoid such races, we pass std::weak_ptr's to the functor.
-        m_thread.setFunction(std::bind(func, this->context(), this->thread(), std::weak_ptr<QIODevice>(io)));
-        m_thread.start();
+        schedule(std::bind(func, this->context(), this->thread(), std::weak_ptr<QIODevice>(io)),
+                 {io});
     }
     template <typename T_binder>
     void run(const T_binder &func, const std::shared_ptr<QIODevice> &io1, const std::shared_ptr<QIODevice> &io2)
     {
-        if (io1) {
-            io1->moveToThread(&m_thread);
-        }
-        if (io2) {
-            io2->moveToThread(&m_thread);
-        }
-        // the arguments passed here to the functor are stored in a QThread, and are not
+        // the arguments passed here to the functor are stored in the job, and are not
         // necessarily destroyed (living outside the UI thread) at the time the result signal
         // is emitted and the signal receiver wants to clean up IO devices.
         // To avoid such races, we pass std::weak_ptr's to the functor.
-        m_thread.setFunction(std::bind(func, this->context(), this->thread(), std::weak_ptr<QIODevice>(io1), std::weak_ptr<QIODevice>(io2)));
-        m_thread.start();
+        schedule(std::bind(func, this->context(), this->thread(), std::weak_ptr<QIODevice>(io1), std::weak_ptr<QIODevice>(io2)),
+                 {io1, io2});
     }
     GpgME::Context *context() const
     {
         return m_ctx.get();
     }
+    std::shared_ptr<JobTask> jobTask() const
+    {
+        return m_task;
+    }
 
     virtual void resultHook(const result_type &) {}
 
     void slotFinished()
     {
-        const T_result r = m_thread.result();
+        const T_result r = m_result;
         m_auditLog = std::get < std::tuple_size<T_result>::value - 2 > (r);
         m_auditLogError = std::get < std::tuple_size<T_result>::value - 1 > (r);
         resultHook(r);
@@ -219,11 +402,36 @@ protected:
         this->deleteLater();
     }
     void slotCancel() Q_DECL_OVERRIDE {
-        if (m_ctx)
+        JobTask::State state;
+        quint64 id;
+        {
+            // a job which is about to be started sees the flag
+            const QMutexLocker locker(&m_task->mutex);
+            m_task->canceled = true;
+            state = m_task->state;
+            id = m_task->id;
+        }
+        if (state == JobTask::Queued && JobScheduler::instance()->dequeue(id))
+        {
+            // the job never got a worker; report the cancel right away
+            {
+                const QMutexLocker locker(&m_task->mutex);
+                m_task->state = JobTask::Finished;
+            }
+            finishCanceled();
+        } else if (m_ctx)
         {
             m_ctx->cancelPendingOperation();
         }
     }
+    bool event(QEvent *e) Q_DECL_OVERRIDE {
+        if (e->type() == FunctionEvent::eventType())
+        {
+            static_cast<FunctionEvent *>(e)->run();
+            return true;
+        }
+        return T_base::event(e);
+    }
     QString auditLogAsHtml() const Q_DECL_OVERRIDE
     {
         return m_auditLog;
@@ -245,6 +453,106 @@ protected:
         Q_ARG(int, total));
     }
 private:
+    void schedule(const std::function<T_result()> &function,
+                  const std::vector<std::shared_ptr<QIODevice> > &ios)
+    {
+        m_function = function;
+        m_ios.clear();
+        for (const std::shared_ptr<QIODevice> &io : ios) {
+            if (io) {
+                m_ios.push_back(io);
+            }
+        }
+        const std::shared_ptr<JobTask> task = m_task;
+        mixin_type *const self = this;
+        {
+            const QMutexLocker locker(&task->mutex);
+            task->state = JobTask::Queued;
+            task->canceled = false;
+        }
+        // The start function may be called by the scheduler in any
+        // thread and even before enqueue() returns; the job itself is
+        // only touched in its own thread.
+        const quint64 id = JobScheduler::instance()->enqueue(m_ctx->protocol(), [task, self](QThread *worker) {
+            const QMutexLocker locker(&task->mutex);
+            task->state = JobTask::Assigned;
+            task->worker = worker;
+            if (!task->job) {
+                JobScheduler::instance()->release(worker);
+                return;
+            }
+            QCoreApplication::postEvent(task->job, new FunctionEvent([self, worker]() {
+                self->startOn(worker);
+            }));
+        });
+        const QMutexLocker locker(&task->mutex);
+        task->id = id;
+    }
+
+    // Runs in the job's thread.
+    void startOn(QThread *worker)
+    {
+        bool canceled;
+        {
+            const QMutexLocker locker(&m_task->mutex);
+            canceled = m_task->canceled;
+            m_task->state = canceled ? JobTask::Finished : JobTask::Running;
+        }
+        if (canceled) {
+            JobScheduler::instance()->release(worker);
+            m_ios.clear();
+            m_function = nullptr;
+            finishCanceled();
+            return;
+        }
+
+        for (const std::weak_ptr<QIODevice> &weak : m_ios) {
+            if (const std::shared_ptr<QIODevice> io = weak.lock()) {
+                io->moveToThread(worker);
+            }
+        }
+        m_ios.clear();
+
+        const std::shared_ptr<JobTask> task = m_task;
+        const std::shared_ptr<GpgME::Context> ctx = m_ctx;
+        const std::function<T_result()> function = m_function;
+        m_function = nullptr;
+        const std::weak_ptr<GpgME::Context> weakCtx = ctx;
+        mixin_type *const self = this;
+        // the worker is released by the scheduler after the function;
+        // the context is kept alive in case the job is deleted meanwhile
+        // but not by the cancel function, which the scheduler may keep
+        // a little longer
+        JobScheduler::instance()->runOn(worker, [task, ctx, function, self]() {
+            const std::shared_ptr<T_result> result(new T_result(function()));
+            {
+                const QMutexLocker locker(&task->mutex);
+                task->state = JobTask::Finished;
+            }
+            task->post([self, result]() {
+                self->m_result = *result;
+                self->slotFinished();
+            });
+        }, [weakCtx]() {
+            if (const std::shared_ptr<GpgME::Context> c = weakCtx.lock()) {
+                c->cancelPendingOperation();
+            }
+        });
+    }
+
+    void finishCanceled()
+    {
+        T_result r;
+        set_canceled(std::get<0>(r));
+        const std::shared_ptr<T_result> result(new T_result(r));
+        mixin_type *const self = this;
+        // emit the signals from the event loop as for a finished job
+        m_task->post([self, result]() {
+            self->m_result = *result;
+            self->slotFinished();
+        });
+    }
+
     template <typename T1, typename T2>
     void doEmitResult(const std::tuple<T1, T2> &tuple)
     {
@@ -271,9 +579,12 @@ private:
 
 private:
     std::shared_ptr<GpgME::Context> m_ctx;
-    Thread<T_result> m_thread;
+    const std::shared_ptr<JobTask> m_task;
+    std::function<T_result()> m_function;
+    std::vector<std::weak_ptr<QIODevice> > m_ios;
     QString m_auditLog;
     GpgME::Error m_auditLogError;
+    T_result m_result;
 };
 
 }
@@ -38,6 +38,7 @@
 #include <QTemporaryDir>
 #include <QSignalSpy>
 #include <QBuffer>
+#include <QTemporaryFile>
 #include "keylistjob.h"
 #include "encryptjob.h"
 #include "signencryptjob.h"
@@ -157,6 +158,57 @@ private Q_SLOTS:
         QVERIFY(spy.wait(QSIGNALSPY_TIMEOUT));
     }
 
+    void testEncryptDecryptFiles()
+    {
+        auto listjob = openpgp()->keyListJob(false, false, false);
+        std::vector<Key> keys;
+        auto keylistresult = listjob->exec(QStringList() << QStringLiteral("alfa@example.net"),
+                                          false, keys);
+        QVERIFY(!keylistresult.error());
+        QVERIFY(keys.size() == 1);
+        delete listjob;
+
+        // files are passed to the engine by their file descriptor
+        const std::shared_ptr<QTemporaryFile> plainFile(new QTemporaryFile);
+        const std::shared_ptr<QTemporaryFile> cipherFile(new QTemporaryFile);
+        QVERIFY(plainFile->open());
+        QVERIFY(cipherFile->open());
+        plainFile->write("Hello File World");
+        QVERIFY(plainFile->seek(0));
+
+        auto job = openpgp()->encryptJob(/*ASCII Armor */true, /* Textmode */ false);
+        QVERIFY(job);
+        connect(job, &EncryptJob::result, this, [this] (const GpgME::EncryptionResult &result,
+                                                        const QByteArray &,
+                                                        const QString,
+                                                        const GpgME::Error) {
+                QVERIFY(!result.error());
+                Q_EMIT asyncDone();
+            });
+        job->start(keys, plainFile, cipherFile, Context::AlwaysTrust);
+        QSignalSpy spy (this, SIGNAL(asyncDone()));
+        QVERIFY(spy.wait(QSIGNALSPY_TIMEOUT));
+
+        QVERIFY(cipherFile->pos() > 0);
+        QVERIFY(cipherFile->seek(0));
+        const QByteArray cipherText = cipherFile->readAll();
+        QVERIFY(cipherText.startsWith("-----BEGIN PGP MESSAGE-----"));
+
+        if (!loopbackSupported()) {
+            return;
+        }
+        auto decJob = openpgp()->decryptJob();
+        auto ctx = Job::context(decJob);
+        TestPassphraseProvider provider;
+        ctx->setPassphraseProvider(&provider);
+        ctx->setPinentryMode(Context::PinentryLoopback);
+        QByteArray plainText;
+        auto decResult = decJob->exec(cipherText, plainText);
+        QVERIFY(!decResult.error());
+        QCOMPARE(plainText, QByteArray("Hello File World"));
+        delete decJob;
+    }
+
     void testSymmetricEncryptDecrypt()
     {
         if (!loopbackSupported()) {
@@ -0,0 +1,234 @@
+/* t-jobscheduler.cpp
+
+    This file is part of qgpgme, the Qt API binding for gpgme
+    Copyright (c) 2020 g10 Code GmbH
+
+    QGpgME is free software; you can redistribute it and/or
+    modify it under the terms of the GNU General Public License as
+    published by the Free Software Foundation; either version 2 of the
+    License, or (at your option) any later version.
+
+    QGpgME is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+    General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program; if not, write to the Free Software
+    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+
+    In addition, as a special exception, the copyright holders give
+    permission to link the code of this program with any edition of
+    the Qt library by Trolltech AS, Norway (or with modified versions
+    of Qt that use the same license as Qt), and distribute linked
+    combinations including the two.  You must obey the GNU General
+    Public License in all respects for all of the code used other than
+    Qt.  If you modify this file, you may extend this exception to
+    your version of the file, but you are not obligated to do so.  If
+    you do not wish to do so, delete this exception statement from
+    your version.
+*/
+
+#ifdef HAVE_CONFIG_H
+ #include "config.h"
+#endif
+
+#include <QDebug>
+#include <QTest>
+#include <QSignalSpy>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+#include "decryptjob.h"
+#include "keylistjob.h"
+#include "protocol.h"
+#include "decryptionresult.h"
+#include "keylistresult.h"
+#include "engineinfo.h"
+
+#include "t-support.h"
+
+#include <memory>
+#include <vector>
+
+using namespace QGpgME;
+using namespace GpgME;
+
+/* A device which blocks the engine reading from it until it is
+   opened.  Then it returns EOF.  */
+class BlockingDevice : public QIODevice
+{
+public:
+    BlockingDevice() : QIODevice(), m_reading(false), m_opened(false)
+    {
+        QIODevice::open(QIODevice::ReadOnly | QIODevice::Unbuffered);
+    }
+
+    bool isSequential() const Q_DECL_OVERRIDE
+    {
+        return true;
+    }
+
+    /* Wait until a job reads from the device.  */
+    bool waitForReading(unsigned long timeout)
+    {
+        const QMutexLocker locker(&m_mutex);
+        if (!m_reading) {
+            m_cond.wait(&m_mutex, timeout);
+        }
+        return m_reading;
+    }
+
+    void unblock()
+    {
+        const QMutexLocker locker(&m_mutex);
+        m_opened = true;
+        m_cond.wakeAll();
+    }
+
+protected:
+    qint64 readData(char *, qint64) Q_DECL_OVERRIDE
+    {
+        const QMutexLocker locker(&m_mutex);
+        m_reading = true;
+        m_cond.wakeAll();
+        while (!m_opened) {
+            m_cond.wait(&m_mutex);
+        }
+        return 0;
+    }
+
+    qint64 writeData(const char *, qint64) Q_DECL_OVERRIDE
+    {
+        return -1;
+    }
+
+private:
+    QMutex m_mutex;
+    QWaitCondition m_cond;
+    bool m_reading;
+    bool m_opened;
+};
+
+struct JobResult
+{
+    JobResult() : done(false) {}
+
+    bool done;
+    Error error;
+};
+
+class JobSchedulerTest: public QGpgMETest
+{
+    Q_OBJECT
+
+private:
+    Job *startDecrypt(const std::shared_ptr<BlockingDevice> &input, JobResult *result)
+    {
+        auto job = openpgp()->decryptJob();
+        connect(job, &DecryptJob::result, this,
+                [result] (const DecryptionResult &res, const QByteArray &, const QString &, const Error &) {
+            result->done = true;
+            result->error = res.error();
+        });
+        job->start(input);
+        return job;
+    }
+
+    Job *startKeyList(const QGpgME::Protocol *protocol, JobResult *result)
+    {
+        auto job = protocol->keyListJob(false, false, false);
+        connect(job, &KeyListJob::result, this,
+                [result] (const KeyListResult &res, const std::vector<Key> &, const QString &, const Error &) {
+            result->done = true;
+            result->error = res.error();
+        });
+        result->error = job->start(QStringList());
+        return job;
+    }
+
+private Q_SLOTS:
+    void testQueuedJobs()
+    {
+        Job::setMaxRunningJobs(OpenPGP, 1);
+        QCOMPARE(Job::maxRunningJobs(OpenPGP), 1);
+        QCOMPARE(Job::maxRunningJobs(CMS), 0);
+
+        const auto input = std::make_shared<BlockingDevice>();
+        JobResult running;
+        auto runningJob = startDecrypt(input, &running);
+        QSignalSpy runningSpy(runningJob, &Job::done);
+        QVERIFY(input->waitForReading(QSIGNALSPY_TIMEOUT));
+
+        // The limit is reached; the next job is queued.
+        const auto queuedInput = std::make_shared<BlockingDevice>();
+        JobResult queued;
+        auto queuedJob = startDecrypt(queuedInput, &queued);
+        QSignalSpy queuedSpy(queuedJob, &Job::done);
+        QVERIFY(!queuedInput->waitForReading(500));
+
+        // A queued job is finished right away when it is canceled.
+        queuedJob->slotCancel();
+        QVERIFY(queuedSpy.wait(QSIGNALSPY_TIMEOUT));
+        QVERIFY(queued.done);
+        QCOMPARE(queued.error.code(), static_cast<int>(GPG_ERR_CANCELED));
+        QVERIFY(!running.done);
+
+        // The jobs of other protocols are not limited.
+        if (!checkEngine(CMS)) {
+            JobResult other;
+            auto otherJob = startKeyList(smime(), &other);
+            QVERIFY(!other.error);
+            QSignalSpy otherSpy(otherJob, &Job::done);
+            QVERIFY(otherSpy.wait(QSIGNALSPY_TIMEOUT));
+            QVERIFY(other.done);
+            QVERIFY(!running.done);
+        }
+
+        input->unblock();
+        queuedInput->unblock();
+        QVERIFY(runningSpy.wait(QSIGNALSPY_TIMEOUT));
+        QVERIFY(running.done);
+        QVERIFY(running.error);
+
+        Job::setMaxRunningJobs(OpenPGP, 0);
+        QCOMPARE(Job::maxRunningJobs(OpenPGP), 0);
+    }
+
+    void testPoolGrows()
+    {
+        // Without a limit all jobs run at once, even if there are
+        // more jobs waiting than cores.
+        const int count = qMax(QThread::idealThreadCount(), 2) + 1;
+        std::vector<std::shared_ptr<BlockingDevice> > inputs;
+        std::vector<JobResult> results(count);
+        int finished = 0;
+        for (int i = 0; i < count; i++) {
+            inputs.push_back(std::make_shared<BlockingDevice>());
+            auto job = startDecrypt(inputs.back(), &results[i]);
+            connect(job, &Job::done, this, [&finished] () {
+                finished++;
+            });
+        }
+        for (const auto &input : inputs) {
+            QVERIFY(input->waitForReading(QSIGNALSPY_TIMEOUT));
+        }
+
+        JobResult other;
+        auto otherJob = startKeyList(openpgp(), &other);
+        QVERIFY(!other.error);
+        QSignalSpy otherSpy(otherJob, &Job::done);
+        QVERIFY(otherSpy.wait(QSIGNALSPY_TIMEOUT));
+        QVERIFY(other.done);
+        QVERIFY(!other.error);
+
+        for (const auto &input : inputs) {
+            input->unblock();
+        }
+        QTRY_COMPARE_WITH_TIMEOUT(finished, count, QSIGNALSPY_TIMEOUT);
+    }
+};
+
+QTEST_MAIN(JobSchedulerTest)
+
+#include "t-jobscheduler.moc"
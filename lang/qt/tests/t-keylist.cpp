@@ -141,6 +141,43 @@ private Q_SLOTS:
         QVERIFY(spy.wait(QSIGNALSPY_TIMEOUT));
     }
 
+    void testKeyListBatched()
+    {
+        std::vector<GpgME::Key> allKeys;
+        KeyListJob *syncJob = openpgp()->keyListJob();
+        QVERIFY(!syncJob->exec(QStringList(), false, allKeys).error());
+        delete syncJob;
+        QVERIFY(allKeys.size() > 5);
+
+        KeyListJob *job = openpgp()->keyListJob();
+        job->setKeyBatching(5, 0);
+        int batches = 0;
+        size_t total = 0;
+        int singleKeys = 0;
+        connect(job, &KeyListJob::nextKeys, this, [&batches, &total](const std::vector<Key> &keys) {
+            QVERIFY(!keys.empty() && keys.size() <= 5);
+            batches++;
+            total += keys.size();
+        });
+        connect(job, &KeyListJob::nextKey, this, [&singleKeys](const Key &) {
+            singleKeys++;
+        });
+        connect(job, &KeyListJob::result, this, [this, &total, &allKeys](KeyListResult result, std::vector<Key> keys, QString, Error)
+        {
+            QVERIFY(!result.error());
+            // all batches are emitted before the result
+            QCOMPARE(total, allKeys.size());
+            QVERIFY(keys.empty());
+            Q_EMIT asyncDone();
+        });
+        job->start(QStringList());
+        QSignalSpy spy (this, SIGNAL(asyncDone()));
+        QVERIFY(spy.wait(QSIGNALSPY_TIMEOUT));
+        // the first key comes in a batch of its own
+        QCOMPARE(batches, 1 + static_cast<int>((allKeys.size() - 1 + 4) / 5));
+        QCOMPARE(singleKeys, 0);
+    }
+
     void testListAllKeysSync()
     {
         const auto accumulateFingerprints = [](std::vector<std::string> &v, const Key &key) { v.push_back(std::string(key.primaryFingerprint())); return v; };
@@ -39,6 +39,9 @@
 #ifndef HAVE_W32_SYSTEM
 #include <sys/wait.h>
 #endif
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
 
 #include "gpgme.h"
 
@@ -101,6 +104,15 @@ ath_select (int nfd, fd_set *rset, fd_set *wset, fd_set *eset,
 }
 
 
+#ifdef HAVE_POLL
+int
+ath_poll (struct pollfd *fds, nfds_t nfds, int timeout)
+{
+  return poll (fds, nfds, timeout);
+}
+#endif
+
+
 gpgme_ssize_t
 ath_waitpid (pid_t pid, int *status, int options)
 {
@@ -44,6 +44,9 @@
 #  include <sys/types.h>
 # endif
 # include <sys/socket.h>
+# ifdef HAVE_POLL_H
+#  include <poll.h>
+# endif
 
 #endif  /*!HAVE_W32_SYSTEM*/
 
@@ -60,6 +63,7 @@
 #define ath_read _ATH_PREFIX(ath_read)
 #define ath_write _ATH_PREFIX(ath_write)
 #define ath_select _ATH_PREFIX(ath_select)
+#define ath_poll _ATH_PREFIX(ath_poll)
 #define ath_waitpid _ATH_PREFIX(ath_waitpid)
 #define ath_connect _ATH_PREFIX(ath_connect)
 #define ath_accept _ATH_PREFIX(ath_accept)
@@ -76,6 +80,9 @@ gpgme_ssize_t ath_read (int fd, void *buf, size_t nbytes);
 gpgme_ssize_t ath_write (int fd, const void *buf, size_t nbytes);
 gpgme_ssize_t ath_select (int nfd, fd_set *rset, fd_set *wset, fd_set *eset,
                            struct timeval *timeout);
+#ifdef HAVE_POLL
+int ath_poll (struct pollfd *fds, nfds_t nfds, int timeout);
+#endif
 gpgme_ssize_t ath_waitpid (pid_t pid, int *status, int options);
 int ath_accept (int s, struct sockaddr *addr, socklen_t *length_ptr);
 int ath_connect (int s, const struct sockaddr *addr, socklen_t length);
@@ -42,6 +42,9 @@ typedef enum
     OPDATA_QUERY_SWDB, OPDATA_SETEXPIRE, OPDATA_REVSIG
   } ctx_op_data_id_t;
 
+/* The number of ctx_op_data_id_t values.  */
+#define OPDATA_COUNT (OPDATA_REVSIG + 1)
+
 
 /* "gpgmeres" in ASCII.  */
 #define CTX_OP_DATA_MAGIC 0x736572656d677067ULL
@@ -51,10 +54,6 @@ struct ctx_op_data
      that ain't a result structure.  */
   unsigned long long magic;
 
-  /* The next element in the linked list, or NULL if this is the last
-     element.  Used by op data structures linked into a context.  */
-  struct ctx_op_data *next;
-
   /* The type of the hook data, which can be used by a routine to
      lookup the hook data.  */
   ctx_op_data_id_t type;
@@ -68,6 +67,9 @@ struct ctx_op_data
 
   /* The number of outstanding references.  */
   int references;
+
+  /* The size of the memory allocated for HOOK.  */
+  int size;
 };
 typedef struct ctx_op_data *ctx_op_data_t;
 
@@ -137,6 +139,9 @@ struct gpgme_context
   /* Pass --expert to gpg edit key. */
   unsigned int extended_edit : 1;
 
+  /* Use the process wide key cache.  */
+  unsigned int key_cache : 1;
+
   /* Flags for keylist mode.  */
   gpgme_keylist_mode_t keylist_mode;
 
@@ -174,8 +179,13 @@ struct gpgme_context
   /* The optional trust-model override.  */
   char *trust_model;
 
-  /* The operation data hooked into the context.  */
-  ctx_op_data_t op_data;
+  /* The operation data hooked into the context, indexed by its
+     type.  */
+  ctx_op_data_t op_data[OPDATA_COUNT];
+
+  /* Released operation data which is not referenced by the user and
+     can thus be reused by the next operation of the same type.  */
+  ctx_op_data_t op_data_spare[OPDATA_COUNT];
 
   /* The user provided passphrase callback and its hook value.  */
   gpgme_passphrase_cb_t passphrase_cb;
@@ -116,21 +116,36 @@ gpgme_data_new_from_filepart (gpgme_data_t *r_dh, const char *fname,
 
 
 /* Create a new data buffer filled with the content of file FNAME.
-   COPY must be non-zero (delayed reads are not supported yet).  */
+   If COPY is zero, the reads may be delayed by mapping a large file
+   into memory; otherwise the file is read at once.  */
 gpgme_error_t
 gpgme_data_new_from_file (gpgme_data_t *r_dh, const char *fname, int copy)
 {
   gpgme_error_t err;
   struct stat statbuf;
+  FILE *stream;
   TRACE_BEG  (DEBUG_DATA, "gpgme_data_new_from_file", r_dh,
 	      "file_name=%s, copy=%i (%s)", fname, copy, copy ? "yes" : "no");
 
-  if (!fname || !copy)
+  if (!fname)
     return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
 
   if (stat (fname, &statbuf) < 0)
     return TRACE_ERR (gpg_error_from_syserror ());
 
+  if (!copy)
+    {
+      stream = fopen (fname, "rb");
+      if (!stream)
+        return TRACE_ERR (gpg_error_from_syserror ());
+      err = _gpgme_data_new_from_mapped_file (r_dh, fileno (stream),
+                                              0, statbuf.st_size);
+      fclose (stream);
+      if (gpg_err_code (err) != GPG_ERR_NOT_SUPPORTED)
+        return TRACE_ERR (err);
+      /* Small files and files which can't be mapped are read.  */
+    }
+
   err = gpgme_data_new_from_filepart (r_dh, fname, NULL, 0, statbuf.st_size);
   return TRACE_ERR (err);
 }
@@ -28,6 +28,9 @@
 #ifdef HAVE_SYS_TYPES_H
 # include <sys/types.h>
 #endif
+#ifndef HAVE_W32_SYSTEM
+# include <fcntl.h>
+#endif
 
 #include "debug.h"
 #include "data.h"
@@ -85,3 +88,36 @@ gpgme_data_new_from_fd (gpgme_data_t *r_dh, int fd)
   TRACE_SUC ("dh=%p", *r_dh);
   return 0;
 }
+
+
+/* Return the file descriptor of DH if an engine may read from
+   (INBOUND is false) or write to (INBOUND is true) it directly
+   instead of going through the data handlers; return -1 otherwise.
+   This is only the case for objects created by
+   gpgme_data_new_from_fd which have no pending data and whose file
+   descriptor is in blocking mode and opened for the requested
+   direction.  Data objects using stdio or estream are not considered
+   because their read buffers would be bypassed.  */
+int
+_gpgme_data_get_passthrough_fd (gpgme_data_t dh, int inbound)
+{
+#ifdef HAVE_W32_SYSTEM
+  (void)dh;
+  (void)inbound;
+  return -1;
+#else
+  int flags;
+
+  if (!dh || dh->cbs != &fd_cbs || dh->pending_len)
+    return -1;
+
+  flags = fcntl (dh->data.fd, F_GETFL);
+  if (flags == -1 || (flags & O_NONBLOCK))
+    return -1;
+  flags &= O_ACCMODE;
+  if (inbound ? flags == O_RDONLY : flags == O_WRONLY)
+    return -1;
+
+  return dh->data.fd;
+#endif
+}
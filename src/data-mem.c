@@ -29,6 +29,15 @@
 #endif
 #include <assert.h>
 #include <string.h>
+#ifdef HAVE_SYS_TYPES_H
+# include <sys/types.h>
+#endif
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
+#ifdef HAVE_SYS_MMAN_H
+# include <sys/mman.h>
+#endif
 
 #include "data.h"
 #include "util.h"
@@ -152,6 +161,10 @@ mem_release (gpgme_data_t dh)
 {
   if (dh->data.mem.buffer)
     free (dh->data.mem.buffer);
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+  if (dh->data.mem.map)
+    munmap (dh->data.mem.map, dh->data.mem.map_size);
+#endif
 }
 
 
@@ -220,6 +233,109 @@ gpgme_data_new_from_mem (gpgme_data_t *r_dh, const char *buffer,
 }
 
 
+/* Files smaller than this are read into memory instead of being
+   mapped.  */
+#define DATA_MMAP_THRESHOLD (64 * 1024)
+
+/* Create a new data object for LENGTH bytes of the file FD starting
+   at OFFSET.  The file is mapped read-only so that the data does not
+   need to be copied to the heap.  The object is a memory based data
+   object whose ORIG_BUFFER points into the mapping; as with
+   gpgme_data_new_from_mem the data is only copied if it is modified.
+   Returns GPG_ERR_NOT_SUPPORTED if the file is not a regular file,
+   too small, does not hold the requested range, or can't be
+   mapped.  */
+gpgme_error_t
+_gpgme_data_new_from_mapped_file (gpgme_data_t *r_dh, int fd,
+                                  gpgme_off_t offset, size_t length)
+{
+#if defined(HAVE_MMAP) && defined(HAVE_SYS_MMAN_H)
+  gpgme_error_t err;
+  struct stat st;
+  long pagesize;
+  size_t delta;
+  void *map;
+  TRACE_BEG  (DEBUG_DATA, "_gpgme_data_new_from_mapped_file", r_dh,
+	      "fd=%d, offset=%lli, length=%zu",
+              fd, (long long int)offset, length);
+
+  if (fd == -1 || fstat (fd, &st) || !S_ISREG (st.st_mode)
+      || length < DATA_MMAP_THRESHOLD || offset < 0
+      || offset > st.st_size || length > st.st_size - offset)
+    return TRACE_ERR (gpg_error (GPG_ERR_NOT_SUPPORTED));
+
+  pagesize = sysconf (_SC_PAGESIZE);
+  if (pagesize <= 0)
+    return TRACE_ERR (gpg_error (GPG_ERR_NOT_SUPPORTED));
+  delta = offset % pagesize;
+  if (length + delta < length)
+    return TRACE_ERR (gpg_error (GPG_ERR_NOT_SUPPORTED));
+
+  map = mmap (NULL, length + delta, PROT_READ, MAP_PRIVATE, fd,
+              offset - delta);
+  if (map == MAP_FAILED)
+    return TRACE_ERR (gpg_error (GPG_ERR_NOT_SUPPORTED));
+#if defined(HAVE_MADVISE) && defined(MADV_SEQUENTIAL)
+  madvise (map, length + delta, MADV_SEQUENTIAL);
+#endif
+
+  err = _gpgme_data_new (r_dh, &mem_cbs);
+  if (err)
+    {
+      munmap (map, length + delta);
+      return TRACE_ERR (err);
+    }
+  (*r_dh)->data.mem.map = map;
+  (*r_dh)->data.mem.map_size = length + delta;
+  (*r_dh)->data.mem.orig_buffer = (const char *)map + delta;
+  (*r_dh)->data.mem.size = length;
+  (*r_dh)->data.mem.length = length;
+  (*r_dh)->size_hint = length;
+
+  TRACE_SUC ("dh=%p", *r_dh);
+  return 0;
+#else /*!HAVE_MMAP*/
+  (void)r_dh;
+  (void)fd;
+  (void)offset;
+  (void)length;
+  return gpg_error (GPG_ERR_NOT_SUPPORTED);
+#endif /*!HAVE_MMAP*/
+}
+
+
+const char *
+_gpgme_data_mem_peek (gpgme_data_t dh, size_t *r_len)
+{
+  const char *src;
+  int blankout;
+
+  if (dh->cbs != &mem_cbs)
+    return NULL;
+
+  /* The data of a blanked out object must only be read by
+     gpgme_data_read, which returns EOF for it.  */
+  if (_gpgme_data_get_prop (dh, 0, DATA_PROP_BLANKOUT, &blankout)
+      || blankout)
+    return NULL;
+
+  src = dh->data.mem.buffer ? dh->data.mem.buffer : dh->data.mem.orig_buffer;
+  *r_len = dh->data.mem.length - dh->data.mem.offset;
+  if (!src)
+    return "";  /* An empty data object.  */
+  return src + dh->data.mem.offset;
+}
+
+
+void
+_gpgme_data_mem_skip (gpgme_data_t dh, size_t n)
+{
+  assert (dh->cbs == &mem_cbs);
+  assert (n <= dh->data.mem.length - dh->data.mem.offset);
+  dh->data.mem.offset += n;
+}
+
+
 /* Destroy the data buffer DH and return a pointer to its content.
    The memory has be to released with gpgme_free() by the user.  It's
    size is returned in R_LEN.  */
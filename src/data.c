@@ -317,6 +317,7 @@ _gpgme_data_new (gpgme_data_t *r_dh, struct _gpgme_data_cbs *cbs)
     return gpg_error_from_syserror ();
 
   dh->cbs = cbs;
+  dh->pipe_fd = -1;
 
   err = insert_into_property_table (dh, &dh->propidx);
   if (err)
@@ -339,6 +340,7 @@ _gpgme_data_release (gpgme_data_t dh)
   remove_from_property_table (dh, dh->propidx);
   if (dh->file_name)
     free (dh->file_name);
+  free (dh->pending);
   free (dh);
 }
 
@@ -431,11 +433,14 @@ gpgme_data_seek (gpgme_data_t dh, gpgme_off_t offset, int whence)
   /* For relative movement, we must take into account the actual
      position of the read counter.  */
   if (whence == SEEK_CUR)
-    offset -= dh->pending_len;
+    offset -= (gpgme_off_t)dh->pending_len;
 
   offset = (*dh->cbs->seek) (dh, offset, whence);
   if (offset >= 0)
-    dh->pending_len = 0;
+    {
+      dh->pending_off = 0;
+      dh->pending_len = 0;
+    }
 
   return TRACE_SYSRES ((int)offset);
 }
@@ -555,6 +560,19 @@ gpgme_data_set_flag (gpgme_data_t dh, const char *name, const char *value)
     {
       dh->size_hint= value? _gpgme_string_to_off (value) : 0;
     }
+  else if (!strcmp (name, "io-buffer-size"))
+    {
+      gpgme_off_t size = value? _gpgme_string_to_off (value) : 0;
+
+      if (size <= 0)
+        dh->io_buffer_max = 0;
+      else if (size < DATA_IO_BUFFER_MIN)
+        dh->io_buffer_max = DATA_IO_BUFFER_MIN;
+      else if (size > INT_MAX)
+        dh->io_buffer_max = INT_MAX;
+      else
+        dh->io_buffer_max = size;
+    }
   else
     return gpg_error (GPG_ERR_UNKNOWN_NAME);
 
@@ -565,26 +583,107 @@ gpgme_data_set_flag (gpgme_data_t dh, const char *name, const char *value)
 
 /* Functions to support the wait interface.  */
 
+/* Return the size of the I/O buffer of DH to be used for a transfer
+   from or to the pipe FD, allocating or growing the buffer as
+   needed.  The first buffer is sized after the size hint, or
+   DATA_IO_BUFFER_INITIAL without a hint.  It is doubled, up to the
+   configured maximum, whenever the previous transfer filled it
+   completely.  Large buffers are only useful if the pipe can hold as
+   much data, thus the pipe is enlarged to match.  Returns 0 with
+   ERRNO set if no buffer could be allocated.  */
+static size_t
+get_io_buffer (gpgme_data_t dh, int fd)
+{
+  size_t max = dh->io_buffer_max? dh->io_buffer_max : DATA_IO_BUFFER_MAX;
+  size_t size;
+  char *buffer;
+
+  if (!dh->pending)
+    {
+      if (dh->size_hint > 0)
+        {
+          /* One more byte so that the EOF is seen by the first
+             read on a data object of exactly SIZE_HINT bytes.  */
+          size = (dh->size_hint < max)? (size_t)dh->size_hint + 1 : max;
+          if (size < DATA_IO_BUFFER_MIN)
+            size = DATA_IO_BUFFER_MIN;
+        }
+      else
+        size = DATA_IO_BUFFER_INITIAL;
+    }
+  else if (dh->pending_filled && dh->pending_size < max)
+    size = dh->pending_size * 2;
+  else
+    size = dh->pending_size;
+  if (size > max)
+    size = max;
+
+  dh->pending_filled = 0;
+  if (size > dh->pending_size)
+    {
+      buffer = realloc (dh->pending, size);
+      if (buffer)
+        {
+          dh->pending = buffer;
+          dh->pending_size = size;
+          dh->pipe_fd = -1;
+        }
+      else if (!dh->pending)
+        return 0;
+    }
+
+  size = dh->pending_size < max? dh->pending_size : max;
+  if (fd != dh->pipe_fd)
+    {
+      if (size > DATA_PIPE_SIZE)
+        _gpgme_io_set_pipe_size (fd, size);
+      dh->pipe_fd = fd;
+    }
+  return size;
+}
+
+
 gpgme_error_t
 _gpgme_data_inbound_handler (void *opaque, int fd)
 {
   struct io_cb_data *data = (struct io_cb_data *) opaque;
   gpgme_data_t dh = (gpgme_data_t) data->handler_value;
-  char buffer[BUFFER_SIZE];
-  char *bufp = buffer;
+  char small_buffer[BUFFER_SIZE];
+  char *buffer;
+  size_t bufsize;
+  char *bufp;
   gpgme_ssize_t buflen;
   TRACE_BEG  (DEBUG_CTX, "_gpgme_data_inbound_handler", dh,
 	      "fd=%d", fd);
 
-  buflen = _gpgme_io_read (fd, buffer, BUFFER_SIZE);
+  /* Do not clobber data pending for an outbound handler of the same
+     data object.  */
+  if (dh->pending_len)
+    {
+      buffer = small_buffer;
+      bufsize = BUFFER_SIZE;
+    }
+  else
+    {
+      bufsize = get_io_buffer (dh, fd);
+      if (!bufsize)
+        return TRACE_ERR (gpg_error_from_syserror ());
+      buffer = dh->pending;
+    }
+
+  buflen = _gpgme_io_read (fd, buffer, bufsize);
   if (buflen < 0)
     return gpg_error_from_syserror ();
   if (buflen == 0)
     {
+      dh->pipe_fd = -1;
       _gpgme_io_close (fd);
       return TRACE_ERR (0);
     }
+  if (buffer == dh->pending && buflen == bufsize)
+    dh->pending_filled = 1;
 
+  bufp = buffer;
   do
     {
       gpgme_ssize_t amt = gpgme_data_write (dh, bufp, buflen);
@@ -598,48 +697,136 @@ _gpgme_data_inbound_handler (void *opaque, int fd)
 }
 
 
+/* Write the SRCLEN bytes at SRC, which is the data at the read
+   position of the memory based data object DH, to FD.  */
+static gpgme_error_t
+write_mem_direct (gpgme_data_t dh, int fd, const char *src, size_t srclen)
+{
+  size_t max = dh->io_buffer_max? dh->io_buffer_max : DATA_IO_BUFFER_MAX;
+  gpgme_ssize_t nwritten;
+  size_t amt;
+
+  if (!srclen)
+    {
+      dh->pipe_fd = -1;
+      _gpgme_io_close (fd);
+      return 0;
+    }
+
+  if (fd != dh->pipe_fd)
+    {
+      if (srclen > DATA_PIPE_SIZE)
+        _gpgme_io_set_pipe_size (fd, srclen < max? srclen : max);
+      dh->pipe_fd = fd;
+    }
+
+  do
+    {
+      amt = srclen < DATA_IO_WRITE_CHUNK? srclen : DATA_IO_WRITE_CHUNK;
+      nwritten = _gpgme_io_write (fd, src, amt);
+      if (nwritten == -1 && errno == EAGAIN)
+        return 0;
+      if (nwritten == -1 && errno == EPIPE)
+        {
+          /* See _gpgme_data_outbound_handler.  */
+          dh->pipe_fd = -1;
+          _gpgme_io_close (fd);
+          return 0;
+        }
+      if (nwritten <= 0)
+        return gpg_error_from_syserror ();
+
+      _gpgme_data_mem_skip (dh, nwritten);
+      src += nwritten;
+      srclen -= nwritten;
+    }
+#ifdef HAVE_W32_SYSTEM
+  /* The writer thread accepts only one buffer per select.  */
+  while (0);
+#else
+  while (srclen && nwritten == DATA_IO_WRITE_CHUNK);
+#endif
+
+  return 0;
+}
+
+
 gpgme_error_t
 _gpgme_data_outbound_handler (void *opaque, int fd)
 {
   struct io_cb_data *data = (struct io_cb_data *) opaque;
   gpgme_data_t dh = (gpgme_data_t) data->handler_value;
   gpgme_ssize_t nwritten;
+  const char *src;
+  size_t srclen;
   TRACE_BEG  (DEBUG_CTX, "_gpgme_data_outbound_handler", dh,
 	      "fd=%d", fd);
 
+  /* Memory based data objects, including mapped files, are written
+     directly without copying the data to the pending buffer.  */
+  if (!dh->pending_len && (src = _gpgme_data_mem_peek (dh, &srclen)))
+    return TRACE_ERR (write_mem_direct (dh, fd, src, srclen));
+
   if (!dh->pending_len)
     {
-      gpgme_ssize_t amt = gpgme_data_read (dh, dh->pending, BUFFER_SIZE);
+      size_t bufsize = get_io_buffer (dh, fd);
+      gpgme_ssize_t amt;
+
+      if (!bufsize)
+        return TRACE_ERR (gpg_error_from_syserror ());
+      amt = gpgme_data_read (dh, dh->pending, bufsize);
       if (amt < 0)
 	return TRACE_ERR (gpg_error_from_syserror ());
       if (amt == 0)
 	{
+          dh->pipe_fd = -1;
 	  _gpgme_io_close (fd);
 	  return TRACE_ERR (0);
 	}
+      if (amt == bufsize)
+        dh->pending_filled = 1;
+      dh->pending_off = 0;
       dh->pending_len = amt;
     }
 
-  nwritten = _gpgme_io_write (fd, dh->pending, dh->pending_len);
-  if (nwritten == -1 && errno == EAGAIN)
-    return TRACE_ERR (0);
-
-  if (nwritten == -1 && errno == EPIPE)
+  /* Writing a large buffer to a nearly full pipe is expensive, thus
+     the pending data is written in chunks until the pipe is full.  */
+  do
     {
-      /* Not much we can do.  The other end closed the pipe, but we
-	 still have data.  This should only ever happen if the other
-	 end is going to tell us what happened on some other channel.
-	 Silently close our end.  */
-      _gpgme_io_close (fd);
-      return TRACE_ERR (0);
-    }
+      size_t amt = dh->pending_len;
 
-  if (nwritten <= 0)
-    return TRACE_ERR (gpg_error_from_syserror ());
+      if (amt > DATA_IO_WRITE_CHUNK)
+        amt = DATA_IO_WRITE_CHUNK;
+      nwritten = _gpgme_io_write (fd, dh->pending + dh->pending_off, amt);
+      if (nwritten == -1 && errno == EAGAIN)
+        return TRACE_ERR (0);
 
-  if (nwritten < dh->pending_len)
-    memmove (dh->pending, dh->pending + nwritten, dh->pending_len - nwritten);
-  dh->pending_len -= nwritten;
+      if (nwritten == -1 && errno == EPIPE)
+        {
+          /* Not much we can do.  The other end closed the pipe, but
+             we still have data.  This should only ever happen if the
+             other end is going to tell us what happened on some
+             other channel.  Silently close our end.  */
+          dh->pipe_fd = -1;
+          _gpgme_io_close (fd);
+          return TRACE_ERR (0);
+        }
+
+      if (nwritten <= 0)
+        return TRACE_ERR (gpg_error_from_syserror ());
+
+      dh->pending_off += nwritten;
+      dh->pending_len -= nwritten;
+    }
+#ifdef HAVE_W32_SYSTEM
+  /* The writer thread accepts only one buffer per select.  */
+  while (0);
+#else
+  while (dh->pending_len && nwritten == DATA_IO_WRITE_CHUNK);
+#endif
+
+  if (!dh->pending_len)
+    dh->pending_off = 0;
   return TRACE_ERR (0);
 }
 
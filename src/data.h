@@ -85,8 +85,41 @@ struct gpgme_data
 #define BUFFER_SIZE 512
 #endif
 #endif
-  char pending[BUFFER_SIZE];
-  int pending_len;
+
+/* The minimal, the initial and the default maximal size of the
+   buffer used to pump data to or from an engine.  */
+#define DATA_IO_BUFFER_MIN     BUFFER_SIZE
+#define DATA_IO_BUFFER_INITIAL (16 * 1024)
+#define DATA_IO_BUFFER_MAX     (1024 * 1024)
+
+/* The maximal amount of data written to a pipe with one call.  */
+#define DATA_IO_WRITE_CHUNK    (16 * 1024)
+
+/* The default capacity of a pipe on Linux.  Pipes are only enlarged
+   for buffers larger than this.  */
+#define DATA_PIPE_SIZE         (64 * 1024)
+
+  /* The buffer used by the inbound and outbound handlers to pump
+     data between the data object and an engine.  It is allocated on
+     first use with a size derived from SIZE_HINT and grows up to
+     IO_BUFFER_MAX whenever a transfer filled it completely.  */
+  char *pending;
+  size_t pending_size;
+
+  /* The data read from the object but not yet written to the engine
+     starts at PENDING_OFF and is PENDING_LEN bytes long.  */
+  size_t pending_off;
+  size_t pending_len;
+
+  /* The maximal size of PENDING as set with the "io-buffer-size"
+     flag or 0 for the default.  */
+  size_t io_buffer_max;
+
+  /* The pipe which has been enlarged to match PENDING or -1.  */
+  int pipe_fd;
+
+  /* Set if the last transfer filled PENDING completely.  */
+  unsigned int pending_filled : 1;
 
   /* File name of the data object.  */
   char *file_name;
@@ -121,6 +154,10 @@ struct gpgme_data
       size_t size;
       size_t length;
       gpgme_off_t offset;
+      /* For gpgme_data_new_from_filepart: The mapping of the file
+         which holds ORIG_BUFFER or NULL.  */
+      void *map;
+      size_t map_size;
     } mem;
 
     /* For gpgme_data_new_from_read_cb.  */
@@ -163,8 +200,30 @@ void _gpgme_data_release (gpgme_data_t dh);
    return -1.  */
 int _gpgme_data_get_fd (gpgme_data_t dh);
 
+/* Get the file descriptor associated with DH if the engine may
+   access it directly for the direction given by INBOUND.  Otherwise
+   return -1.  */
+int _gpgme_data_get_passthrough_fd (gpgme_data_t dh, int inbound);
+
 /* Get the size-hint value for DH or 0 if not available.  */
 gpgme_off_t _gpgme_data_get_size_hint (gpgme_data_t dh);
 
+/* Create a new memory based data object for LENGTH bytes of the file
+   FD starting at OFFSET by mapping the file.  Returns
+   GPG_ERR_NOT_SUPPORTED if the file is not mapped.  */
+gpgme_error_t _gpgme_data_new_from_mapped_file (gpgme_data_t *r_dh, int fd,
+                                                gpgme_off_t offset,
+                                                size_t length);
+
+/* Return a pointer to the data at the read position of the memory
+   based data object DH and store the number of bytes from there to
+   the end at R_LEN.  Returns NULL if DH is not memory based or its
+   data is blanked out.  */
+const char *_gpgme_data_mem_peek (gpgme_data_t dh, size_t *r_len);
+
+/* Advance the read position of the memory based data object DH by N
+   bytes.  */
+void _gpgme_data_mem_skip (gpgme_data_t dh, size_t n);
+
 
 #endif	/* DATA_H */
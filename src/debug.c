@@ -32,6 +32,9 @@
 #include <ctype.h>
 #include <errno.h>
 #include <time.h>
+#ifdef HAVE_SYS_TIME_H
+# include <sys/time.h>
+#endif
 #ifndef HAVE_DOSISH_SYSTEM
 # ifdef HAVE_SYS_TYPES_H
 #  include <sys/types.h>
@@ -48,6 +51,7 @@
 #include "sema.h"
 #include "sys-util.h"
 #include "debug.h"
+#include "trace-ring.h"
 
 
 /* The amount of detail requested by the user, per environment
@@ -69,6 +73,67 @@ static char *envvar_override;
 static __thread int frame_nr = 0;
 #endif
 
+
+/* With the "ring" option of GPGME_DEBUG the trace messages are stored
+   as binary records in a ring buffer per thread instead of being
+   formatted and written.  See trace-ring.h.  RING_SIZE is the number
+   of records per ring or 0 if the option is not used, and RING_FILE
+   is the file to which the rings are dumped.  */
+#define DEFAULT_RING_SIZE 1024
+#define MAX_RINGS 64
+static size_t ring_size;
+static char *ring_file;
+
+struct trace_ring_s
+{
+  struct trace_ring_s *next;
+
+  /* Set if the ring is used by several threads and thus must be
+     written with the RING_LOCK held.  */
+  int shared;
+
+  /* The thread owning the ring unless it is shared.  This saves a
+     system call per record.  */
+  uint64_t thread;
+
+  /* The number of records written to the ring.  */
+  uint64_t count;
+
+  struct trace_record_s records[1];
+};
+
+/* _gpgme_debug_dump reads the rings while their threads write them.
+   Like with a seqlock, the writer clears the sequence number of a
+   record before and sets it after writing the record, and then
+   increments the count of the ring.  The reader takes a record only
+   if its sequence number is the expected one before and after
+   copying it.  */
+#ifdef HAVE_ATOMIC_BUILTINS
+# define ring_load(p)          __atomic_load_n ((p), __ATOMIC_ACQUIRE)
+# define ring_store(p,v)       __atomic_store_n ((p), (v), __ATOMIC_RELEASE)
+# define ring_fence_acquire()  __atomic_thread_fence (__ATOMIC_ACQUIRE)
+# define ring_fence_release()  __atomic_thread_fence (__ATOMIC_RELEASE)
+#else
+# define ring_load(p)          (*(volatile uint64_t *)(p))
+# define ring_store(p,v)       (*(volatile uint64_t *)(p) = (v))
+# define ring_fence_acquire()  do { } while (0)
+# define ring_fence_release()  do { } while (0)
+#endif
+
+/* The ring_lock protects the list of rings and the shared ring.  */
+DEFINE_STATIC_LOCK (ring_lock);
+static struct trace_ring_s *ring_list;
+static unsigned int ring_count;
+
+/* The ring used by the threads which do not get one of their own
+   because there are already MAX_RINGS rings or there is no thread
+   local storage.  */
+static struct trace_ring_s *shared_ring;
+
+#ifdef HAVE_TLS
+static __thread struct trace_ring_s *thread_ring;
+#endif
+
 void
 _gpgme_debug_frame_begin (void)
 {
@@ -178,12 +243,25 @@ debug_init (void)
 		      memcpy (p, s1, s2 - s1);
 		      p[s2-s1] = 0;
 		      trim_spaces (p);
-		      fp = fopen (p,"a");
-		      if (fp)
-			{
-			  setvbuf (fp, NULL, _IOLBF, 0);
-			  errfp = fp;
-			}
+                      if (*s2 && !strncmp (s2 + 1, "ring", 4)
+                          && (!s2[5] || s2[5] == '=' || s2[5] == PATHSEP_C))
+                        {
+                          /* The file is only written on a dump.  */
+                          ring_size = DEFAULT_RING_SIZE;
+                          if (s2[5] == '=' && atoi (s2 + 6) > 0)
+                            ring_size = atoi (s2 + 6);
+                          ring_file = p;
+                          p = NULL;
+                        }
+                      else
+                        {
+                          fp = fopen (p,"a");
+                          if (fp)
+                            {
+                              setvbuf (fp, NULL, _IOLBF, 0);
+                              errfp = fp;
+                            }
+                        }
 		      free (p);
 		    }
 #ifndef HAVE_DOSISH_SYSTEM
@@ -210,6 +288,289 @@ debug_init (void)
 
 
 
+/* Return the current time in nanoseconds since the Epoch.  */
+static uint64_t
+ring_timestamp (void)
+{
+#ifdef HAVE_CLOCK_GETTIME
+  struct timespec ts;
+
+  clock_gettime (CLOCK_REALTIME, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#elif defined(HAVE_SYS_TIME_H)
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return (uint64_t)tv.tv_sec * 1000000000 + (uint64_t)tv.tv_usec * 1000;
+#else
+  return (uint64_t)time (NULL) * 1000000000;
+#endif
+}
+
+
+static struct trace_ring_s *
+ring_new (void)
+{
+  struct trace_ring_s *ring;
+
+  ring = calloc (1, (sizeof *ring
+                     + (ring_size - 1) * sizeof (struct trace_record_s)));
+  if (!ring)
+    return NULL;
+  ring->next = ring_list;
+  ring_list = ring;
+  return ring;
+}
+
+
+/* Return the ring of the calling thread.  */
+static struct trace_ring_s *
+ring_get (void)
+{
+  struct trace_ring_s *ring = NULL;
+
+#ifdef HAVE_TLS
+  if (thread_ring)
+    return thread_ring;
+#endif
+
+  LOCK (ring_lock);
+#ifdef HAVE_TLS
+  if (ring_count < MAX_RINGS && (ring = ring_new ()))
+    {
+      ring->thread = ath_self ();
+      ring_count++;
+    }
+#endif
+  if (!ring)
+    {
+      if (!shared_ring && (shared_ring = ring_new ()))
+        shared_ring->shared = 1;
+      ring = shared_ring;
+    }
+  UNLOCK (ring_lock);
+
+#ifdef HAVE_TLS
+  thread_ring = ring;
+#endif
+  return ring;
+}
+
+
+/* Store a trace message in the ring of the calling thread.  The
+   arguments are those of _gpgme_debug.  No lock is taken unless the
+   thread uses the shared ring.  */
+static void
+ring_record (int level, int mode, int indent, const char *func,
+             const char *tagname, const void *tagvalue,
+             const char *format, va_list arg_ptr)
+{
+  struct trace_ring_s *ring;
+  struct trace_record_s *rec;
+  uint64_t count;
+
+  ring = ring_get ();
+  if (!ring)
+    return;
+  if (ring->shared)
+    LOCK (ring_lock);
+
+  /* Only this thread writes the count.  */
+  count = ring->count;
+  rec = &ring->records[count % ring_size];
+  ring_store (&rec->seq, 0);
+  ring_fence_release ();
+  rec->stamp = ring_timestamp ();
+  rec->thread = ring->shared? ath_self () : ring->thread;
+  rec->tag = (uintptr_t) tagvalue;
+  rec->func = (uintptr_t) func;
+  rec->format = (uintptr_t) format;
+  if (tagname && strcmp (tagname, XSTRINGIFY (NULL)))
+    rec->tagname = (uintptr_t) tagname;
+  else
+    rec->tagname = 0;
+  rec->level = level;
+  rec->mode = mode;
+  rec->indent = indent;
+  rec->ptrsize = sizeof (void *);
+  if (format && *format)
+    _gpgme_trace_record_args (rec, format, arg_ptr);
+  else
+    rec->nargs = 0;
+  ring_store (&rec->seq, count + 1);
+  ring_store (&ring->count, count + 1);
+
+  if (ring->shared)
+    UNLOCK (ring_lock);
+}
+
+
+/* Store a message without the standard information in the ring.  */
+static void
+ring_recordf (const char *format, ...)
+{
+  va_list arg_ptr;
+
+  va_start (arg_ptr, format);
+  ring_record (0, -1, 0, NULL, NULL, NULL, format, arg_ptr);
+  va_end (arg_ptr);
+}
+
+
+static int
+compare_pointers (const void *a, const void *b)
+{
+  const char *pa = *(const char *const *)a;
+  const char *pb = *(const char *const *)b;
+
+  return pa < pb? -1 : pa > pb;
+}
+
+
+/* Return the index of the string P in the sorted array STRINGS of
+   length NSTRINGS.  */
+static uint64_t
+string_index (const char **strings, size_t nstrings, uint64_t p)
+{
+  const char *key = (const char *)(uintptr_t)p;
+  const char **found;
+
+  if (!key)
+    return TRACE_NO_STRING;
+  found = bsearch (&key, strings, nstrings, sizeof *strings,
+                   compare_pointers);
+  return found? (uint64_t)(found - strings) : TRACE_NO_STRING;
+}
+
+
+static int
+write_uint32 (FILE *fp, uint32_t value)
+{
+  return fwrite (&value, sizeof value, 1, fp) != 1;
+}
+
+
+/* Copy the complete records of RING from the oldest one on to the
+   end of the array *RECORDS with *NRECORDS elements, which is grown
+   as needed.  Records which are written while they are copied are
+   skipped.  Returns 0 on success.  */
+static int
+copy_ring (struct trace_ring_s *ring,
+           struct trace_record_s **records, size_t *nrecords)
+{
+  struct trace_record_s *newrecords, *rec;
+  uint64_t count, first, i;
+
+  count = ring_load (&ring->count);
+  first = count < ring_size? 0 : count - ring_size;
+  if (count == first)
+    return 0;
+
+  newrecords = realloc (*records,
+                        (*nrecords + (count - first)) * sizeof *newrecords);
+  if (!newrecords)
+    return -1;
+  *records = newrecords;
+
+  for (i = first; i < count; i++)
+    {
+      rec = &newrecords[*nrecords];
+      if (ring_load (&ring->records[i % ring_size].seq) != i + 1)
+        continue;
+      memcpy (rec, &ring->records[i % ring_size], sizeof *rec);
+      ring_fence_acquire ();
+      if (ring_load (&ring->records[i % ring_size].seq) != i + 1)
+        continue;
+      ++*nrecords;
+    }
+  return 0;
+}
+
+
+/* Dump the trace rings to FILE_NAME or, if it is empty, to the file
+   given with GPGME_DEBUG.  The dump is appended to the file.  Returns
+   0 on success.  */
+int
+_gpgme_debug_dump (const char *file_name)
+{
+  struct trace_ring_s *ring;
+  struct trace_record_s *records = NULL;
+  size_t nrecords = 0;
+  const char **strings = NULL;
+  size_t nstrings = 0;
+  size_t i, j;
+  FILE *fp = NULL;
+  int rc = -1;
+
+  if (!ring_size)
+    return -1;
+  if (!file_name || !*file_name)
+    file_name = ring_file;
+
+  /* Copy the records first, so that the strings and the number of
+     records written match the records.  */
+  LOCK (ring_lock);
+  for (ring = ring_list; ring; ring = ring->next)
+    if (copy_ring (ring, &records, &nrecords))
+      break;
+  UNLOCK (ring_lock);
+  if (ring)
+    goto leave;
+
+  /* Collect the strings of the records and sort them to look them up
+     by their address.  */
+  strings = malloc ((3 * nrecords + 1) * sizeof *strings);
+  if (!strings)
+    goto leave;
+  for (i = 0; i < nrecords; i++)
+    {
+      strings[nstrings++] = (const char *)(uintptr_t)records[i].func;
+      strings[nstrings++] = (const char *)(uintptr_t)records[i].format;
+      strings[nstrings++] = (const char *)(uintptr_t)records[i].tagname;
+    }
+  qsort (strings, nstrings, sizeof *strings, compare_pointers);
+  for (i = 0, j = 0; i < nstrings; i++)
+    if (strings[i] && (!j || strings[j - 1] != strings[i]))
+      strings[j++] = strings[i];
+  nstrings = j;
+
+  fp = fopen (file_name, "ab");
+  if (!fp)
+    goto leave;
+  if (fwrite (TRACE_DUMP_MAGIC, 8, 1, fp) != 1
+      || write_uint32 (fp, TRACE_DUMP_BYTEORDER)
+      || write_uint32 (fp, nstrings))
+    goto leave;
+  for (j = 0; j < nstrings; j++)
+    if (write_uint32 (fp, strlen (strings[j]))
+        || (*strings[j]
+            && fwrite (strings[j], strlen (strings[j]), 1, fp) != 1))
+      goto leave;
+
+  if (write_uint32 (fp, nrecords))
+    goto leave;
+  for (i = 0; i < nrecords; i++)
+    {
+      records[i].func = string_index (strings, nstrings, records[i].func);
+      records[i].format = string_index (strings, nstrings,
+                                        records[i].format);
+      records[i].tagname = string_index (strings, nstrings,
+                                         records[i].tagname);
+    }
+  if (nrecords && fwrite (records, sizeof *records, nrecords, fp) != nrecords)
+    goto leave;
+  rc = 0;
+
+ leave:
+  if (fp && fclose (fp))
+    rc = -1;
+  free (strings);
+  free (records);
+  return rc;
+}
+
+
+
 /* This should be called as soon as possible.  It is required so that
  * the assuan logging gets connected to the gpgme log stream as early
  * as possible.  */
@@ -267,17 +628,33 @@ _gpgme_debug (void **line, int level, int mode,
 
   saved_errno = errno;
   va_start (arg_ptr, format);
-  {
-    struct tm *tp;
-    time_t atime = time (NULL);
-
-    tp = localtime (&atime);
-    prefix = gpgrt_bsprintf ("GPGME %04d%02d%02dT%02d%02d%02d %04llX  %*s",
-                             1900+tp->tm_year, tp->tm_mon+1, tp->tm_mday,
-                             tp->tm_hour, tp->tm_min, tp->tm_sec,
-                             (unsigned long long) ath_self (),
-                             indent < 40? indent : 40, "");
-  }
+  if (ring_size)
+    {
+      /* Record the message instead of formatting it.  A line to be
+         continued is formatted without the prefix and recorded by
+         _gpgme_debug_end.  */
+      if (!line)
+        {
+          ring_record (level, mode, indent < 40? indent : 40,
+                       func, tagname, tagvalue, format, arg_ptr);
+          va_end (arg_ptr);
+          gpg_err_set_errno (saved_errno);
+          return 0;
+        }
+      prefix = gpgrt_bsprintf ("%*s", indent < 40? indent : 40, "");
+    }
+  else
+    {
+      struct tm *tp;
+      time_t atime = time (NULL);
+
+      tp = localtime (&atime);
+      prefix = gpgrt_bsprintf ("GPGME %04d%02d%02dT%02d%02d%02d %04llX  %*s",
+                               1900+tp->tm_year, tp->tm_mon+1, tp->tm_mday,
+                               tp->tm_hour, tp->tm_min, tp->tm_sec,
+                               (unsigned long long) ath_self (),
+                               indent < 40? indent : 40, "");
+    }
 
   switch (mode)
     {
@@ -378,10 +755,15 @@ _gpgme_debug_end (void **line)
     return;
   string = *line;
 
-  fprintf (errfp, "%s%s",
-           string,
-           (*string && string[strlen (string)-1] != '\n')? "\n":"");
-  fflush (errfp);
+  if (ring_size)
+    ring_recordf ("%s", string);
+  else
+    {
+      fprintf (errfp, "%s%s",
+               string,
+               (*string && string[strlen (string)-1] != '\n')? "\n":"");
+      fflush (errfp);
+    }
   gpgrt_free (*line);
   *line = NULL;
 }
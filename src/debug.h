@@ -68,6 +68,9 @@ int _gpgme_debug_set_debug_envvar (const char *value);
 /* Called early to initialize the logging.  */
 void _gpgme_debug_subsystem_init (void);
 
+/* Dump the trace rings to a file; see debug.c.  */
+int _gpgme_debug_dump (const char *file_name);
+
 /* Log the formatted string FORMAT at debug level LEVEL or higher.  */
 int  _gpgme_debug (void **line, int level, int mode,
                    const char *func, const char *tagname, const char *tagvalue,
@@ -112,6 +112,8 @@ delete_start (gpgme_ctx_t ctx, int synchronous, const gpgme_key_t key,
 {
   gpgme_error_t err;
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -178,10 +178,34 @@ parse_output (char *line, int components)
 }
 
 
+/* Append LINE and a LF to the malloced buffer at R_BUFFER of length
+   R_LENGTH.  On error the buffer is released.  */
+static void
+append_line (char **r_buffer, size_t *r_length, const char *line)
+{
+  size_t n = strlen (line);
+  char *p;
+
+  p = realloc (*r_buffer, *r_length + n + 2);
+  if (!p)
+    {
+      free (*r_buffer);
+      *r_buffer = NULL;
+      return;
+    }
+  memcpy (p + *r_length, line, n);
+  p[*r_length + n] = '\n';
+  p[*r_length + n + 1] = 0;
+  *r_buffer = p;
+  *r_length += n + 1;
+}
+
+
 /* Read the directory information from gpgconf.  This function expects
    that DIRINFO_LOCK is held by the caller.  PGNAME is the name of the
    gpgconf binary. If COMPONENTS is set, not the directories bit the
-   name of the componeNts are read. */
+   name of the componeNts are read.  The output is taken from or
+   stored in the engine cache.  */
 static void
 read_gpgconf_dirs (const char *pgmname, int components)
 {
@@ -194,11 +218,31 @@ read_gpgconf_dirs (const char *pgmname, int components)
   int status;
   int nread;
   char *mark = NULL;
+  const char *extra;
+  char *output = NULL;
+  size_t outputlen = 0;
+  int output_failed = 0;
 
   argv[0] = (char *)pgmname;
   argv[1] = (char*)(components? "--list-components" : "--list-dirs");
   argv[2] = NULL;
 
+  /* The directories depend on the GNUPGHOME envvar.  */
+  extra = components? NULL : getenv ("GNUPGHOME");
+  output = _gpgme_engine_cache_get (argv[1], pgmname, extra);
+  if (output)
+    {
+      char *line;
+
+      for (line = output; (mark = strchr (line, '\n')); line = mark + 1)
+        {
+          *mark = 0;
+          parse_output (line, components);
+        }
+      free (output);
+      return;
+    }
+
   if (_gpgme_io_pipe (rp, 1) < 0)
     return;
 
@@ -235,6 +279,11 @@ read_gpgconf_dirs (const char *pgmname, int components)
               else
                 mark[0] = '\0';
 
+              if (!output_failed)
+                {
+                  append_line (&output, &outputlen, line);
+                  output_failed = !output;
+                }
               parse_output (line, components);
 	    }
 
@@ -246,6 +295,10 @@ read_gpgconf_dirs (const char *pgmname, int components)
   while (nread > 0 && linelen < sizeof linebuf - 1);
 
   _gpgme_io_close (rp[0]);
+
+  if (output && !nread)
+    _gpgme_engine_cache_put (argv[1], pgmname, extra, output);
+  free (output);
 }
 
 
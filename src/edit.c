@@ -123,6 +123,8 @@ interact_start (gpgme_ctx_t ctx, int synchronous, gpgme_key_t key,
   void *hook;
   op_data_t opd;
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -202,6 +204,8 @@ edit_start (gpgme_ctx_t ctx, int synchronous, int type, gpgme_key_t key,
   void *hook;
   op_data_t opd;
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
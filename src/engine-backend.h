@@ -135,7 +135,8 @@ struct engine_ops
                                        gpgme_assuan_status_cb_t status_cb,
                                        void *status_cb_value);
 
-  gpgme_error_t  (*conf_load) (void *engine, gpgme_conf_comp_t *conf_p);
+  gpgme_error_t  (*conf_load) (void *engine, const char *component,
+                               gpgme_conf_comp_t *conf_p);
   gpgme_error_t  (*conf_save) (void *engine, gpgme_conf_comp_t conf);
   gpgme_error_t  (*conf_dir) (void *engine, const char *what, char **result);
 
@@ -188,6 +189,14 @@ gpgme_error_t _gpgme_conf_opt_change (gpgme_conf_opt_t opt, int reset,
 void _gpgme_conf_release (gpgme_conf_comp_t conf);
 gpgme_error_t _gpgme_conf_load (void *engine, gpgme_conf_comp_t *conf_p);
 
+/* Prototypes for the engine pool in engine-pool.c  */
+int _gpgme_engine_pool_enabled (void);
+void *_gpgme_engine_pool_get (gpgme_protocol_t protocol,
+                              const char *file_name, const char *home_dir);
+int _gpgme_engine_pool_put (gpgme_protocol_t protocol,
+                            const char *file_name, const char *home_dir,
+                            void *engine, void (*release) (void *engine));
+
 
 
 #endif /* ENGINE_BACKEND_H */
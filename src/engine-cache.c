@@ -0,0 +1,354 @@
+/* engine-cache.c - Persistent cache for engine versions and dirinfo.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#ifdef HAVE_SYS_TYPES_H
+# include <sys/types.h>
+#endif
+#include <sys/stat.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
+
+#include "gpgme.h"
+#include "util.h"
+#include "sema.h"
+#include "debug.h"
+
+
+/* Running the engines to figure out their versions and running
+ * gpgconf to get the directory information takes a noticeable time
+ * for short-lived processes.  If the global flag "engine-cache" is
+ * set, these results are stored in the given file and reused by
+ * later processes.  Each record is bound to the program which
+ * produced it: if the program's device, inode, size or modification
+ * time changes, the record is ignored and overwritten by the next
+ * probe.
+ *
+ * The file consists of lines with five space delimited, percent
+ * escaped fields:
+ *
+ *   KIND FILE_NAME EXTRA STAMP VALUE
+ *
+ * KIND is "version" or the gpgconf option used to list the
+ * directory information.  EXTRA describes other things the value
+ * depends on, for example the GNUPGHOME envvar.  */
+
+/* Larger files are ignored.  */
+#define ENGINE_CACHE_MAX_FILE_SIZE (64 * 1024)
+
+
+struct cache_record_s
+{
+  struct cache_record_s *next;
+  char *kind;
+  char *file_name;
+  char *extra;
+  char *stamp;
+  char *value;
+};
+typedef struct cache_record_s *cache_record_t;
+
+
+DEFINE_STATIC_LOCK (engine_cache_lock);
+
+/* The name of the cache file or NULL if the cache is not used.  */
+static char *cache_file_name;
+
+/* The records of the cache file.  */
+static cache_record_t cache_records;
+static int cache_loaded;
+
+
+/* Helper function to be used only by gpgme_set_global_flag.  An
+ * empty VALUE disables the cache.  Returns 0 on success.  */
+int
+_gpgme_set_engine_cache_file (const char *value)
+{
+  char *name = NULL;
+
+  if (*value)
+    {
+      name = strdup (value);
+      if (!name)
+        return -1;
+    }
+  LOCK (engine_cache_lock);
+  free (cache_file_name);
+  cache_file_name = name;
+  cache_loaded = 0;
+  UNLOCK (engine_cache_lock);
+  return 0;
+}
+
+
+static void
+release_record (cache_record_t rec)
+{
+  free (rec->kind);
+  free (rec->file_name);
+  free (rec->extra);
+  free (rec->stamp);
+  free (rec->value);
+  free (rec);
+}
+
+
+/* Store a string identifying the current state of FILE_NAME in
+ * BUFFER.  Returns 0 on success.  */
+static int
+get_stamp (const char *file_name, char *buffer, size_t bufsize)
+{
+  struct stat st;
+
+  if (stat (file_name, &st))
+    return -1;
+  snprintf (buffer, bufsize, "%lu.%lu.%llu.%lld",
+            (unsigned long)st.st_dev, (unsigned long)st.st_ino,
+            (unsigned long long)st.st_size, (long long)st.st_mtime);
+  return 0;
+}
+
+
+/* Parse LINE and prepend a new record to CACHE_RECORDS.  */
+static void
+parse_line (char *line)
+{
+  char *field[5];
+  cache_record_t rec;
+  int i;
+
+  for (i = 0; i < DIM (field) - 1; i++)
+    {
+      field[i] = line;
+      line = strchr (line, ' ');
+      if (!line)
+        return;
+      *line++ = 0;
+    }
+  field[i] = line;
+
+  rec = calloc (1, sizeof *rec);
+  if (!rec)
+    return;
+  if (_gpgme_decode_percent_string (field[0], &rec->kind, 0, 0)
+      || _gpgme_decode_percent_string (field[1], &rec->file_name, 0, 0)
+      || _gpgme_decode_percent_string (field[2], &rec->extra, 0, 0)
+      || _gpgme_decode_percent_string (field[3], &rec->stamp, 0, 0)
+      || _gpgme_decode_percent_string (field[4], &rec->value, 0, 0))
+    {
+      release_record (rec);
+      return;
+    }
+  rec->next = cache_records;
+  cache_records = rec;
+}
+
+
+/* Read the cache file unless this has already been done.  Must be
+ * called with the lock held.  */
+static void
+load_cache (void)
+{
+  cache_record_t rec;
+  FILE *fp;
+  char *buffer, *line, *p;
+  size_t n;
+
+  if (cache_loaded)
+    return;
+  cache_loaded = 1;
+
+  while ((rec = cache_records))
+    {
+      cache_records = rec->next;
+      release_record (rec);
+    }
+
+  fp = fopen (cache_file_name, "r");
+  if (!fp)
+    return;
+  buffer = malloc (ENGINE_CACHE_MAX_FILE_SIZE + 1);
+  if (buffer)
+    {
+      n = fread (buffer, 1, ENGINE_CACHE_MAX_FILE_SIZE + 1, fp);
+      if (!ferror (fp) && n <= ENGINE_CACHE_MAX_FILE_SIZE)
+        {
+          buffer[n] = 0;
+          for (line = buffer; (p = strchr (line, '\n')); line = p + 1)
+            {
+              *p = 0;
+              parse_line (line);
+            }
+        }
+      free (buffer);
+    }
+  fclose (fp);
+}
+
+
+/* Write all records to the cache file.  Must be called with the lock
+ * held.  */
+static void
+save_cache (void)
+{
+  cache_record_t rec;
+  char *tmpname;
+  char *f[5];
+  char numbuf[30];
+  FILE *fp;
+  int i, failed = 0;
+
+#ifdef HAVE_W32_SYSTEM
+  *numbuf = 0;
+#else
+  snprintf (numbuf, sizeof numbuf, ".%lu", (unsigned long)getpid ());
+#endif
+  tmpname = _gpgme_strconcat (cache_file_name, ".tmp", numbuf, NULL);
+  if (!tmpname)
+    return;
+  fp = fopen (tmpname, "w");
+  if (!fp)
+    {
+      free (tmpname);
+      return;
+    }
+  for (rec = cache_records; rec && !failed; rec = rec->next)
+    {
+      memset (f, 0, sizeof f);
+      if (_gpgme_encode_percent_string (rec->kind, &f[0], 0)
+          || _gpgme_encode_percent_string (rec->file_name, &f[1], 0)
+          || _gpgme_encode_percent_string (rec->extra, &f[2], 0)
+          || _gpgme_encode_percent_string (rec->stamp, &f[3], 0)
+          || _gpgme_encode_percent_string (rec->value, &f[4], 0)
+          || fprintf (fp, "%s %s %s %s %s\n",
+                      f[0], f[1], f[2], f[3], f[4]) < 0)
+        failed = 1;
+      for (i = 0; i < DIM (f); i++)
+        free (f[i]);
+    }
+  if (fclose (fp))
+    failed = 1;
+#ifdef HAVE_W32_SYSTEM
+  if (!failed)
+    remove (cache_file_name);
+#endif
+  if (failed || rename (tmpname, cache_file_name))
+    remove (tmpname);
+  free (tmpname);
+}
+
+
+/* Return a malloced copy of the cached value of KIND for the program
+ * FILE_NAME or NULL if there is no valid record.  EXTRA is an
+ * additional key and may be NULL.  */
+char *
+_gpgme_engine_cache_get (const char *kind, const char *file_name,
+                         const char *extra)
+{
+  cache_record_t rec;
+  char stamp[100];
+  char *result = NULL;
+
+  if (!extra)
+    extra = "";
+
+  LOCK (engine_cache_lock);
+  if (!cache_file_name || get_stamp (file_name, stamp, sizeof stamp))
+    goto leave;
+  load_cache ();
+  for (rec = cache_records; rec; rec = rec->next)
+    if (!strcmp (rec->kind, kind) && !strcmp (rec->file_name, file_name)
+        && !strcmp (rec->extra, extra))
+      break;
+  if (rec && !strcmp (rec->stamp, stamp))
+    {
+      result = strdup (rec->value);
+      TRACE (DEBUG_INIT, "gpgme-engine-cache", NULL,
+             "%s of '%s' taken from the cache", kind, file_name);
+    }
+
+ leave:
+  UNLOCK (engine_cache_lock);
+  return result;
+}
+
+
+/* Store VALUE as the result of KIND for the program FILE_NAME and
+ * update the cache file.  EXTRA is an additional key and may be
+ * NULL.  */
+void
+_gpgme_engine_cache_put (const char *kind, const char *file_name,
+                         const char *extra, const char *value)
+{
+  cache_record_t rec;
+  char stamp[100];
+  char *newstamp, *newvalue;
+
+  if (!extra)
+    extra = "";
+
+  LOCK (engine_cache_lock);
+  if (!cache_file_name || get_stamp (file_name, stamp, sizeof stamp))
+    goto leave;
+  load_cache ();
+  for (rec = cache_records; rec; rec = rec->next)
+    if (!strcmp (rec->kind, kind) && !strcmp (rec->file_name, file_name)
+        && !strcmp (rec->extra, extra))
+      break;
+  if (!rec)
+    {
+      rec = calloc (1, sizeof *rec);
+      if (!rec)
+        goto leave;
+      rec->kind = strdup (kind);
+      rec->file_name = strdup (file_name);
+      rec->extra = strdup (extra);
+      if (!rec->kind || !rec->file_name || !rec->extra)
+        {
+          release_record (rec);
+          goto leave;
+        }
+      rec->next = cache_records;
+      cache_records = rec;
+    }
+  newstamp = strdup (stamp);
+  newvalue = strdup (value);
+  if (!newstamp || !newvalue)
+    {
+      free (newstamp);
+      free (newvalue);
+      goto leave;
+    }
+  free (rec->stamp);
+  rec->stamp = newstamp;
+  free (rec->value);
+  rec->value = newvalue;
+
+  save_cache ();
+
+ leave:
+  UNLOCK (engine_cache_lock);
+}
@@ -44,6 +44,7 @@
 #include "debug.h"
 #include "data.h"
 #include "mbox-util.h"
+#include "linebuf.h"
 
 #include "engine-backend.h"
 
@@ -96,9 +97,7 @@ struct engine_gpg
   {
     int fd[2];
     int arg_loc;
-    size_t bufsize;
-    char *buffer;
-    size_t readpos;
+    struct linebuf_s lb;
     int eof;
     engine_status_handler_t fnc;
     void *fnc_value;
@@ -112,9 +111,7 @@ struct engine_gpg
   {
     int fd[2];
     int arg_loc;
-    size_t bufsize;
-    char *buffer;
-    size_t readpos;
+    struct linebuf_s lb;
     int eof;
     engine_colon_line_handler_t fnc;  /* this indicate use of this structrue */
     void *fnc_value;
@@ -157,6 +154,10 @@ struct engine_gpg
 
   /* Memory data containing diagnostics (--logger-fd) of gpg */
   gpgme_data_t diagnostics;
+
+  /* The process id of gpg or -1.  The process is reaped when the
+   * engine is released.  */
+  pid_t pid;
 };
 
 typedef struct engine_gpg *engine_gpg_t;
@@ -432,6 +433,16 @@ gpg_release (void *engine)
 
   gpg_cancel (engine);
 
+#ifndef HAVE_W32_SYSTEM
+  /* All fds to gpg are closed now, thus it is about to terminate.
+     It may still wait for gpg-agent or dirmngr, so don't block.  */
+  if (gpg->pid != -1)
+    {
+      _gpgme_io_reap (gpg->pid);
+      gpg->pid = -1;
+    }
+#endif
+
   if (gpg->file_name)
     free (gpg->file_name);
   if (gpg->version)
@@ -450,10 +461,8 @@ gpg_release (void *engine)
       gpg->arglist = next;
     }
 
-  if (gpg->status.buffer)
-    free (gpg->status.buffer);
-  if (gpg->colon.buffer)
-    free (gpg->colon.buffer);
+  _gpgme_linebuf_release (&gpg->status.lb);
+  _gpgme_linebuf_release (&gpg->colon.lb);
   if (gpg->argv)
     free_argv (gpg->argv);
   if (gpg->cmd.keyword)
@@ -503,6 +512,7 @@ gpg_new (void **engine, const char *file_name, const char *home_dir,
 	}
     }
 
+  gpg->pid = -1;
   gpg->argtail = &gpg->arglist;
   gpg->status.fd[0] = -1;
   gpg->status.fd[1] = -1;
@@ -512,14 +522,9 @@ gpg_new (void **engine, const char *file_name, const char *home_dir,
   gpg->cmd.idx = -1;
 
   /* Allocate the read buffer for the status pipe.  */
-  gpg->status.bufsize = 1024;
-  gpg->status.readpos = 0;
-  gpg->status.buffer = malloc (gpg->status.bufsize);
-  if (!gpg->status.buffer)
-    {
-      rc = gpg_error_from_syserror ();
-      goto leave;
-    }
+  rc = _gpgme_linebuf_init (&gpg->status.lb, 1024);
+  if (rc)
+    goto leave;
   /* In any case we need a status pipe - create it right here and
      don't handle it with our generic gpgme_data_t mechanism.  */
   if (_gpgme_io_pipe (gpg->status.fd, 1) == -1)
@@ -774,17 +779,19 @@ gpg_set_colon_line_handler (void *engine, engine_colon_line_handler_t fnc,
 {
   engine_gpg_t gpg = engine;
 
-  gpg->colon.bufsize = 1024;
-  gpg->colon.readpos = 0;
-  gpg->colon.buffer = malloc (gpg->colon.bufsize);
-  if (!gpg->colon.buffer)
-    return gpg_error_from_syserror ();
+  gpgme_error_t err;
+
+  /* The colon output may be large; thus we start with a larger
+     buffer than for the status lines.  */
+  _gpgme_linebuf_release (&gpg->colon.lb);
+  err = _gpgme_linebuf_init (&gpg->colon.lb, 8192);
+  if (err)
+    return err;
 
   if (_gpgme_io_pipe (gpg->colon.fd, 1) == -1)
     {
       int saved_err = gpg_error_from_syserror ();
-      free (gpg->colon.buffer);
-      gpg->colon.buffer = NULL;
+      _gpgme_linebuf_release (&gpg->colon.lb);
       return saved_err;
     }
   if (_gpgme_io_set_close_notify (gpg->colon.fd[0], close_notify_handler, gpg)
@@ -1123,10 +1130,35 @@ build_argv (engine_gpg_t gpg, const char *pgmname)
 
       if (a->data)
 	{
+	  int passfd;
+
 	  /* Create a pipe to pass it down to gpg.  */
 	  fd_data_map[datac].inbound = a->inbound;
 
-	  /* Create a pipe.  */
+	  /* If the data object is backed by a plain file descriptor we
+	     hand a copy of it directly to gpg so that the payload does
+	     not need to be pumped through gpgme.  */
+	  if (gpg->cmd.used && gpg->cmd.cb_data == a->data)
+	    passfd = -1;
+	  else
+	    passfd = _gpgme_data_get_passthrough_fd (a->data, a->inbound);
+	  if (passfd != -1)
+	    {
+	      int fd = _gpgme_io_dup (passfd);
+
+	      if (fd == -1)
+		{
+		  int saved_err = gpg_error_from_syserror ();
+		  free (fd_data_map);
+		  free_argv (argv);
+		  return saved_err;
+		}
+	      if (_gpgme_io_set_close_notify (fd, close_notify_handler, gpg))
+		return gpg_error (GPG_ERR_GENERAL);
+	      fd_data_map[datac].fd       = -1;
+	      fd_data_map[datac].peer_fd  = fd;
+	    }
+	  else /* Create a pipe.  */
 	  {
 	    int fds[2];
 
@@ -1255,25 +1287,16 @@ add_io_cb (engine_gpg_t gpg, int fd, int dir, gpgme_io_cb_t handler, void *data,
 static gpgme_error_t
 read_status (engine_gpg_t gpg)
 {
-  char *p;
+  char *p, *line;
+  size_t len, linelen;
   int nread;
-  size_t bufsize = gpg->status.bufsize;
-  char *buffer = gpg->status.buffer;
-  size_t readpos = gpg->status.readpos;
   gpgme_error_t err;
 
-  assert (buffer);
-  if (bufsize - readpos < 256)
-    {
-      /* Need more room for the read.  */
-      bufsize += 1024;
-      buffer = realloc (buffer, bufsize);
-      if (!buffer)
-	return gpg_error_from_syserror ();
-    }
+  err = _gpgme_linebuf_reserve (&gpg->status.lb, 256, 0, &p, &len);
+  if (err)
+    return err;
 
-  nread = _gpgme_io_read (gpg->status.fd[0],
-			  buffer + readpos, bufsize-readpos);
+  nread = _gpgme_io_read (gpg->status.fd[0], p, len);
   if (nread == -1)
     return gpg_error_from_syserror ();
 
@@ -1295,96 +1318,76 @@ read_status (engine_gpg_t gpg)
       return err;
     }
 
-  while (nread > 0)
+  _gpgme_linebuf_commit (&gpg->status.lb, nread);
+
+  /* Process all complete lines (we require that the last line is
+     terminated by a LF).  */
+  while ((line = _gpgme_linebuf_getline (&gpg->status.lb, &linelen)))
     {
-      for (p = buffer + readpos; nread; nread--, p++)
-	{
-	  if (*p == '\n')
-	    {
-	      /* (we require that the last line is terminated by a LF) */
-	      if (p > buffer && p[-1] == '\r')
-		p[-1] = 0;
-	      *p = 0;
-	      if (!strncmp (buffer, "[GNUPG:] ", 9)
-		  && buffer[9] >= 'A' && buffer[9] <= 'Z')
-		{
-		  char *rest;
-		  gpgme_status_code_t r;
-
-		  rest = strchr (buffer + 9, ' ');
-		  if (!rest)
-		    rest = p; /* Set to an empty string.  */
-		  else
-		    *rest++ = 0;
-
-		  r = _gpgme_parse_status (buffer + 9);
-                  if (gpg->status.mon_cb && r != GPGME_STATUS_PROGRESS)
-                    {
-                      /* Note that we call the monitor even if we do
-                       * not know the status code (r < 0).  */
-                      err = gpg->status.mon_cb (gpg->status.mon_cb_value,
-                                                buffer + 9, rest);
-                      if (err)
-                        return err;
-                    }
-		  if (r >= 0)
-		    {
-		      if (gpg->cmd.used
-			  && (r == GPGME_STATUS_GET_BOOL
-			      || r == GPGME_STATUS_GET_LINE
-			      || r == GPGME_STATUS_GET_HIDDEN))
-			{
-			  gpg->cmd.code = r;
-			  if (gpg->cmd.keyword)
-			    free (gpg->cmd.keyword);
-			  gpg->cmd.keyword = strdup (rest);
-			  if (!gpg->cmd.keyword)
-			    return gpg_error_from_syserror ();
-			  /* This should be the last thing we have
-			     received and the next thing will be that
-			     the command handler does its action.  */
-			  if (nread > 1)
-			    TRACE (DEBUG_CTX, "gpgme:read_status", 0,
-				    "error: unexpected data");
-
-			  add_io_cb (gpg, gpg->cmd.fd, 0,
-				     command_handler, gpg,
-				     &gpg->fd_data_map[gpg->cmd.idx].tag);
-			  gpg->fd_data_map[gpg->cmd.idx].fd = gpg->cmd.fd;
-			  gpg->cmd.fd = -1;
-                        }
-		      else if (gpg->status.fnc)
-			{
-			  err = gpg->status.fnc (gpg->status.fnc_value,
-						 r, rest);
-                          if (gpg_err_code (err) == GPG_ERR_FALSE)
-                            err = 0; /* Drop special error code.  */
-			  if (err)
-			    return err;
-                        }
-                    }
+      p = line + linelen;
+      if (p > line && p[-1] == '\r')
+        p[-1] = 0;
+      if (!strncmp (line, "[GNUPG:] ", 9)
+          && line[9] >= 'A' && line[9] <= 'Z')
+        {
+          char *rest;
+          gpgme_status_code_t r;
+
+          rest = strchr (line + 9, ' ');
+          if (!rest)
+            rest = p; /* Set to an empty string.  */
+          else
+            *rest++ = 0;
+
+          r = _gpgme_parse_status (line + 9);
+          if (gpg->status.mon_cb && r != GPGME_STATUS_PROGRESS)
+            {
+              /* Note that we call the monitor even if we do
+               * not know the status code (r < 0).  */
+              err = gpg->status.mon_cb (gpg->status.mon_cb_value,
+                                        line + 9, rest);
+              if (err)
+                return err;
+            }
+          if (r >= 0)
+            {
+              if (gpg->cmd.used
+                  && (r == GPGME_STATUS_GET_BOOL
+                      || r == GPGME_STATUS_GET_LINE
+                      || r == GPGME_STATUS_GET_HIDDEN))
+                {
+                  gpg->cmd.code = r;
+                  if (gpg->cmd.keyword)
+                    free (gpg->cmd.keyword);
+                  gpg->cmd.keyword = strdup (rest);
+                  if (!gpg->cmd.keyword)
+                    return gpg_error_from_syserror ();
+                  /* This should be the last thing we have
+                     received and the next thing will be that
+                     the command handler does its action.  */
+                  if (_gpgme_linebuf_pending (&gpg->status.lb))
+                    TRACE (DEBUG_CTX, "gpgme:read_status", 0,
+                           "error: unexpected data");
+
+                  add_io_cb (gpg, gpg->cmd.fd, 0,
+                             command_handler, gpg,
+                             &gpg->fd_data_map[gpg->cmd.idx].tag);
+                  gpg->fd_data_map[gpg->cmd.idx].fd = gpg->cmd.fd;
+                  gpg->cmd.fd = -1;
+                }
+              else if (gpg->status.fnc)
+                {
+                  err = gpg->status.fnc (gpg->status.fnc_value,
+                                         r, rest);
+                  if (gpg_err_code (err) == GPG_ERR_FALSE)
+                    err = 0; /* Drop special error code.  */
+                  if (err)
+                    return err;
                 }
-	      /* To reuse the buffer for the next line we have to
-		 shift the remaining data to the buffer start and
-		 restart the loop Hmmm: We can optimize this function
-		 by looking forward in the buffer to see whether a
-		 second complete line is available and in this case
-		 avoid the memmove for this line.  */
-	      nread--; p++;
-	      if (nread)
-		memmove (buffer, p, nread);
-	      readpos = 0;
-	      break; /* the for loop */
             }
-	  else
-	    readpos++;
         }
     }
 
-  /* Update the gpg object.  */
-  gpg->status.bufsize = bufsize;
-  gpg->status.buffer = buffer;
-  gpg->status.readpos = readpos;
   return 0;
 }
 
@@ -1409,23 +1412,16 @@ status_handler (void *opaque, int fd)
 static gpgme_error_t
 read_colon_line (engine_gpg_t gpg)
 {
-  char *p;
+  char *p, *buffer;
+  size_t len;
   int nread;
-  size_t bufsize = gpg->colon.bufsize;
-  char *buffer = gpg->colon.buffer;
-  size_t readpos = gpg->colon.readpos;
+  gpgme_error_t err;
 
-  assert (buffer);
-  if (bufsize - readpos < 256)
-    {
-      /* Need more room for the read.  */
-      bufsize += 1024;
-      buffer = realloc (buffer, bufsize);
-      if (!buffer)
-	return gpg_error_from_syserror ();
-    }
+  err = _gpgme_linebuf_reserve (&gpg->colon.lb, 256, 0, &p, &len);
+  if (err)
+    return err;
 
-  nread = _gpgme_io_read (gpg->colon.fd[0], buffer+readpos, bufsize-readpos);
+  nread = _gpgme_io_read (gpg->colon.fd[0], p, len);
   if (nread == -1)
     return gpg_error_from_syserror ();
 
@@ -1437,74 +1433,48 @@ read_colon_line (engine_gpg_t gpg)
       return 0;
     }
 
-  while (nread > 0)
+  _gpgme_linebuf_commit (&gpg->colon.lb, nread);
+
+  /* Process all complete lines (we require that the last line is
+     terminated by a LF) and skip empty lines.  Note: we use UTF8
+     encoding and escaping of special characters.  We require at
+     least one colon to cope with some other printed information.  */
+  while ((buffer = _gpgme_linebuf_getline (&gpg->colon.lb, NULL)))
     {
-      for (p = buffer + readpos; nread; nread--, p++)
-	{
-	  if ( *p == '\n' )
-	    {
-	      /* (we require that the last line is terminated by a LF)
-		 and we skip empty lines.  Note: we use UTF8 encoding
-		 and escaping of special characters.  We require at
-		 least one colon to cope with some other printed
-		 information.  */
-	      *p = 0;
-	      if (*buffer && strchr (buffer, ':'))
-		{
-		  char *line = NULL;
-
-		  if (gpg->colon.preprocess_fnc)
-		    {
-		      gpgme_error_t err;
-
-		      err = gpg->colon.preprocess_fnc (buffer, &line);
-		      if (err)
-			return err;
-		    }
-
-		  assert (gpg->colon.fnc);
-                  if (line)
-                    {
-                      char *linep = line;
-                      char *endp;
-
-                      do
-                        {
-                          endp = strchr (linep, '\n');
-                          if (endp)
-                            *endp++ = 0;
-                          gpg->colon.fnc (gpg->colon.fnc_value, linep);
-                          linep = endp;
-                        }
-                      while (linep && *linep);
-
-                      gpgrt_free (line);
-                    }
-                  else
-                    gpg->colon.fnc (gpg->colon.fnc_value, buffer);
+      if (*buffer && strchr (buffer, ':'))
+        {
+          char *line = NULL;
+
+          if (gpg->colon.preprocess_fnc)
+            {
+              err = gpg->colon.preprocess_fnc (buffer, &line);
+              if (err)
+                return err;
+            }
+
+          assert (gpg->colon.fnc);
+          if (line)
+            {
+              char *linep = line;
+              char *endp;
+
+              do
+                {
+                  endp = strchr (linep, '\n');
+                  if (endp)
+                    *endp++ = 0;
+                  gpg->colon.fnc (gpg->colon.fnc_value, linep);
+                  linep = endp;
                 }
+              while (linep && *linep);
 
-	      /* To reuse the buffer for the next line we have to
-		 shift the remaining data to the buffer start and
-		 restart the loop Hmmm: We can optimize this function
-		 by looking forward in the buffer to see whether a
-		 second complete line is available and in this case
-		 avoid the memmove for this line.  */
-	      nread--; p++;
-	      if (nread)
-		memmove (buffer, p, nread);
-	      readpos = 0;
-	      break; /* The for loop.  */
+              gpgrt_free (line);
             }
-	  else
-	    readpos++;
+          else
+            gpg->colon.fnc (gpg->colon.fnc_value, buffer);
         }
     }
 
-  /* Update the gpg object.  */
-  gpg->colon.bufsize = bufsize;
-  gpg->colon.buffer  = buffer;
-  gpg->colon.readpos = readpos;
   return 0;
 }
 
@@ -1599,15 +1569,24 @@ start (engine_gpg_t gpg)
   fd_list[n].fd = -1;
   fd_list[n].dup_to = -1;
 
+#ifdef HAVE_W32_SYSTEM
   status = _gpgme_io_spawn (pgmname, gpg->argv,
                             (IOSPAWN_FLAG_DETACHED |IOSPAWN_FLAG_ALLOW_SET_FG),
                             fd_list, NULL, NULL, &pid);
+#else
+  status = _gpgme_io_spawn (pgmname, gpg->argv,
+                            (IOSPAWN_FLAG_WAIT |IOSPAWN_FLAG_ALLOW_SET_FG),
+                            fd_list, NULL, NULL, &pid);
+#endif
   {
     int saved_err = gpg_error_from_syserror ();
     free (fd_list);
     if (status == -1)
       return saved_err;
   }
+#ifndef HAVE_W32_SYSTEM
+  gpg->pid = pid;
+#endif
 
   /*_gpgme_register_term_handler ( closure, closure_value, pid );*/
 
@@ -1635,7 +1614,7 @@ start (engine_gpg_t gpg)
 	  gpg->cmd.fd = gpg->fd_data_map[i].fd;
 	  gpg->fd_data_map[i].fd = -1;
 	}
-      else
+      else if (gpg->fd_data_map[i].fd != -1)
 	{
 	  rc = add_io_cb (gpg, gpg->fd_data_map[i].fd,
 			  gpg->fd_data_map[i].inbound,
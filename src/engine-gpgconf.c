@@ -30,6 +30,9 @@
 # include <sys/types.h>
 #endif
 #include <assert.h>
+#ifdef HAVE_SYS_STAT_H
+# include <sys/stat.h>
+#endif
 #ifdef HAVE_UNISTD_H
 # include <unistd.h>
 #endif
@@ -45,6 +48,7 @@
 
 #include "assuan.h"
 #include "debug.h"
+#include "linebuf.h"
 
 #include "engine-backend.h"
 
@@ -59,6 +63,48 @@ struct engine_gpgconf
 
 typedef struct engine_gpgconf *engine_gpgconf_t;
 
+
+/* The maximum length of a line of gpgconf output.  This should allow
+   for quite a long "group" line, which is usually the longest line
+   (mine is currently ~3k).  */
+#define MAX_LINE_LENGTH (64 * 1024)
+
+/* The outputs of gpgconf --list-components and --list-options are
+   cached per gpgconf program and home directory.  The list of
+   components is valid as long as the gpgconf program is not changed.
+   The options of a component are also invalidated by a change of the
+   configuration files which gpgconf reads for them; see
+   conf_cache_stamp.  Changes are detected by the stat information of
+   these files.  */
+#define CONF_CACHE_FILES 5
+
+struct file_stamp_s
+{
+  int exists;
+  time_t mtime;
+  time_t ctime;
+  long mtime_nsec;
+  long ctime_nsec;
+  off_t size;
+  unsigned long ino;
+};
+
+struct conf_cache_item_s
+{
+  struct conf_cache_item_s *next;
+  char *file_name;
+  char *home_dir;
+  /* The component or NULL for the list of components.  */
+  char *component;
+  struct file_stamp_s stamps[CONF_CACHE_FILES];
+  char *output;
+  size_t outputlen;
+};
+typedef struct conf_cache_item_s *conf_cache_item_t;
+
+DEFINE_STATIC_LOCK (conf_cache_lock);
+static conf_cache_item_t conf_cache;
+
 
 /* Return true if the engine's version is at least VERSION.  */
 static int
@@ -213,28 +259,18 @@ gpgconf_config_release (gpgme_conf_comp_t conf)
     }
 }
 
-/* Read from gpgconf and pass line after line to the hook function.
-   We put a limit of 64 k on the maximum size for a line.  This should
-   allow for quite a long "group" line, which is usually the longest
-   line (mine is currently ~3k).  */
+/* Start gpgconf with the arguments ARG1 and ARG2 and store the fd to
+   read its output from at R_FD.  */
 static gpgme_error_t
-gpgconf_read (void *engine, const char *arg1, char *arg2,
-	      gpgme_error_t (*cb) (void *hook, char *line),
-	      void *hook)
+gpgconf_spawn (engine_gpgconf_t gpgconf, const char *arg1, char *arg2,
+               int *r_fd)
 {
-  struct engine_gpgconf *gpgconf = engine;
-  gpgme_error_t err = 0;
-  char *linebuf;
-  size_t linebufsize;
-  int linelen;
   char *argv[6];
   int argc = 0;
   int rp[2];
   struct spawn_fd_item_s cfd[] = { {-1, 1 /* STDOUT_FILENO */, -1, 0},
 				   {-1, -1} };
   int status;
-  int nread;
-  char *mark = NULL;
 
   /* _gpgme_engine_new guarantees that this is not NULL.  */
   argv[argc++] = gpgconf->file_name;
@@ -264,38 +300,56 @@ gpgconf_read (void *engine, const char *arg1, char *arg2,
       return gpg_error_from_syserror ();
     }
 
-  linebufsize = 1024; /* Usually enough for conf lines.  */
-  linebuf = malloc (linebufsize);
-  if (!linebuf)
-    {
-      err = gpg_error_from_syserror ();
-      goto leave;
-    }
-  linelen = 0;
+  *r_fd = rp[0];
+  return 0;
+}
+
 
-  while ((nread = _gpgme_io_read (rp[0], linebuf + linelen,
-                                  linebufsize - linelen - 1)))
+/* Read from gpgconf and pass line after line to the hook function.
+   We put a limit of MAX_LINE_LENGTH on the maximum size for a
+   line.  */
+static gpgme_error_t
+gpgconf_read (void *engine, const char *arg1, char *arg2,
+	      gpgme_error_t (*cb) (void *hook, char *line),
+	      void *hook)
+{
+  gpgme_error_t err = 0;
+  struct linebuf_s lb;
+  int fd;
+  int nread;
+
+  err = gpgconf_spawn (engine, arg1, arg2, &fd);
+  if (err)
+    return err;
+
+  /* Usually enough for conf lines.  */
+  err = _gpgme_linebuf_init (&lb, 1024);
+  if (err)
+    goto leave;
+
+  for (;;)
     {
-      char *line;
-      const char *lastmark = NULL;
-      size_t nused;
+      char *space, *line;
+      size_t len, linelen;
 
+      err = _gpgme_linebuf_reserve (&lb, 256, MAX_LINE_LENGTH, &space, &len);
+      if (err)
+        goto leave;
+
+      nread = _gpgme_io_read (fd, space, len);
       if (nread < 0)
         {
           err = gpg_error_from_syserror ();
           goto leave;
         }
+      if (!nread)
+        break;
+      _gpgme_linebuf_commit (&lb, nread);
 
-      linelen += nread;
-      linebuf[linelen] = '\0';
-
-      for (line=linebuf; (mark = strchr (line, '\n')); line = mark+1 )
+      while ((line = _gpgme_linebuf_getline (&lb, &linelen)))
         {
-          lastmark = mark;
-          if (mark > line && mark[-1] == '\r')
-            mark[-1] = '\0';
-          else
-            mark[0] = '\0';
+          if (linelen && line[linelen - 1] == '\r')
+            line[linelen - 1] = '\0';
 
           /* Got a full line.  Due to the CR removal code (which
              occurs only on Windows) we might be one-off and thus
@@ -305,40 +359,312 @@ gpgconf_read (void *engine, const char *arg1, char *arg2,
           if (err)
             goto leave;
         }
+    }
 
-      nused = lastmark? (lastmark + 1 - linebuf) : 0;
-      memmove (linebuf, linebuf + nused, linelen - nused);
-      linelen -= nused;
+ leave:
+  _gpgme_linebuf_release (&lb);
+  _gpgme_io_close (fd);
+  return err;
+}
 
-      if (!(linelen < linebufsize - 1))
-        {
-          char *newlinebuf;
 
-          if (linelen <  8 * 1024 - 1)
-            linebufsize = 8 * 1024;
-          else if (linelen < 64 * 1024 - 1)
-            linebufsize = 64 * 1024;
-          else
-            {
-              /* We reached our limit - give up.  */
-              err = gpg_error (GPG_ERR_LINE_TOO_LONG);
-              goto leave;
-            }
+/* Read the whole output of gpgconf from FD, which is closed, and
+   store it in a newly allocated buffer at R_OUTPUT and its length at
+   R_OUTPUTLEN.  */
+static gpgme_error_t
+gpgconf_read_output (int fd, char **r_output, size_t *r_outputlen)
+{
+  gpgme_error_t err = 0;
+  char *output = NULL;
+  size_t size = 0;
+  size_t len = 0;
+  int nread;
+
+  for (;;)
+    {
+      if (size - len < 256)
+        {
+          char *newoutput;
 
-          newlinebuf = realloc (linebuf, linebufsize);
-          if (!newlinebuf)
+          size = size? 2 * size : 4096;
+          newoutput = realloc (output, size);
+          if (!newoutput)
             {
               err = gpg_error_from_syserror ();
-              goto leave;
+              break;
             }
-          linebuf = newlinebuf;
+          output = newoutput;
         }
+
+      nread = _gpgme_io_read (fd, output + len, size - len);
+      if (nread < 0)
+        {
+          err = gpg_error_from_syserror ();
+          break;
+        }
+      if (!nread)
+        break;
+      len += nread;
     }
+  _gpgme_io_close (fd);
 
- leave:
-  free (linebuf);
-  _gpgme_io_close (rp[0]);
-  return err;
+  if (err)
+    {
+      free (output);
+      return err;
+    }
+  *r_output = output;
+  *r_outputlen = len;
+  return 0;
+}
+
+
+/* Pass line after line of the gpgconf output OUTPUT of length
+   OUTPUTLEN to the hook function as gpgconf_read does.  The lines are
+   terminated in place.  */
+static gpgme_error_t
+gpgconf_parse_output (char *output, size_t outputlen,
+                      gpgme_error_t (*cb) (void *hook, char *line),
+                      void *hook)
+{
+  gpgme_error_t err;
+  char *line, *end;
+  size_t linelen;
+
+  line = output;
+  while ((end = memchr (line, '\n', outputlen - (line - output))))
+    {
+      linelen = end - line;
+      if (linelen >= MAX_LINE_LENGTH)
+        return gpg_error (GPG_ERR_LINE_TOO_LONG);
+      *end = '\0';
+      if (linelen && line[linelen - 1] == '\r')
+        line[linelen - 1] = '\0';
+
+      err = *line? (*cb) (hook, line) : 0;
+      if (err)
+        return err;
+      line = end + 1;
+    }
+
+  return 0;
+}
+
+
+/* Record the stat information of FILE_NAME at STAMP.  */
+static void
+file_stamp (struct file_stamp_s *stamp, const char *file_name)
+{
+  struct stat st;
+
+  memset (stamp, 0, sizeof *stamp);
+  if (!file_name || stat (file_name, &st))
+    return;
+  stamp->exists = 1;
+  stamp->mtime = st.st_mtime;
+  stamp->ctime = st.st_ctime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+  stamp->mtime_nsec = st.st_mtim.tv_nsec;
+  stamp->ctime_nsec = st.st_ctim.tv_nsec;
+#endif
+  stamp->size = st.st_size;
+  stamp->ino = st.st_ino;
+}
+
+
+/* Record the stat information of the files the output of gpgconf
+   --list-options COMPONENT depends on at STAMPS.  If COMPONENT is
+   NULL, this is done for --list-components.  */
+static void
+conf_cache_stamp (engine_gpgconf_t gpgconf, const char *component,
+                  struct file_stamp_s stamps[CONF_CACHE_FILES])
+{
+  static const char *const conf_files[CONF_CACHE_FILES - 2] =
+    { NULL, "gpgconf.conf", "common.conf" };
+  const char *home_dir, *sysconfdir;
+  char *file_name;
+  int i;
+
+  file_stamp (&stamps[0], gpgconf->file_name);
+  for (i = 1; i < CONF_CACHE_FILES; i++)
+    file_stamp (&stamps[i], NULL);
+  if (!component)
+    return;
+
+  /* The configuration file of the component and the files with
+     options common to all components.  */
+  home_dir = gpgconf->home_dir;
+  if (!home_dir)
+    home_dir = _gpgme_get_default_homedir ();
+  for (i = 0; home_dir && i < CONF_CACHE_FILES - 2; i++)
+    {
+      if (conf_files[i])
+        file_name = _gpgme_strconcat (home_dir, "/", conf_files[i], NULL);
+      else
+        file_name = _gpgme_strconcat (home_dir, "/", component, ".conf",
+                                      NULL);
+      file_stamp (&stamps[i + 1], file_name);
+      free (file_name);
+    }
+
+  /* The global gpgconf.conf.  */
+  sysconfdir = gpgme_get_dirinfo ("sysconfdir");
+  if (sysconfdir)
+    {
+      file_name = _gpgme_strconcat (sysconfdir, "/gpgconf.conf", NULL);
+      file_stamp (&stamps[CONF_CACHE_FILES - 1], file_name);
+      free (file_name);
+    }
+}
+
+
+static int
+same_string (const char *a, const char *b)
+{
+  return a? (b && !strcmp (a, b)) : !b;
+}
+
+
+/* Return true if the cache item ITEM is for GPGCONF and COMPONENT.  */
+static int
+conf_cache_match (conf_cache_item_t item, engine_gpgconf_t gpgconf,
+                  const char *component)
+{
+  return (!strcmp (item->file_name, gpgconf->file_name)
+          && same_string (item->home_dir, gpgconf->home_dir)
+          && same_string (item->component, component));
+}
+
+
+static int
+same_stamps (const struct file_stamp_s *a, const struct file_stamp_s *b)
+{
+  int i;
+
+  for (i = 0; i < CONF_CACHE_FILES; i++)
+    if (a[i].exists != b[i].exists
+        || a[i].mtime != b[i].mtime
+        || a[i].ctime != b[i].ctime
+        || a[i].mtime_nsec != b[i].mtime_nsec
+        || a[i].ctime_nsec != b[i].ctime_nsec
+        || a[i].size != b[i].size
+        || a[i].ino != b[i].ino)
+      return 0;
+  return 1;
+}
+
+
+static void
+conf_cache_item_release (conf_cache_item_t item)
+{
+  free (item->file_name);
+  free (item->home_dir);
+  free (item->component);
+  free (item->output);
+  free (item);
+}
+
+
+/* Look up the cached output of gpgconf for COMPONENT (see
+   conf_cache_stamp).  If it is there and still valid according to
+   STAMPS, store a copy at R_OUTPUT and its length at R_OUTPUTLEN and
+   return true.  */
+static int
+conf_cache_get (engine_gpgconf_t gpgconf, const char *component,
+                const struct file_stamp_s *stamps,
+                char **r_output, size_t *r_outputlen)
+{
+  conf_cache_item_t item;
+  int found = 0;
+
+  LOCK (conf_cache_lock);
+  for (item = conf_cache; item; item = item->next)
+    if (conf_cache_match (item, gpgconf, component))
+      break;
+  if (item && same_stamps (item->stamps, stamps))
+    {
+      *r_output = malloc (item->outputlen? item->outputlen : 1);
+      if (*r_output)
+        {
+          memcpy (*r_output, item->output, item->outputlen);
+          *r_outputlen = item->outputlen;
+          found = 1;
+        }
+    }
+  UNLOCK (conf_cache_lock);
+
+  TRACE (DEBUG_ENGINE, "gpgconf_conf_load", gpgconf,
+         "%s for component %s", found? "cache hit" : "cache miss",
+         component? component : "(list)");
+  return found;
+}
+
+
+/* Enter a copy of the output OUTPUT of length OUTPUTLEN of gpgconf
+   for COMPONENT, which was started after taking STAMPS, into the
+   cache.  Errors are ignored.  */
+static void
+conf_cache_put (engine_gpgconf_t gpgconf, const char *component,
+                const struct file_stamp_s *stamps,
+                const char *output, size_t outputlen)
+{
+  conf_cache_item_t item, *itemp;
+
+  item = calloc (1, sizeof *item);
+  if (!item)
+    return;
+  item->file_name = strdup (gpgconf->file_name);
+  item->home_dir = gpgconf->home_dir? strdup (gpgconf->home_dir) : NULL;
+  item->component = component? strdup (component) : NULL;
+  item->output = malloc (outputlen? outputlen : 1);
+  if (!item->file_name || (gpgconf->home_dir && !item->home_dir)
+      || (component && !item->component) || !item->output)
+    {
+      conf_cache_item_release (item);
+      return;
+    }
+  memcpy (item->stamps, stamps, sizeof item->stamps);
+  memcpy (item->output, output, outputlen);
+  item->outputlen = outputlen;
+
+  LOCK (conf_cache_lock);
+  for (itemp = &conf_cache; *itemp; itemp = &(*itemp)->next)
+    if (conf_cache_match (*itemp, gpgconf, component))
+      {
+        conf_cache_item_t old = *itemp;
+
+        *itemp = old->next;
+        conf_cache_item_release (old);
+        break;
+      }
+  item->next = conf_cache;
+  conf_cache = item;
+  UNLOCK (conf_cache_lock);
+}
+
+
+/* Remove the cached options of all components for GPGCONF.  */
+static void
+conf_cache_flush (engine_gpgconf_t gpgconf)
+{
+  conf_cache_item_t *itemp;
+
+  LOCK (conf_cache_lock);
+  itemp = &conf_cache;
+  while (*itemp)
+    {
+      conf_cache_item_t item = *itemp;
+
+      if (item->component && !strcmp (item->file_name, gpgconf->file_name)
+          && same_string (item->home_dir, gpgconf->home_dir))
+        {
+          *itemp = item->next;
+          conf_cache_item_release (item);
+        }
+      else
+        itemp = &item->next;
+    }
+  UNLOCK (conf_cache_lock);
 }
 
 
@@ -560,34 +886,143 @@ gpgconf_config_load_cb2 (void *hook, char *line)
 }
 
 
+/* The state of loading the options of one component.  */
+struct conf_load_job_s
+{
+  gpgme_conf_comp_t comp;
+  struct file_stamp_s stamps[CONF_CACHE_FILES];
+  int fd;
+  char *output;
+  size_t outputlen;
+};
+
+
+/* Load the list of components into a new list at R_COMP.  */
+static gpgme_error_t
+gpgconf_list_components (engine_gpgconf_t gpgconf, gpgme_conf_comp_t *r_comp)
+{
+  gpgme_error_t err;
+  struct file_stamp_s stamps[CONF_CACHE_FILES];
+  char *output;
+  size_t outputlen;
+  int fd;
+
+  *r_comp = NULL;
+  conf_cache_stamp (gpgconf, NULL, stamps);
+  if (!conf_cache_get (gpgconf, NULL, stamps, &output, &outputlen))
+    {
+      err = gpgconf_spawn (gpgconf, "--list-components", NULL, &fd);
+      if (!err)
+        err = gpgconf_read_output (fd, &output, &outputlen);
+      if (err)
+        return err;
+      conf_cache_put (gpgconf, NULL, stamps, output, outputlen);
+    }
+
+  err = gpgconf_parse_output (output, outputlen,
+                              gpgconf_config_load_cb, r_comp);
+  free (output);
+  if (err)
+    {
+      gpgconf_config_release (*r_comp);
+      *r_comp = NULL;
+    }
+  return err;
+}
+
+
+/* Load the configuration of COMPONENT or, if it is NULL, of all
+   components.  The options of the components are listed by
+   concurrent gpgconf processes unless they are in the cache.  */
 static gpgme_error_t
-gpgconf_conf_load (void *engine, gpgme_conf_comp_t *comp_p)
+gpgconf_conf_load (void *engine, const char *component,
+                   gpgme_conf_comp_t *comp_p)
 {
+  engine_gpgconf_t gpgconf = engine;
   gpgme_error_t err;
   gpgme_conf_comp_t comp = NULL;
-  gpgme_conf_comp_t cur_comp;
+  gpgme_conf_comp_t cur_comp, *compp;
+  struct conf_load_job_s *jobs = NULL;
+  unsigned int njobs, i;
 
   *comp_p = NULL;
 
-  err = gpgconf_read (engine, "--list-components", NULL,
-		      gpgconf_config_load_cb, &comp);
+  err = gpgconf_list_components (gpgconf, &comp);
   if (err)
+    return err;
+
+  if (component)
     {
-      gpgconf_release (comp);
-      return err;
+      /* Keep only the requested component.  */
+      for (compp = &comp; *compp; compp = &(*compp)->next)
+        if (!strcmp ((*compp)->name, component))
+          break;
+      if (!*compp)
+        {
+          gpgconf_config_release (comp);
+          return gpg_error (GPG_ERR_NOT_FOUND);
+        }
+      cur_comp = *compp;
+      *compp = cur_comp->next;
+      cur_comp->next = NULL;
+      gpgconf_config_release (comp);
+      comp = cur_comp;
+    }
+
+  for (njobs = 0, cur_comp = comp; cur_comp; cur_comp = cur_comp->next)
+    njobs++;
+  jobs = calloc (njobs? njobs : 1, sizeof *jobs);
+  if (!jobs)
+    {
+      err = gpg_error_from_syserror ();
+      goto leave;
+    }
+
+  /* Start gpgconf for all components which are not cached.  */
+  for (i = 0, cur_comp = comp; cur_comp; i++, cur_comp = cur_comp->next)
+    {
+      jobs[i].comp = cur_comp;
+      jobs[i].fd = -1;
+      conf_cache_stamp (gpgconf, cur_comp->name, jobs[i].stamps);
+      if (!err
+          && !conf_cache_get (gpgconf, cur_comp->name, jobs[i].stamps,
+                              &jobs[i].output, &jobs[i].outputlen))
+        err = gpgconf_spawn (gpgconf, "--list-options", cur_comp->name,
+                             &jobs[i].fd);
     }
 
-  cur_comp = comp;
-  while (!err && cur_comp)
+  /* Collect their output.  The processes do not depend on each other
+     and thus reading them one after the other can't deadlock.  */
+  for (i = 0; i < njobs; i++)
     {
-      err = gpgconf_read (engine, "--list-options", cur_comp->name,
-			  gpgconf_config_load_cb2, cur_comp);
-      cur_comp = cur_comp->next;
+      if (jobs[i].fd == -1)
+        continue;
+      if (err)
+        {
+          _gpgme_io_close (jobs[i].fd);
+          continue;
+        }
+      err = gpgconf_read_output (jobs[i].fd, &jobs[i].output,
+                                 &jobs[i].outputlen);
+      if (!err)
+        conf_cache_put (gpgconf, jobs[i].comp->name, jobs[i].stamps,
+                        jobs[i].output, jobs[i].outputlen);
     }
 
+  for (i = 0; !err && i < njobs; i++)
+    err = gpgconf_parse_output (jobs[i].output, jobs[i].outputlen,
+                                gpgconf_config_load_cb2, jobs[i].comp);
+
+ leave:
+  if (jobs)
+    {
+      for (i = 0; i < njobs; i++)
+        free (jobs[i].output);
+      free (jobs);
+    }
   if (err)
     {
-      gpgconf_release (comp);
+      gpgconf_config_release (comp);
       return err;
     }
 
@@ -596,7 +1031,6 @@ gpgconf_conf_load (void *engine, gpgme_conf_comp_t *comp_p)
 }
 
 
-
 gpgme_error_t
 _gpgme_conf_arg_new (gpgme_conf_arg_t *arg_p,
 		     gpgme_conf_type_t type, const void *value)
@@ -981,6 +1415,7 @@ gpgconf_conf_save (void *engine, gpgme_conf_comp_t comp)
     goto bail;
 
   err = gpgconf_write (engine, "--change-options", comp->name, conf);
+  conf_cache_flush (engine);
  bail:
   gpgme_data_release (conf);
   return err;
@@ -1127,9 +1562,7 @@ gpgconf_query_swdb (void *engine,
 {
   struct engine_gpgconf *gpgconf = engine;
   gpgme_error_t err = 0;
-  char *linebuf;
-  size_t linebufsize;
-  int linelen;
+  struct linebuf_s lb;
   char *argv[7];
   int argc = 0;
   int rp[2];
@@ -1137,7 +1570,6 @@ gpgconf_query_swdb (void *engine,
 				   {-1, -1} };
   int status;
   int nread;
-  char *mark = NULL;
 
   if (!have_gpgconf_version (gpgconf, "2.1.16"))
     return gpg_error (GPG_ERR_ENGINE_TOO_OLD);
@@ -1171,38 +1603,34 @@ gpgconf_query_swdb (void *engine,
       return gpg_error_from_syserror ();
     }
 
-  linebufsize = 2048; /* Same as used by gpgconf.  */
-  linebuf = malloc (linebufsize);
-  if (!linebuf)
-    {
-      err = gpg_error_from_syserror ();
-      goto leave;
-    }
-  linelen = 0;
+  /* Same as used by gpgconf.  */
+  err = _gpgme_linebuf_init (&lb, 2048);
+  if (err)
+    goto leave;
 
-  while ((nread = _gpgme_io_read (rp[0], linebuf + linelen,
-                                  linebufsize - linelen - 1)))
+  for (;;)
     {
-      char *line;
-      const char *lastmark = NULL;
-      size_t nused;
+      char *space, *line;
+      size_t len, linelen;
+
+      err = _gpgme_linebuf_reserve (&lb, 256, 64 * 1024, &space, &len);
+      if (err)
+        goto leave;
 
+      nread = _gpgme_io_read (rp[0], space, len);
       if (nread < 0)
         {
           err = gpg_error_from_syserror ();
           goto leave;
         }
+      if (!nread)
+        break;
+      _gpgme_linebuf_commit (&lb, nread);
 
-      linelen += nread;
-      linebuf[linelen] = '\0';
-
-      for (line=linebuf; (mark = strchr (line, '\n')); line = mark+1 )
+      while ((line = _gpgme_linebuf_getline (&lb, &linelen)))
         {
-          lastmark = mark;
-          if (mark > line && mark[-1] == '\r')
-            mark[-1] = '\0';
-          else
-            mark[0] = '\0';
+          if (linelen && line[linelen - 1] == '\r')
+            line[linelen - 1] = '\0';
 
           /* Got a full line.  Due to the CR removal code (which
              occurs only on Windows) we might be one-off and thus
@@ -1215,38 +1643,10 @@ gpgconf_query_swdb (void *engine,
           else /* empty line.  */
             err = 0;
         }
-
-      nused = lastmark? (lastmark + 1 - linebuf) : 0;
-      memmove (linebuf, linebuf + nused, linelen - nused);
-      linelen -= nused;
-
-      if (!(linelen < linebufsize - 1))
-        {
-          char *newlinebuf;
-
-          if (linelen <  8 * 1024 - 1)
-            linebufsize = 8 * 1024;
-          else if (linelen < 64 * 1024 - 1)
-            linebufsize = 64 * 1024;
-          else
-            {
-              /* We reached our limit - give up.  */
-              err = gpg_error (GPG_ERR_LINE_TOO_LONG);
-              goto leave;
-            }
-
-          newlinebuf = realloc (linebuf, linebufsize);
-          if (!newlinebuf)
-            {
-              err = gpg_error_from_syserror ();
-              goto leave;
-            }
-          linebuf = newlinebuf;
-        }
     }
 
  leave:
-  free (linebuf);
+  _gpgme_linebuf_release (&lb);
   _gpgme_io_close (rp[0]);
   return err;
 }
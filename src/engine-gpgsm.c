@@ -108,11 +108,24 @@ struct engine_gpgsm
   gpgme_data_t inline_data;  /* Used to collect D lines.  */
 
   char request_origin[10];
+  int request_origin_sent;  /* OPTION request-origin has been sent.  */
 
   struct gpgme_io_cbs io_cbs;
 
   /* Memory data containing diagnostics (--logger-fd) of gpgsm */
   gpgme_data_t diagnostics;
+
+  /* State for the engine pool.  ENABLED is set if the engine may be
+   * put into the pool; FILE_NAME and HOME_DIR are then the arguments
+   * used to create it.  */
+  struct
+  {
+    int enabled;
+    char *file_name;
+    char *home_dir;
+    int tainted;  /* An option has been set which RESET can't undo.  */
+    int diag_fd;  /* A dup of the read end of the diag pipe.  */
+  } pool;
 };
 
 typedef struct engine_gpgsm *engine_gpgsm_t;
@@ -120,6 +133,10 @@ typedef struct engine_gpgsm *engine_gpgsm_t;
 
 static void gpgsm_io_event (void *engine,
                             gpgme_event_io_t type, void *type_data);
+static gpgme_error_t gpgsm_assuan_simple_command (engine_gpgsm_t gpgsm,
+                                                  const char *cmd,
+                                                  engine_status_handler_t fnc,
+                                                  void *fnc_value);
 
 
 
@@ -244,8 +261,9 @@ gpgsm_cancel (void *engine)
 }
 
 
+/* Terminate the server and release the engine.  */
 static void
-gpgsm_release (void *engine)
+gpgsm_destroy (void *engine)
 {
   engine_gpgsm_t gpgsm = engine;
 
@@ -256,11 +274,76 @@ gpgsm_release (void *engine)
 
   gpgme_data_release (gpgsm->diagnostics);
 
+  if (gpgsm->pool.diag_fd != -1)
+    _gpgme_io_close (gpgsm->pool.diag_fd);
+  free (gpgsm->pool.file_name);
+  free (gpgsm->pool.home_dir);
   free (gpgsm->colon.attic.line);
   free (gpgsm);
 }
 
 
+#if USE_DESCRIPTOR_PASSING
+/* Reset the idle engine GPGSM and put it into the engine pool.
+ * Returns 0 on success.  */
+static int
+gpgsm_pool_put (engine_gpgsm_t gpgsm)
+{
+  gpgme_data_t diagnostics;
+
+  if (!gpgsm->pool.enabled || gpgsm->pool.tainted || !gpgsm->assuan_ctx
+      || gpgsm->status_cb.fd != -1 || gpgsm->input_cb.fd != -1
+      || gpgsm->output_cb.fd != -1 || gpgsm->message_cb.fd != -1
+      || gpgsm->inline_data || !_gpgme_engine_pool_enabled ())
+    return -1;
+
+  /* Forget everything about the context.  A locale is never set here
+     because gpgsm can't reset it.  */
+  gpgsm->status.fnc = NULL;
+  gpgsm->status.fnc_value = NULL;
+  gpgsm->status.mon_cb = NULL;
+  gpgsm->status.mon_cb_value = NULL;
+  gpgsm->colon.fnc = NULL;
+  gpgsm->colon.fnc_value = NULL;
+  gpgsm->colon.attic.linelen = 0;
+  gpgsm->colon.any = 0;
+  memset (&gpgsm->io_cbs, 0, sizeof gpgsm->io_cbs);
+  *gpgsm->request_origin = 0;
+
+  if (gpgsm_assuan_simple_command (gpgsm, "RESET", NULL, NULL))
+    return -1;
+
+  /* The diagnostics belong to the context.  */
+  if (gpgme_data_new (&diagnostics))
+    return -1;
+  gpgme_data_release (gpgsm->diagnostics);
+  gpgsm->diagnostics = diagnostics;
+  gpgsm->diag_cb.data = diagnostics;
+  if (gpgsm->diag_cb.fd != -1)
+    _gpgme_io_close (gpgsm->diag_cb.fd);
+
+  return _gpgme_engine_pool_put (GPGME_PROTOCOL_CMS, gpgsm->pool.file_name,
+                                 gpgsm->pool.home_dir, gpgsm, gpgsm_destroy);
+}
+#endif /*USE_DESCRIPTOR_PASSING*/
+
+
+static void
+gpgsm_release (void *engine)
+{
+  engine_gpgsm_t gpgsm = engine;
+
+  if (!gpgsm)
+    return;
+
+#if USE_DESCRIPTOR_PASSING
+  if (!gpgsm_pool_put (gpgsm))
+    return;
+#endif
+  gpgsm_destroy (gpgsm);
+}
+
+
 static gpgme_error_t
 gpgsm_new (void **engine, const char *file_name, const char *home_dir,
            const char *version)
@@ -283,9 +366,51 @@ gpgsm_new (void **engine, const char *file_name, const char *home_dir,
 
   (void)version; /* Not yet used.  */
 
+#if USE_DESCRIPTOR_PASSING
+  /* Try to reuse an idle server.  */
+  if (_gpgme_engine_pool_enabled ())
+    {
+      gpgsm = _gpgme_engine_pool_get (GPGME_PROTOCOL_CMS,
+                                      file_name, home_dir);
+      if (gpgsm && !gpgsm_assuan_simple_command (gpgsm, "NOP", NULL, NULL))
+        {
+          struct io_select_fd_s fd;
+          char buf[256];
+
+          /* Discard what the server logged for the previous context.  */
+          fd.fd = gpgsm->pool.diag_fd;
+          fd.for_read = 1;
+          fd.for_write = 0;
+          while (_gpgme_io_select (&fd, 1, 1) > 0 && fd.signaled
+                 && _gpgme_io_read (fd.fd, buf, sizeof buf) > 0)
+            ;
+          *engine = gpgsm;
+          return 0;
+        }
+      gpgsm_destroy (gpgsm);
+    }
+#endif
+
   gpgsm = calloc (1, sizeof *gpgsm);
   if (!gpgsm)
     return gpg_error_from_syserror ();
+  gpgsm->pool.diag_fd = -1;
+
+#if USE_DESCRIPTOR_PASSING
+  if (_gpgme_engine_pool_enabled ())
+    {
+      gpgsm->pool.enabled = 1;
+      if (file_name && !(gpgsm->pool.file_name = strdup (file_name)))
+        err = gpg_error_from_syserror ();
+      if (home_dir && !(gpgsm->pool.home_dir = strdup (home_dir)))
+        err = gpg_error_from_syserror ();
+      if (err)
+        {
+          gpgsm_destroy (gpgsm);
+          return err;
+        }
+    }
+#endif
 
   gpgsm->status_cb.fd = -1;
   gpgsm->status_cb.dir = 1;
@@ -337,6 +462,20 @@ gpgsm_new (void **engine, const char *file_name, const char *home_dir,
   gpgsm->diag_cb.server_fd = fds[1];
 
 #if USE_DESCRIPTOR_PASSING
+  /* The diag fd is closed at the end of each operation because the
+     server never closes the pipe.  A pooled server can't be given a
+     new pipe, thus we keep the pipe open to read it again for the
+     next operation.  */
+  if (gpgsm->pool.enabled)
+    {
+      gpgsm->pool.diag_fd = _gpgme_io_dup (fds[0]);
+      if (gpgsm->pool.diag_fd < 0)
+        {
+          err = gpg_error_from_syserror ();
+          goto leave;
+        }
+    }
+
   child_fds[0] = gpgsm->diag_cb.server_fd;
   child_fds[1] = -1;
   nchild_fds = 2;
@@ -578,7 +717,7 @@ gpgsm_new (void **engine, const char *file_name, const char *home_dir,
     _gpgme_io_close (gpgsm->diag_cb.server_fd);
 
   if (err)
-    gpgsm_release (gpgsm);
+    gpgsm_destroy (gpgsm);
   else
     *engine = gpgsm;
   free (diag_fd_str);
@@ -624,7 +763,7 @@ gpgsm_set_locale (void *engine, int category, const char *value)
       if (!value && gpgsm->lc_ctype_set)
 	return gpg_error (GPG_ERR_INV_VALUE);
       if (value)
-	gpgsm->lc_ctype_set = 1;
+	gpgsm->lc_ctype_set = gpgsm->pool.tainted = 1;
     }
 #endif
 #ifdef LC_MESSAGES
@@ -634,7 +773,7 @@ gpgsm_set_locale (void *engine, int category, const char *value)
       if (!value && gpgsm->lc_messages_set)
 	return gpg_error (GPG_ERR_INV_VALUE);
       if (value)
-	gpgsm->lc_messages_set = 1;
+	gpgsm->lc_messages_set = gpgsm->pool.tainted = 1;
     }
 #endif /* LC_MESSAGES */
   else
@@ -1161,6 +1300,16 @@ start (engine_gpgsm_t gpgsm, const char *command)
       free (cmd);
       if (err && gpg_err_code (err) != GPG_ERR_UNKNOWN_OPTION)
         return err;
+      gpgsm->request_origin_sent = 1;
+    }
+  else if (gpgsm->request_origin_sent)
+    {
+      /* Revert to the default which RESET does not do.  */
+      err = gpgsm_assuan_simple_command (gpgsm, "OPTION request-origin=local",
+                                         NULL, NULL);
+      if (err && gpg_err_code (err) != GPG_ERR_UNKNOWN_OPTION)
+        return err;
+      gpgsm->request_origin_sent = 0;
     }
 
   /* We need to know the fd used by assuan for reads.  We do this by
@@ -1196,6 +1345,23 @@ start (engine_gpgsm_t gpgsm, const char *command)
       return gpg_error (GPG_ERR_GENERAL);
     }
 
+#if USE_DESCRIPTOR_PASSING
+  /* Read the diagnostics of a pooled server again.  */
+  if (gpgsm->diag_cb.fd == -1 && gpgsm->pool.diag_fd != -1)
+    {
+      gpgsm->diag_cb.fd = _gpgme_io_dup (gpgsm->pool.diag_fd);
+      if (gpgsm->diag_cb.fd < 0)
+        return gpg_error_from_syserror ();
+      if (_gpgme_io_set_close_notify (gpgsm->diag_cb.fd,
+                                      close_notify_handler, gpgsm))
+        {
+          _gpgme_io_close (gpgsm->diag_cb.fd);
+          gpgsm->diag_cb.fd = -1;
+          return gpg_error (GPG_ERR_GENERAL);
+        }
+    }
+#endif
+
   err = add_io_cb (gpgsm, &gpgsm->status_cb, status_handler);
   if (!err && gpgsm->input_cb.fd != -1)
     err = add_io_cb (gpgsm, &gpgsm->input_cb, _gpgme_data_outbound_handler);
@@ -1471,6 +1637,8 @@ gpgsm_encrypt (void *engine, gpgme_key_t recp[], const char *recpstring,
 
   if ((flags & GPGME_ENCRYPT_NO_ENCRYPT_TO))
     {
+      /* There is no way to revert this option.  */
+      gpgsm->pool.tainted = 1;
       err = gpgsm_assuan_simple_command (gpgsm,
 					 "OPTION no-encrypt-to", NULL, NULL);
       if (err)
@@ -2042,6 +2210,7 @@ gpgsm_sign (void *engine, gpgme_data_t in, gpgme_data_t out,
 	 can reset any previously set value in case the default is
 	 requested.  */
 
+      gpgsm->pool.tainted = 1;
       if (gpgrt_asprintf (&assuan_cmd,
                           "OPTION include-certs %i", include_certs) < 0)
 	return gpg_error_from_syserror ();
@@ -0,0 +1,261 @@
+/* engine-pool.c - Process wide pool of idle engine connections.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "gpgme.h"
+#include "util.h"
+#include "sema.h"
+#include "debug.h"
+#include "engine-backend.h"
+
+
+/* Starting a gpgsm server and connecting to an UI server is
+ * expensive and the server needs to warm up its caches.  If the
+ * global flag "engine-pool" is set, the assuan based engines do not
+ * terminate their server when a context is released but hand the
+ * idle connection over to this pool.  The next context using the
+ * same engine with the same home directory takes the connection from
+ * the pool instead of starting a new server.  Connections which have
+ * been idle for too long are closed whenever the pool is used.  */
+
+/* The default idle timeout in seconds.  */
+#define ENGINE_POOL_DEFAULT_TIMEOUT 60
+
+
+struct pool_item_s
+{
+  struct pool_item_s *next;
+  gpgme_protocol_t protocol;
+  char *file_name;
+  char *home_dir;
+  time_t stamp;               /* Time the connection was put back.  */
+  void *engine;
+  void (*release) (void *engine);
+};
+typedef struct pool_item_s *pool_item_t;
+
+
+DEFINE_STATIC_LOCK (engine_pool_lock);
+
+/* The maximum number of idle connections; 0 disables the pool.  */
+static unsigned int pool_max;
+
+/* The idle timeout in seconds.  */
+static unsigned int pool_timeout = ENGINE_POOL_DEFAULT_TIMEOUT;
+
+/* The idle connections, the most recently used first.  */
+static pool_item_t pool_items;
+static unsigned int pool_nitems;
+
+
+/* Helper function to be used only by gpgme_set_global_flag.  VALUE
+ * is the maximum number of idle connections optionally followed by
+ * a comma and the idle timeout in seconds.  Returns 0 on success.  */
+int
+_gpgme_set_engine_pool (const char *value)
+{
+  char *endp;
+  unsigned long maxitems, timeout = ENGINE_POOL_DEFAULT_TIMEOUT;
+
+  maxitems = strtoul (value, &endp, 10);
+  if (*endp == ',')
+    timeout = strtoul (endp + 1, &endp, 10);
+  if (*endp || maxitems > 1024)
+    return -1;
+
+  LOCK (engine_pool_lock);
+  pool_max = maxitems;
+  pool_timeout = timeout;
+  UNLOCK (engine_pool_lock);
+  return 0;
+}
+
+
+/* Return true if idle connections shall be put into the pool.  */
+int
+_gpgme_engine_pool_enabled (void)
+{
+  int result;
+
+  LOCK (engine_pool_lock);
+  result = !!pool_max;
+  UNLOCK (engine_pool_lock);
+  return result;
+}
+
+
+static int
+same_string (const char *a, const char *b)
+{
+  if (!a || !b)
+    return !a && !b;
+  return !strcmp (a, b);
+}
+
+
+static void
+release_item (pool_item_t item)
+{
+  TRACE (DEBUG_ENGINE, "gpgme-engine-pool", item->engine,
+         "closing idle connection to '%s'", item->file_name);
+  item->release (item->engine);
+  free (item->file_name);
+  free (item->home_dir);
+  free (item);
+}
+
+
+/* Remove expired items and, if MAXITEMS is reached, the least
+ * recently used items from the pool and return them as a list.  Must
+ * be called with the lock held.  */
+static pool_item_t
+remove_stale_items (unsigned int maxitems)
+{
+  pool_item_t item, *itemp, stale = NULL;
+  time_t now = time (NULL);
+  unsigned int n = 0;
+
+  for (itemp = &pool_items; (item = *itemp); )
+    {
+      if (n >= maxitems || now - item->stamp > pool_timeout
+          || now < item->stamp)
+        {
+          *itemp = item->next;
+          item->next = stale;
+          stale = item;
+          pool_nitems--;
+        }
+      else
+        {
+          n++;
+          itemp = &item->next;
+        }
+    }
+  return stale;
+}
+
+
+/* Release the items of the list ITEMS.  This is done without holding
+ * the lock because it waits for the servers.  */
+static void
+release_items (pool_item_t items)
+{
+  pool_item_t next;
+
+  for (; items; items = next)
+    {
+      next = items->next;
+      release_item (items);
+    }
+}
+
+
+/* Take an idle connection for the engine PROTOCOL with the binary
+ * FILE_NAME and the home directory HOME_DIR from the pool.  Returns
+ * NULL if there is none.  */
+void *
+_gpgme_engine_pool_get (gpgme_protocol_t protocol,
+                        const char *file_name, const char *home_dir)
+{
+  pool_item_t item, *itemp, stale;
+  void *engine = NULL;
+
+  LOCK (engine_pool_lock);
+  stale = remove_stale_items (pool_max);
+  for (itemp = &pool_items; (item = *itemp); itemp = &item->next)
+    if (item->protocol == protocol
+        && same_string (item->file_name, file_name)
+        && same_string (item->home_dir, home_dir))
+      {
+        *itemp = item->next;
+        pool_nitems--;
+        break;
+      }
+  UNLOCK (engine_pool_lock);
+
+  release_items (stale);
+  if (item)
+    {
+      engine = item->engine;
+      TRACE (DEBUG_ENGINE, "gpgme-engine-pool", engine,
+             "reusing idle connection to '%s'", item->file_name);
+      free (item->file_name);
+      free (item->home_dir);
+      free (item);
+    }
+  return engine;
+}
+
+
+/* Put the idle connection ENGINE for PROTOCOL, FILE_NAME and
+ * HOME_DIR into the pool.  RELEASE is the function to finally
+ * release ENGINE.  The caller must have reset ENGINE so that it can
+ * be used by any other context.  Returns 0 on success; on error the
+ * caller still owns ENGINE.  */
+int
+_gpgme_engine_pool_put (gpgme_protocol_t protocol,
+                        const char *file_name, const char *home_dir,
+                        void *engine, void (*release) (void *engine))
+{
+  pool_item_t item, stale;
+
+  item = calloc (1, sizeof *item);
+  if (!item)
+    return -1;
+  item->protocol = protocol;
+  item->file_name = file_name? strdup (file_name) : NULL;
+  item->home_dir = home_dir? strdup (home_dir) : NULL;
+  if ((file_name && !item->file_name) || (home_dir && !item->home_dir))
+    {
+      free (item->file_name);
+      free (item->home_dir);
+      free (item);
+      return -1;
+    }
+  item->stamp = time (NULL);
+  item->engine = engine;
+  item->release = release;
+
+  LOCK (engine_pool_lock);
+  if (!pool_max)
+    {
+      UNLOCK (engine_pool_lock);
+      free (item->file_name);
+      free (item->home_dir);
+      free (item);
+      return -1;
+    }
+  item->next = pool_items;
+  pool_items = item;
+  pool_nitems++;
+  stale = remove_stale_items (pool_max);
+  UNLOCK (engine_pool_lock);
+
+  TRACE (DEBUG_ENGINE, "gpgme-engine-pool", engine,
+         "keeping idle connection to '%s'", file_name);
+  release_items (stale);
+  return 0;
+}
@@ -110,6 +110,16 @@ struct engine_uiserver
   gpgme_data_t inline_data;  /* Used to collect D lines.  */
 
   struct gpgme_io_cbs io_cbs;
+
+  /* State for the engine pool.  ENABLED is set if the engine may be
+   * put into the pool; FILE_NAME is then the socket name used to
+   * create it.  */
+  struct
+  {
+    int enabled;
+    char *file_name;
+    int tainted;  /* An option has been set which RESET can't undo.  */
+  } pool;
 };
 
 typedef struct engine_uiserver *engine_uiserver_t;
@@ -117,6 +127,9 @@ typedef struct engine_uiserver *engine_uiserver_t;
 
 static void uiserver_io_event (void *engine,
                             gpgme_event_io_t type, void *type_data);
+static gpgme_error_t uiserver_assuan_simple_command
+     (engine_uiserver_t uiserver, const char *cmd,
+      engine_status_handler_t fnc, void *fnc_value);
 
 
 
@@ -225,8 +238,9 @@ uiserver_cancel (void *engine)
 }
 
 
+/* Close the connection and release the engine.  */
 static void
-uiserver_release (void *engine)
+uiserver_destroy (void *engine)
 {
   engine_uiserver_t uiserver = engine;
 
@@ -235,11 +249,60 @@ uiserver_release (void *engine)
 
   uiserver_cancel (engine);
 
+  free (uiserver->pool.file_name);
   free (uiserver->colon.attic.line);
   free (uiserver);
 }
 
 
+/* Reset the idle engine UISERVER and put it into the engine pool.
+ * Returns 0 on success.  */
+static int
+uiserver_pool_put (engine_uiserver_t uiserver)
+{
+  if (!uiserver->pool.enabled || uiserver->pool.tainted
+      || !uiserver->assuan_ctx
+      || uiserver->status_cb.fd != -1 || uiserver->input_cb.fd != -1
+      || uiserver->output_cb.fd != -1 || uiserver->message_cb.fd != -1
+      || uiserver->inline_data || !_gpgme_engine_pool_enabled ())
+    return -1;
+
+  /* Forget everything about the context.  A locale is never set here
+     because the server can't reset it.  */
+  uiserver->protocol = GPGME_PROTOCOL_DEFAULT;
+  uiserver->status.fnc = NULL;
+  uiserver->status.fnc_value = NULL;
+  uiserver->status.mon_cb = NULL;
+  uiserver->status.mon_cb_value = NULL;
+  uiserver->colon.fnc = NULL;
+  uiserver->colon.fnc_value = NULL;
+  uiserver->colon.attic.linelen = 0;
+  uiserver->colon.any = 0;
+  memset (&uiserver->io_cbs, 0, sizeof uiserver->io_cbs);
+
+  if (uiserver_assuan_simple_command (uiserver, "RESET", NULL, NULL))
+    return -1;
+
+  return _gpgme_engine_pool_put (GPGME_PROTOCOL_UISERVER,
+                                 uiserver->pool.file_name, NULL,
+                                 uiserver, uiserver_destroy);
+}
+
+
+static void
+uiserver_release (void *engine)
+{
+  engine_uiserver_t uiserver = engine;
+
+  if (!uiserver)
+    return;
+
+  if (!uiserver_pool_put (uiserver))
+    return;
+  uiserver_destroy (uiserver);
+}
+
+
 static gpgme_error_t
 uiserver_new (void **engine, const char *file_name, const char *home_dir,
               const char *version)
@@ -255,10 +318,35 @@ uiserver_new (void **engine, const char *file_name, const char *home_dir,
   (void)home_dir;
   (void)version; /* Not yet used.  */
 
+  /* Try to reuse an idle connection.  */
+  if (_gpgme_engine_pool_enabled ())
+    {
+      uiserver = _gpgme_engine_pool_get (GPGME_PROTOCOL_UISERVER,
+                                         file_name, NULL);
+      if (uiserver
+          && !uiserver_assuan_simple_command (uiserver, "NOP", NULL, NULL))
+        {
+          *engine = uiserver;
+          return 0;
+        }
+      uiserver_destroy (uiserver);
+    }
+
   uiserver = calloc (1, sizeof *uiserver);
   if (!uiserver)
     return gpg_error_from_syserror ();
 
+  if (_gpgme_engine_pool_enabled ())
+    {
+      uiserver->pool.enabled = 1;
+      if (file_name && !(uiserver->pool.file_name = strdup (file_name)))
+        {
+          err = gpg_error_from_syserror ();
+          uiserver_destroy (uiserver);
+          return err;
+        }
+    }
+
   uiserver->protocol = GPGME_PROTOCOL_DEFAULT;
   uiserver->status_cb.fd = -1;
   uiserver->status_cb.dir = 1;
@@ -397,7 +485,7 @@ uiserver_new (void **engine, const char *file_name, const char *home_dir,
 
  leave:
   if (err)
-    uiserver_release (uiserver);
+    uiserver_destroy (uiserver);
   else
     *engine = uiserver;
 
@@ -422,7 +510,7 @@ uiserver_set_locale (void *engine, int category, const char *value)
       if (!value && uiserver->lc_ctype_set)
 	return gpg_error (GPG_ERR_INV_VALUE);
       if (value)
-	uiserver->lc_ctype_set = 1;
+	uiserver->lc_ctype_set = uiserver->pool.tainted = 1;
     }
 #ifdef LC_MESSAGES
   else if (category == LC_MESSAGES)
@@ -431,7 +519,7 @@ uiserver_set_locale (void *engine, int category, const char *value)
       if (!value && uiserver->lc_messages_set)
 	return gpg_error (GPG_ERR_INV_VALUE);
       if (value)
-	uiserver->lc_messages_set = 1;
+	uiserver->lc_messages_set = uiserver->pool.tainted = 1;
     }
 #endif /* LC_MESSAGES */
   else
@@ -68,6 +68,9 @@ DEFINE_STATIC_LOCK (engine_info_lock);
 static char *engine_minimal_version;
 
 
+static gpgme_error_t engine_info_init (void);
+static gpgme_error_t engine_info_probe (gpgme_engine_info_t info);
+
 
 /* Get the file name of the engine for PROTOCOL.  */
 static const char *
@@ -137,23 +140,24 @@ gpgme_engine_check_version (gpgme_protocol_t proto)
   int result;
 
   LOCK (engine_info_lock);
-  info = engine_info;
-  if (!info)
+  err = engine_info_init ();
+  if (err)
     {
-      /* Make sure it is initialized.  */
       UNLOCK (engine_info_lock);
-      err = gpgme_get_engine_info (&info);
-      if (err)
-	return err;
-
-      LOCK (engine_info_lock);
+      return err;
     }
+  info = engine_info;
 
   while (info && info->protocol != proto)
     info = info->next;
 
   if (!info)
     result = 0;
+  else if ((err = engine_info_probe (info)))
+    {
+      UNLOCK (engine_info_lock);
+      return err;
+    }
   else
     result = _gpgme_compare_versions (info->version,
 				      info->req_version);
@@ -203,103 +207,189 @@ _gpgme_set_engine_minimal_version (const char *value)
 }
 
 
-/* Get the information about the configured and installed engines.  A
-   pointer to the first engine in the statically allocated linked list
-   is returned in *INFO.  If an error occurs, it is returned.  The
-   returned data is valid until the next gpgme_set_engine_info.  */
-gpgme_error_t
-gpgme_get_engine_info (gpgme_engine_info_t *info)
+/* Run the engine of INFO to get its version unless this has already
+ * been done.  The version is taken from or stored in the global
+ * engine info if it describes the same engine.  This function expects
+ * that ENGINE_INFO_LOCK is held by the caller.  */
+static gpgme_error_t
+engine_info_probe (gpgme_engine_info_t info)
+{
+  gpgme_engine_info_t ginfo;
+  char *version;
+
+  if (info->version)
+    return 0;
+
+  for (ginfo = engine_info; ginfo; ginfo = ginfo->next)
+    if (ginfo->protocol == info->protocol && ginfo != info
+        && ginfo->version && !strcmp (ginfo->file_name, info->file_name))
+      break;
+  if (ginfo)
+    {
+      info->version = strdup (ginfo->version);
+      if (!info->version)
+        return gpg_error_from_syserror ();
+      return 0;
+    }
+
+  version = engine_get_version (info->protocol, info->file_name);
+
+  /* Check against the optional minimal engine version.  */
+  if (version && engine_minimal_version
+      && !_gpgme_compare_versions (version, engine_minimal_version))
+    {
+      free (version);
+      return gpg_error (GPG_ERR_ENGINE_TOO_OLD);
+    }
+
+  /* Now set the dummy version for pseudo engines.  */
+  if (!version)
+    {
+      version = strdup ("1.0.0");
+      if (!version)
+        return gpg_error_from_syserror ();
+    }
+  info->version = version;
+
+  /* Let the global info know the version if it is still unknown.  */
+  for (ginfo = engine_info; ginfo; ginfo = ginfo->next)
+    if (ginfo->protocol == info->protocol && ginfo != info
+        && !ginfo->version && !strcmp (ginfo->file_name, info->file_name))
+      {
+        ginfo->version = strdup (version);
+        break;
+      }
+
+  return 0;
+}
+
+
+/* Make sure that the version of all engines in the list INFO is
+ * known.  This function expects that ENGINE_INFO_LOCK is held by the
+ * caller.  */
+static gpgme_error_t
+engine_info_probe_all (gpgme_engine_info_t info)
 {
   gpgme_error_t err;
 
-  LOCK (engine_info_lock);
-  if (!engine_info)
+  for (; info; info = info->next)
+    if ((err = engine_info_probe (info)))
+      return err;
+  return 0;
+}
+
+
+/* Create the global engine info unless this has already been done.
+ * The engines are not run to get their versions; this is deferred
+ * until a version is actually needed.  However, if a minimal engine
+ * version has been requested, all engines are checked right away.
+ * This function expects that ENGINE_INFO_LOCK is held by the
+ * caller.  */
+static gpgme_error_t
+engine_info_init (void)
+{
+  gpgme_error_t err = 0;
+  gpgme_engine_info_t *lastp = &engine_info;
+  gpgme_protocol_t proto_list[] = { GPGME_PROTOCOL_OpenPGP,
+                                    GPGME_PROTOCOL_CMS,
+                                    GPGME_PROTOCOL_GPGCONF,
+                                    GPGME_PROTOCOL_ASSUAN,
+                                    GPGME_PROTOCOL_G13,
+                                    GPGME_PROTOCOL_UISERVER,
+                                    GPGME_PROTOCOL_SPAWN    };
+  unsigned int proto;
+
+  if (engine_info)
+    return 0;
+
+  for (proto = 0; proto < DIM (proto_list); proto++)
     {
-      gpgme_engine_info_t *lastp = &engine_info;
-      gpgme_protocol_t proto_list[] = { GPGME_PROTOCOL_OpenPGP,
-					GPGME_PROTOCOL_CMS,
-					GPGME_PROTOCOL_GPGCONF,
-					GPGME_PROTOCOL_ASSUAN,
-					GPGME_PROTOCOL_G13,
-					GPGME_PROTOCOL_UISERVER,
-                                        GPGME_PROTOCOL_SPAWN    };
-      unsigned int proto;
-
-      err = 0;
-      for (proto = 0; proto < DIM (proto_list); proto++)
-	{
-	  const char *ofile_name = engine_get_file_name (proto_list[proto]);
-	  const char *ohome_dir  = engine_get_home_dir (proto_list[proto]);
-          char *version = engine_get_version (proto_list[proto], NULL);
-	  char *file_name;
-	  char *home_dir;
+      const char *ofile_name = engine_get_file_name (proto_list[proto]);
+      const char *ohome_dir  = engine_get_home_dir (proto_list[proto]);
+      char *file_name;
+      char *home_dir;
 
-	  if (!ofile_name)
-	    continue;
+      if (!ofile_name)
+        continue;
+
+      file_name = strdup (ofile_name);
+      if (!file_name)
+        err = gpg_error_from_syserror ();
 
-	  file_name = strdup (ofile_name);
-          if (!file_name)
+      if (ohome_dir)
+        {
+          home_dir = strdup (ohome_dir);
+          if (!home_dir && !err)
             err = gpg_error_from_syserror ();
+        }
+      else
+        home_dir = NULL;
 
-          if (ohome_dir)
-            {
-              home_dir = strdup (ohome_dir);
-              if (!home_dir && !err)
-                err = gpg_error_from_syserror ();
-            }
-          else
-            home_dir = NULL;
+      *lastp = calloc (1, sizeof (*engine_info));
+      if (!*lastp && !err)
+        err = gpg_error_from_syserror ();
 
-	  *lastp = calloc (1, sizeof (*engine_info));
-          if (!*lastp && !err)
-            err = gpg_error_from_syserror ();
+      if (err)
+        {
+          free (file_name);
+          free (home_dir);
+          goto leave;
+        }
 
-          /* Check against the optional minimal engine version.  */
-          if (!err && version && engine_minimal_version
-              && !_gpgme_compare_versions (version, engine_minimal_version))
-            {
-              err = gpg_error (GPG_ERR_ENGINE_TOO_OLD);
-            }
+      (*lastp)->protocol = proto_list[proto];
+      (*lastp)->file_name = file_name;
+      (*lastp)->home_dir = home_dir;
+      (*lastp)->version = NULL;  /* Not yet known.  */
+      (*lastp)->req_version = engine_get_req_version (proto_list[proto]);
+      if (!(*lastp)->req_version)
+        (*lastp)->req_version = "1.0.0"; /* Dummy for pseudo engines. */
+      (*lastp)->next = NULL;
+      lastp = &(*lastp)->next;
+    }
 
-          /* Now set the dummy version for pseudo engines.  */
-          if (!err && !version)
-            {
-              version = strdup ("1.0.0");
-              if (!version)
-                err = gpg_error_from_syserror ();
-            }
+  if (engine_minimal_version)
+    err = engine_info_probe_all (engine_info);
 
-	  if (err)
-	    {
-	      _gpgme_engine_info_release (engine_info);
-	      engine_info = NULL;
-
-	      if (file_name)
-		free (file_name);
-	      if (home_dir)
-		free (home_dir);
-	      if (version)
-		free (version);
-
-	      UNLOCK (engine_info_lock);
-	      return err;
-	    }
-
-	  (*lastp)->protocol = proto_list[proto];
-	  (*lastp)->file_name = file_name;
-	  (*lastp)->home_dir = home_dir;
-	  (*lastp)->version = version;
-	  (*lastp)->req_version = engine_get_req_version (proto_list[proto]);
-	  if (!(*lastp)->req_version)
-            (*lastp)->req_version = "1.0.0"; /* Dummy for pseudo engines. */
-	  (*lastp)->next = NULL;
-	  lastp = &(*lastp)->next;
-	}
+ leave:
+  if (err)
+    {
+      _gpgme_engine_info_release (engine_info);
+      engine_info = NULL;
     }
+  return err;
+}
+
 
-  *info = engine_info;
+/* Get the information about the configured and installed engines.  A
+   pointer to the first engine in the statically allocated linked list
+   is returned in *INFO.  If an error occurs, it is returned.  The
+   returned data is valid until the next gpgme_set_engine_info.  */
+gpgme_error_t
+gpgme_get_engine_info (gpgme_engine_info_t *info)
+{
+  gpgme_error_t err;
+
+  LOCK (engine_info_lock);
+  err = engine_info_init ();
+  if (!err)
+    err = engine_info_probe_all (engine_info);
+  *info = err? NULL : engine_info;
   UNLOCK (engine_info_lock);
-  return 0;
+  return err;
+}
+
+
+/* Make sure that the versions in the engine info list INFO, which is
+ * usually the list of a context, are known.  */
+gpgme_error_t
+_gpgme_engine_info_probe (gpgme_engine_info_t info)
+{
+  gpgme_error_t err;
+
+  LOCK (engine_info_lock);
+  err = engine_info_probe_all (info);
+  UNLOCK (engine_info_lock);
+  return err;
 }
 
 
@@ -313,17 +403,13 @@ _gpgme_engine_info_copy (gpgme_engine_info_t *r_info)
   gpgme_engine_info_t *lastp;
 
   LOCK (engine_info_lock);
-  info = engine_info;
-  if (!info)
+  err = engine_info_init ();
+  if (err)
     {
-      /* Make sure it is initialized.  */
       UNLOCK (engine_info_lock);
-      err = gpgme_get_engine_info (&info);
-      if (err)
-	return err;
-
-      LOCK (engine_info_lock);
+      return err;
     }
+  info = engine_info;
 
   new_info = NULL;
   lastp = &new_info;
@@ -449,10 +535,14 @@ _gpgme_set_engine_info (gpgme_engine_info_t info, gpgme_protocol_t proto,
         new_home_dir = NULL;
     }
 
-  new_version = engine_get_version (proto, new_file_name);
-  if (!new_version)
+  /* Running the engine to get its version is expensive; thus we
+     reuse the known version if the file name does not change.  This
+     is the common case for gpgme_ctx_set_engine_info.  Otherwise the
+     version is figured out when it is needed.  */
+  if (info->version && info->file_name
+      && !strcmp (info->file_name, new_file_name))
     {
-      new_version = strdup ("1.0.0"); /* Fake one for dummy entries.  */
+      new_version = strdup (info->version);
       if (!new_version)
         {
           free (new_file_name);
@@ -460,6 +550,8 @@ _gpgme_set_engine_info (gpgme_engine_info_t info, gpgme_protocol_t proto,
           return gpg_error_from_syserror ();
         }
     }
+  else
+    new_version = NULL;
 
   /* Remove the old members.  */
   assert (info->file_name);
@@ -485,22 +577,11 @@ gpgme_set_engine_info (gpgme_protocol_t proto,
 		       const char *file_name, const char *home_dir)
 {
   gpgme_error_t err;
-  gpgme_engine_info_t info;
 
   LOCK (engine_info_lock);
-  info = engine_info;
-  if (!info)
-    {
-      /* Make sure it is initialized.  */
-      UNLOCK (engine_info_lock);
-      err = gpgme_get_engine_info (&info);
-      if (err)
-	return err;
-
-      LOCK (engine_info_lock);
-    }
-
-  err = _gpgme_set_engine_info (info, proto, file_name, home_dir);
+  err = engine_info_init ();
+  if (!err)
+    err = _gpgme_set_engine_info (engine_info, proto, file_name, home_dir);
   UNLOCK (engine_info_lock);
   return err;
 }
@@ -509,11 +590,21 @@ gpgme_set_engine_info (gpgme_protocol_t proto,
 gpgme_error_t
 _gpgme_engine_new (gpgme_engine_info_t info, engine_t *r_engine)
 {
+  gpgme_error_t err;
   engine_t engine;
 
-  if (!info->file_name || !info->version)
+  if (!info->file_name)
     return trace_gpg_error (GPG_ERR_INV_ENGINE);
 
+  if (!info->version)
+    {
+      LOCK (engine_info_lock);
+      err = engine_info_probe (info);
+      UNLOCK (engine_info_lock);
+      if (err)
+        return err;
+    }
+
   engine = calloc (1, sizeof *engine);
   if (!engine)
     return gpg_error_from_syserror ();
@@ -521,7 +612,6 @@ _gpgme_engine_new (gpgme_engine_info_t info, engine_t *r_engine)
   engine->ops = engine_ops[info->protocol];
   if (engine->ops->new)
     {
-      gpgme_error_t err;
       err = (*engine->ops->new) (&engine->engine,
 				 info->file_name, info->home_dir,
                                  info->version);
@@ -991,7 +1081,8 @@ _gpgme_engine_op_assuan_transact (engine_t engine,
 
 
 gpgme_error_t
-_gpgme_engine_op_conf_load (engine_t engine, gpgme_conf_comp_t *conf_p)
+_gpgme_engine_op_conf_load (engine_t engine, const char *component,
+                            gpgme_conf_comp_t *conf_p)
 {
   if (!engine)
     return gpg_error (GPG_ERR_INV_VALUE);
@@ -999,7 +1090,7 @@ _gpgme_engine_op_conf_load (engine_t engine, gpgme_conf_comp_t *conf_p)
   if (!engine->ops->conf_load)
     return gpg_error (GPG_ERR_NOT_IMPLEMENTED);
 
-  return (*engine->ops->conf_load) (engine->engine, conf_p);
+  return (*engine->ops->conf_load) (engine->engine, component, conf_p);
 }
 
 
@@ -44,12 +44,18 @@ typedef gpgme_error_t (*engine_command_handler_t) (void *priv,
 typedef gpgme_error_t (*engine_assuan_result_cb_t) (void *priv,
                                                     gpgme_error_t result);
 
-/* Helper for gpgme_set_global_flag.  */
+/* Helpers for gpgme_set_global_flag.  */
 int _gpgme_set_engine_minimal_version (const char *value);
+int _gpgme_set_engine_pool (const char *value);
 
-/* Get a deep copy of the engine info and return it in INFO.  */
+/* Get a deep copy of the engine info and return it in INFO.  The
+   versions of the engines may not yet be known.  */
 gpgme_error_t _gpgme_engine_info_copy (gpgme_engine_info_t *r_info);
 
+/* Make sure that the versions in the engine info list INFO are
+   known.  */
+gpgme_error_t _gpgme_engine_info_probe (gpgme_engine_info_t info);
+
 /* Release the engine info INFO.  */
 void _gpgme_engine_info_release (gpgme_engine_info_t info);
 
@@ -181,6 +187,7 @@ gpgme_error_t _gpgme_engine_op_assuan_transact
                  void *status_cb_value);
 
 gpgme_error_t _gpgme_engine_op_conf_load (engine_t engine,
+					  const char *component,
 					  gpgme_conf_comp_t *conf_p);
 gpgme_error_t _gpgme_engine_op_conf_save (engine_t engine,
 					  gpgme_conf_comp_t conf);
@@ -245,6 +245,9 @@ genkey_start (gpgme_ctx_t ctx, int synchronous, const char *parms,
   gpgme_error_t err;
   void *hook;
   op_data_t opd;
+
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -332,6 +335,8 @@ createkey_start (gpgme_ctx_t ctx, int synchronous,
   void *hook;
   op_data_t opd;
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -420,6 +425,8 @@ createsubkey_start (gpgme_ctx_t ctx, int synchronous,
   if (ctx->protocol != GPGME_PROTOCOL_OPENPGP)
     return gpgme_error (GPG_ERR_UNSUPPORTED_PROTOCOL);
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -507,6 +514,8 @@ addrevuid_start (gpgme_ctx_t ctx, int synchronous, int extraflags,
   if (!key || !userid)
     return gpg_error (GPG_ERR_INV_ARG);
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -82,7 +82,32 @@ gpgme_op_conf_load (gpgme_ctx_t ctx, gpgme_conf_comp_t *conf_p)
   if (err)
     return err;
 
-  err = _gpgme_engine_op_conf_load (ctx->engine, conf_p);
+  err = _gpgme_engine_op_conf_load (ctx->engine, NULL, conf_p);
+  ctx->protocol = proto;
+  return err;
+}
+
+
+/* Public function to load the configuration of the component NAME.
+   This is cheaper than loading the configuration of all components.
+   No asynchronous interface for now.  */
+gpgme_error_t
+gpgme_op_conf_load_component (gpgme_ctx_t ctx, const char *name,
+                              gpgme_conf_comp_t *conf_p)
+{
+  gpgme_error_t err;
+  gpgme_protocol_t proto;
+
+  if (!ctx || !name || !conf_p)
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  proto = ctx->protocol;
+  ctx->protocol = GPGME_PROTOCOL_GPGCONF;
+  err = _gpgme_op_reset (ctx, 1);
+  if (err)
+    return err;
+
+  err = _gpgme_engine_op_conf_load (ctx->engine, name, conf_p);
   ctx->protocol = proto;
   return err;
 }
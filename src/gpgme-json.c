@@ -27,6 +27,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
 #include <stdarg.h>
 #ifdef HAVE_LOCALE_H
 #include <locale.h>
@@ -53,6 +54,20 @@
 #define DEF_REPLY_CHUNK_SIZE  0
 #define MAX_REPLY_CHUNK_SIZE (10 * 1024 * 1024)
 
+/* Output data up to this size is kept in memory; larger output is
+ * spilled to a temporary file.  */
+#define MAX_OUTPUT_IN_MEMORY (256 * 1024)
+
+/* The number of bytes of output data encoded at once while writing a
+ * response.  */
+#define RESPONSE_ENCODE_CHUNK (16 * 1024)
+
+
+/* A response which is produced piecewise so that the memory needed
+ * does not depend on the size of the data.  */
+struct json_stream_s;
+typedef struct json_stream_s *json_stream_t;
+
 
 static void xoutofcore (const char *type) GPGRT_ATTR_NORETURN;
 static cjson_t error_object_v (cjson_t json, const char *message,
@@ -62,7 +77,7 @@ static cjson_t error_object (cjson_t json, const char *message,
                             ...) GPGRT_ATTR_PRINTF(2,3);
 static char *error_object_string (const char *message,
                                   ...) GPGRT_ATTR_PRINTF(1,2);
-static char *process_request (const char *request);
+static json_stream_t process_request (const char *request);
 
 
 /* True if interactive mode is active.  */
@@ -70,13 +85,18 @@ static int opt_interactive;
 /* True is debug mode is active.  */
 static int opt_debug;
 
-/* Pending data to be returned by a getmore command.  */
+/* Pending response to be returned by getmore commands or NULL.  */
+static json_stream_t pending_stream;
+
+/* The output data of the current request.  This is set by
+ * make_data_object and streamed after the other items of the
+ * response.  */
 static struct
 {
-  char  *buffer;   /* Malloced data or NULL if not used.  */
-  size_t length;   /* Length of that data.  */
-  size_t written;  /* # of already written bytes from BUFFER.  */
-} pending_data;
+  gpgme_data_t data;  /* The data or NULL.  */
+  int base64;         /* Encode it in Base-64.  */
+  size_t length;      /* The length of the encoded data.  */
+} response_data;
 
 
 /*
@@ -1428,159 +1448,516 @@ get_string_data (cjson_t request, cjson_t result, const char *name,
 }
 
 
+/* Create an output data object.  Small data is kept in memory,
+ * larger data is written to a temporary file.  */
+struct output_data_s
+{
+  char *buffer;    /* In-memory data or NULL.  */
+  size_t length;   /* Used length of BUFFER.  */
+  size_t size;     /* Allocated size of BUFFER.  */
+  size_t offset;   /* The current position in BUFFER.  */
+  estream_t fp;    /* The temporary file or NULL.  */
+};
+
+
+static ssize_t
+output_data_read (void *handle, void *buffer, size_t size)
+{
+  struct output_data_s *od = handle;
+  size_t n;
+
+  if (od->fp)
+    {
+      if (es_read (od->fp, buffer, size, &n))
+        return -1;
+      return n;
+    }
+
+  n = od->offset < od->length? od->length - od->offset : 0;
+  if (n > size)
+    n = size;
+  memcpy (buffer, od->buffer + od->offset, n);
+  od->offset += n;
+  return n;
+}
+
+
+static ssize_t
+output_data_write (void *handle, const void *buffer, size_t size)
+{
+  struct output_data_s *od = handle;
+  size_t n;
+  char *p;
+
+  if (!od->fp && od->offset + size > MAX_OUTPUT_IN_MEMORY)
+    {
+      /* Too large - move the data to a temporary file.  */
+      od->fp = es_tmpfile ();
+      if (!od->fp)
+        return -1;
+      if (es_write (od->fp, od->buffer, od->length, NULL)
+          || es_fseeko (od->fp, od->offset, SEEK_SET))
+        {
+          es_fclose (od->fp);
+          od->fp = NULL;
+          return -1;
+        }
+      xfree (od->buffer);
+      od->buffer = NULL;
+      od->length = od->size = od->offset = 0;
+    }
+
+  if (od->fp)
+    {
+      if (es_write (od->fp, buffer, size, &n))
+        return -1;
+      return n;
+    }
+
+  if (od->offset + size > od->size)
+    {
+      n = od->size? od->size : 4096;
+      while (n < od->offset + size)
+        n *= 2;
+      p = gpgrt_realloc (od->buffer, n);
+      if (!p)
+        return -1;
+      od->buffer = p;
+      od->size = n;
+    }
+  memcpy (od->buffer + od->offset, buffer, size);
+  od->offset += size;
+  if (od->offset > od->length)
+    od->length = od->offset;
+  return size;
+}
+
+
+static off_t
+output_data_seek (void *handle, off_t offset, int whence)
+{
+  struct output_data_s *od = handle;
+
+  if (od->fp)
+    {
+      if (es_fseeko (od->fp, offset, whence))
+        return -1;
+      return es_ftello (od->fp);
+    }
+
+  switch (whence)
+    {
+    case SEEK_SET: break;
+    case SEEK_CUR: offset += od->offset; break;
+    case SEEK_END: offset += od->length; break;
+    default:
+      gpg_err_set_errno (EINVAL);
+      return -1;
+    }
+  if (offset < 0)
+    {
+      gpg_err_set_errno (EINVAL);
+      return -1;
+    }
+  od->offset = offset;
+  return offset;
+}
+
+
+static void
+output_data_release (void *handle)
+{
+  struct output_data_s *od = handle;
+
+  es_fclose (od->fp);
+  xfree (od->buffer);
+  xfree (od);
+}
+
+
+static gpg_error_t
+create_output_data (gpgme_data_t *r_data)
+{
+  static struct gpgme_data_cbs cbs = {
+    output_data_read,
+    output_data_write,
+    output_data_seek,
+    output_data_release
+  };
+  gpg_error_t err;
+  struct output_data_s *od;
+
+  od = gpgrt_calloc (1, sizeof *od);
+  if (!od)
+    return gpg_error_from_syserror ();
+  err = gpgme_data_new_from_cbs (r_data, &cbs, od);
+  if (err)
+    xfree (od);
+  return err;
+}
+
+
+/* Return the length of the JSON string escaped by cJSON for the
+ * octet C.  */
+static GPGRT_INLINE size_t
+escaped_length (unsigned char c)
+{
+  if (c == '"' || c == '\\' || c == '\b' || c == '\f'
+      || c == '\n' || c == '\r' || c == '\t')
+    return 2;
+  else if (c < 32)
+    return 6;
+  return 1;
+}
+
+
 /* Create a "data" object and the "type" and "base64" flags
  * from DATA and append them to RESULT.  Ownership of DATA is
  * transferred to this function.  TYPE must be a fixed string.
  * If BASE64 is -1 the need for base64 encoding is determined
  * by the content of DATA, all other values are taken as true
- * or false. */
+ * or false.  The data itself is not added to RESULT but written
+ * by the response stream.  */
 static gpg_error_t
 make_data_object (cjson_t result, gpgme_data_t data,
                   const char *type, int base64)
 {
   gpg_error_t err;
-  char *buffer;
-  const char *s;
-  size_t buflen, n;
-
-  if (!base64 || base64 == -1) /* Make sure that we really have a string.  */
-    gpgme_data_write (data, "", 1);
+  unsigned char buffer[4096];
+  ssize_t nread, n;
+  size_t datalen, enclen;
+  int eos;
 
-  buffer = gpgme_data_release_and_get_mem (data, &buflen);
-  data = NULL;
-  if (!buffer)
+  if (gpgme_data_seek (data, 0, SEEK_SET))
     {
       err = gpg_error_from_syserror ();
       goto leave;
     }
 
-  if (base64 == -1)
+  /* Figure out the length of the data and, unless we are asked to
+   * use Base-64, the length of the escaped string.  Note that
+   * cJSON's strings end at a Nul.  */
+  datalen = enclen = 0;
+  eos = 0;
+  while ((nread = gpgme_data_read (data, buffer, sizeof buffer)) > 0)
     {
-      base64 = 0;
-      if (!buflen)
-        log_fatal ("Appended Nul byte got lost\n");
-      /* Figure out if there is any Nul octet in the buffer.  In that
-       * case we need to Base-64 the buffer.  Due to problems with the
-       * browser's Javascript we use Base-64 also in case an UTF-8
-       * character is in the buffer.  This is because the chunking may
-       * split an UTF-8 characters and JS can't handle this.  */
-      for (s=buffer, n=0; n < buflen -1; s++, n++)
-        if (!*s || (*s & 0x80))
-          {
-            buflen--; /* Adjust for the extra nul byte.  */
+      datalen += nread;
+      for (n = 0; n < nread && !eos && base64 != 1; n++)
+        {
+          /* If there is any Nul octet in the buffer we need to
+           * Base-64 the buffer.  Due to problems with the browser's
+           * Javascript we use Base-64 also in case an UTF-8
+           * character is in the buffer.  This is because the
+           * chunking may split an UTF-8 characters and JS can't
+           * handle this.  */
+          if (base64 == -1 && (!buffer[n] || (buffer[n] & 0x80)))
             base64 = 1;
-            break;
-          }
+          else if (!buffer[n])
+            eos = 1;
+          else
+            enclen += escaped_length (buffer[n]);
+        }
+    }
+  if (nread < 0 || gpgme_data_seek (data, 0, SEEK_SET))
+    {
+      err = gpg_error_from_syserror ();
+      goto leave;
     }
+  if (base64 == -1)
+    base64 = 0;
 
-  xjson_AddStringToObject (result, "type", type);
+  err = cjson_AddStringToObject (result, "type", type);
+  if (err)
+    goto leave;
   xjson_AddBoolToObject (result, "base64", base64);
 
-  if (base64)
-    err = add_base64_to_object (result, "data", buffer, buflen);
-  else
-    err = cjson_AddStringToObject (result, "data", buffer);
+  gpgme_data_release (response_data.data);
+  response_data.data = data;
+  data = NULL;
+  response_data.base64 = base64;
+  response_data.length = base64? (datalen + 2) / 3 * 4 : enclen;
+  err = 0;
 
  leave:
-  gpgme_free (buffer);
+  gpgme_data_release (data);
   return err;
 }
 
 
-/* Encode and chunk response.
- *
- * If necessary this base64 encodes and chunks the response
- * for getmore so that we always return valid json independent
- * of the chunksize.
- *
- * A chunked response contains the base64 encoded chunk
- * as a string and a boolean if there is still more data
- * available for getmore like:
- * {
- *   chunk: "SGVsbG8gV29ybGQK"
- *   more: true
- * }
- *
- * Chunking is only done if the response is larger then the
- * chunksize.
- *
- * caller has to xfree the return value.
+
+/*
+ * Streaming of responses
  */
-static char *
-encode_and_chunk (cjson_t request, cjson_t response)
+
+struct json_stream_s
 {
-  char *data;
-  gpg_error_t err = 0;
-  size_t chunksize = 0;
-  char *getmore_request = NULL;
+  char *head;             /* The JSON text before the data.  */
+  size_t headlen;
+  gpgme_data_t data;      /* The data to encode or NULL.  */
+  int base64;             /* Encode DATA in Base-64.  */
+  size_t datalen;         /* The length of the encoded data.  */
+  const char *tail;       /* The JSON text after the data.  */
+  size_t length;          /* The total length of the JSON text.  */
+  size_t offset;          /* The number of bytes already read.  */
+
+  /* State of the encoder.  RAW holds up to 2 octets which have not
+   * yet been Base-64 encoded followed by the octets read from DATA.
+   * OUT holds the encoded but not yet returned text.  */
+  int data_eof;
+  size_t dataout;
+  unsigned char *raw;
+  size_t nraw;
+  char *out;
+  size_t outlen, outpos;
+};
+
+
+/* Create a response stream for the JSON text TEXT and the data in
+ * response_data.  Takes ownership of TEXT.  */
+static json_stream_t
+json_stream_new (char *text)
+{
+  json_stream_t stream;
+  size_t n;
+
+  stream = xcalloc (1, sizeof *stream);
+  stream->head = text;
+  stream->tail = "";
+
+  if (response_data.data)
+    {
+      /* Remove the closing brace and append the data item.  */
+      n = strlen (text);
+      while (n && text[n-1] != '}')
+        n--;
+      if (n)
+        n--;
+      while (n > 1 && (text[n-1] == '\n' || text[n-1] == '\t'
+                       || text[n-1] == ' '))
+        n--;
+      text[n] = 0;
+      stream->head = xstrconcat (text, n > 1? ",":"",
+                                 opt_interactive? "\n\t\"data\":\t\""
+                                 /**/           : "\"data\":\"", NULL);
+      xfree (text);
+      stream->tail = opt_interactive? "\"\n}" : "\"}";
+
+      stream->data = response_data.data;
+      stream->base64 = response_data.base64;
+      stream->datalen = response_data.length;
+      response_data.data = NULL;
+
+      stream->raw = xmalloc (RESPONSE_ENCODE_CHUNK + 2);
+      /* Escaping may need 6 octets per input octet.  */
+      stream->out = xmalloc (6 * RESPONSE_ENCODE_CHUNK + 4);
+    }
+
+  stream->headlen = strlen (stream->head);
+  stream->length = stream->headlen + stream->datalen + strlen (stream->tail);
+  return stream;
+}
+
+
+static void
+json_stream_release (json_stream_t stream)
+{
+  if (!stream)
+    return;
+  xfree (stream->head);
+  gpgme_data_release (stream->data);
+  xfree (stream->raw);
+  xfree (stream->out);
+  xfree (stream);
+}
 
-  if (opt_interactive)
-    data = cJSON_Print (response);
-  else
-    data = cJSON_PrintUnformatted (response);
 
-  if (!data)
+/* Read and encode the next part of the data into STREAM->OUT.  */
+static void
+json_stream_encode (json_stream_t stream)
+{
+  static const char b64chars[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  unsigned char *s;
+  char *d;
+  ssize_t nread;
+  size_t n;
+
+  stream->outlen = stream->outpos = 0;
+  nread = gpgme_data_read (stream->data, stream->raw + stream->nraw,
+                           RESPONSE_ENCODE_CHUNK);
+  if (nread < 0)
     {
-      err = GPG_ERR_NO_DATA;
-      goto leave;
+      log_error ("error reading output data: %s\n",
+                 gpg_strerror (gpg_error_from_syserror ()));
+      nread = 0;
     }
+  if (!nread)
+    stream->data_eof = 1;
+  n = stream->nraw + nread;
+  s = stream->raw;
+  d = stream->out;
 
-  if (!request)
+  if (stream->base64)
     {
-      goto leave;
+      for (; n >= 3; n -= 3, s += 3)
+        {
+          *d++ = b64chars[(s[0] >> 2) & 0x3f];
+          *d++ = b64chars[((s[0] << 4) & 0x30) | ((s[1] >> 4) & 0x0f)];
+          *d++ = b64chars[((s[1] << 2) & 0x3c) | ((s[2] >> 6) & 0x03)];
+          *d++ = b64chars[s[2] & 0x3f];
+        }
+      if (n && stream->data_eof)
+        {
+          *d++ = b64chars[(s[0] >> 2) & 0x3f];
+          if (n == 1)
+            {
+              *d++ = b64chars[((s[0] << 4) & 0x30)];
+              *d++ = '=';
+            }
+          else
+            {
+              *d++ = b64chars[((s[0] << 4) & 0x30) | ((s[1] >> 4) & 0x0f)];
+              *d++ = b64chars[((s[1] << 2) & 0x3c)];
+            }
+          *d++ = '=';
+          n = 0;
+        }
+      /* Keep the remaining octets for the next round.  */
+      memmove (stream->raw, s, n);
+      stream->nraw = n;
     }
-
-  if ((err = get_chunksize (request, &chunksize)))
+  else
     {
-      err = GPG_ERR_INV_VALUE;
-      goto leave;
+      for (; n && !stream->data_eof; n--, s++)
+        {
+          if (*s > 31 && *s != '"' && *s != '\\')
+            *d++ = *s;
+          else if (!*s)
+            stream->data_eof = 1;  /* A JSON string ends at a Nul.  */
+          else
+            {
+              *d++ = '\\';
+              switch (*s)
+                {
+                case '\\': *d++ = '\\'; break;
+                case '"':  *d++ = '"'; break;
+                case '\b': *d++ = 'b'; break;
+                case '\f': *d++ = 'f'; break;
+                case '\n': *d++ = 'n'; break;
+                case '\r': *d++ = 'r'; break;
+                case '\t': *d++ = 't'; break;
+                default:
+                  snprintf (d, 6, "u%04x", *s);
+                  d += 5;
+                  break;
+                }
+            }
+        }
+      stream->nraw = 0;
     }
 
-  if (!chunksize)
-    goto leave;
+  stream->outlen = d - stream->out;
+}
+
 
-  pending_data.buffer = data;
-  /* Data should already be encoded so that it does not
-     contain 0.*/
-  pending_data.length = strlen (data);
-  pending_data.written = 0;
+/* Read up to SIZE bytes of the JSON text of STREAM into BUFFER.
+ * Returns the number of bytes read; 0 indicates the end.  */
+static size_t
+json_stream_read (json_stream_t stream, char *buffer, size_t size)
+{
+  size_t nread = 0;
+  size_t n, pos;
 
-  if (gpgrt_asprintf (&getmore_request,
-                  "{ \"op\":\"getmore\", \"chunksize\": %i }",
-                  (int) chunksize) == -1)
+  while (nread < size && stream->offset < stream->length)
     {
-      err = gpg_error_from_syserror ();
-      goto leave;
+      pos = stream->offset;
+      if (pos < stream->headlen)
+        {
+          n = stream->headlen - pos;
+          if (n > size - nread)
+            n = size - nread;
+          memcpy (buffer + nread, stream->head + pos, n);
+        }
+      else if (pos < stream->headlen + stream->datalen)
+        {
+          if (stream->outpos == stream->outlen)
+            {
+              if (!stream->data_eof)
+                json_stream_encode (stream);
+              if (stream->outpos == stream->outlen)
+                {
+                  /* The data is shorter than it was before.  Pad it
+                   * to keep the announced length.  */
+                  log_error ("output data changed while writing it\n");
+                  memset (stream->out, stream->base64? '=':' ',
+                          stream->datalen - stream->dataout > 1024?
+                          1024 : stream->datalen - stream->dataout);
+                  stream->outlen =
+                    stream->datalen - stream->dataout > 1024?
+                    1024 : stream->datalen - stream->dataout;
+                }
+            }
+          n = stream->outlen - stream->outpos;
+          if (n > stream->datalen - stream->dataout)
+            n = stream->datalen - stream->dataout;
+          if (n > size - nread)
+            n = size - nread;
+          memcpy (buffer + nread, stream->out + stream->outpos, n);
+          stream->outpos += n;
+          stream->dataout += n;
+        }
+      else
+        {
+          pos -= stream->headlen + stream->datalen;
+          n = stream->length - stream->offset;
+          if (n > size - nread)
+            n = size - nread;
+          memcpy (buffer + nread, stream->tail + pos, n);
+        }
+      nread += n;
+      stream->offset += n;
     }
 
-  data = process_request (getmore_request);
+  return nread;
+}
 
-leave:
-  xfree (getmore_request);
 
-  if (!err && !data)
+/* Write the JSON text of STREAM to FP.  */
+static gpg_error_t
+json_stream_write (json_stream_t stream, estream_t fp)
+{
+  char buffer[8192];
+  size_t n, nwritten;
+
+  while ((n = json_stream_read (stream, buffer, sizeof buffer)))
     {
-      err = GPG_ERR_GENERAL;
+      if (es_write (fp, buffer, n, &nwritten))
+        return gpg_error_from_syserror ();
+      if (n != nwritten)
+        return gpg_error (GPG_ERR_EIO);
     }
+  return 0;
+}
 
-  if (err)
-    {
-      cjson_t err_obj = gpg_error_object (NULL, err,
-                                          "Encode and chunk failed: %s",
-                                          gpgme_strerror (err));
-      xfree (data);
-      if (opt_interactive)
-        data = cJSON_Print (err_obj);
-      data = cJSON_PrintUnformatted (err_obj);
 
-      cJSON_Delete (err_obj);
-    }
+/* Return the entire JSON text of STREAM as a string and release
+ * STREAM.  This is only used by the interactive mode.  */
+static char *
+json_stream_to_string (json_stream_t stream)
+{
+  char *string;
+  size_t n;
 
-  return data;
+  if (!stream)
+    return NULL;
+  string = xmalloc (stream->length + 1);
+  n = json_stream_read (stream, string, stream->length);
+  string[n] = 0;
+  json_stream_release (stream);
+  return string;
 }
 
 
-
 /*
  * Implementation of the commands.
  */
@@ -1733,7 +2110,7 @@ op_encrypt (cjson_t request, cjson_t result)
     }
 
   /* Create an output data object.  */
-  err = gpgme_data_new (&output);
+  err = create_output_data (&output);
   if (err)
     {
       gpg_error_object (result, err, "Error creating output data object: %s",
@@ -1885,7 +2262,7 @@ op_decrypt (cjson_t request, cjson_t result)
       goto leave;
 
   /* Create an output data object.  */
-  err = gpgme_data_new (&output);
+  err = create_output_data (&output);
   if (err)
     {
       gpg_error_object (result, err,
@@ -2041,7 +2418,7 @@ op_sign (cjson_t request, cjson_t result)
     goto leave;
 
   /* Create an output data object.  */
-  err = gpgme_data_new (&output);
+  err = create_output_data (&output);
   if (err)
     {
       gpg_error_object (result, err, "Error creating output data object: %s",
@@ -2166,7 +2543,7 @@ op_verify (cjson_t request, cjson_t result)
   if (!signature)
     {
       /* Verify opaque or clearsigned we need an output data object.  */
-      err = gpgme_data_new (&output);
+      err = create_output_data (&output);
       if (err)
         {
           gpg_error_object (result, err,
@@ -2674,7 +3051,7 @@ op_export (cjson_t request, cjson_t result)
   patterns = create_keylist_patterns (request, "keys");
 
   /* Create an output data object.  */
-  err = gpgme_data_new (&output);
+  err = create_output_data (&output);
   if (err)
     {
       gpg_error_object (result, err, "Error creating output data object: %s",
@@ -2838,8 +3215,10 @@ op_config_opt (cjson_t request, cjson_t result)
     }
   opt_name = j_tmp->valuestring;
 
-  /* Load the config */
-  err = gpgme_op_conf_load (ctx, &conf);
+  /* Load the config of the component.  */
+  err = gpgme_op_conf_load_component (ctx, comp_name, &conf);
+  if (gpg_err_code (err) == GPG_ERR_NOT_FOUND)
+    err = 0;
   if (err)
     {
       goto leave;
@@ -2936,8 +3315,16 @@ op_config (cjson_t request, cjson_t result)
       goto leave;
     }
 
-  /* Load the config */
-  err = gpgme_op_conf_load (ctx, &conf);
+  /* Load the config of all components or only of the requested
+     one.  */
+  if (comp_name)
+    {
+      err = gpgme_op_conf_load_component (ctx, comp_name, &conf);
+      if (gpg_err_code (err) == GPG_ERR_NOT_FOUND)
+        err = 0;
+    }
+  else
+    err = gpgme_op_conf_load (ctx, &conf);
   if (err)
     {
       goto leave;
@@ -3070,9 +3457,10 @@ static gpg_error_t
 op_getmore (cjson_t request, cjson_t result)
 {
   gpg_error_t err;
-  int c;
+  char *buffer = NULL;
   size_t n;
   size_t chunksize;
+  int more;
 
   if ((err = get_chunksize (request, &chunksize)))
     goto leave;
@@ -3085,7 +3473,7 @@ op_getmore (cjson_t request, cjson_t result)
   chunksize = (chunksize / 4) * 3;
 
   /* Do we have anything pending?  */
-  if (!pending_data.buffer)
+  if (!pending_stream)
     {
       err = gpg_error (GPG_ERR_NO_DATA);
       gpg_error_object (result, err, "Operation not possible: %s",
@@ -3096,49 +3484,32 @@ op_getmore (cjson_t request, cjson_t result)
   /* We currently always use base64 encoding for simplicity. */
   xjson_AddBoolToObject (result, "base64", 1);
 
-  if (pending_data.written >= pending_data.length)
+  /* Encode only the next chunk of the pending response.  At EOF,
+   * which should not happen, we return an empty string once in case
+   * of client errors.  */
+  buffer = xtrymalloc (chunksize + 1);
+  if (!buffer)
     {
-      /* EOF reached.  This should not happen but we return an empty
-       * string once in case of client errors.  */
-      gpgme_free (pending_data.buffer);
-      pending_data.buffer = NULL;
-      xjson_AddBoolToObject (result, "more", 0);
-      err = cjson_AddStringToObject (result, "response", "");
+      err = gpg_error_from_syserror ();
+      goto leave;
     }
-  else
+  n = json_stream_read (pending_stream, buffer, chunksize);
+  more = pending_stream->offset < pending_stream->length;
+  xjson_AddBoolToObject (result, "more", more);
+  err = add_base64_to_object (result, "response", buffer, n);
+  if (err || !more)
     {
-      n = pending_data.length - pending_data.written;
-      if (n > chunksize)
-        {
-          n = chunksize;
-          xjson_AddBoolToObject (result, "more", 1);
-        }
-      else
-        xjson_AddBoolToObject (result, "more", 0);
-
-      c = pending_data.buffer[pending_data.written + n];
-      pending_data.buffer[pending_data.written + n] = 0;
-      err = add_base64_to_object (result, "response",
-                                  (pending_data.buffer
-                                   + pending_data.written), n);
-      pending_data.buffer[pending_data.written + n] = c;
-      if (!err)
-        {
-          pending_data.written += n;
-          if (pending_data.written >= pending_data.length)
-            {
-              xfree (pending_data.buffer);
-              pending_data.buffer = NULL;
-            }
-        }
+      json_stream_release (pending_stream);
+      pending_stream = NULL;
     }
 
  leave:
+  xfree (buffer);
   return err;
 }
 
 
-
+
 static const char hlp_help[] =
   "The tool expects a JSON object with the request and responds with\n"
   "another JSON object.  Even on error a JSON object is returned.  The\n"
@@ -3195,8 +3566,8 @@ op_help (cjson_t request, cjson_t result)
  */
 
 /* Process a request and return the response.  The response is a newly
- * allocated string or NULL in case of an error.  */
-static char *
+ * allocated stream which the caller needs to release.  */
+static json_stream_t
 process_request (const char *request)
 {
   static struct {
@@ -3228,9 +3599,13 @@ process_request (const char *request)
   int is_getmore = 0;
   const char *op;
   char *res = NULL;
+  size_t chunksize = 0;
+  json_stream_t stream;
   int idx;
 
   response = xjson_CreateObject ();
+  gpgme_data_release (response_data.data);
+  response_data.data = NULL;
 
   json = cJSON_Parse (request, &erroff);
   if (!json)
@@ -3274,15 +3649,17 @@ process_request (const char *request)
           is_getmore = optbl[idx].handler == op_getmore;
           /* If this is not the "getmore" command and we have any
            * pending data release that data.  */
-          if (pending_data.buffer && optbl[idx].handler != op_getmore)
+          if (pending_stream && optbl[idx].handler != op_getmore)
             {
-              gpgme_free (pending_data.buffer);
-              pending_data.buffer = NULL;
+              json_stream_release (pending_stream);
+              pending_stream = NULL;
             }
 
           err = optbl[idx].handler (json, response);
           if (err)
             {
+              gpgme_data_release (response_data.data);
+              response_data.data = NULL;
               if (!(j_tmp = cJSON_GetObjectItem (response, "type"))
                   || !cjson_is_string (j_tmp)
                   || strcmp (j_tmp->valuestring, "error"))
@@ -3303,25 +3680,31 @@ process_request (const char *request)
     }
 
  leave:
-  if (is_getmore)
+  if (!is_getmore && json && get_chunksize (json, &chunksize))
     {
-      /* For getmore we bypass the encode_and_chunk. */
-      if (opt_interactive)
-        res = cJSON_Print (response);
-      else
-        res = cJSON_PrintUnformatted (response);
+      /* Replace the response by an error.  */
+      gpgme_data_release (response_data.data);
+      response_data.data = NULL;
+      cJSON_Delete (response);
+      response = gpg_error_object (NULL, gpg_error (GPG_ERR_INV_VALUE),
+                                   "Encode and chunk failed: %s",
+                                   gpgme_strerror (GPG_ERR_INV_VALUE));
+      chunksize = 0;
     }
+
+  if (opt_interactive)
+    res = cJSON_Print (response);
   else
-    res = encode_and_chunk (json, response);
+    res = cJSON_PrintUnformatted (response);
   if (!res)
     {
       cjson_t err_obj;
 
       log_error ("printing JSON data failed\n");
 
+      gpgme_data_release (response_data.data);
+      response_data.data = NULL;
       err_obj = error_object (NULL, "Printing JSON data failed");
-      if (opt_interactive)
-        res = cJSON_Print (err_obj);
       res = cJSON_PrintUnformatted (err_obj);
       cJSON_Delete (err_obj);
     }
@@ -3332,13 +3715,32 @@ process_request (const char *request)
   if (!res)
     {
       /* Can't happen unless we created a broken error_object above */
-      return xtrystrdup ("Bug: Fatal error in process request\n");
+      res = xstrdup ("Bug: Fatal error in process request\n");
     }
-  return res;
+  stream = json_stream_new (res);
+
+  if (chunksize)
+    {
+      /* Return the response in chunks using getmore.  Chunking is
+       * done on the fly by op_getmore so that the response is never
+       * fully encoded in memory.  */
+      char *getmore_request;
+
+      json_stream_release (pending_stream);
+      pending_stream = stream;
+      if (gpgrt_asprintf (&getmore_request,
+                          "{ \"op\":\"getmore\", \"chunksize\": %i }",
+                          (int) chunksize) == -1)
+        xoutofcore ("asprintf");
+      stream = process_request (getmore_request);
+      xfree (getmore_request);
+    }
+
+  return stream;
 }
 
 
-
+
 /*
  *  Driver code
  */
@@ -3453,17 +3855,18 @@ process_meta_commands (const char *request)
         {
           char *buf = xstrconcat ("{ \"help\":true, \"op\":\"", request+5,
                                   "\" }", NULL);
-          result = process_request (buf);
+          result = json_stream_to_string (process_request (buf));
           xfree (buf);
         }
       else
-        result = process_request ("{ \"op\": \"help\","
+        result = json_stream_to_string
+          (process_request ("{ \"op\": \"help\","
                                   " \"interactive_help\": "
                                   "\"\\nMeta commands:\\n"
                                   "  ,read FNAME Process data from FILE\\n"
                                   "  ,help CMD   Print help for a command\\n"
                                   "  ,quit       Terminate process\""
-                                  "}");
+                                  "}"));
     }
   else if (!strncmp (request, "quit", 4) && (spacep (request+4) || !request[4]))
     exit (0);
@@ -3476,7 +3879,7 @@ process_meta_commands (const char *request)
           char *buffer = get_file (request + 5);
           if (buffer)
             {
-              result = process_request (buffer);
+              result = json_stream_to_string (process_request (buffer));
               xfree (buffer);
             }
         }
@@ -3579,7 +3982,7 @@ interactive_repl (void)
             }
           else if (request)
             {
-              response = process_request (request);
+              response = json_stream_to_string (process_request (request));
             }
           xfree (request);
           request = NULL;
@@ -3626,10 +4029,10 @@ interactive_repl (void)
 static void
 read_and_process_single_request (void)
 {
+  gpg_error_t err;
   char *line = NULL;
   char *request = NULL;
-  char *response = NULL;
-  size_t n;
+  json_stream_t response;
 
   for (;;)
     {
@@ -3642,21 +4045,19 @@ read_and_process_single_request (void)
         {
           if (request)
             {
-              xfree (response);
               response = process_request (request);
-              if (response)
-                {
-                  es_fputs (response, es_stdout);
-                  if ((n = strlen (response)) && response[n-1] != '\n')
-                    es_fputc ('\n', es_stdout);
-                }
+              if ((err = json_stream_write (response, es_stdout)))
+                log_error ("error writing response: %s\n",
+                           gpg_strerror (err));
+              else if (response->length)
+                es_fputc ('\n', es_stdout);
+              json_stream_release (response);
               es_fflush (es_stdout);
             }
           break;
         }
     }
 
-  xfree (response);
   xfree (request);
   xfree (line);
 }
@@ -3669,7 +4070,7 @@ native_messaging_repl (void)
   gpg_error_t err;
   uint32_t nrequest, nresponse;
   char *request = NULL;
-  char *response = NULL;
+  json_stream_t response = NULL;
   size_t n;
 
   /* Due to the length octets we need to switch the I/O stream into
@@ -3725,22 +4126,29 @@ native_messaging_repl (void)
       if (n != nrequest)
         {
           /* That is a protocol violation.  */
-          xfree (response);
-          response = error_object_string ("Invalid request:"
-                                          " short read (%zu of %zu bytes)\n",
-                                          n, (size_t)nrequest);
+          json_stream_release (response);
+          response = json_stream_new
+            (error_object_string ("Invalid request:"
+                                  " short read (%zu of %zu bytes)\n",
+                                  n, (size_t)nrequest));
         }
       else /* Process request  */
         {
           request[n] = '\0'; /* Ensure that request has an end */
           if (opt_debug)
             log_debug ("request='%s'\n", request);
-          xfree (response);
+          json_stream_release (response);
           response = process_request (request);
           if (opt_debug)
-            log_debug ("response='%s'\n", response);
+            log_debug ("response='%s'%s (%zu bytes)\n", response->head,
+                       response->data? " + data" : "", response->length);
         }
-      nresponse = strlen (response);
+      if (response->length > (uint32_t)(-1))
+        {
+          log_error ("error writing response: response too long\n");
+          break;
+        }
+      nresponse = response->length;
 
       /* Write response */
       if (es_write (es_stdout, &nresponse, sizeof nresponse, &n))
@@ -3754,30 +4162,26 @@ native_messaging_repl (void)
           log_error ("error writing request header: short write\n");
           break;
         }
-      if (es_write (es_stdout, response, nresponse, &n))
+      /* The response is encoded while writing it so that we do not
+       * need to keep the encoded data in memory.  */
+      if ((err = json_stream_write (response, es_stdout)))
         {
-          err = gpg_error_from_syserror ();
           log_error ("error writing request: %s\n", gpg_strerror (err));
           break;
         }
-      if (n != nresponse)
-        {
-          log_error ("error writing request: short write\n");
-          break;
-        }
       if (es_fflush (es_stdout) || es_ferror (es_stdout))
         {
           err = gpg_error_from_syserror ();
           log_error ("error writing request: %s\n", gpg_strerror (err));
           break;
         }
-      xfree (response);
+      json_stream_release (response);
       response = NULL;
       xfree (request);
       request = NULL;
     }
 
-  xfree (response);
+  json_stream_release (response);
   xfree (request);
 }
 
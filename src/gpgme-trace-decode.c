@@ -0,0 +1,294 @@
+/* gpgme-trace-decode.c - Render dumps of the GPGME trace rings
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This reads the dumps of the trace rings written by GPGME when the
+ * "ring" option of GPGME_DEBUG is used and prints the trace messages
+ * of all threads ordered by time in the format GPGME uses for
+ * GPGME_DEBUG without that option.  Example:
+ *
+ *   GPGME_DEBUG=9:/tmp/gpgme.ring:ring  myprogram
+ *   gpgme-trace-decode /tmp/gpgme.ring
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "trace-ring.h"
+
+#define PGM "gpgme-trace-decode"
+
+
+/* The records of all dumps read so far.  The string fields of the
+   records point to the strings of their dump.  */
+static struct trace_record_s *records;
+static size_t nrecords;
+
+/* Print the time with microseconds.  */
+static int opt_usec;
+
+
+static void
+out_of_core (void)
+{
+  fprintf (stderr, PGM ": out of core\n");
+  exit (2);
+}
+
+
+static int
+read_uint32 (FILE *fp, uint32_t *r_value)
+{
+  return fread (r_value, sizeof *r_value, 1, fp) != 1;
+}
+
+
+/* Replace the string index VALUE by the address of the string.  */
+static uint64_t
+resolve_string (uint64_t value, char **strings, uint32_t nstrings)
+{
+  if (value >= nstrings)
+    return 0;
+  return (uintptr_t) strings[value];
+}
+
+
+/* Read one dump from FP.  Returns 1 at EOF, -1 on error.  The strings
+   of the dump are not released.  */
+static int
+read_dump (FILE *fp, const char *fname)
+{
+  char magic[8];
+  uint32_t byteorder, nstrings, count, len, i;
+  char **strings;
+  struct trace_record_s *newrecords;
+
+  if (fread (magic, sizeof magic, 1, fp) != 1)
+    return 1;
+  if (memcmp (magic, TRACE_DUMP_MAGIC, sizeof magic)
+      || read_uint32 (fp, &byteorder))
+    {
+      fprintf (stderr, PGM ": %s: not a trace dump\n", fname);
+      return -1;
+    }
+  if (byteorder != TRACE_DUMP_BYTEORDER)
+    {
+      fprintf (stderr, PGM ": %s: dump has a different byte order\n",
+               fname);
+      return -1;
+    }
+
+  if (read_uint32 (fp, &nstrings))
+    goto truncated;
+  strings = calloc (nstrings + 1, sizeof *strings);
+  if (!strings)
+    out_of_core ();
+  for (i = 0; i < nstrings; i++)
+    {
+      if (read_uint32 (fp, &len))
+        goto truncated;
+      strings[i] = malloc (len + 1);
+      if (!strings[i])
+        out_of_core ();
+      if (len && fread (strings[i], len, 1, fp) != 1)
+        goto truncated;
+      strings[i][len] = 0;
+    }
+
+  if (read_uint32 (fp, &count))
+    goto truncated;
+  newrecords = realloc (records, (nrecords + count) * sizeof *records);
+  if (!newrecords && nrecords + count)
+    out_of_core ();
+  records = newrecords;
+  for (i = 0; i < count; i++)
+    {
+      struct trace_record_s *rec = &records[nrecords];
+
+      if (fread (rec, sizeof *rec, 1, fp) != 1)
+        goto truncated;
+      if (!rec->seq)
+        continue;  /* The record was being written.  */
+      rec->func = resolve_string (rec->func, strings, nstrings);
+      rec->format = resolve_string (rec->format, strings, nstrings);
+      rec->tagname = resolve_string (rec->tagname, strings, nstrings);
+      nrecords++;
+    }
+  return 0;
+
+ truncated:
+  fprintf (stderr, PGM ": %s: dump is truncated\n", fname);
+  return -1;
+}
+
+
+static int
+compare_records (const void *a, const void *b)
+{
+  const struct trace_record_s *ra = a;
+  const struct trace_record_s *rb = b;
+
+  if (ra->stamp != rb->stamp)
+    return ra->stamp < rb->stamp? -1 : 1;
+  if (ra->thread != rb->thread)
+    return ra->thread < rb->thread? -1 : 1;
+  return ra->seq < rb->seq? -1 : ra->seq > rb->seq;
+}
+
+
+/* Print REC like _gpgme_debug in debug.c.  */
+static void
+print_record (const struct trace_record_s *rec)
+{
+  const char *func = (const char *)(uintptr_t) rec->func;
+  const char *format = (const char *)(uintptr_t) rec->format;
+  const char *tagname = (const char *)(uintptr_t) rec->tagname;
+  const char *modestr;
+  char tag[24];
+  char userinfo[4096];
+  int need_lf;
+  struct tm *tp;
+  time_t atime = rec->stamp / 1000000000;
+
+  tp = localtime (&atime);
+  if (opt_usec)
+    printf ("GPGME %04d%02d%02dT%02d%02d%02d.%06u %04llX  %*s",
+            1900+tp->tm_year, tp->tm_mon+1, tp->tm_mday,
+            tp->tm_hour, tp->tm_min, tp->tm_sec,
+            (unsigned int)(rec->stamp % 1000000000 / 1000),
+            (unsigned long long) rec->thread, rec->indent, "");
+  else
+    printf ("GPGME %04d%02d%02dT%02d%02d%02d %04llX  %*s",
+            1900+tp->tm_year, tp->tm_mon+1, tp->tm_mday,
+            tp->tm_hour, tp->tm_min, tp->tm_sec,
+            (unsigned long long) rec->thread, rec->indent, "");
+
+  switch (rec->mode)
+    {
+    case -1: modestr = NULL; break; /* Do nothing.  */
+    case 0: modestr = "call"; break;
+    case 1: modestr = "enter"; break;
+    case 2: modestr = "check"; break;
+    case 3: modestr = "leave"; break;
+    default: modestr = "mode?"; break;
+    }
+
+  if (!modestr)
+    ;
+  else if (tagname)
+    {
+      _gpgme_trace_record_pointer (rec, rec->tag, tag, sizeof tag);
+      printf ("%s: %s: %s=%s ", func? func : "(null)", modestr, tagname, tag);
+    }
+  else
+    printf ("%s: %s: ", func? func : "(null)", modestr);
+
+  if (format && *format)
+    _gpgme_trace_record_format (rec, format, userinfo, sizeof userinfo);
+  else
+    *userinfo = 0;
+
+  if (rec->mode != -1 && (!format || !*format))
+    need_lf = 1;
+  else if (*userinfo && userinfo[strlen (userinfo) - 1] != '\n')
+    need_lf = 1;
+  else
+    need_lf = 0;
+
+  printf ("%s%s", userinfo, need_lf? "\n":"");
+}
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options] [FILE...]\n\n"
+         "Print the trace messages in the dumps of the GPGME trace rings\n"
+         "in FILE or stdin.\n\n"
+         "Options:\n"
+         "  --usec           print the time with microseconds\n"
+         , ex? stderr : stdout);
+  exit (ex);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  FILE *fp;
+  size_t i;
+  int rc, any_err = 0;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--usec"))
+        {
+          opt_usec = 1;
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+
+  if (!argc)
+    {
+      while (!(rc = read_dump (stdin, "[stdin]")))
+        ;
+      any_err = rc < 0;
+    }
+  for (; argc; argc--, argv++)
+    {
+      fp = fopen (*argv, "rb");
+      if (!fp)
+        {
+          fprintf (stderr, PGM ": can't open '%s'\n", *argv);
+          any_err = 1;
+          continue;
+        }
+      while (!(rc = read_dump (fp, *argv)))
+        ;
+      if (rc < 0)
+        any_err = 1;
+      fclose (fp);
+    }
+
+  qsort (records, nrecords, sizeof *records, compare_records);
+  for (i = 0; i < nrecords; i++)
+    print_record (&records[i]);
+
+  free (records);
+  return any_err;
+}
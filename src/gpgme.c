@@ -68,6 +68,8 @@ gpgme_set_global_flag (const char *name, const char *value)
     return -1;
   else if (!strcmp (name, "debug"))
     return _gpgme_debug_set_debug_envvar (value);
+  else if (!strcmp (name, "debug-dump"))
+    return _gpgme_debug_dump (value);
   else if (!strcmp (name, "disable-gpgconf"))
     {
       _gpgme_dirinfo_disable_gpgconf ();
@@ -81,6 +83,10 @@ gpgme_set_global_flag (const char *name, const char *value)
     return _gpgme_set_default_gpg_name (value);
   else if (!strcmp (name, "w32-inst-dir"))
     return _gpgme_set_override_inst_dir (value);
+  else if (!strcmp (name, "engine-cache"))
+    return _gpgme_set_engine_cache_file (value);
+  else if (!strcmp (name, "engine-pool"))
+    return _gpgme_set_engine_pool (value);
   else
     return -1;
 }
@@ -201,12 +207,28 @@ gpgme_error_t
 gpgme_cancel (gpgme_ctx_t ctx)
 {
   gpg_error_t err;
+  size_t i;
 
   TRACE_BEG (DEBUG_CTX, "gpgme_cancel", ctx, "");
 
   if (!ctx)
     return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
 
+  /* Without a pending operation of its own, CTX may run a batch
+     operation in another thread, which checks this flag.  */
+  LOCK (ctx->lock);
+  for (i = 0; i < ctx->fdt.size; i++)
+    if (ctx->fdt.fds[i].fd != -1)
+      break;
+  if (i == ctx->fdt.size)
+    {
+      ctx->canceled = 1;
+      _gpgme_fd_table_wakeup (&ctx->fdt);
+    }
+  UNLOCK (ctx->lock);
+  if (!ctx->engine)
+    return TRACE_ERR (0);
+
   err = _gpgme_cancel_with_err (ctx, gpg_error (GPG_ERR_CANCELED), 0);
 
   return TRACE_ERR (err);
@@ -224,8 +246,13 @@ gpgme_cancel_async (gpgme_ctx_t ctx)
 
   LOCK (ctx->lock);
   ctx->canceled = 1;
+  _gpgme_fd_table_wakeup (&ctx->fdt);
   UNLOCK (ctx->lock);
 
+  /* This takes the lock of the global event loop, which must not be
+     taken while holding the context lock.  */
+  _gpgme_wait_global_wakeup (ctx);
+
   return TRACE_ERR (0);
 }
 
@@ -234,6 +261,8 @@ gpgme_cancel_async (gpgme_ctx_t ctx)
 void
 gpgme_release (gpgme_ctx_t ctx)
 {
+  int i;
+
   TRACE (DEBUG_CTX, "gpgme_release", ctx, "");
 
   if (!ctx)
@@ -243,6 +272,8 @@ gpgme_release (gpgme_ctx_t ctx)
   ctx->engine = NULL;
   _gpgme_fd_table_deinit (&ctx->fdt);
   _gpgme_release_result (ctx);
+  for (i = 0; i < OPDATA_COUNT; i++)
+    free (ctx->op_data_spare[i]);
   _gpgme_signers_clear (ctx);
   _gpgme_sig_notation_clear (ctx);
   free (ctx->sender);
@@ -304,19 +335,39 @@ gpgme_result_unref (void *result)
 }
 
 
+/* Release the operation data of CTX.  Operation data which is not
+   referenced by the user is kept to be reused by the next operation
+   of the same type.  */
 void
 _gpgme_release_result (gpgme_ctx_t ctx)
 {
-  struct ctx_op_data *data = ctx->op_data;
+  struct ctx_op_data *data;
+  int type, last_ref;
 
-  while (data)
+  for (type = 0; type < OPDATA_COUNT; type++)
     {
-      struct ctx_op_data *next_data = data->next;
-      data->next = NULL;
-      gpgme_result_unref (data->hook);
-      data = next_data;
+      data = ctx->op_data[type];
+      if (!data)
+        continue;
+      ctx->op_data[type] = NULL;
+
+      LOCK (result_ref_lock);
+      last_ref = (data->references == 1);
+      if (last_ref)
+        data->references = 0;
+      UNLOCK (result_ref_lock);
+      if (!last_ref)
+        {
+          gpgme_result_unref (data->hook);
+          continue;
+        }
+
+      if (data->cleanup)
+        (*data->cleanup) (data->hook);
+      memset (data->hook, 0, data->size);
+      free (ctx->op_data_spare[type]);
+      ctx->op_data_spare[type] = data;
     }
-  ctx->op_data = NULL;
 }
 
 
@@ -578,6 +629,10 @@ gpgme_set_ctx_flag (gpgme_ctx_t ctx, const char *name, const char *value)
     {
       ctx->extended_edit = abool;
     }
+  else if (!strcmp (name, "key-cache"))
+    {
+      ctx->key_cache = abool;
+    }
   else
     err = gpg_error (GPG_ERR_UNKNOWN_NAME);
 
@@ -647,6 +702,10 @@ gpgme_get_ctx_flag (gpgme_ctx_t ctx, const char *name)
     {
       return ctx->extended_edit ? "1":"";
     }
+  else if (!strcmp (name, "key-cache"))
+    {
+      return ctx->key_cache? "1":"";
+    }
   else
     return NULL;
 }
@@ -1080,6 +1139,8 @@ gpgme_ctx_get_engine_info (gpgme_ctx_t ctx)
 {
   TRACE (DEBUG_CTX, "gpgme_ctx_get_engine_info", ctx,
 	  "ctx->engine_info=%p", ctx->engine_info);
+  /* The versions are figured out only on demand.  */
+  _gpgme_engine_info_probe (ctx->engine_info);
   return ctx->engine_info;
 }
 
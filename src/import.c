@@ -266,6 +266,8 @@ _gpgme_op_import_start (gpgme_ctx_t ctx, int synchronous, gpgme_data_t keydata)
   void *hook;
   op_data_t opd;
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -331,6 +333,8 @@ _gpgme_op_import_keys_start (gpgme_ctx_t ctx, int synchronous,
   op_data_t opd;
   int idx, firstidx, nkeys;
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -23,6 +23,7 @@
 #include <config.h>
 #endif
 #include <stdlib.h>
+#include <stddef.h>
 #include <string.h>
 #include <assert.h>
 #include <errno.h>
@@ -35,33 +36,182 @@
 
 
 
-/* Protects all reference counters in keys.  All other accesses to a
-   key are read only.  */
+/* Protects all reference counters in keys if atomic operations are
+   not available.  All other accesses to a key are read only.  */
+#ifndef HAVE_ATOMIC_BUILTINS
 DEFINE_STATIC_LOCK (key_ref_lock);
+#endif
+
+
+/* A key and all objects hanging off it (subkeys, user IDs, key
+   signatures, notations, TOFU info and strings) are allocated from a
+   per-key arena which is released in one go by gpgme_key_unref.  The
+   arena header is placed in front of the key object, thus the public
+   structures are not changed.  */
+
+/* The size of the first chunk of an arena, including the header and
+   the key object.  This is enough for a typical key without
+   signatures.  Further chunks double in size up to the maximum;
+   larger objects get a chunk of their own.  */
+#define KEY_ARENA_FIRST_CHUNK 1024
+#define KEY_ARENA_MAX_CHUNK   (32 * 1024)
+
+/* All objects are aligned to the size of this type.  */
+typedef union
+{
+  void *ptr;
+  long long ll;
+  double d;
+} key_arena_align_t;
+#define KEY_ARENA_ALIGN(n) \
+  (((n) + sizeof (key_arena_align_t) - 1) & ~(sizeof (key_arena_align_t) - 1))
+
+struct key_chunk_s
+{
+  struct key_chunk_s *next;
+  key_arena_align_t data[1];
+};
+typedef struct key_chunk_s *key_chunk_t;
+
+struct key_arena_s
+{
+  key_chunk_t chunks;		/* The chunks following the first one.  */
+  char *ptr;			/* Free space in the current chunk.  */
+  size_t avail;			/* Number of bytes at PTR.  */
+  size_t chunksize;		/* Size of the current chunk.  */
+  unsigned int nobjects;	/* Number of objects allocated.  */
+  unsigned int nchunks;		/* Number of chunks malloced.  */
+  struct _gpgme_key key;
+};
+typedef struct key_arena_s *key_arena_t;
+
+#define KEY_ARENA(key) \
+  ((key_arena_t) ((char *) (key) - offsetof (struct key_arena_s, key)))
 
 
 /* Create a new key.  */
 gpgme_error_t
 _gpgme_key_new (gpgme_key_t *r_key)
 {
-  gpgme_key_t key;
+  key_arena_t arena;
+  size_t hdrlen = KEY_ARENA_ALIGN (sizeof *arena);
 
-  key = calloc (1, sizeof *key);
-  if (!key)
+  arena = malloc (KEY_ARENA_FIRST_CHUNK);
+  if (!arena)
     return gpg_error_from_syserror ();
-  key->_refs = 1;
-
-  *r_key = key;
+  memset (arena, 0, sizeof *arena);
+  arena->ptr = (char *) arena + hdrlen;
+  arena->avail = KEY_ARENA_FIRST_CHUNK - hdrlen;
+  arena->chunksize = KEY_ARENA_FIRST_CHUNK;
+  arena->nobjects = 1;
+  arena->nchunks = 1;
+  arena->key._refs = 1;
+
+  *r_key = &arena->key;
   return 0;
 }
 
 
+/* Allocate SIZE zeroed bytes from the arena of KEY.  The memory is
+   released with the key.  Returns NULL and sets ERRNO on error.  */
+void *
+_gpgme_key_alloc (gpgme_key_t key, size_t size)
+{
+  key_arena_t arena = KEY_ARENA (key);
+  key_chunk_t chunk;
+  size_t chunksize;
+  size_t hdrlen = offsetof (struct key_chunk_s, data);
+  void *p;
+
+  size = KEY_ARENA_ALIGN (size);
+  if (size > arena->avail)
+    {
+      chunksize = arena->chunksize * 2;
+      if (chunksize > KEY_ARENA_MAX_CHUNK)
+        chunksize = KEY_ARENA_MAX_CHUNK;
+      if (size > (chunksize - hdrlen) / 4)
+        {
+          /* A large object - give it a chunk of its own and keep
+             using the current chunk.  */
+          chunk = malloc (hdrlen + size);
+          if (!chunk)
+            return NULL;
+          chunk->next = arena->chunks;
+          arena->chunks = chunk;
+          arena->nchunks++;
+          arena->nobjects++;
+          p = chunk->data;
+          memset (p, 0, size);
+          return p;
+        }
+
+      chunk = malloc (chunksize);
+      if (!chunk)
+        return NULL;
+      chunk->next = arena->chunks;
+      arena->chunks = chunk;
+      arena->nchunks++;
+      arena->chunksize = chunksize;
+      arena->ptr = (char *) chunk->data;
+      arena->avail = chunksize - hdrlen;
+    }
+
+  p = arena->ptr;
+  arena->ptr += size;
+  arena->avail -= size;
+  arena->nobjects++;
+  memset (p, 0, size);
+  return p;
+}
+
+
+/* Return a copy of STRING allocated from the arena of KEY.  Returns
+   NULL and sets ERRNO on error.  */
+char *
+_gpgme_key_strdup (gpgme_key_t key, const char *string)
+{
+  size_t len = strlen (string) + 1;
+  char *p;
+
+  p = _gpgme_key_alloc (key, len);
+  if (p)
+    memcpy (p, string, len);
+  return p;
+}
+
+
+/* Public version of _gpgme_key_strdup.  */
+char *
+gpgme_key_strdup (gpgme_key_t key, const char *string)
+{
+  if (!key || !string)
+    {
+      gpg_err_set_errno (EINVAL);
+      return NULL;
+    }
+  return _gpgme_key_strdup (key, string);
+}
+
+
+/* Store the number of objects allocated for KEY at R_NOBJECTS and
+   the number of actual memory allocations at R_NCHUNKS.  */
+void
+_gpgme_key_alloc_stats (gpgme_key_t key, unsigned int *r_nobjects,
+                        unsigned int *r_nchunks)
+{
+  key_arena_t arena = KEY_ARENA (key);
+
+  *r_nobjects = arena->nobjects;
+  *r_nchunks = arena->nchunks;
+}
+
+
 gpgme_error_t
 _gpgme_key_add_subkey (gpgme_key_t key, gpgme_subkey_t *r_subkey)
 {
   gpgme_subkey_t subkey;
 
-  subkey = calloc (1, sizeof *subkey);
+  subkey = _gpgme_key_alloc (key, sizeof *subkey);
   if (!subkey)
     return gpg_error_from_syserror ();
   subkey->keyid = subkey->_keyid;
@@ -208,17 +358,17 @@ gpgme_error_t
 _gpgme_key_append_name (gpgme_key_t key, const char *src, int convert)
 {
   gpgme_user_id_t uid;
-  char *dst;
+  char *dst, *address;
   int src_len = strlen (src);
 
   assert (key);
-  /* We can malloc a buffer of the same length, because the converted
-     string will never be larger. Actually we allocate it twice the
-     size, so that we are able to store the parsed stuff there too.  */
-  uid = malloc (sizeof (*uid) + 2 * src_len + 3);
+  /* We can allocate a buffer of the same length, because the
+     converted string will never be larger. Actually we allocate it
+     twice the size, so that we are able to store the parsed stuff
+     there too.  */
+  uid = _gpgme_key_alloc (key, sizeof (*uid) + 2 * src_len + 3);
   if (!uid)
     return gpg_error_from_syserror ();
-  memset (uid, 0, sizeof *uid);
 
   uid->uid = ((char *) uid) + sizeof (*uid);
   dst = uid->uid;
@@ -235,7 +385,14 @@ _gpgme_key_append_name (gpgme_key_t key, const char *src, int convert)
     parse_user_id (uid->uid, &uid->name, &uid->email,
 		   &uid->comment, dst);
 
-  uid->address = _gpgme_mailbox_from_userid (uid->uid);
+  address = _gpgme_mailbox_from_userid (uid->uid);
+  if (address)
+    {
+      uid->address = _gpgme_key_strdup (key, address);
+      free (address);
+      if (!uid->address)
+        return gpg_error_from_syserror ();
+    }
   if ((!uid->email || !*uid->email) && uid->address && uid->name
       && !strcmp (uid->name, uid->address))
     {
@@ -267,13 +424,13 @@ _gpgme_key_add_sig (gpgme_key_t key, char *src)
   uid = key->_last_uid;
   assert (uid);	/* XXX */
 
-  /* We can malloc a buffer of the same length, because the converted
-     string will never be larger.  Actually we allocate it twice the
-     size, so that we are able to store the parsed stuff there too.  */
-  sig = malloc (sizeof (*sig) + 2 * src_len + 3);
+  /* We can allocate a buffer of the same length, because the
+     converted string will never be larger.  Actually we allocate it
+     twice the size, so that we are able to store the parsed stuff
+     there too.  */
+  sig = _gpgme_key_alloc (key, sizeof (*sig) + 2 * src_len + 3);
   if (!sig)
     return NULL;
-  memset (sig, 0, sizeof *sig);
 
   sig->keyid = sig->_keyid;
   sig->_keyid[16] = '\0';
@@ -303,14 +460,212 @@ _gpgme_key_add_sig (gpgme_key_t key, char *src)
   return sig;
 }
 
+
+/* Return a copy of the LEN bytes at BUFFER, followed by a Nul,
+   allocated from the arena of KEY or NULL if BUFFER is NULL.  On
+   error NULL is returned and *R_ERR is set; nothing is done if
+   *R_ERR is already set.  */
+static char *
+copy_part (gpgme_key_t key, const char *buffer, size_t len,
+           gpgme_error_t *r_err)
+{
+  char *p;
+
+  if (!buffer || *r_err)
+    return NULL;
+  p = _gpgme_key_alloc (key, len + 1);
+  if (!p)
+    {
+      *r_err = gpg_error_from_syserror ();
+      return NULL;
+    }
+  memcpy (p, buffer, len);
+  return p;
+}
+
+
+static char *
+copy_string (gpgme_key_t key, const char *string, gpgme_error_t *r_err)
+{
+  return copy_part (key, string, string? strlen (string) : 0, r_err);
+}
+
+
+/* Append copies of the key signatures SRC to UID of KEY.  */
+static gpgme_error_t
+copy_key_sigs (gpgme_key_t key, gpgme_user_id_t uid, gpgme_key_sig_t src)
+{
+  gpgme_error_t err = 0;
+  gpgme_key_sig_t sig;
+  gpgme_sig_notation_t notation, srcnot;
+
+  for (; src; src = src->next)
+    {
+      sig = _gpgme_key_alloc (key, sizeof *sig);
+      if (!sig)
+        return gpg_error_from_syserror ();
+      *sig = *src;
+      sig->next = NULL;
+      sig->keyid = sig->_keyid;
+      sig->uid = copy_string (key, src->uid, &err);
+      sig->name = copy_string (key, src->name, &err);
+      sig->email = copy_string (key, src->email, &err);
+      sig->comment = copy_string (key, src->comment, &err);
+      sig->notations = sig->_last_notation = NULL;
+      for (srcnot = src->notations; srcnot && !err; srcnot = srcnot->next)
+        {
+          notation = _gpgme_key_alloc (key, sizeof *notation);
+          if (!notation)
+            return gpg_error_from_syserror ();
+          *notation = *srcnot;
+          notation->next = NULL;
+          notation->name = copy_part (key, srcnot->name, srcnot->name_len,
+                                      &err);
+          notation->value = copy_part (key, srcnot->value, srcnot->value_len,
+                                       &err);
+          if (!sig->notations)
+            sig->notations = notation;
+          if (sig->_last_notation)
+            sig->_last_notation->next = notation;
+          sig->_last_notation = notation;
+        }
+      if (err)
+        return err;
+
+      if (!uid->signatures)
+        uid->signatures = sig;
+      if (uid->_last_keysig)
+        uid->_last_keysig->next = sig;
+      uid->_last_keysig = sig;
+    }
+  return 0;
+}
+
+
+/* Store a deep copy of KEY at R_COPY.  The copy has its own arena
+   and reference counter and thus shares nothing with KEY.  */
+gpgme_error_t
+_gpgme_key_copy (gpgme_key_t key, gpgme_key_t *r_copy)
+{
+  gpgme_error_t err;
+  gpgme_key_t copy;
+  gpgme_subkey_t subkey, srcsub;
+  gpgme_user_id_t uid, srcuid;
+  gpgme_tofu_info_t ti, srcti, *tail;
+  unsigned int refs;
+
+  *r_copy = NULL;
+  err = _gpgme_key_new (&copy);
+  if (err)
+    return err;
+
+  refs = copy->_refs;
+  *copy = *key;
+  copy->_refs = refs;
+  copy->subkeys = copy->_last_subkey = NULL;
+  copy->uids = copy->_last_uid = NULL;
+  copy->fpr = NULL;
+  copy->issuer_serial = copy_string (copy, key->issuer_serial, &err);
+  copy->issuer_name = copy_string (copy, key->issuer_name, &err);
+  copy->chain_id = copy_string (copy, key->chain_id, &err);
+  if (err)
+    goto leave;
+
+  for (srcsub = key->subkeys; srcsub; srcsub = srcsub->next)
+    {
+      err = _gpgme_key_add_subkey (copy, &subkey);
+      if (err)
+        goto leave;
+      *subkey = *srcsub;
+      subkey->next = NULL;
+      subkey->keyid = subkey->_keyid;
+      subkey->fpr = copy_string (copy, srcsub->fpr, &err);
+      subkey->card_number = copy_string (copy, srcsub->card_number, &err);
+      subkey->curve = copy_string (copy, srcsub->curve, &err);
+      subkey->keygrip = copy_string (copy, srcsub->keygrip, &err);
+      if (err)
+        goto leave;
+      if (key->fpr && key->fpr == srcsub->fpr)
+        copy->fpr = subkey->fpr;
+    }
+  if (key->fpr && !copy->fpr)
+    {
+      copy->fpr = copy_string (copy, key->fpr, &err);
+      if (err)
+        goto leave;
+    }
+
+  for (srcuid = key->uids; srcuid; srcuid = srcuid->next)
+    {
+      uid = _gpgme_key_alloc (copy, sizeof *uid);
+      if (!uid)
+        {
+          err = gpg_error_from_syserror ();
+          goto leave;
+        }
+      *uid = *srcuid;
+      uid->next = NULL;
+      uid->uid = copy_string (copy, srcuid->uid, &err);
+      uid->name = copy_string (copy, srcuid->name, &err);
+      uid->comment = copy_string (copy, srcuid->comment, &err);
+      uid->address = copy_string (copy, srcuid->address, &err);
+      uid->uidhash = copy_string (copy, srcuid->uidhash, &err);
+      /* For a mailbox only key the email is the address.  */
+      if (srcuid->email && srcuid->email == srcuid->address)
+        uid->email = uid->address;
+      else
+        uid->email = copy_string (copy, srcuid->email, &err);
+      uid->signatures = uid->_last_keysig = NULL;
+      uid->tofu = NULL;
+      tail = &uid->tofu;
+      for (srcti = srcuid->tofu; srcti && !err; srcti = srcti->next)
+        {
+          ti = _gpgme_key_alloc (copy, sizeof *ti);
+          if (!ti)
+            {
+              err = gpg_error_from_syserror ();
+              goto leave;
+            }
+          *ti = *srcti;
+          ti->next = NULL;
+          ti->description = copy_string (copy, srcti->description, &err);
+          *tail = ti;
+          tail = &ti->next;
+        }
+      if (!err)
+        err = copy_key_sigs (copy, uid, srcuid->signatures);
+      if (err)
+        goto leave;
+
+      if (!copy->uids)
+        copy->uids = uid;
+      if (copy->_last_uid)
+        copy->_last_uid->next = uid;
+      copy->_last_uid = uid;
+    }
+
+ leave:
+  if (err)
+    gpgme_key_unref (copy);
+  else
+    *r_copy = copy;
+  return err;
+}
+
 
 /* Acquire a reference to KEY.  */
 void
 gpgme_key_ref (gpgme_key_t key)
 {
+#ifdef HAVE_ATOMIC_BUILTINS
+  /* The caller already holds a reference, thus no ordering is
+     required.  */
+  __atomic_add_fetch (&key->_refs, 1, __ATOMIC_RELAXED);
+#else
   LOCK (key_ref_lock);
   key->_refs++;
   UNLOCK (key_ref_lock);
+#endif
 }
 
 
@@ -322,12 +677,23 @@ gpgme_key_ref (gpgme_key_t key)
 void
 gpgme_key_unref (gpgme_key_t key)
 {
-  gpgme_user_id_t uid;
-  gpgme_subkey_t subkey;
+  key_arena_t arena;
+  key_chunk_t chunk;
+#ifdef HAVE_ATOMIC_BUILTINS
+  unsigned int refs;
+#endif
 
   if (!key)
     return;
 
+#ifdef HAVE_ATOMIC_BUILTINS
+  /* The release ordering makes all accesses by other threads visible
+     to the thread which eventually frees the key.  */
+  refs = __atomic_sub_fetch (&key->_refs, 1, __ATOMIC_ACQ_REL);
+  assert (refs != (unsigned int)-1);
+  if (refs)
+    return;
+#else
   LOCK (key_ref_lock);
   assert (key->_refs > 0);
   if (--key->_refs)
@@ -336,70 +702,20 @@ gpgme_key_unref (gpgme_key_t key)
       return;
     }
   UNLOCK (key_ref_lock);
+#endif
 
-  subkey = key->subkeys;
-  while (subkey)
+  /* All objects of the key live in its arena.  */
+  arena = KEY_ARENA (key);
+  while ((chunk = arena->chunks))
     {
-      gpgme_subkey_t next = subkey->next;
-      free (subkey->fpr);
-      free (subkey->curve);
-      free (subkey->keygrip);
-      free (subkey->card_number);
-      free (subkey);
-      subkey = next;
+      arena->chunks = chunk->next;
+      free (chunk);
     }
-
-  uid = key->uids;
-  while (uid)
-    {
-      gpgme_user_id_t next_uid = uid->next;
-      gpgme_key_sig_t keysig = uid->signatures;
-      gpgme_tofu_info_t tofu = uid->tofu;
-
-      while (keysig)
-	{
-	  gpgme_key_sig_t next_keysig = keysig->next;
-	  gpgme_sig_notation_t notation = keysig->notations;
-
-	  while (notation)
-	    {
-	      gpgme_sig_notation_t next_notation = notation->next;
-
-	      _gpgme_sig_notation_free (notation);
-	      notation = next_notation;
-	    }
-
-          free (keysig);
-	  keysig = next_keysig;
-        }
-
-      while (tofu)
-        {
-          /* NB: The ->next is currently not used but we are prepared
-           * for it.  */
-          gpgme_tofu_info_t tofu_next = tofu->next;
-
-          free (tofu->description);
-          free (tofu);
-          tofu = tofu_next;
-        }
-
-      free (uid->address);
-      free (uid->uidhash);
-      free (uid);
-      uid = next_uid;
-    }
-
-  free (key->issuer_serial);
-  free (key->issuer_name);
-  free (key->chain_id);
-  free (key->fpr);
-
-  free (key);
+  free (arena);
 }
 
 
-
+
 /* Support functions.  */
 
 /* Create a dummy key to specify an email address.  */
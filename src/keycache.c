@@ -0,0 +1,441 @@
+/* keycache.c - Process wide cache for gpgme_get_key.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef HAVE_SYS_TYPES_H
+# include <sys/types.h>
+#endif
+#include <sys/stat.h>
+
+#include "gpgme.h"
+#include "util.h"
+#include "context.h"
+#include "ops.h"
+#include "sema.h"
+#include "debug.h"
+
+
+/* The cache maps fingerprints, key IDs and keygrips to the keys
+ * returned by a keylist operation.  Each entry is valid for a scope
+ * describing the engine, the home directory, the keylist mode and
+ * whether the secret keys have been listed.  It also records the
+ * state of the key database files at the time the key was listed;
+ * if one of these files changes the entry is ignored.  */
+
+/* The size of the hash table.  */
+#define KEY_CACHE_TABLE_SIZE 1021
+
+/* The maximum number of entries.  The cache is flushed if this is
+ * exceeded.  */
+#define KEY_CACHE_MAX_ENTRIES 8192
+
+/* The files in the home directory whose modification invalidates the
+ * cached keys.  */
+static const char *const stamp_files[] =
+  {
+    "pubring.kbx",
+    "pubring.gpg",
+    "trustdb.gpg",
+    "trustlist.txt",
+    "private-keys-v1.d",
+    "tofu.db"
+  };
+#define N_STAMP_FILES DIM (stamp_files)
+
+
+struct key_cache_stamp_s
+{
+  struct
+  {
+    time_t mtime;
+    long mtime_nsec;
+    gpgme_off_t size;
+    unsigned long ino;
+  } file[N_STAMP_FILES];
+};
+
+
+struct key_cache_scope_s
+{
+  char *string;
+  struct key_cache_stamp_s stamp;
+};
+
+
+struct key_cache_entry_s
+{
+  struct key_cache_entry_s *next;
+  unsigned int hash;
+  char *scope;
+  struct key_cache_stamp_s stamp;
+
+  /* The key or NULL if the name is ambiguous in this scope.  */
+  gpgme_key_t key;
+  char name[1];
+};
+typedef struct key_cache_entry_s *key_cache_entry_t;
+
+
+DEFINE_STATIC_LOCK (key_cache_lock);
+static key_cache_entry_t key_cache_table[KEY_CACHE_TABLE_SIZE];
+static unsigned int key_cache_entries;
+
+
+static unsigned int
+hash_name (const char *scope, const char *name)
+{
+  unsigned int hash = 2166136261U;
+
+  for (; *scope; scope++)
+    hash = (hash ^ (unsigned char)*scope) * 16777619U;
+  for (; *name; name++)
+    hash = (hash ^ (unsigned char)*name) * 16777619U;
+  return hash;
+}
+
+
+/* Return the canonical form of NAME in BUFFER if it is a name we
+ * cache: a fingerprint, a long key ID, or a keygrip prefixed by an
+ * ampersand, optionally written with a "0x" prefix.  Return NULL
+ * otherwise.  */
+static const char *
+canon_name (const char *name, char *buffer, size_t bufsize)
+{
+  size_t i, n;
+  int is_grip = 0;
+
+  if (*name == '&')
+    {
+      is_grip = 1;
+      name++;
+    }
+  else if (name[0] == '0' && (name[1] == 'x' || name[1] == 'X'))
+    name += 2;
+
+  n = strlen (name);
+  if (is_grip? n != 40 : (n != 16 && n != 32 && n != 40 && n != 64))
+    return NULL;
+  if (n + 2 > bufsize)
+    return NULL;
+
+  i = 0;
+  if (is_grip)
+    buffer[i++] = '&';
+  for (; *name; name++)
+    {
+      if (*name >= 'a' && *name <= 'f')
+        buffer[i++] = *name - 'a' + 'A';
+      else if ((*name >= '0' && *name <= '9')
+               || (*name >= 'A' && *name <= 'F'))
+        buffer[i++] = *name;
+      else
+        return NULL;
+    }
+  buffer[i] = 0;
+  return buffer;
+}
+
+
+static void
+release_entry (key_cache_entry_t entry)
+{
+  gpgme_key_unref (entry->key);
+  free (entry);
+}
+
+
+/* Remove all entries.  Must be called with the lock held.  */
+static void
+flush_table (void)
+{
+  key_cache_entry_t entry, next;
+  int i;
+
+  if (!key_cache_entries)
+    return;
+  for (i = 0; i < KEY_CACHE_TABLE_SIZE; i++)
+    {
+      for (entry = key_cache_table[i]; entry; entry = next)
+        {
+          next = entry->next;
+          release_entry (entry);
+        }
+      key_cache_table[i] = NULL;
+    }
+  key_cache_entries = 0;
+}
+
+
+/* Flush the entire cache.  This is called by all operations which
+ * may modify keys.  */
+void
+_gpgme_key_cache_invalidate (void)
+{
+  LOCK (key_cache_lock);
+  flush_table ();
+  UNLOCK (key_cache_lock);
+}
+
+
+static void
+get_stamp (const char *homedir, struct key_cache_stamp_s *stamp)
+{
+  struct stat st;
+  char *fname;
+  int i;
+
+  memset (stamp, 0, sizeof *stamp);
+  for (i = 0; i < N_STAMP_FILES; i++)
+    {
+      fname = _gpgme_strconcat (homedir, "/", stamp_files[i], NULL);
+      if (!fname)
+        {
+          /* Make sure that this never matches a real stamp.  */
+          stamp->file[i].size = -1;
+          continue;
+        }
+      if (!stat (fname, &st))
+        {
+          stamp->file[i].mtime = st.st_mtime;
+#ifdef HAVE_STRUCT_STAT_ST_MTIM_TV_NSEC
+          stamp->file[i].mtime_nsec = st.st_mtim.tv_nsec;
+#endif
+          stamp->file[i].size = st.st_size;
+          stamp->file[i].ino = st.st_ino;
+        }
+      free (fname);
+    }
+}
+
+
+/* Return the current scope for a keylist with SECRET on CTX in
+ * R_SCOPE or NULL if keys listed by CTX can't be cached.  */
+gpgme_error_t
+_gpgme_key_cache_get_scope (gpgme_ctx_t ctx, int secret,
+                            key_cache_scope_t *r_scope)
+{
+  gpgme_engine_info_t info;
+  key_cache_scope_t scope;
+  const char *homedir;
+  char numbuf[50];
+
+  *r_scope = NULL;
+  if (!ctx->key_cache)
+    return 0;
+  if (ctx->protocol != GPGME_PROTOCOL_OpenPGP
+      && ctx->protocol != GPGME_PROTOCOL_CMS)
+    return 0;
+
+  for (info = ctx->engine_info; info; info = info->next)
+    if (info->protocol == ctx->protocol)
+      break;
+  if (!info || !info->file_name)
+    return 0;
+  homedir = info->home_dir? info->home_dir : _gpgme_get_default_homedir ();
+  if (!homedir)
+    return 0;
+
+  scope = calloc (1, sizeof *scope);
+  if (!scope)
+    return gpg_error_from_syserror ();
+
+  snprintf (numbuf, sizeof numbuf, "%d:%u:%d:",
+            ctx->protocol, (unsigned int)ctx->keylist_mode, !!secret);
+  scope->string = _gpgme_strconcat (numbuf, info->file_name, ":",
+                                    homedir, NULL);
+  if (!scope->string)
+    {
+      gpgme_error_t err = gpg_error_from_syserror ();
+      free (scope);
+      return err;
+    }
+  get_stamp (homedir, &scope->stamp);
+
+  *r_scope = scope;
+  return 0;
+}
+
+
+void
+_gpgme_key_cache_release_scope (key_cache_scope_t scope)
+{
+  if (!scope)
+    return;
+  free (scope->string);
+  free (scope);
+}
+
+
+/* Return true if KEY or one of its subkeys has expired since it has
+ * been listed.  */
+static int
+key_has_expired (gpgme_key_t key)
+{
+  gpgme_subkey_t subkey;
+  time_t now = time (NULL);
+
+  for (subkey = key->subkeys; subkey; subkey = subkey->next)
+    if (!subkey->expired && subkey->expires > 0 && subkey->expires <= now)
+      return 1;
+  return 0;
+}
+
+
+/* Look up NAME in the cache for SCOPE.  On a hit store a copy of the
+ * key at R_KEY and return true.  The caller owns that copy; the keys
+ * in the cache are never handed out.  */
+int
+_gpgme_key_cache_lookup (key_cache_scope_t scope, const char *name,
+                         gpgme_key_t *r_key)
+{
+  char buffer[70];
+  key_cache_entry_t entry;
+  unsigned int hash;
+  gpgme_key_t key = NULL;
+
+  *r_key = NULL;
+  if (!scope || !(name = canon_name (name, buffer, sizeof buffer)))
+    return 0;
+
+  hash = hash_name (scope->string, name);
+  LOCK (key_cache_lock);
+  for (entry = key_cache_table[hash % KEY_CACHE_TABLE_SIZE];
+       entry; entry = entry->next)
+    if (entry->hash == hash
+        && !strcmp (entry->name, name)
+        && !strcmp (entry->scope, scope->string))
+      break;
+  if (entry && entry->key
+      && !memcmp (&entry->stamp, &scope->stamp, sizeof entry->stamp)
+      && !key_has_expired (entry->key))
+    {
+      gpgme_key_ref (entry->key);
+      key = entry->key;
+    }
+  UNLOCK (key_cache_lock);
+
+  /* The cached key is never modified, thus it can be copied without
+   * holding the lock.  If that fails the key is listed again.  */
+  if (key)
+    {
+      _gpgme_key_copy (key, r_key);
+      gpgme_key_unref (key);
+    }
+
+  TRACE (DEBUG_CTX, "_gpgme_key_cache_lookup", NULL,
+         "name=%s -> %s", name, *r_key? "hit" : "miss");
+  return !!*r_key;
+}
+
+
+/* Store KEY under NAME.  Must be called with the lock held.  */
+static void
+put_name (key_cache_scope_t scope, const char *name, gpgme_key_t key)
+{
+  char buffer[70];
+  key_cache_entry_t entry;
+  unsigned int hash;
+
+  if (!name || !(name = canon_name (name, buffer, sizeof buffer)))
+    return;
+
+  hash = hash_name (scope->string, name);
+  for (entry = key_cache_table[hash % KEY_CACHE_TABLE_SIZE];
+       entry; entry = entry->next)
+    if (entry->hash == hash
+        && !strcmp (entry->name, name)
+        && !strcmp (entry->scope, scope->string))
+      break;
+
+  if (entry)
+    {
+      if (memcmp (&entry->stamp, &scope->stamp, sizeof entry->stamp))
+        {
+          /* Outdated entry - simply replace it.  */
+          entry->stamp = scope->stamp;
+        }
+      else if (entry->key != key
+               && (!entry->key
+                   || strcmp (entry->key->subkeys->fpr, key->subkeys->fpr)))
+        {
+          /* Another key with the same name - mark as ambiguous.  */
+          gpgme_key_unref (entry->key);
+          entry->key = NULL;
+          return;
+        }
+      gpgme_key_ref (key);
+      gpgme_key_unref (entry->key);
+      entry->key = key;
+      return;
+    }
+
+  entry = malloc (sizeof *entry + strlen (name) + strlen (scope->string) + 1);
+  if (!entry)
+    return;  /* Not cached.  */
+  strcpy (entry->name, name);
+  entry->scope = entry->name + strlen (name) + 1;
+  strcpy (entry->scope, scope->string);
+  entry->hash = hash;
+  entry->stamp = scope->stamp;
+  gpgme_key_ref (key);
+  entry->key = key;
+  entry->next = key_cache_table[hash % KEY_CACHE_TABLE_SIZE];
+  key_cache_table[hash % KEY_CACHE_TABLE_SIZE] = entry;
+  key_cache_entries++;
+}
+
+
+/* Add a copy of KEY which has been listed in SCOPE to the cache.  The
+ * key is stored under the fingerprints, key IDs and keygrips of all
+ * its subkeys.  KEY itself is owned by the caller which may modify
+ * it, for example by gpgme_key_strdup.  */
+void
+_gpgme_key_cache_put (key_cache_scope_t scope, gpgme_key_t key)
+{
+  gpgme_subkey_t subkey;
+  char grip[42];
+
+  if (!scope || !key || !key->subkeys || !key->subkeys->fpr)
+    return;
+  if (_gpgme_key_copy (key, &key))
+    return;  /* Not cached.  */
+
+  LOCK (key_cache_lock);
+  if (key_cache_entries > KEY_CACHE_MAX_ENTRIES)
+    flush_table ();
+  for (subkey = key->subkeys; subkey; subkey = subkey->next)
+    {
+      put_name (scope, subkey->fpr, key);
+      put_name (scope, subkey->keyid, key);
+      if (subkey->keygrip && strlen (subkey->keygrip) < sizeof grip - 1)
+        {
+          grip[0] = '&';
+          strcpy (grip + 1, subkey->keygrip);
+          put_name (scope, grip, key);
+        }
+    }
+  UNLOCK (key_cache_lock);
+  gpgme_key_unref (key);
+}
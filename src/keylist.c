@@ -45,6 +45,7 @@
 #include "debug.h"
 
 
+/* The queue items are allocated from the arena of their key.  */
 struct key_queue_item_s
 {
   struct key_queue_item_s *next;
@@ -69,6 +70,16 @@ typedef struct
   /* Something new is available.  */
   int key_cond;
   struct key_queue_item_s *key_queue;
+
+  /* The scope used to add the listed keys to the key cache or NULL.  */
+  key_cache_scope_t cache_scope;
+
+  /* Allocation statistics for the debug output: The number of keys,
+     the number of objects in the keys and the number of memory
+     allocations needed for them.  */
+  unsigned long nkeys;
+  unsigned long nobjects;
+  unsigned long nchunks;
 } *op_data_t;
 
 
@@ -78,6 +89,11 @@ release_op_data (void *hook)
   op_data_t opd = (op_data_t) hook;
   struct key_queue_item_s *key = opd->key_queue;
 
+  if (opd->nkeys)
+    TRACE (DEBUG_CTX, "gpgme:keylist_release_op_data", NULL,
+           "keys=%lu objects=%lu allocations=%lu",
+           opd->nkeys, opd->nobjects, opd->nchunks);
+
   if (opd->tmp_key)
     gpgme_key_unref (opd->tmp_key);
 
@@ -91,6 +107,8 @@ release_op_data (void *hook)
       gpgme_key_unref (key->key);
       key = next;
     }
+
+  _gpgme_key_cache_release_scope (opd->cache_scope);
 }
 
 
@@ -418,7 +436,7 @@ parse_sec_field15 (gpgme_key_t key, gpgme_subkey_t subkey, char *field)
       /* Fields starts with a hex digit; thus it is a serial number.  */
       key->secret = 1;
       subkey->is_cardkey = 1;
-      subkey->card_number = strdup (field);
+      subkey->card_number = _gpgme_key_strdup (key, field);
       if (!subkey->card_number)
         return gpg_error_from_syserror ();
     }
@@ -438,7 +456,8 @@ parse_sec_field15 (gpgme_key_t key, gpgme_subkey_t subkey, char *field)
 
 /* Parse a tfs record.  */
 static gpg_error_t
-parse_tfs_record (gpgme_user_id_t uid, char **field, int nfield)
+parse_tfs_record (gpgme_key_t key, gpgme_user_id_t uid,
+                  char **field, int nfield)
 {
   gpg_error_t err;
   gpgme_tofu_info_t ti;
@@ -453,7 +472,7 @@ parse_tfs_record (gpgme_user_id_t uid, char **field, int nfield)
   if (nfield < 8 || atoi(field[1]) != 1)
     return trace_gpg_error (GPG_ERR_INV_ENGINE);
 
-  ti = calloc (1, sizeof *ti);
+  ti = _gpgme_key_alloc (key, sizeof *ti);
   if (!ti)
     return gpg_error_from_syserror ();
 
@@ -523,7 +542,7 @@ parse_tfs_record (gpgme_user_id_t uid, char **field, int nfield)
   return 0;
 
  inv_engine:
-  free (ti);
+  /* TI is released with the key.  */
   return trace_gpg_error (GPG_ERR_INV_ENGINE);
 }
 
@@ -534,13 +553,20 @@ static void
 finish_key (gpgme_ctx_t ctx, op_data_t opd)
 {
   gpgme_key_t key = opd->tmp_key;
+  unsigned int nobjects, nchunks;
 
   opd->tmp_key = NULL;
   opd->tmp_uid = NULL;
   opd->tmp_keysig = NULL;
 
   if (key)
-    _gpgme_engine_io_event (ctx->engine, GPGME_EVENT_NEXT_KEY, key);
+    {
+      _gpgme_key_alloc_stats (key, &nobjects, &nchunks);
+      opd->nkeys++;
+      opd->nobjects += nobjects;
+      opd->nchunks += nchunks;
+      _gpgme_engine_io_event (ctx->engine, GPGME_EVENT_NEXT_KEY, key);
+    }
 }
 
 
@@ -694,7 +720,7 @@ keylist_colon_handler (void *priv, char *line)
       /* Field 8 has the X.509 serial number.  */
       if (fields >= 8 && (rectype == RT_CRT || rectype == RT_CRS))
 	{
-	  key->issuer_serial = strdup (field[7]);
+	  key->issuer_serial = _gpgme_key_strdup (key, field[7]);
 	  if (!key->issuer_serial)
 	    return gpg_error_from_syserror ();
 	}
@@ -706,8 +732,16 @@ keylist_colon_handler (void *priv, char *line)
       /* Field 10 is not used for gpg due to --fixed-list-mode option
 	 but GPGSM stores the issuer name.  */
       if (fields >= 10 && (rectype == RT_CRT || rectype == RT_CRS))
-	if (_gpgme_decode_c_string (field[9], &key->issuer_name, 0))
-	  return gpg_error (GPG_ERR_ENOMEM);	/* FIXME */
+	{
+	  size_t len = strlen (field[9]) + 1;
+
+	  key->issuer_name = _gpgme_key_alloc (key, len);
+	  if (!key->issuer_name)
+	    return gpg_error_from_syserror ();
+	  err = _gpgme_decode_c_string (field[9], &key->issuer_name, len);
+	  if (err)
+	    return err;
+	}
 
       /* Field 11 has the signature class.  */
 
@@ -728,7 +762,7 @@ keylist_colon_handler (void *priv, char *line)
       /* Field 17 has the curve name for ECC.  */
       if (fields >= 17 && *field[16])
         {
-          subkey->curve = strdup (field[16]);
+          subkey->curve = _gpgme_key_strdup (key, field[16]);
           if (!subkey->curve)
             return gpg_error_from_syserror ();
         }
@@ -811,7 +845,7 @@ keylist_colon_handler (void *priv, char *line)
       /* Field 17 has the curve name for ECC.  */
       if (fields >= 17 && *field[16])
         {
-          subkey->curve = strdup (field[16]);
+          subkey->curve = _gpgme_key_strdup (key, field[16]);
           if (!subkey->curve)
             return gpg_error_from_syserror ();
         }
@@ -835,7 +869,9 @@ keylist_colon_handler (void *priv, char *line)
             {
               gpgme_user_id_t uid = key->_last_uid;
               assert (uid);
-              uid->uidhash = strdup (field[7]);
+              uid->uidhash = _gpgme_key_strdup (key, field[7]);
+              if (!uid->uidhash)
+                return gpg_error_from_syserror ();
             }
           opd->tmp_uid = key->_last_uid;
           if (fields >= 20)
@@ -849,7 +885,7 @@ keylist_colon_handler (void *priv, char *line)
     case RT_TFS:
       if (opd->tmp_uid)
 	{
-          err = parse_tfs_record (opd->tmp_uid, field, fields);
+          err = parse_tfs_record (key, opd->tmp_uid, field, fields);
           if (err)
             return err;
         }
@@ -864,7 +900,7 @@ keylist_colon_handler (void *priv, char *line)
           subkey = key->_last_subkey;
           if (!subkey->fpr)
             {
-              subkey->fpr = strdup (field[9]);
+              subkey->fpr = _gpgme_key_strdup (key, field[9]);
               if (!subkey->fpr)
                 return gpg_error_from_syserror ();
             }
@@ -877,19 +913,16 @@ keylist_colon_handler (void *priv, char *line)
                   /* FPR already set but mismatch: Should never happen.  */
                   return trace_gpg_error (GPG_ERR_INTERNAL);
                 }
+              /* Both live in the key's arena; share the string.  */
               if (!key->fpr)
-                {
-                  key->fpr = strdup (subkey->fpr);
-                  if (!key->fpr)
-                    return gpg_error_from_syserror ();
-                }
+                key->fpr = subkey->fpr;
             }
 	}
 
       /* Field 13 has the gpgsm chain ID (take only the first one).  */
       if (fields >= 13 && !key->chain_id && *field[12])
 	{
-	  key->chain_id = strdup (field[12]);
+	  key->chain_id = _gpgme_key_strdup (key, field[12]);
 	  if (!key->chain_id)
 	    return gpg_error_from_syserror ();
 	}
@@ -904,7 +937,7 @@ keylist_colon_handler (void *priv, char *line)
           subkey = key->_last_subkey;
           if (!subkey->keygrip)
             {
-              subkey->keygrip = strdup (field[9]);
+              subkey->keygrip = _gpgme_key_strdup (key, field[9]);
               if (!subkey->keygrip)
                 return gpg_error_from_syserror ();
             }
@@ -1014,7 +1047,8 @@ keylist_colon_handler (void *priv, char *line)
 	      keysig = opd->tmp_keysig;
 
 	      /* At this time, any error is serious.  */
-	      err = _gpgme_parse_notation (&notation, type, flags, len, data);
+	      err = _gpgme_parse_notation (key, &notation,
+                                           type, flags, len, data);
 	      if (err)
 		return err;
 
@@ -1052,7 +1086,7 @@ _gpgme_op_keylist_event_cb (void *data, gpgme_event_io_t type, void *type_data)
   if (err)
     return;
 
-  q = malloc (sizeof *q);
+  q = _gpgme_key_alloc (key, sizeof *q);
   if (!q)
     {
       gpgme_key_unref (key);
@@ -1061,6 +1095,7 @@ _gpgme_op_keylist_event_cb (void *data, gpgme_event_io_t type, void *type_data)
     }
   q->key = key;
   q->next = NULL;
+  _gpgme_key_cache_put (opd->cache_scope, key);
   /* FIXME: Use a tail pointer?  */
   if (!(q2 = opd->key_queue))
     opd->key_queue = q;
@@ -1101,6 +1136,10 @@ gpgme_op_keylist_start (gpgme_ctx_t ctx, const char *pattern, int secret_only)
   if (err)
     return TRACE_ERR (err);
 
+  err = _gpgme_key_cache_get_scope (ctx, secret_only, &opd->cache_scope);
+  if (err)
+    return TRACE_ERR (err);
+
   _gpgme_engine_set_status_handler (ctx->engine, keylist_status_handler, ctx);
 
   err = _gpgme_engine_set_colon_line_handler (ctx->engine,
@@ -1145,6 +1184,10 @@ gpgme_op_keylist_ext_start (gpgme_ctx_t ctx, const char *pattern[],
   if (err)
     return TRACE_ERR (err);
 
+  err = _gpgme_key_cache_get_scope (ctx, secret_only, &opd->cache_scope);
+  if (err)
+    return TRACE_ERR (err);
+
   _gpgme_engine_set_status_handler (ctx->engine, keylist_status_handler, ctx);
   err = _gpgme_engine_set_colon_line_handler (ctx->engine,
 					      keylist_colon_handler, ctx);
@@ -1240,7 +1283,6 @@ gpgme_op_keylist_next (gpgme_ctx_t ctx, gpgme_key_t *r_key)
     opd->key_cond = 0;
 
   *r_key = queue_item->key;
-  free (queue_item);
 
   TRACE_SUC ("key=%p (%s)", *r_key,
              ((*r_key)->subkeys && (*r_key)->subkeys->fpr) ?
@@ -1262,6 +1304,41 @@ gpgme_op_keylist_end (gpgme_ctx_t ctx)
 }
 
 
+/* Create a new context for an internal keylist operation with the
+   relevant state of CTX.  */
+static gpgme_error_t
+new_list_context (gpgme_ctx_t ctx, gpgme_ctx_t *r_listctx)
+{
+  gpgme_ctx_t listctx;
+  gpgme_error_t err;
+  gpgme_protocol_t proto;
+  gpgme_engine_info_t info;
+
+  /* FIXME: We use our own context because we have to avoid the user's
+     I/O callback handlers.  */
+  err = gpgme_new (&listctx);
+  if (err)
+    return err;
+
+  /* Clone the relevant state.  */
+  proto = gpgme_get_protocol (ctx);
+  gpgme_set_protocol (listctx, proto);
+  gpgme_set_keylist_mode (listctx, gpgme_get_keylist_mode (ctx));
+  listctx->key_cache = ctx->key_cache;
+  /* Do not use gpgme_ctx_get_engine_info so that the engines are not
+     run to get their versions.  */
+  info = ctx->engine_info;
+  while (info && info->protocol != proto)
+    info = info->next;
+  if (info)
+    gpgme_ctx_set_engine_info (listctx, proto,
+                               info->file_name, info->home_dir);
+
+  *r_listctx = listctx;
+  return 0;
+}
+
+
 /* Get the key with the fingerprint FPR from the crypto backend.  If
    SECRET is true, get the secret key.  */
 gpgme_error_t
@@ -1284,26 +1361,28 @@ gpgme_get_key (gpgme_ctx_t ctx, const char *fpr, gpgme_key_t *r_key,
   if (strlen (fpr) < 8)	/* We have at least a key ID.  */
     return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
 
-  /* FIXME: We use our own context because we have to avoid the user's
-     I/O callback handlers.  */
-  err = gpgme_new (&listctx);
+  if (ctx->key_cache)
+    {
+      key_cache_scope_t scope;
+      int hit;
+
+      err = _gpgme_key_cache_get_scope (ctx, secret, &scope);
+      if (err)
+        return TRACE_ERR (err);
+      hit = _gpgme_key_cache_lookup (scope, fpr, r_key);
+      _gpgme_key_cache_release_scope (scope);
+      if (hit)
+        {
+          TRACE_LOG  ("key=%p (%s) from cache", *r_key,
+                      ((*r_key)->subkeys && (*r_key)->subkeys->fpr) ?
+                      (*r_key)->subkeys->fpr : "invalid");
+          return TRACE_ERR (0);
+        }
+    }
+
+  err = new_list_context (ctx, &listctx);
   if (err)
     return TRACE_ERR (err);
-  {
-    gpgme_protocol_t proto;
-    gpgme_engine_info_t info;
-
-    /* Clone the relevant state.  */
-    proto = gpgme_get_protocol (ctx);
-    gpgme_set_protocol (listctx, proto);
-    gpgme_set_keylist_mode (listctx, gpgme_get_keylist_mode (ctx));
-    info = gpgme_ctx_get_engine_info (ctx);
-    while (info && info->protocol != proto)
-      info = info->next;
-    if (info)
-      gpgme_ctx_set_engine_info (listctx, proto,
-				 info->file_name, info->home_dir);
-  }
 
   err = gpgme_op_keylist_start (listctx, fpr, secret);
   if (!err)
@@ -1349,3 +1428,229 @@ gpgme_get_key (gpgme_ctx_t ctx, const char *fpr, gpgme_key_t *r_key,
     }
   return TRACE_ERR (err);
 }
+
+
+
+/* The number of patterns passed to one keylist operation by
+   gpgme_get_keys.  This limits the length of the command line.  */
+#define GET_KEYS_CHUNK 512
+
+/* The state of gpgme_get_keys.  NAMES holds the canonical form of the
+   requested fingerprints and key IDs.  The hash table maps a name to
+   the last slot requested with that name; the other slots with a name
+   of the same hash value are chained via NEXT.  */
+struct get_keys_s
+{
+  gpgme_key_t *keys;
+  char **names;
+  char *ambiguous;
+  int *next;
+  int *table;
+  unsigned int tablesize;
+};
+
+
+static unsigned int
+get_keys_hash (const char *name)
+{
+  unsigned int hash = 2166136261U;
+
+  for (; *name; name++)
+    hash = (hash ^ (unsigned char)*name) * 16777619U;
+  return hash;
+}
+
+
+/* Return a malloced canonical form of the fingerprint or key ID FPR,
+   i.e. without a "0x" prefix or a "!" suffix and in uppercase.  */
+static char *
+get_keys_canon (const char *fpr)
+{
+  char *name, *p;
+
+  if (fpr[0] == '0' && (fpr[1] == 'x' || fpr[1] == 'X'))
+    fpr += 2;
+  name = strdup (fpr);
+  if (!name)
+    return NULL;
+  for (p = name; *p; p++)
+    if (*p >= 'a' && *p <= 'f')
+      *p = *p - 'a' + 'A';
+  if (p > name && p[-1] == '!')
+    p[-1] = 0;
+  return name;
+}
+
+
+/* Store KEY in all slots requested as NAME.  A slot matching keys
+   with different fingerprints is marked as ambiguous and left
+   empty.  */
+static void
+get_keys_store (struct get_keys_s *gk, const char *name, gpgme_key_t key)
+{
+  int idx;
+
+  if (!name)
+    return;
+
+  for (idx = gk->table[get_keys_hash (name) % gk->tablesize];
+       idx != -1; idx = gk->next[idx])
+    {
+      if (gk->ambiguous[idx] || strcmp (gk->names[idx], name))
+        continue;
+      if (!gk->keys[idx])
+        {
+          gpgme_key_ref (key);
+          gk->keys[idx] = key;
+        }
+      else if (gk->keys[idx] != key
+               && strcmp (gk->keys[idx]->subkeys->fpr, key->subkeys->fpr))
+        {
+          gpgme_key_unref (gk->keys[idx]);
+          gk->keys[idx] = NULL;
+          gk->ambiguous[idx] = 1;
+        }
+    }
+}
+
+
+/* Assign KEY as returned by the engine to the requested slots.  */
+static void
+get_keys_assign (struct get_keys_s *gk, gpgme_key_t key)
+{
+  gpgme_subkey_t subkey;
+
+  if (!key->subkeys || !key->subkeys->fpr)
+    return;
+
+  for (subkey = key->subkeys; subkey; subkey = subkey->next)
+    {
+      get_keys_store (gk, subkey->fpr, key);
+      get_keys_store (gk, subkey->keyid, key);
+      if (subkey->keyid && strlen (subkey->keyid) == 16)
+        get_keys_store (gk, subkey->keyid + 8, key);
+    }
+}
+
+
+/* Get the keys with the fingerprints or key IDs given by the NULL
+   terminated array FPRS using a single keylist operation.  R_KEYS
+   must have space for one key per entry of FPRS; the key matching
+   FPRS[i] is stored at R_KEYS[i] or NULL if no unique key was found.
+   Missing keys are not an error.  */
+gpgme_error_t
+gpgme_get_keys (gpgme_ctx_t ctx, const char *fprs[], gpgme_key_t *r_keys,
+                unsigned int flags)
+{
+  gpgme_error_t err = 0;
+  gpgme_ctx_t listctx = NULL;
+  struct get_keys_s gk;
+  key_cache_scope_t scope = NULL;
+  const char **patterns = NULL;
+  gpgme_key_t key;
+  int secret = !!(flags & GPGME_GET_KEYS_SECRET);
+  int nfprs, npatterns, idx, start;
+  unsigned int hash;
+
+  TRACE_BEG  (DEBUG_CTX, "gpgme_get_keys", ctx, "flags=0x%x", flags);
+
+  if (!ctx || !fprs || !r_keys)
+    return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
+
+  for (nfprs = 0; fprs[nfprs]; nfprs++)
+    {
+      r_keys[nfprs] = NULL;
+      if (strlen (fprs[nfprs]) < 8)	/* We need at least a key ID.  */
+        return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
+    }
+  TRACE_LOG  ("nfprs=%d", nfprs);
+  if (!nfprs)
+    return TRACE_ERR (0);
+
+  memset (&gk, 0, sizeof gk);
+  gk.keys = r_keys;
+  gk.tablesize = 2 * nfprs + 1;
+  gk.names = calloc (nfprs, sizeof *gk.names);
+  gk.ambiguous = calloc (nfprs, 1);
+  gk.next = calloc (nfprs, sizeof *gk.next);
+  gk.table = malloc (gk.tablesize * sizeof *gk.table);
+  patterns = calloc (GET_KEYS_CHUNK + 1, sizeof *patterns);
+  if (!gk.names || !gk.ambiguous || !gk.next || !gk.table || !patterns)
+    {
+      err = gpg_error_from_syserror ();
+      goto leave;
+    }
+  for (hash = 0; hash < gk.tablesize; hash++)
+    gk.table[hash] = -1;
+
+  if (ctx->key_cache)
+    {
+      err = _gpgme_key_cache_get_scope (ctx, secret, &scope);
+      if (err)
+        goto leave;
+    }
+
+  npatterns = 0;
+  for (idx = 0; idx < nfprs; idx++)
+    {
+      if (scope && _gpgme_key_cache_lookup (scope, fprs[idx], &r_keys[idx]))
+        continue;
+      gk.names[idx] = get_keys_canon (fprs[idx]);
+      if (!gk.names[idx])
+        {
+          err = gpg_error_from_syserror ();
+          goto leave;
+        }
+      hash = get_keys_hash (gk.names[idx]) % gk.tablesize;
+      gk.next[idx] = gk.table[hash];
+      gk.table[hash] = idx;
+      npatterns++;
+    }
+  TRACE_LOG  ("%d keys from cache", nfprs - npatterns);
+  if (!npatterns)
+    goto leave;
+
+  err = new_list_context (ctx, &listctx);
+  if (err)
+    goto leave;
+
+  for (start = 0; start < nfprs; )
+    {
+      npatterns = 0;
+      for (; start < nfprs && npatterns < GET_KEYS_CHUNK; start++)
+        if (gk.names[start])
+          patterns[npatterns++] = fprs[start];
+      if (!npatterns)
+        break;
+      patterns[npatterns] = NULL;
+
+      err = gpgme_op_keylist_ext_start (listctx, patterns, secret, 0);
+      while (!err && !(err = gpgme_op_keylist_next (listctx, &key)))
+        {
+          get_keys_assign (&gk, key);
+          gpgme_key_unref (key);
+        }
+      if (gpg_err_code (err) != GPG_ERR_EOF)
+        goto leave;
+      err = 0;
+    }
+
+ leave:
+  if (err)
+    for (idx = 0; idx < nfprs; idx++)
+      {
+        gpgme_key_unref (r_keys[idx]);
+        r_keys[idx] = NULL;
+      }
+  gpgme_release (listctx);
+  _gpgme_key_cache_release_scope (scope);
+  if (gk.names)
+    for (idx = 0; idx < nfprs; idx++)
+      free (gk.names[idx]);
+  free (gk.names);
+  free (gk.ambiguous);
+  free (gk.next);
+  free (gk.table);
+  free (patterns);
+  return TRACE_ERR (err);
+}
@@ -154,6 +154,8 @@ keysign_start (gpgme_ctx_t ctx, int synchronous,
   if (ctx->protocol != GPGME_PROTOCOL_OPENPGP)
     return gpgme_error (GPG_ERR_UNSUPPORTED_PROTOCOL);
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
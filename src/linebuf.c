@@ -0,0 +1,117 @@
+/* linebuf.c - Split engine output into lines.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifdef HAVE_CONFIG_H
+# include <config.h>
+#endif
+#include <stdlib.h>
+#include <string.h>
+
+#include "linebuf.h"
+
+
+gpgme_error_t
+_gpgme_linebuf_init (linebuf_t lb, size_t size)
+{
+  lb->size = lb->start = lb->end = lb->scanned = 0;
+  lb->buffer = malloc (size);
+  if (!lb->buffer)
+    return gpg_error_from_syserror ();
+  lb->size = size;
+  return 0;
+}
+
+
+void
+_gpgme_linebuf_release (linebuf_t lb)
+{
+  free (lb->buffer);
+  lb->buffer = NULL;
+  lb->size = lb->start = lb->end = lb->scanned = 0;
+}
+
+
+gpgme_error_t
+_gpgme_linebuf_reserve (linebuf_t lb, size_t minspace, size_t maxsize,
+                        char **r_space, size_t *r_len)
+{
+  if (lb->start == lb->end)
+    lb->start = lb->end = lb->scanned = 0;
+  else if (lb->size - lb->end < minspace && lb->start)
+    {
+      /* Move the incomplete line to the start of the buffer.  */
+      memmove (lb->buffer, lb->buffer + lb->start, lb->end - lb->start);
+      lb->end -= lb->start;
+      lb->scanned -= lb->start;
+      lb->start = 0;
+    }
+
+  if (lb->size - lb->end < minspace)
+    {
+      size_t newsize = lb->size? lb->size : 256;
+      char *newbuffer;
+
+      while (newsize - lb->end < minspace)
+        newsize *= 2;
+      if (maxsize && newsize > maxsize)
+        {
+          if (maxsize - lb->end < minspace)
+            return gpg_error (GPG_ERR_LINE_TOO_LONG);
+          newsize = maxsize;
+        }
+      newbuffer = realloc (lb->buffer, newsize);
+      if (!newbuffer)
+        return gpg_error_from_syserror ();
+      lb->buffer = newbuffer;
+      lb->size = newsize;
+    }
+
+  *r_space = lb->buffer + lb->end;
+  *r_len = lb->size - lb->end;
+  return 0;
+}
+
+
+void
+_gpgme_linebuf_commit (linebuf_t lb, size_t n)
+{
+  lb->end += n;
+}
+
+
+char *
+_gpgme_linebuf_getline (linebuf_t lb, size_t *r_len)
+{
+  char *line, *p;
+
+  p = memchr (lb->buffer + lb->scanned, '\n', lb->end - lb->scanned);
+  if (!p)
+    {
+      lb->scanned = lb->end;
+      return NULL;
+    }
+
+  *p = 0;
+  line = lb->buffer + lb->start;
+  if (r_len)
+    *r_len = p - line;
+  lb->start = lb->scanned = p + 1 - lb->buffer;
+  return line;
+}
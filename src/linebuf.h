@@ -0,0 +1,75 @@
+/* linebuf.h - Split engine output into lines.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef LINEBUF_H
+#define LINEBUF_H
+
+#include <stddef.h>
+
+#include "gpgme.h"
+
+
+/* A buffer used to split the output of an engine into lines.  New
+   data is read into the free space at the end of the buffer and the
+   complete lines are returned in place.  The unprocessed rest is only
+   moved to the start of the buffer if the free space at the end runs
+   short.  */
+struct linebuf_s
+{
+  char *buffer;
+  size_t size;     /* The allocated size of BUFFER.  */
+  size_t start;    /* Offset of the first byte not yet returned.  */
+  size_t end;      /* Offset after the last valid byte.  */
+  size_t scanned;  /* Offset up to which there is no LF.  */
+};
+typedef struct linebuf_s *linebuf_t;
+
+
+/*-- linebuf.c --*/
+
+/* Initialize LB with a buffer of SIZE bytes.  */
+gpgme_error_t _gpgme_linebuf_init (linebuf_t lb, size_t size);
+
+/* Release the buffer of LB.  LB may be reinitialized afterwards.  */
+void _gpgme_linebuf_release (linebuf_t lb);
+
+/* Make sure that at least MINSPACE bytes can be appended to LB and
+   return the free space in R_SPACE and its length in R_LEN.  The
+   buffer is not grown beyond MAXSIZE bytes unless MAXSIZE is 0;
+   GPG_ERR_LINE_TOO_LONG is returned if that would be required.  */
+gpgme_error_t _gpgme_linebuf_reserve (linebuf_t lb, size_t minspace,
+                                      size_t maxsize,
+                                      char **r_space, size_t *r_len);
+
+/* Declare that N bytes have been stored at the space returned by
+   _gpgme_linebuf_reserve.  */
+void _gpgme_linebuf_commit (linebuf_t lb, size_t n);
+
+/* Return the next complete line of LB or NULL if there is none.  The
+   terminating LF is replaced by a Nul and the length of the line
+   without the LF is stored at R_LEN if it is not NULL.  The returned
+   line is valid until the next call to _gpgme_linebuf_reserve.  */
+char *_gpgme_linebuf_getline (linebuf_t lb, size_t *r_len);
+
+/* Return the number of bytes of LB which have not been returned.  */
+#define _gpgme_linebuf_pending(lb) ((lb)->end - (lb)->start)
+
+
+#endif /*LINEBUF_H*/
@@ -0,0 +1,327 @@
+/* mkstatus.c - Tool to create status-table.h
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is free software; as a special exception the author gives
+ * unlimited permission to copy and/or distribute it, with or without
+ * modifications, as long as this notice is preserved.
+ *
+ * This file is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY, to the extent permitted by law; without even the
+ * implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.
+ */
+
+/* This tool reads the status table from status-table.c and writes a
+   perfect hash for the keywords to stdout.  The output defines the
+   hash function status_hash, the character positions it uses, and
+   the table status_hash_index which maps the hash of each keyword to
+   its index in the status table plus one; unused slots are zero.
+
+   Like gperf the hash uses only the length of a keyword and the
+   characters at a few positions which are selected so that all
+   keywords are distinct.  The tool then tries seeds until there are
+   no collisions and doubles the size of the table if no seed works.
+
+   The tool is run on the build platform and must thus not use
+   anything from GPGME.  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PGM "mkstatus"
+
+/* The maximum number of keywords.  The indices are stored in an
+   unsigned char.  */
+#define MAX_KEYWORDS 254
+
+/* The maximum number of character positions used by the hash.  */
+#define MAX_POSITIONS 8
+
+
+static char *keywords[MAX_KEYWORDS];
+static int nkeywords;
+
+/* The positions of the characters used by the hash function.  A
+   negative position counts from the end of the keyword.  */
+static int positions[MAX_POSITIONS];
+static int npositions;
+
+
+/* The hash function.  It is emitted verbatim into the output; keep
+   the code and the string in sync.  The seed, an odd multiplier,
+   spreads the bits so that the BITS high bits of the product can be
+   used as the slot.  */
+static unsigned int
+status_hash (const char *name, unsigned int seed, unsigned int bits)
+{
+  int len = strlen (name);
+  unsigned int h = len;
+  int i, pos;
+
+  for (i = 0; i < npositions; i++)
+    {
+      pos = positions[i];
+      if (pos < 0)
+        pos += len;
+      h = ((h << 7) | (h >> 25)) & 0xffffffff;
+      if (pos >= 0 && pos < len)
+        h ^= (unsigned char)name[pos];
+    }
+  return ((h * seed) & 0xffffffff) >> (32 - bits);
+}
+
+static const char status_hash_code[] =
+  "static unsigned int\n"
+  "status_hash (const char *name, unsigned int seed, unsigned int bits)\n"
+  "{\n"
+  "  int len = strlen (name);\n"
+  "  unsigned int h = len;\n"
+  "  int i, pos;\n"
+  "\n"
+  "  for (i = 0; i < STATUS_HASH_NPOSITIONS; i++)\n"
+  "    {\n"
+  "      pos = status_hash_positions[i];\n"
+  "      if (pos < 0)\n"
+  "        pos += len;\n"
+  "      h = ((h << 7) | (h >> 25)) & 0xffffffff;\n"
+  "      if (pos >= 0 && pos < len)\n"
+  "        h ^= (unsigned char)name[pos];\n"
+  "    }\n"
+  "  return ((h * seed) & 0xffffffff) >> (32 - bits);\n"
+  "}\n";
+
+
+/* Read the keywords from the table in FNAME.  Each line of the table
+   starts with '{ "' followed by the keyword; the table ends at the
+   line with the NULL entry.  */
+static void
+read_keywords (const char *fname)
+{
+  FILE *fp;
+  char line[256];
+  char *p, *end;
+  int in_table = 0;
+  int lnr = 0;
+
+  fp = fopen (fname, "r");
+  if (!fp)
+    {
+      fprintf (stderr, PGM ": can't open '%s'\n", fname);
+      exit (1);
+    }
+  while (fgets (line, sizeof line, fp))
+    {
+      lnr++;
+      if (!in_table)
+        {
+          if (strstr (line, " status_table[] ="))
+            in_table = 1;
+          continue;
+        }
+      for (p = line; *p == ' ' || *p == '\t'; p++)
+        ;
+      if (!strncmp (p, "{NULL", 5) || !strncmp (p, "{ NULL", 6))
+        break;
+      if (strncmp (p, "{ \"", 3))
+        continue;
+      p += 3;
+      end = strchr (p, '\"');
+      if (!end || end == p)
+        {
+          fprintf (stderr, PGM ": %s:%d: invalid table entry\n", fname, lnr);
+          exit (1);
+        }
+      *end = 0;
+      if (nkeywords == MAX_KEYWORDS)
+        {
+          fprintf (stderr, PGM ": %s: too many keywords\n", fname);
+          exit (1);
+        }
+      keywords[nkeywords] = strdup (p);
+      if (!keywords[nkeywords])
+        {
+          fputs (PGM ": out of core\n", stderr);
+          exit (1);
+        }
+      nkeywords++;
+    }
+  if (ferror (fp) || !in_table || !nkeywords)
+    {
+      fprintf (stderr, PGM ": %s: status table not found\n", fname);
+      exit (1);
+    }
+  fclose (fp);
+}
+
+
+/* Return the character at position POS of the keyword NAME of
+   length LEN or 0 if there is no such character.  */
+static int
+char_at (const char *name, int len, int pos)
+{
+  if (pos < 0)
+    pos += len;
+  return (pos >= 0 && pos < len)? (unsigned char)name[pos] : 0;
+}
+
+
+/* Return the number of keywords which can be told apart by their
+   length and the characters at the positions POS[0..NPOS-1].  */
+static int
+count_distinct (const int *pos, int npos)
+{
+  int i, j, k, len;
+  int distinct = 0;
+
+  for (i = 0; i < nkeywords; i++)
+    {
+      len = strlen (keywords[i]);
+      for (j = 0; j < nkeywords; j++)
+        {
+          if (j == i || (int)strlen (keywords[j]) != len)
+            continue;
+          for (k = 0; k < npos; k++)
+            if (char_at (keywords[i], len, pos[k])
+                != char_at (keywords[j], len, pos[k]))
+              break;
+          if (k == npos)
+            break;  /* Keyword J looks the same.  */
+        }
+      if (j == nkeywords)
+        distinct++;
+    }
+  return distinct;
+}
+
+
+/* Select the character positions for the hash function by greedily
+   adding the position which tells apart the most keywords.  */
+static void
+select_positions (void)
+{
+  static const int candidates[] =
+    { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15,
+      -1, -2, -3, -4, -5, -6, -7, -8 };
+  int n, best, best_n;
+  size_t i;
+
+  while (count_distinct (positions, npositions) < nkeywords)
+    {
+      if (npositions == MAX_POSITIONS)
+        {
+          fputs (PGM ": keywords can't be told apart\n", stderr);
+          exit (1);
+        }
+      best = 0;
+      best_n = -1;
+      for (i = 0; i < sizeof candidates / sizeof *candidates; i++)
+        {
+          positions[npositions] = candidates[i];
+          n = count_distinct (positions, npositions + 1);
+          if (n > best_n)
+            {
+              best = candidates[i];
+              best_n = n;
+            }
+        }
+      positions[npositions++] = best;
+    }
+}
+
+
+/* Try to find a seed which maps all keywords to distinct slots of
+   INDEX, a table with 2^BITS entries.  Returns true on success.  */
+static int
+find_seed (unsigned char *index, unsigned int bits, unsigned int *r_seed)
+{
+  unsigned int n, seed, slot;
+  int i;
+
+  for (n = 0; n < 200000; n++)
+    {
+      seed = ((n * 2654435761U) & 0xffffffff) | 1;
+      memset (index, 0, 1U << bits);
+      for (i = 0; i < nkeywords; i++)
+        {
+          slot = status_hash (keywords[i], seed, bits);
+          if (index[slot])
+            break;
+          index[slot] = i + 1;
+        }
+      if (i == nkeywords)
+        {
+          *r_seed = seed;
+          return 1;
+        }
+    }
+  return 0;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  unsigned char *index = NULL;
+  unsigned int bits, size, seed, i;
+
+  if (argc != 2)
+    {
+      fputs ("usage: " PGM " status-table.c\n", stderr);
+      return 1;
+    }
+  read_keywords (argv[1]);
+  select_positions ();
+
+  for (bits = 6; (1U << bits) < 2 * (unsigned int)nkeywords; bits++)
+    ;
+  for (;; bits++)
+    {
+      size = 1U << bits;
+      free (index);
+      index = malloc (size);
+      if (!index)
+        {
+          fputs (PGM ": out of core\n", stderr);
+          return 1;
+        }
+      if (find_seed (index, bits, &seed))
+        break;
+      if (bits >= 16)
+        {
+          fputs (PGM ": no perfect hash found\n", stderr);
+          return 1;
+        }
+    }
+
+  printf ("/* Generated by mkstatus from status-table.c - DO NOT EDIT.  */\n"
+          "\n"
+          "#define STATUS_HASH_NKEYWORDS %d\n"
+          "#define STATUS_HASH_SEED %uU\n"
+          "#define STATUS_HASH_BITS %u\n"
+          "#define STATUS_HASH_NPOSITIONS %d\n"
+          "\n"
+          "static const int status_hash_positions[STATUS_HASH_NPOSITIONS] =\n"
+          "  {", nkeywords, seed, bits, npositions);
+  for (i = 0; i < (unsigned int)npositions; i++)
+    printf (" %d%s", positions[i],
+            i + 1 < (unsigned int)npositions? "," : "");
+  fputs (" };\n\n", stdout);
+  fputs (status_hash_code, stdout);
+  printf ("\n"
+          "static const unsigned char status_hash_index[1 << %u] =\n"
+          "  {", bits);
+  for (i = 0; i < size; i++)
+    printf ("%s%3u%s", (i % 12)? " " : "\n    ", index[i],
+            i + 1 < size? "," : "");
+  fputs ("\n  };\n", stdout);
+
+  if (fflush (stdout) || ferror (stdout))
+    {
+      fputs (PGM ": error writing output\n", stderr);
+      return 1;
+    }
+  free (index);
+  for (i = 0; i < (unsigned int)nkeywords; i++)
+    free (keywords[i]);
+  return 0;
+}
@@ -42,12 +42,10 @@ _gpgme_op_data_lookup (gpgme_ctx_t ctx, ctx_op_data_id_t type, void **hook,
 {
   struct ctx_op_data *data;
 
-  if (!ctx)
+  if (!ctx || (unsigned int)type >= OPDATA_COUNT)
     return gpg_error (GPG_ERR_INV_VALUE);
 
-  data = ctx->op_data;
-  while (data && data->type != type)
-    data = data->next;
+  data = ctx->op_data[type];
   if (!data)
     {
       if (size < 0)
@@ -56,16 +54,24 @@ _gpgme_op_data_lookup (gpgme_ctx_t ctx, ctx_op_data_id_t type, void **hook,
 	  return 0;
 	}
 
-      data = calloc (1, sizeof (struct ctx_op_data) + size);
-      if (!data)
-	return gpg_error_from_syserror ();
+      /* Reuse the memory of the last operation of this type.  It has
+         already been cleaned up and zeroed by _gpgme_release_result.  */
+      data = ctx->op_data_spare[type];
+      if (data && data->size == size)
+        ctx->op_data_spare[type] = NULL;
+      else
+        {
+          data = calloc (1, sizeof (struct ctx_op_data) + size);
+          if (!data)
+            return gpg_error_from_syserror ();
+        }
       data->magic = CTX_OP_DATA_MAGIC;
-      data->next = ctx->op_data;
       data->type = type;
       data->cleanup = cleanup;
       data->hook = (void *) (((char *) data) + sizeof (struct ctx_op_data));
       data->references = 1;
-      ctx->op_data = data;
+      data->size = size;
+      ctx->op_data[type] = data;
     }
   *hook = data->hook;
   return 0;
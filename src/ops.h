@@ -40,6 +40,9 @@ gpgme_error_t _gpgme_wait_one (gpgme_ctx_t ctx);
 gpgme_error_t _gpgme_wait_one_ext (gpgme_ctx_t ctx, gpgme_error_t *op_err);
 gpgme_error_t _gpgme_wait_on_condition (gpgme_ctx_t ctx, volatile int *cond,
 					gpgme_error_t *op_err);
+int _gpgme_wait_on_any (gpgme_ctx_t ctx,
+                        gpgme_ctx_t *ctxs, unsigned int nctxs,
+                        gpgme_error_t *r_err, gpgme_error_t *r_op_err);
 
 
 /* From data.c.  */
@@ -140,11 +143,16 @@ gpgme_error_t _gpgme_progress_status_handler (void *priv,
 
 /* From key.c.  */
 gpgme_error_t _gpgme_key_new (gpgme_key_t *r_key);
+void *_gpgme_key_alloc (gpgme_key_t key, size_t size);
+char *_gpgme_key_strdup (gpgme_key_t key, const char *string);
+void _gpgme_key_alloc_stats (gpgme_key_t key, unsigned int *r_nobjects,
+                             unsigned int *r_nchunks);
 gpgme_error_t _gpgme_key_add_subkey (gpgme_key_t key,
 				     gpgme_subkey_t *r_subkey);
 gpgme_error_t _gpgme_key_append_name (gpgme_key_t key,
                                       const char *src, int convert);
 gpgme_key_sig_t _gpgme_key_add_sig (gpgme_key_t key, char *src);
+gpgme_error_t _gpgme_key_copy (gpgme_key_t key, gpgme_key_t *r_copy);
 
 
 
@@ -152,6 +160,28 @@ gpgme_key_sig_t _gpgme_key_add_sig (gpgme_key_t key, char *src);
 void _gpgme_op_keylist_event_cb (void *data, gpgme_event_io_t type,
 				 void *type_data);
 
+
+/* From keycache.c.  */
+
+/* The scope of keys listed by a context.  */
+typedef struct key_cache_scope_s *key_cache_scope_t;
+
+/* Get the current scope for listing keys on CTX or NULL if the key
+   cache is not used.  */
+gpgme_error_t _gpgme_key_cache_get_scope (gpgme_ctx_t ctx, int secret,
+                                          key_cache_scope_t *r_scope);
+void _gpgme_key_cache_release_scope (key_cache_scope_t scope);
+
+/* Look up the key with the fingerprint, key ID or keygrip NAME.  */
+int _gpgme_key_cache_lookup (key_cache_scope_t scope, const char *name,
+                             gpgme_key_t *r_key);
+
+/* Add a key listed in SCOPE to the cache.  */
+void _gpgme_key_cache_put (key_cache_scope_t scope, gpgme_key_t key);
+
+/* Flush the cache.  */
+void _gpgme_key_cache_invalidate (void);
+
 
 /* From trust-item.c.  */
 
@@ -187,8 +217,10 @@ gpgme_error_t _gpgme_sig_notation_create (gpgme_sig_notation_t *notationp,
 void _gpgme_sig_notation_free (gpgme_sig_notation_t notation);
 
 /* Parse a notation or policy URL subpacket.  If the packet type is
-   not known, return no error but NULL in NOTATION.  */
-gpgme_error_t _gpgme_parse_notation (gpgme_sig_notation_t *notationp,
+   not known, return no error but NULL in NOTATION.  The notation is
+   allocated from the arena of KEY.  */
+gpgme_error_t _gpgme_parse_notation (gpgme_key_t key,
+                                     gpgme_sig_notation_t *notationp,
 				     int type, int pkflags, int len,
 				     char *data);
 
@@ -47,6 +47,18 @@
 #endif
 #include <ctype.h>
 #include <sys/resource.h>
+#ifdef HAVE_POLL_H
+# include <poll.h>
+#endif
+#ifdef HAVE_SYS_EPOLL_H
+# include <sys/epoll.h>
+#endif
+#ifdef HAVE_SPAWN_H
+# include <spawn.h>
+#endif
+#if defined(HAVE_SYS_EVENTFD_H) && defined(HAVE_EVENTFD)
+# include <sys/eventfd.h>
+#endif
 
 #ifdef USE_LINUX_GETDENTS
 # include <sys/syscall.h>
@@ -347,6 +359,26 @@ _gpgme_io_set_nonblocking (int fd)
 }
 
 
+/* Try to change the capacity of the pipe FD to SIZE bytes.  Returns
+   the new capacity or -1 if this is not supported.  */
+int
+_gpgme_io_set_pipe_size (int fd, size_t size)
+{
+  int res;
+  TRACE_BEG (DEBUG_SYSIO, "_gpgme_io_set_pipe_size", NULL,
+             "fd=%d size=%zu", fd, size);
+
+#ifdef F_SETPIPE_SZ
+  res = fcntl (fd, F_SETPIPE_SZ, (int)size);
+#else
+  (void)size;
+  gpg_err_set_errno (ENOSYS);
+  res = -1;
+#endif
+  return TRACE_SYSRES (res);
+}
+
+
 static long int
 get_max_fds (void)
 {
@@ -510,6 +542,176 @@ _gpgme_io_waitpid (int pid, int hang, int *r_status, int *r_signal)
 }
 
 
+/* The processes handed to _gpgme_io_reap which had not yet
+ * terminated.  They are waited for by reap_pending.  */
+DEFINE_STATIC_LOCK (reap_lock);
+static pid_t *reap_pids;
+static size_t reap_count;
+static size_t reap_size;
+
+
+/* Wait without blocking for PID.  Returns true if the process has
+ * terminated or is not our child anymore.  */
+static int
+reap_one (pid_t pid)
+{
+  pid_t ret;
+  int status;
+
+  do
+    ret = _gpgme_ath_waitpid (pid, &status, WNOHANG);
+  while (ret == (pid_t)(-1) && errno == EINTR);
+  return ret == pid || (ret == (pid_t)(-1) && errno == ECHILD);
+}
+
+
+/* Wait for those processes in REAP_PIDS which have terminated.  */
+static void
+reap_pending (void)
+{
+  size_t i;
+
+  LOCK (reap_lock);
+  for (i = 0; i < reap_count; )
+    {
+      if (reap_one (reap_pids[i]))
+        reap_pids[i] = reap_pids[--reap_count];
+      else
+        i++;
+    }
+  UNLOCK (reap_lock);
+}
+
+
+/* Wait for the process PID started with IOSPAWN_FLAG_WAIT without
+ * blocking.  If it is still running, it is waited for again by later
+ * calls of this function and of _gpgme_io_spawn.  */
+void
+_gpgme_io_reap (int pid)
+{
+  pid_t *newpids;
+  size_t newsize;
+
+  reap_pending ();
+  if (pid == -1 || reap_one (pid))
+    return;
+
+  LOCK (reap_lock);
+  if (reap_count == reap_size)
+    {
+      newsize = reap_size? 2 * reap_size : 16;
+      newpids = realloc (reap_pids, newsize * sizeof *newpids);
+      if (!newpids)
+        {
+          UNLOCK (reap_lock);
+          TRACE (DEBUG_SYSIO, "_gpgme_io_reap", NULL,
+                 "out of core - not waiting for pid=%i", pid);
+          return;
+        }
+      reap_pids = newpids;
+      reap_size = newsize;
+    }
+  reap_pids[reap_count++] = pid;
+  UNLOCK (reap_lock);
+}
+
+
+#if defined(HAVE_SPAWN_H) && defined(HAVE_POSIX_SPAWN) \
+  && defined(HAVE_POSIX_SPAWN_FILE_ACTIONS_ADDCLOSEFROM_NP)
+# define USE_POSIX_SPAWN 1
+
+extern char **environ;
+
+/* Start the program PATH with the arguments ARGV and the file
+ * descriptors of FD_LIST using posix_spawn.  Unlike fork, which
+ * copies the page tables of the caller, posix_spawn uses vfork or
+ * clone(CLONE_VM|CLONE_VFORK) and thus takes the same time however
+ * large the calling process is.  The file descriptors are set up
+ * with the same steps as in the forked child of _gpgme_io_spawn.
+ * The process is a direct child which the caller needs to wait for.
+ * Returns 0 on success.  */
+static int
+spawn_process (const char *path, char *const argv[],
+               struct spawn_fd_item_s *fd_list, pid_t *r_pid)
+{
+  posix_spawn_file_actions_t actions;
+  int seen_stdin = 0;
+  int seen_stdout = 0;
+  int seen_stderr = 0;
+  int max_fd = -1;
+  int child_fd;
+  int fd, i;
+  int rc;
+  pid_t pid;
+
+  if (posix_spawn_file_actions_init (&actions))
+    return -1;
+
+  /* First close all fds which will not be inherited.  */
+  for (i = 0; fd_list[i].fd != -1; i++)
+    if (fd_list[i].fd > max_fd)
+      max_fd = fd_list[i].fd;
+  rc = posix_spawn_file_actions_addclosefrom_np (&actions, max_fd + 1);
+  for (fd = 0; !rc && fd < max_fd; fd++)
+    {
+      for (i = 0; fd_list[i].fd != -1; i++)
+        if (fd_list[i].fd == fd)
+          break;
+      if (fd_list[i].fd == -1)
+        rc = posix_spawn_file_actions_addclose (&actions, fd);
+    }
+
+  /* And now dup and close those to be duplicated.  */
+  for (i = 0; !rc && fd_list[i].fd != -1; i++)
+    {
+      if (fd_list[i].dup_to != -1)
+        child_fd = fd_list[i].dup_to;
+      else
+        child_fd = fd_list[i].fd;
+
+      if (child_fd == 0)
+        seen_stdin = 1;
+      else if (child_fd == 1)
+        seen_stdout = 1;
+      else if (child_fd == 2)
+        seen_stderr = 1;
+
+      if (fd_list[i].dup_to == -1)
+        continue;
+
+      rc = posix_spawn_file_actions_adddup2 (&actions, fd_list[i].fd,
+                                             fd_list[i].dup_to);
+      if (!rc && fd_list[i].fd != fd_list[i].dup_to)
+        rc = posix_spawn_file_actions_addclose (&actions, fd_list[i].fd);
+    }
+
+  /* Make sure that the process has connected stdin, stdout and
+   * stderr.  */
+  if (!rc && !seen_stdin)
+    rc = posix_spawn_file_actions_addopen (&actions, 0, "/dev/null",
+                                           O_RDWR, 0);
+  if (!rc && !seen_stdout)
+    rc = posix_spawn_file_actions_addopen (&actions, 1, "/dev/null",
+                                           O_RDWR, 0);
+  if (!rc && !seen_stderr)
+    rc = posix_spawn_file_actions_addopen (&actions, 2, "/dev/null",
+                                           O_RDWR, 0);
+
+  if (!rc)
+    rc = posix_spawn (&pid, path, &actions, NULL, argv, environ);
+  posix_spawn_file_actions_destroy (&actions);
+  if (rc)
+    {
+      errno = rc;
+      return -1;
+    }
+
+  *r_pid = pid;
+  return 0;
+}
+#endif /*USE_POSIX_SPAWN*/
+
+
 /* Returns 0 on success, -1 on error.  */
 int
 _gpgme_io_spawn (const char *path, char *const argv[], unsigned int flags,
@@ -538,14 +740,33 @@ _gpgme_io_spawn (const char *path, char *const argv[], unsigned int flags,
         TRACE_LOG  ("fd[%i] = 0x%x -> 0x%x", i,fd_list[i].fd,fd_list[i].dup_to);
     }
 
+  /* A detached process is never waited for.  */
+  if ((flags & IOSPAWN_FLAG_DETACHED))
+    flags &= ~IOSPAWN_FLAG_WAIT;
+
+  reap_pending ();
+
+#ifdef USE_POSIX_SPAWN
+  /* Only a process the caller waits for may be a direct child.  An
+   * ATFORK function needs to run code in the child; only the fork
+   * based code below can do that.  */
+  if ((flags & IOSPAWN_FLAG_WAIT) && !atfork)
+    {
+      if (spawn_process (path, argv, fd_list, &pid))
+        return TRACE_SYSRES (-1);
+      goto leave;
+    }
+#endif /*USE_POSIX_SPAWN*/
+
   pid = fork ();
   if (pid == -1)
     return TRACE_SYSRES (-1);
 
   if (!pid)
     {
-      /* Intermediate child to prevent zombie processes.  */
-      if ((pid = fork ()) == 0)
+      /* Intermediate child to prevent zombie processes.  Not needed
+       * if the caller waits for the process.  */
+      if ((flags & IOSPAWN_FLAG_WAIT) || (pid = fork ()) == 0)
 	{
 	  /* Child.  */
           int max_fds = -1;
@@ -669,11 +890,17 @@ _gpgme_io_spawn (const char *path, char *const argv[], unsigned int flags,
 	_exit (0);
     }
 
-  TRACE_LOG  ("waiting for child process pid=%i", pid);
-  _gpgme_io_waitpid (pid, 1, &status, &signo);
-  if (status)
-    return TRACE_SYSRES (-1);
+  if (!(flags & IOSPAWN_FLAG_WAIT))
+    {
+      TRACE_LOG  ("waiting for child process pid=%i", pid);
+      _gpgme_io_waitpid (pid, 1, &status, &signo);
+      if (status)
+        return TRACE_SYSRES (-1);
+    }
 
+#ifdef USE_POSIX_SPAWN
+ leave:
+#endif
   for (i = 0; fd_list[i].fd != -1; i++)
     {
       if (! (flags & IOSPAWN_FLAG_NOCLOSE))
@@ -691,6 +918,115 @@ _gpgme_io_spawn (const char *path, char *const argv[], unsigned int flags,
 
 /* Select on the list of fds.  Returns: -1 = error, 0 = timeout or
    nothing to select, > 0 = number of signaled fds.  */
+#ifdef HAVE_POLL
+/* Number of entries for which _gpgme_io_select uses a stack buffer.  */
+#define IO_SELECT_STACK_FDS 32
+
+/* Select on the list of fds.  Unlike select(2), poll(2) has no limit
+   on the value of a file descriptor and its cost depends only on the
+   number of entries in FDS.  Returns -1 on error, 0 on timeout, or
+   the number of signaled fds.  */
+int
+_gpgme_io_select (struct io_select_fd_s *fds, size_t nfds, int nonblock)
+{
+  struct pollfd pfd_buffer[IO_SELECT_STACK_FDS];
+  struct pollfd *pfd;
+  unsigned int i;
+  int any;
+  int count;
+  int saved_errno;
+  void *dbg_help = NULL;
+  TRACE_BEG  (DEBUG_SYSIO, "_gpgme_io_select", NULL,
+	      "nfds=%zu, nonblock=%u", nfds, nonblock);
+
+  if (nfds <= IO_SELECT_STACK_FDS)
+    pfd = pfd_buffer;
+  else
+    {
+      pfd = malloc (nfds * sizeof *pfd);
+      if (!pfd)
+        return TRACE_SYSRES (-1);
+    }
+
+  TRACE_SEQ (dbg_help, "select on [ ");
+
+  any = 0;
+  for (i = 0; i < nfds; i++)
+    {
+      /* Negative fds are ignored by poll, thus we keep the indices of
+         PFD and FDS in sync.  */
+      pfd[i].fd = -1;
+      pfd[i].events = 0;
+      pfd[i].revents = 0;
+      fds[i].signaled = 0;
+      if (fds[i].fd == -1)
+	continue;
+      if (fds[i].for_read)
+	{
+          pfd[i].fd = fds[i].fd;
+          pfd[i].events = POLLIN;
+	  TRACE_ADD1 (dbg_help, "r=%d ", fds[i].fd);
+          any = 1;
+        }
+      else if (fds[i].for_write)
+	{
+          pfd[i].fd = fds[i].fd;
+          pfd[i].events = POLLOUT;
+	  TRACE_ADD1 (dbg_help, "w=%d ", fds[i].fd);
+	  any = 1;
+        }
+    }
+  TRACE_END (dbg_help, "]");
+  if (!any)
+    {
+      if (pfd != pfd_buffer)
+        free (pfd);
+      return TRACE_SYSRES (0);
+    }
+
+  do
+    {
+      count = _gpgme_ath_poll (pfd, nfds, nonblock ? 0 : 1000);
+    }
+  while (count < 0 && errno == EINTR);
+  if (count < 0)
+    {
+      saved_errno = errno;
+      if (pfd != pfd_buffer)
+        free (pfd);
+      errno = saved_errno;
+      return TRACE_SYSRES (-1);
+    }
+
+  /* A hangup or error condition is reported as readiness, as select
+     does; the following read or write returns the actual condition.
+     An invalid fd is however an error like with select.  */
+  TRACE_SEQ (dbg_help, "select OK [ ");
+  for (count = 0, i = 0; i < nfds; i++)
+    {
+      if (!pfd[i].revents)
+        continue;
+      if ((pfd[i].revents & POLLNVAL))
+        {
+          TRACE_END (dbg_help, " -BAD- ]");
+          if (pfd != pfd_buffer)
+            free (pfd);
+          gpg_err_set_errno (EBADF);
+          return TRACE_SYSRES (-1);
+        }
+      fds[i].signaled = 1;
+      count++;
+      TRACE_ADD2 (dbg_help, "%c=%d ", fds[i].for_read? 'r':'w', fds[i].fd);
+    }
+  TRACE_END (dbg_help, "]");
+
+  if (pfd != pfd_buffer)
+    free (pfd);
+  return TRACE_SYSRES (count);
+}
+
+#else /*!HAVE_POLL*/
+
 int
 _gpgme_io_select (struct io_select_fd_s *fds, size_t nfds, int nonblock)
 {
@@ -804,6 +1140,400 @@ _gpgme_io_select (struct io_select_fd_s *fds, size_t nfds, int nonblock)
 }
 
 
+#endif /*!HAVE_POLL*/
+
+
+#ifdef HAVE_EPOLL_CREATE1
+/* A persistent select set backed by epoll.  The index into the
+   caller's io_select_fd_s array is stored with each registration, so
+   that waiting needs neither to rebuild the interest set nor to scan
+   the array.  */
+struct io_select_set_s
+{
+  int epfd;
+
+  /* The buffer for epoll_wait and its allocated length.  */
+  struct epoll_event *events;
+  int nevents;
+
+  /* The number of registered fds.  */
+  int count;
+
+  /* The registered wakeup fd or -1.  */
+  int wakeup_fd;
+};
+
+/* The index under which the wakeup fd is registered.  */
+#define IO_SELECT_SET_WAKEUP 0xffffffffU
+
+
+int
+_gpgme_io_select_set_new (io_select_set_t *r_set)
+{
+  io_select_set_t set;
+  TRACE_BEG  (DEBUG_SYSIO, "_gpgme_io_select_set_new", r_set, "");
+
+  set = calloc (1, sizeof *set);
+  if (!set)
+    return TRACE_SYSRES (-1);
+  set->wakeup_fd = -1;
+
+  set->epfd = epoll_create1 (EPOLL_CLOEXEC);
+  if (set->epfd == -1)
+    {
+      int saved_errno = errno;
+      free (set);
+      errno = saved_errno;
+      return TRACE_SYSRES (-1);
+    }
+
+  *r_set = set;
+  TRACE_SUC ("set=%p epfd=%d", set, set->epfd);
+  return 0;
+}
+
+
+void
+_gpgme_io_select_set_release (io_select_set_t set)
+{
+  TRACE (DEBUG_SYSIO, "_gpgme_io_select_set_release", set, "");
+
+  if (!set)
+    return;
+  close (set->epfd);
+  free (set->events);
+  free (set);
+}
+
+
+int
+_gpgme_io_select_set_add (io_select_set_t set,
+                          struct io_select_fd_s *fds, int idx)
+{
+  struct epoll_event ev;
+  TRACE_BEG  (DEBUG_SYSIO, "_gpgme_io_select_set_add", set,
+	      "fd=%d idx=%d r=%d w=%d", fds[idx].fd, idx,
+              fds[idx].for_read, fds[idx].for_write);
+
+  if (set->count == set->nevents)
+    {
+      struct epoll_event *new_events;
+      int new_nevents = set->nevents? 2 * set->nevents : 8;
+
+      new_events = realloc (set->events, new_nevents * sizeof *new_events);
+      if (!new_events)
+        return TRACE_SYSRES (-1);
+      set->events = new_events;
+      set->nevents = new_nevents;
+    }
+
+  memset (&ev, 0, sizeof ev);
+  ev.events = fds[idx].for_read? EPOLLIN : EPOLLOUT;
+  ev.data.u32 = idx;
+  if (epoll_ctl (set->epfd, EPOLL_CTL_ADD, fds[idx].fd, &ev))
+    return TRACE_SYSRES (-1);
+
+  set->count++;
+  return TRACE_SYSRES (0);
+}
+
+
+int
+_gpgme_io_select_set_del (io_select_set_t set,
+                          struct io_select_fd_s *fds, int idx)
+{
+  struct epoll_event ev;
+  TRACE_BEG  (DEBUG_SYSIO, "_gpgme_io_select_set_del", set,
+	      "fd=%d idx=%d", fds[idx].fd, idx);
+
+  /* An fd which has already been closed is no longer registered.  */
+  memset (&ev, 0, sizeof ev);
+  if (epoll_ctl (set->epfd, EPOLL_CTL_DEL, fds[idx].fd, &ev)
+      && errno != EBADF && errno != ENOENT)
+    return TRACE_SYSRES (-1);
+
+  set->count--;
+  return TRACE_SYSRES (0);
+}
+
+
+int
+_gpgme_io_select_set_add_wakeup (io_select_set_t set, int fd)
+{
+  struct epoll_event ev;
+  TRACE_BEG  (DEBUG_SYSIO, "_gpgme_io_select_set_add_wakeup", set,
+	      "fd=%d", fd);
+
+  memset (&ev, 0, sizeof ev);
+  ev.events = EPOLLIN;
+  ev.data.u32 = IO_SELECT_SET_WAKEUP;
+  if (epoll_ctl (set->epfd, EPOLL_CTL_ADD, fd, &ev))
+    return TRACE_SYSRES (-1);
+
+  set->wakeup_fd = fd;
+  return TRACE_SYSRES (0);
+}
+
+
+/* Wait on the fds registered with SET and mark those which are ready
+   in FDS, which must be the array used for registration and of
+   length NFDS.  Returns -1 on error, 0 on timeout, or the number of
+   signaled fds.  */
+int
+_gpgme_io_select_set_wait (io_select_set_t set,
+                           struct io_select_fd_s *fds, size_t nfds,
+                           int nonblock)
+{
+  int nev;
+  int count;
+  int i;
+  unsigned int idx;
+  void *dbg_help = NULL;
+  TRACE_BEG  (DEBUG_SYSIO, "_gpgme_io_select_set_wait", set,
+	      "nfds=%zu, registered=%d, nonblock=%u",
+              nfds, set->count, nonblock);
+
+  if (!set->count)
+    return TRACE_SYSRES (0);
+
+  do
+    {
+      nev = epoll_wait (set->epfd, set->events, set->nevents,
+                        nonblock ? 0 : 1000);
+    }
+  while (nev < 0 && errno == EINTR);
+  if (nev < 0)
+    return TRACE_SYSRES (-1);
+
+  /* As with select, hangup and error conditions are reported as
+     readiness.  */
+  TRACE_SEQ (dbg_help, "select OK [ ");
+  for (count = 0, i = 0; i < nev; i++)
+    {
+      idx = set->events[i].data.u32;
+      if (idx == IO_SELECT_SET_WAKEUP)
+        {
+          _gpgme_io_wakeup_clear (set->wakeup_fd);
+          continue;
+        }
+      if (idx >= nfds || fds[idx].fd == -1)
+        continue;
+      fds[idx].signaled = 1;
+      count++;
+      TRACE_ADD2 (dbg_help, "%c=%d ",
+                  fds[idx].for_read? 'r':'w', fds[idx].fd);
+    }
+  TRACE_END (dbg_help, "]");
+
+  return TRACE_SYSRES (count);
+}
+
+
+/* Wait on the fds registered with SET and store the indices of up to
+   NREADY (at most IO_SELECT_SET_POLL_MAX) ready fds in READY.
+   Returns -1 on error, 0 on timeout, or the number of stored
+   indices.  */
+int
+_gpgme_io_select_set_poll (io_select_set_t set, int *ready, int nready,
+                           int nonblock)
+{
+  struct epoll_event events[IO_SELECT_SET_POLL_MAX];
+  int nev;
+  int i;
+  TRACE_BEG  (DEBUG_SYSIO, "_gpgme_io_select_set_poll", set,
+	      "nready=%d, nonblock=%u", nready, nonblock);
+
+  if (nready > IO_SELECT_SET_POLL_MAX)
+    nready = IO_SELECT_SET_POLL_MAX;
+
+  do
+    {
+      nev = epoll_wait (set->epfd, events, nready, nonblock ? 0 : 1000);
+    }
+  while (nev < 0 && errno == EINTR);
+  if (nev < 0)
+    return TRACE_SYSRES (-1);
+
+  for (i = 0; i < nev; i++)
+    ready[i] = (events[i].data.u32 == IO_SELECT_SET_WAKEUP
+                ? -1 : (int)events[i].data.u32);
+
+  return TRACE_SYSRES (nev);
+}
+
+#else /*!HAVE_EPOLL_CREATE1*/
+
+int
+_gpgme_io_select_set_new (io_select_set_t *r_set)
+{
+  (void)r_set;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+void
+_gpgme_io_select_set_release (io_select_set_t set)
+{
+  (void)set;
+}
+
+
+int
+_gpgme_io_select_set_add (io_select_set_t set,
+                          struct io_select_fd_s *fds, int idx)
+{
+  (void)set;
+  (void)fds;
+  (void)idx;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+int
+_gpgme_io_select_set_del (io_select_set_t set,
+                          struct io_select_fd_s *fds, int idx)
+{
+  (void)set;
+  (void)fds;
+  (void)idx;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+int
+_gpgme_io_select_set_wait (io_select_set_t set,
+                           struct io_select_fd_s *fds, size_t nfds,
+                           int nonblock)
+{
+  (void)set;
+  (void)fds;
+  (void)nfds;
+  (void)nonblock;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+int
+_gpgme_io_select_set_poll (io_select_set_t set, int *ready, int nready,
+                           int nonblock)
+{
+  (void)set;
+  (void)ready;
+  (void)nready;
+  (void)nonblock;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+int
+_gpgme_io_select_set_add_wakeup (io_select_set_t set, int fd)
+{
+  (void)set;
+  (void)fd;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+#endif /*!HAVE_EPOLL_CREATE1*/
+
+
+/* Create a wakeup fd and store the fd to wait on in FDS[0] and the fd
+   to signal in FDS[1].  Returns 0 on success.  */
+int
+_gpgme_io_wakeup_new (int fds[2])
+{
+  TRACE_BEG  (DEBUG_SYSIO, "_gpgme_io_wakeup_new", fds, "");
+
+#if defined(HAVE_SYS_EVENTFD_H) && defined(HAVE_EVENTFD)
+  fds[0] = eventfd (0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (fds[0] == -1)
+    return TRACE_SYSRES (-1);
+  fds[1] = fds[0];
+#else
+  {
+    int i;
+
+    if (pipe (fds))
+      return TRACE_SYSRES (-1);
+    for (i = 0; i < 2; i++)
+      if (fcntl (fds[i], F_SETFD, FD_CLOEXEC) == -1
+          || fcntl (fds[i], F_SETFL,
+                    fcntl (fds[i], F_GETFL) | O_NONBLOCK) == -1)
+        {
+          int saved_errno = errno;
+          close (fds[0]);
+          close (fds[1]);
+          errno = saved_errno;
+          return TRACE_SYSRES (-1);
+        }
+  }
+#endif
+
+  TRACE_SUC ("read fd=%d write fd=%d", fds[0], fds[1]);
+  return 0;
+}
+
+
+void
+_gpgme_io_wakeup_release (int fds[2])
+{
+  if (fds[0] != -1)
+    close (fds[0]);
+  if (fds[1] != -1 && fds[1] != fds[0])
+    close (fds[1]);
+  fds[0] = fds[1] = -1;
+}
+
+
+/* Make the wakeup fd ready.  This is async-signal-safe.  */
+void
+_gpgme_io_wakeup_signal (int fd)
+{
+#if defined(HAVE_SYS_EVENTFD_H) && defined(HAVE_EVENTFD)
+  uint64_t one = 1;
+  int res;
+
+  do
+    res = write (fd, &one, sizeof one);
+  while (res == -1 && errno == EINTR);
+#else
+  int res;
+
+  /* If the pipe is full, it is ready anyway.  */
+  do
+    res = write (fd, "", 1);
+  while (res == -1 && errno == EINTR);
+#endif
+}
+
+
+/* Reset the wakeup fd to not ready.  */
+void
+_gpgme_io_wakeup_clear (int fd)
+{
+#if defined(HAVE_SYS_EVENTFD_H) && defined(HAVE_EVENTFD)
+  uint64_t value;
+  int res;
+
+  do
+    res = read (fd, &value, sizeof value);
+  while (res == -1 && errno == EINTR);
+#else
+  char buffer[64];
+  int res;
+
+  do
+    res = read (fd, buffer, sizeof buffer);
+  while (res > 0 || (res == -1 && errno == EINTR));
+#endif
+}
+
+
 int
 _gpgme_io_recvmsg (int fd, struct msghdr *msg, int flags)
 {
@@ -72,8 +72,10 @@ typedef void (*_gpgme_close_notify_handler_t) (int,void*);
 int _gpgme_io_set_close_notify (int fd, _gpgme_close_notify_handler_t handler,
 				void *value);
 int _gpgme_io_set_nonblocking (int fd);
+int _gpgme_io_set_pipe_size (int fd, size_t size);
 
-/* Under Windows do not allocate a console.  */
+/* Under Windows do not allocate a console.  Under POSIX this always
+   detaches the process, even if IOSPAWN_FLAG_WAIT is also given.  */
 #define IOSPAWN_FLAG_DETACHED 1
 /* A flag to tell the spawn function to allow the child process to set
    the foreground window. */
@@ -82,6 +84,11 @@ int _gpgme_io_set_nonblocking (int fd);
 #define IOSPAWN_FLAG_NOCLOSE 4
 /* Set show window to true for windows */
 #define IOSPAWN_FLAG_SHOW_WINDOW 8
+/* The caller waits for the process with _gpgme_io_waitpid or
+   _gpgme_io_reap.  Under POSIX the process is then not detached by a
+   second fork and may be started with posix_spawn.  Ignored under
+   Windows.  */
+#define IOSPAWN_FLAG_WAIT 16
 
 /* Spawn the executable PATH with ARGV as arguments.  After forking
    close all fds except for those in FD_LIST in the child, then
@@ -94,6 +101,48 @@ int _gpgme_io_spawn (const char *path, char *const argv[], unsigned int flags,
 
 int _gpgme_io_select (struct io_select_fd_s *fds, size_t nfds, int nonblock);
 
+/* A persistent select set keeps the fds of an io_select_fd_s array
+   registered with the system (epoll on Linux) so that waiting costs
+   only as much as the number of ready fds.  Entries are identified
+   by their index into the array, which must be passed to all calls.
+   If the system does not support this, _gpgme_io_select_set_new
+   fails with ENOSYS and the caller shall use _gpgme_io_select.  */
+typedef struct io_select_set_s *io_select_set_t;
+int _gpgme_io_select_set_new (io_select_set_t *r_set);
+void _gpgme_io_select_set_release (io_select_set_t set);
+int _gpgme_io_select_set_add (io_select_set_t set,
+                              struct io_select_fd_s *fds, int idx);
+int _gpgme_io_select_set_del (io_select_set_t set,
+                              struct io_select_fd_s *fds, int idx);
+int _gpgme_io_select_set_wait (io_select_set_t set,
+                               struct io_select_fd_s *fds, size_t nfds,
+                               int nonblock);
+
+/* Like _gpgme_io_select_set_wait but store the indices of up to
+   NREADY ready fds in READY instead of marking them in the array.
+   The array used for registration is not accessed; thus the caller
+   may change it while waiting if it serializes the calls to add and
+   del.  */
+#define IO_SELECT_SET_POLL_MAX 64
+int _gpgme_io_select_set_poll (io_select_set_t set, int *ready, int nready,
+                               int nonblock);
+
+/* Register the wakeup fd FD (see below) with SET.  If it is ready,
+   _gpgme_io_select_set_wait clears it and _gpgme_io_select_set_poll
+   returns the index -1 for it.  */
+int _gpgme_io_select_set_add_wakeup (io_select_set_t set, int fd);
+
+/* A wakeup fd lets another thread interrupt a thread waiting for
+   fds.  It is an eventfd if available and a pipe otherwise.  FDS[0]
+   is to be waited on for reading; _gpgme_io_wakeup_signal on FDS[1]
+   makes it ready until _gpgme_io_wakeup_clear is called on FDS[0].
+   If the system does not support this, _gpgme_io_wakeup_new fails
+   with ENOSYS.  */
+int _gpgme_io_wakeup_new (int fds[2]);
+void _gpgme_io_wakeup_release (int fds[2]);
+void _gpgme_io_wakeup_signal (int fd);
+void _gpgme_io_wakeup_clear (int fd);
+
 /* Write the printable version of FD to the buffer BUF of length
    BUFLEN.  The printable version is the representation on the command
    line that the child process expects.  */
@@ -112,6 +161,7 @@ int _gpgme_io_dup (int fd);
 int _gpgme_io_recvmsg (int fd, struct msghdr *msg, int flags);
 int _gpgme_io_sendmsg (int fd, const struct msghdr *msg, int flags);
 int _gpgme_io_waitpid (int pid, int hang, int *r_status, int *r_signal);
+void _gpgme_io_reap (int pid);
 #endif
 
 #endif /* IO_H */
@@ -149,6 +149,8 @@ revsig_start (gpgme_ctx_t ctx, int synchronous,
   if (!key)
     return gpg_error (GPG_ERR_INV_ARG);
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -140,6 +140,8 @@ setexpire (gpgme_ctx_t ctx, int synchronous,
   if (!key)
     return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -135,10 +135,58 @@ _gpgme_sig_notation_create (gpgme_sig_notation_t *notationp,
 /* This subpacket is marked critical.  */
 #define GNUPG_SPK_CRITICAL	0x02
 
+/* Create a new signature notation data object in the arena of KEY.
+   The name, the value and the object are allocated in one piece.  */
+static gpgme_error_t
+key_sig_notation_create (gpgme_key_t key, gpgme_sig_notation_t *notationp,
+                         const char *name, int name_len,
+                         const char *value, int value_len,
+                         gpgme_sig_notation_flags_t flags)
+{
+  gpgme_sig_notation_t notation;
+  char *p;
+
+  /* Currently, we require all notations to be human-readable.  */
+  if (name && !(flags & GPGME_SIG_NOTATION_HUMAN_READABLE))
+    return gpg_error (GPG_ERR_INV_VALUE);
+
+  notation = _gpgme_key_alloc (key, sizeof (*notation)
+                               + (name ? name_len + 1 : 0)
+                               + (value ? value_len + 1 : 0));
+  if (!notation)
+    return gpg_error_from_syserror ();
+  p = (char *) (notation + 1);
+
+  /* See _gpgme_sig_notation_create for why NAME may be NULL.  */
+  if (name)
+    {
+      notation->name = p;
+      memcpy (p, name, name_len);
+      p[name_len] = '\0';
+      notation->name_len = name_len;
+      p += name_len + 1;
+    }
+
+  if (value)
+    {
+      notation->value = p;
+      memcpy (p, value, value_len);
+      p[value_len] = '\0';
+      notation->value_len = value_len;
+    }
+
+  sig_notation_set_flags (notation, flags);
+
+  *notationp = notation;
+  return 0;
+}
+
+
 /* Parse a notation or policy URL subpacket.  If the packet type is
-   not known, return no error but NULL in NOTATION.  */
+   not known, return no error but NULL in NOTATION.  The notation is
+   allocated from the arena of KEY.  */
 gpgme_error_t
-_gpgme_parse_notation (gpgme_sig_notation_t *notationp,
+_gpgme_parse_notation (gpgme_key_t key, gpgme_sig_notation_t *notationp,
 		       int type, int pkflags, int len, char *data)
 {
   gpgme_error_t err;
@@ -253,8 +301,8 @@ _gpgme_parse_notation (gpgme_sig_notation_t *notationp,
       value_len = strlen (value);
     }
 
-  err = _gpgme_sig_notation_create (notationp, name, name_len,
-				    value, value_len, flags);
+  err = key_sig_notation_create (key, notationp, name, name_len,
+                                 value, value_len, flags);
 
   free (decoded_data);
   return err;
@@ -27,6 +27,7 @@
 #include <string.h>
 
 #include "util.h"
+#include "status-table.h"
 
 struct status_table_s {
     const char *name;
@@ -35,9 +36,11 @@ struct status_table_s {
 
 
 /* Lexicographically sorted ('_' comes after any letter).  You can use
-   the Emacs command M-x sort-lines.  But don't sweat it, the table is
-   sorted at start up, too.  */
-static struct status_table_s status_table[] =
+   the Emacs command M-x sort-lines.  But don't sweat it, the order
+   does not matter: at build time mkstatus reads this table and
+   creates a perfect hash for the keywords in status-table.h.  Keep
+   one entry per line.  */
+static const struct status_table_s status_table[] =
 {
   { "ABORT", GPGME_STATUS_ABORT },
   { "ALREADY_SIGNED", GPGME_STATUS_ALREADY_SIGNED },
@@ -144,33 +147,21 @@ static struct status_table_s status_table[] =
 };
 
 
-static int
-status_cmp (const void *ap, const void *bp)
-{
-  const struct status_table_s *a = ap;
-  const struct status_table_s *b = bp;
-
-  return strcmp (a->name, b->name);
-}
-
-
-void
-_gpgme_status_init (void)
-{
-  qsort (status_table,
-	 DIM(status_table) - 1, sizeof (status_table[0]),
-	 status_cmp);
-}
+/* Fail to compile if status-table.h is out of date.  */
+typedef char status_hash_check_t[(DIM (status_table) - 1
+                                  == STATUS_HASH_NKEYWORDS)? 1 : -1];
 
 
 gpgme_status_code_t
 _gpgme_parse_status (const char *name)
 {
-  struct status_table_s t, *r;
-  t.name = name;
-  r = bsearch (&t, status_table, DIM(status_table) - 1,
-	       sizeof t, status_cmp);
-  return r ? r->code : -1;
+  unsigned int idx;
+
+  idx = status_hash_index[status_hash (name, STATUS_HASH_SEED,
+                                       STATUS_HASH_BITS)];
+  if (idx && !strcmp (status_table[idx - 1].name, name))
+    return status_table[idx - 1].code;
+  return -1;
 }
 
 
@@ -130,6 +130,8 @@ tofu_policy_start (gpgme_ctx_t ctx, int synchronous,
   if (!key)
     return gpg_error (GPG_ERR_INV_VALUE);
 
+  _gpgme_key_cache_invalidate ();
+
   err = _gpgme_op_reset (ctx, synchronous);
   if (err)
     return err;
@@ -0,0 +1,448 @@
+/* trace-ring.c - Binary trace records
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This file is also linked into gpgme-trace-decode and must thus not
+   use any other part of the library.  */
+
+#if HAVE_CONFIG_H
+#include <config.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+
+#include "trace-ring.h"
+
+
+/* The length modifiers of a conversion specification.  */
+enum length_mod
+  {
+    LEN_NONE, LEN_HH, LEN_H, LEN_L, LEN_LL, LEN_Z, LEN_J, LEN_T, LEN_BIG_L
+  };
+
+/* A parsed conversion specification of a printf format.  */
+struct spec_s
+{
+  const char *flags;
+  size_t nflags;
+  const char *width;      /* "*" or digits.  */
+  size_t nwidth;
+  int have_prec;
+  const char *prec;       /* "*" or digits.  */
+  size_t nprec;
+  enum length_mod length;
+  char conv;              /* 0 for an incomplete specification.  */
+};
+
+
+/* Parse the conversion specification at P, which points to a '%',
+   into SPEC and return a pointer to the character after it.  */
+static const char *
+parse_spec (const char *p, struct spec_s *spec)
+{
+  memset (spec, 0, sizeof *spec);
+  p++;
+
+  spec->flags = p;
+  while (*p && strchr ("-+ #0'", *p))
+    p++;
+  spec->nflags = p - spec->flags;
+
+  spec->width = p;
+  if (*p == '*')
+    p++;
+  else
+    while (*p >= '0' && *p <= '9')
+      p++;
+  spec->nwidth = p - spec->width;
+
+  if (*p == '.')
+    {
+      p++;
+      spec->have_prec = 1;
+      spec->prec = p;
+      if (*p == '*')
+        p++;
+      else
+        while (*p >= '0' && *p <= '9')
+          p++;
+      spec->nprec = p - spec->prec;
+    }
+
+  switch (*p)
+    {
+    case 'h':
+      p++;
+      if (*p == 'h')
+        {
+          p++;
+          spec->length = LEN_HH;
+        }
+      else
+        spec->length = LEN_H;
+      break;
+    case 'l':
+      p++;
+      if (*p == 'l')
+        {
+          p++;
+          spec->length = LEN_LL;
+        }
+      else
+        spec->length = LEN_L;
+      break;
+    case 'q': p++; spec->length = LEN_LL; break;
+    case 'z': p++; spec->length = LEN_Z; break;
+    case 'j': p++; spec->length = LEN_J; break;
+    case 't': p++; spec->length = LEN_T; break;
+    case 'L': p++; spec->length = LEN_BIG_L; break;
+    default: break;
+    }
+
+  if (*p)
+    spec->conv = *p++;
+  return p;
+}
+
+
+/* Add an argument of type TYPE and value VALUE to REC.  Returns
+   false if there is no more room.  */
+static int
+add_arg (struct trace_record_s *rec, int type, uint64_t value)
+{
+  if (rec->nargs >= TRACE_RECORD_ARGS)
+    return 0;
+  rec->argtype[rec->nargs] = type;
+  rec->args[rec->nargs] = value;
+  rec->nargs++;
+  return 1;
+}
+
+
+/* Store the arguments ARG_PTR for FORMAT in the record REC.  */
+void
+_gpgme_trace_record_args (struct trace_record_s *rec,
+                          const char *format, va_list arg_ptr)
+{
+  struct spec_s spec;
+  const char *p = format;
+  size_t strused = 0;
+
+  rec->nargs = 0;
+  while (p && (p = strchr (p, '%')))
+    {
+      p = parse_spec (p, &spec);
+
+      if (spec.nwidth == 1 && *spec.width == '*'
+          && !add_arg (rec, TRACE_ARG_INT, (int64_t) va_arg (arg_ptr, int)))
+        return;
+      if (spec.nprec == 1 && *spec.prec == '*'
+          && !add_arg (rec, TRACE_ARG_INT, (int64_t) va_arg (arg_ptr, int)))
+        return;
+
+      switch (spec.conv)
+        {
+        case 'd':
+        case 'i':
+          {
+            int64_t value;
+
+            switch (spec.length)
+              {
+              case LEN_L:  value = va_arg (arg_ptr, long); break;
+              case LEN_LL: value = va_arg (arg_ptr, long long); break;
+              case LEN_Z:  value = va_arg (arg_ptr, ptrdiff_t); break;
+              case LEN_J:  value = va_arg (arg_ptr, intmax_t); break;
+              case LEN_T:  value = va_arg (arg_ptr, ptrdiff_t); break;
+              default:     value = va_arg (arg_ptr, int); break;
+              }
+            if (!add_arg (rec, TRACE_ARG_INT, value))
+              return;
+          }
+          break;
+
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+        case 'c':
+          {
+            uint64_t value;
+
+            switch (spec.length)
+              {
+              case LEN_L:  value = va_arg (arg_ptr, unsigned long); break;
+              case LEN_LL: value = va_arg (arg_ptr, unsigned long long); break;
+              case LEN_Z:  value = va_arg (arg_ptr, size_t); break;
+              case LEN_J:  value = va_arg (arg_ptr, uintmax_t); break;
+              case LEN_T:  value = va_arg (arg_ptr, size_t); break;
+              default:     value = va_arg (arg_ptr, unsigned int); break;
+              }
+            if (!add_arg (rec, TRACE_ARG_UINT, value))
+              return;
+          }
+          break;
+
+        case 'e': case 'E':
+        case 'f': case 'F':
+        case 'g': case 'G':
+        case 'a': case 'A':
+          {
+            double value;
+            uint64_t bits;
+
+            if (spec.length == LEN_BIG_L)
+              value = (double) va_arg (arg_ptr, long double);
+            else
+              value = va_arg (arg_ptr, double);
+            memcpy (&bits, &value, sizeof bits);
+            if (!add_arg (rec, TRACE_ARG_DOUBLE, bits))
+              return;
+          }
+          break;
+
+        case 'p':
+          if (!add_arg (rec, TRACE_ARG_PTR,
+                        (uintptr_t) va_arg (arg_ptr, void *)))
+            return;
+          break;
+
+        case 's':
+          {
+            const char *s = va_arg (arg_ptr, const char *);
+            size_t len;
+
+            if (!s)
+              {
+                if (!add_arg (rec, TRACE_ARG_NULLSTR, 0))
+                  return;
+                break;
+              }
+            len = strlen (s);
+            if (len > TRACE_RECORD_STRSPACE - strused)
+              len = TRACE_RECORD_STRSPACE - strused;
+            memcpy (rec->strings + strused, s, len);
+            if (!add_arg (rec, TRACE_ARG_STR,
+                          ((uint64_t) strused << 16) | len))
+              return;
+            strused += len;
+          }
+          break;
+
+        case 'n':
+          va_arg (arg_ptr, void *);
+          if (!add_arg (rec, TRACE_ARG_NONE, 0))
+            return;
+          break;
+
+        default:
+          /* "%%" or an unknown conversion, which takes no argument
+             or can't be handled.  */
+          break;
+        }
+    }
+}
+
+
+/* Build a printf conversion specification for SPEC with the length
+   modifier LENGTH in BUFFER.  The width and precision arguments of
+   '*' are replaced by their values taken from ARGS.  */
+static void
+build_spec (char *buffer, size_t size, const struct spec_s *spec,
+            const char *length, const struct trace_record_s *rec,
+            unsigned int *argidx)
+{
+  char width[24], prec[24];
+
+  if (spec->nwidth == 1 && *spec->width == '*')
+    snprintf (width, sizeof width, "%lld",
+              *argidx < rec->nargs? (long long) rec->args[(*argidx)++] : 0);
+  else
+    snprintf (width, sizeof width, "%.*s", (int) spec->nwidth, spec->width);
+
+  if (spec->nprec == 1 && *spec->prec == '*')
+    snprintf (prec, sizeof prec, ".%lld",
+              *argidx < rec->nargs? (long long) rec->args[(*argidx)++] : 0);
+  else if (spec->have_prec)
+    snprintf (prec, sizeof prec, ".%.*s", (int) spec->nprec, spec->prec);
+  else
+    *prec = 0;
+
+  snprintf (buffer, size, "%%%.*s%s%s%s%c", (int) spec->nflags, spec->flags,
+            width, prec, length, spec->conv);
+}
+
+
+/* Format the pointer VALUE of REC like gpgrt_bsprintf formats "%p" and
+   store the result in the buffer BUFFER of size SIZE.  */
+void
+_gpgme_trace_record_pointer (const struct trace_record_s *rec,
+                             uint64_t value, char *buffer, size_t size)
+{
+  snprintf (buffer, size, "0x%0*llx",
+            rec->ptrsize? 2 * rec->ptrsize : 16, (unsigned long long) value);
+}
+
+
+/* Format the arguments of REC according to FORMAT like printf would
+   format the original arguments and store the result in the buffer
+   BUFFER of size SIZE.  */
+void
+_gpgme_trace_record_format (const struct trace_record_s *rec,
+                            const char *format, char *buffer, size_t size)
+{
+  const char *p = format;
+  const char *mark;
+  struct spec_s spec;
+  unsigned int argidx = 0;
+  size_t used = 0;
+  char fmt[80];
+  char str[TRACE_RECORD_STRSPACE + 1];
+  int n;
+
+  if (!size)
+    return;
+  *buffer = 0;
+
+#define APPEND(...) do {                                        \
+    if (used < size)                                            \
+      {                                                         \
+        n = snprintf (buffer + used, size - used, __VA_ARGS__); \
+        if (n > 0)                                              \
+          used += n;                                            \
+      }                                                         \
+  } while (0)
+
+  while (p && *p)
+    {
+      mark = strchr (p, '%');
+      if (!mark)
+        {
+          APPEND ("%s", p);
+          break;
+        }
+      APPEND ("%.*s", (int) (mark - p), p);
+      p = parse_spec (mark, &spec);
+
+      switch (spec.conv)
+        {
+        case 0:
+          break;
+
+        case '%':
+          APPEND ("%%");
+          break;
+
+        case 'd':
+        case 'i':
+          build_spec (fmt, sizeof fmt, &spec, "ll", rec, &argidx);
+          if (argidx < rec->nargs)
+            APPEND (fmt, (long long) rec->args[argidx++]);
+          else
+            APPEND ("?");
+          break;
+
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+          build_spec (fmt, sizeof fmt, &spec, "ll", rec, &argidx);
+          if (argidx < rec->nargs)
+            APPEND (fmt, (unsigned long long) rec->args[argidx++]);
+          else
+            APPEND ("?");
+          break;
+
+        case 'c':
+          build_spec (fmt, sizeof fmt, &spec, "", rec, &argidx);
+          if (argidx < rec->nargs)
+            APPEND (fmt, (int) rec->args[argidx++]);
+          else
+            APPEND ("?");
+          break;
+
+        case 'e': case 'E':
+        case 'f': case 'F':
+        case 'g': case 'G':
+        case 'a': case 'A':
+          build_spec (fmt, sizeof fmt, &spec, "", rec, &argidx);
+          if (argidx < rec->nargs)
+            {
+              double value;
+
+              memcpy (&value, &rec->args[argidx++], sizeof value);
+              APPEND (fmt, value);
+            }
+          else
+            APPEND ("?");
+          break;
+
+        case 'p':
+          build_spec (fmt, sizeof fmt, &spec, "", rec, &argidx);
+          if (argidx < rec->nargs)
+            {
+              char ptr[24];
+
+              _gpgme_trace_record_pointer (rec, rec->args[argidx++],
+                                           ptr, sizeof ptr);
+              fmt[strlen (fmt) - 1] = 's';
+              APPEND (fmt, ptr);
+            }
+          else
+            APPEND ("?");
+          break;
+
+        case 's':
+          build_spec (fmt, sizeof fmt, &spec, "", rec, &argidx);
+          if (argidx >= rec->nargs)
+            APPEND ("?");
+          else if (rec->argtype[argidx] == TRACE_ARG_STR)
+            {
+              size_t off = rec->args[argidx] >> 16;
+              size_t len = rec->args[argidx] & 0xffff;
+
+              if (off + len > TRACE_RECORD_STRSPACE)
+                len = 0;
+              memcpy (str, rec->strings + off, len);
+              str[len] = 0;
+              argidx++;
+              APPEND (fmt, str);
+            }
+          else
+            {
+              argidx++;
+              APPEND (fmt, "(null)");
+            }
+          break;
+
+        case 'n':
+          argidx++;
+          break;
+
+        default:
+          APPEND ("%%%c", spec.conv);
+          break;
+        }
+    }
+
+#undef APPEND
+  if (used >= size)
+    buffer[size - 1] = 0;
+}
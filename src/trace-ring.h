@@ -0,0 +1,115 @@
+/* trace-ring.h - Binary trace records
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+#ifndef TRACE_RING_H
+#define TRACE_RING_H
+
+#include <stdarg.h>
+#include <stddef.h>
+#ifdef HAVE_STDINT_H
+# include <stdint.h>
+#endif
+
+/* With the "ring" option of GPGME_DEBUG, the trace messages are not
+   formatted but stored as records in a ring buffer per thread.  A
+   dump of the rings is rendered in the text format by the program
+   gpgme-trace-decode.  This file describes the records and the dump,
+   and is shared by both.
+
+   A dump starts with the magic TRACE_DUMP_MAGIC, the number
+   TRACE_DUMP_BYTEORDER and the number of strings as 32 bit values,
+   followed by the strings, each as its 32 bit length and its bytes.
+   Then the number of records follows as a 32 bit value and the
+   records.  All numbers are in the byte order of the dumping
+   process.  In a dump, the fields FUNC, FORMAT and TAGNAME of a
+   record are indices into the strings or TRACE_NO_STRING.  */
+
+#define TRACE_DUMP_MAGIC     "GPGMETR1"
+#define TRACE_DUMP_BYTEORDER 0x01020304
+#define TRACE_NO_STRING      0xffffffffU
+
+/* The maximum number of arguments and the space for the strings of
+   a record.  Further arguments are dropped and the strings are
+   truncated.  */
+#define TRACE_RECORD_ARGS     8
+#define TRACE_RECORD_STRSPACE 120
+
+/* The types of the arguments.  */
+enum trace_arg_type
+  {
+    TRACE_ARG_NONE = 0,
+    TRACE_ARG_INT,        /* Stored as int64_t.  */
+    TRACE_ARG_UINT,
+    TRACE_ARG_DOUBLE,     /* Stored as the bits of the double.  */
+    TRACE_ARG_PTR,
+    TRACE_ARG_STR,        /* Offset in STRINGS << 16 | length.  */
+    TRACE_ARG_NULLSTR
+  };
+
+/* A trace record.  Its size is 256 bytes.  */
+struct trace_record_s
+{
+  /* The number of the record in its ring, starting at 1.  0 marks an
+     unused record or one which is being written.  */
+  uint64_t seq;
+
+  /* The time in nanoseconds since the Epoch.  */
+  uint64_t stamp;
+
+  uint64_t thread;
+  uint64_t tag;
+
+  /* The function name, the format and the name of the tag, which is
+     NULL if there is no tag.  These are string literals of the
+     library in memory, and indices into the strings in a dump.  */
+  uint64_t func;
+  uint64_t format;
+  uint64_t tagname;
+
+  uint8_t level;
+  int8_t mode;
+  uint8_t indent;
+  uint8_t nargs;
+  uint8_t argtype[TRACE_RECORD_ARGS];
+  uint8_t ptrsize;       /* sizeof (void *) of the recording process.  */
+  uint8_t reserved[3];
+
+  uint64_t args[TRACE_RECORD_ARGS];
+  char strings[TRACE_RECORD_STRSPACE];
+};
+
+
+/* Store the arguments ARG_PTR for FORMAT in the record REC.  */
+void _gpgme_trace_record_args (struct trace_record_s *rec,
+                               const char *format, va_list arg_ptr);
+
+/* Format the pointer VALUE of REC like gpgrt_bsprintf formats "%p" and
+   store the result in the buffer BUFFER of size SIZE.  */
+void _gpgme_trace_record_pointer (const struct trace_record_s *rec,
+                                  uint64_t value, char *buffer, size_t size);
+
+/* Format the arguments of REC according to FORMAT like printf would
+   format the original arguments and store the result in the buffer
+   BUFFER of size SIZE.  */
+void _gpgme_trace_record_format (const struct trace_record_s *rec,
+                                 const char *format,
+                                 char *buffer, size_t size);
+
+#endif	/* TRACE_RING_H */
@@ -61,6 +61,13 @@ int _gpgme_in_gpg_one_mode (void);
 
 const char *_gpgme_get_basename (const char *name);
 
+/*-- engine-cache.c --*/
+int _gpgme_set_engine_cache_file (const char *value);
+char *_gpgme_engine_cache_get (const char *kind, const char *file_name,
+                               const char *extra);
+void _gpgme_engine_cache_put (const char *kind, const char *file_name,
+                              const char *extra, const char *value);
+
 
 
 /*-- replacement functions in <funcname>.c --*/
@@ -186,7 +193,6 @@ gpgme_error_t _gpgme_getenv (const char *name, char **value);
 
 /*-- status-table.c --*/
 /* Convert a status string to a status code.  */
-void _gpgme_status_init (void);
 gpgme_status_code_t _gpgme_parse_status (const char *name);
 const char *_gpgme_status_to_string (gpgme_status_code_t code);
 
@@ -27,6 +27,9 @@
 #include <errno.h>
 #include <assert.h>
 #include <limits.h>
+#ifdef HAVE_UNISTD_H
+# include <unistd.h>
+#endif
 
 #include "gpgme.h"
 #include "debug.h"
@@ -725,9 +728,13 @@ parse_tofu_user (gpgme_signature_t sig, char *args, gpgme_protocol_t protocol)
       err = _gpgme_key_new (&sig->key);
       if (err)
         goto leave;
-      sig->key->fpr = fpr;
+      sig->key->fpr = _gpgme_key_strdup (sig->key, fpr);
+      if (!sig->key->fpr)
+        {
+          err = gpg_error_from_syserror ();
+          goto leave;
+        }
       sig->key->protocol = protocol;
-      fpr = NULL;
     }
   else if (!sig->key->fpr)
     {
@@ -742,7 +749,8 @@ parse_tofu_user (gpgme_signature_t sig, char *args, gpgme_protocol_t protocol)
   uid = sig->key->_last_uid;
   assert (uid);
 
-  ti = calloc (1, sizeof *ti);
+  /* The TOFU info is released with the key.  */
+  ti = _gpgme_key_alloc (sig->key, sizeof *ti);
   if (!ti)
     {
       err = gpg_error_from_syserror ();
@@ -859,6 +867,7 @@ parse_tofu_stats_long (gpgme_signature_t sig, char *args, int raw)
 {
   gpgme_error_t err;
   gpgme_tofu_info_t ti;
+  char *description = NULL;
   char *p;
 
   if (!sig->key || !sig->key->_last_uid || !(ti = sig->key->_last_uid->tofu))
@@ -866,9 +875,13 @@ parse_tofu_stats_long (gpgme_signature_t sig, char *args, int raw)
   if (ti->description)
     return trace_gpg_error (GPG_ERR_INV_ENGINE); /* Already set.  */
 
-  err = _gpgme_decode_percent_string (args, &ti->description, 0, 0);
+  err = _gpgme_decode_percent_string (args, &description, 0, 0);
   if (err)
     return err;
+  ti->description = _gpgme_key_strdup (sig->key, description);
+  free (description);
+  if (!ti->description)
+    return gpg_error_from_syserror ();
 
   /* Remove the non-breaking spaces.  */
   if (!raw)
@@ -1199,6 +1212,233 @@ gpgme_op_verify (gpgme_ctx_t ctx, gpgme_data_t sig, gpgme_data_t signed_text,
 }
 
 
+/* Write function of the data object used by gpgme_op_verify_batch to
+   discard the plaintext of normal and cleartext signatures.  */
+static gpgme_ssize_t
+discard_write (void *handle, const void *buffer, size_t size)
+{
+  (void)handle;
+  (void)buffer;
+  return size;
+}
+
+static struct gpgme_data_cbs discard_cbs = { NULL, discard_write, NULL, NULL };
+
+
+/* Return the default number of parallel jobs of a batch.  */
+static unsigned int
+default_batch_jobs (void)
+{
+#ifdef _SC_NPROCESSORS_ONLN
+  long n = sysconf (_SC_NPROCESSORS_ONLN);
+
+  if (n > 0)
+    return n > 64? 64 : n;
+#endif
+  return 4;
+}
+
+
+/* Store a malloced copy of SRC at DST after releasing DST.  */
+static gpgme_error_t
+copy_string (char **dst, const char *src)
+{
+  free (*dst);
+  *dst = NULL;
+  if (src && !(*dst = strdup (src)))
+    return gpg_error_from_syserror ();
+  return 0;
+}
+
+
+/* Create a new context for a job of a batch with the state of CTX
+   which is relevant for verifying signatures.  */
+static gpgme_error_t
+new_batch_context (gpgme_ctx_t ctx, gpgme_ctx_t *r_bctx)
+{
+  gpgme_ctx_t bctx;
+  gpgme_error_t err;
+  gpgme_engine_info_t info;
+
+  err = gpgme_new (&bctx);
+  if (err)
+    return err;
+
+  gpgme_set_protocol (bctx, ctx->protocol);
+  bctx->sub_protocol = ctx->sub_protocol;
+  bctx->offline = ctx->offline;
+  bctx->full_status = 0;
+  bctx->raw_description = ctx->raw_description;
+  bctx->auto_key_import = ctx->auto_key_import;
+  bctx->auto_key_retrieve = ctx->auto_key_retrieve;
+  bctx->key_cache = ctx->key_cache;
+  bctx->keylist_mode = ctx->keylist_mode;
+  bctx->pinentry_mode = ctx->pinentry_mode;
+  err = copy_string (&bctx->sender, ctx->sender);
+  if (!err)
+    err = copy_string (&bctx->request_origin, ctx->request_origin);
+  if (!err)
+    err = copy_string (&bctx->auto_key_locate, ctx->auto_key_locate);
+  if (!err)
+    err = copy_string (&bctx->trust_model, ctx->trust_model);
+  if (!err)
+    err = copy_string (&bctx->lc_ctype, ctx->lc_ctype);
+  if (!err)
+    err = copy_string (&bctx->lc_messages, ctx->lc_messages);
+
+  /* Do not use gpgme_ctx_get_engine_info so that the engines are not
+     run to get their versions.  */
+  for (info = ctx->engine_info; info; info = info->next)
+    if (info->protocol == ctx->protocol)
+      break;
+  if (!err && info)
+    err = gpgme_ctx_set_engine_info (bctx, ctx->protocol,
+                                     info->file_name, info->home_dir);
+  if (err)
+    {
+      gpgme_release (bctx);
+      return err;
+    }
+
+  *r_bctx = bctx;
+  return 0;
+}
+
+
+/* Verify the COUNT signatures SIGS[i] of the signed texts
+   SIGNED_TEXTS[i] using up to MAX_JOBS engine processes at once.  If
+   SIGNED_TEXTS or one of its entries is NULL, the signature is a normal
+   or cleartext signature and its plaintext is discarded.  The result of
+   SIGS[i] is stored at R_RESULTS[i] and must be released with
+   gpgme_result_unref; the error of the operation is stored at
+   R_ERRORS[i].  A MAX_JOBS of 0 uses one process per CPU.  Results
+   already stored at R_RESULTS must be released even if an error is
+   returned.  */
+gpgme_error_t
+gpgme_op_verify_batch (gpgme_ctx_t ctx, unsigned int count,
+                       gpgme_data_t sigs[], gpgme_data_t signed_texts[],
+                       gpgme_verify_result_t r_results[],
+                       gpgme_error_t r_errors[], unsigned int max_jobs)
+{
+  gpgme_error_t err = 0;
+  gpgme_error_t op_err;
+  gpgme_ctx_t *jobs = NULL;    /* The contexts of all jobs.  */
+  gpgme_ctx_t *active = NULL;  /* The contexts of the running jobs.  */
+  unsigned int *job_item = NULL;
+  gpgme_data_t *discard = NULL;  /* The plaintext sinks of the jobs.  */
+  gpgme_data_t signed_text;
+  unsigned int njobs, nrunning, next, i, item;
+  int canceled, idx;
+
+  TRACE_BEG  (DEBUG_CTX, "gpgme_op_verify_batch", ctx,
+              "count=%u, max_jobs=%u", count, max_jobs);
+
+  if (!ctx || (count && (!sigs || !r_results || !r_errors)))
+    return TRACE_ERR (gpg_error (GPG_ERR_INV_VALUE));
+
+  for (i = 0; i < count; i++)
+    {
+      r_results[i] = NULL;
+      r_errors[i] = 0;
+    }
+  if (!count)
+    return TRACE_ERR (0);
+
+  njobs = max_jobs? max_jobs : default_batch_jobs ();
+  if (njobs > count)
+    njobs = count;
+  jobs = calloc (njobs, sizeof *jobs);
+  active = calloc (njobs, sizeof *active);
+  job_item = calloc (njobs, sizeof *job_item);
+  discard = calloc (njobs, sizeof *discard);
+  if (!jobs || !active || !job_item || !discard)
+    {
+      err = gpg_error_from_syserror ();
+      goto leave;
+    }
+  for (i = 0; i < njobs; i++)
+    {
+      err = new_batch_context (ctx, &jobs[i]);
+      if (!err)
+        err = gpgme_data_new_from_cbs (&discard[i], &discard_cbs, NULL);
+      if (err)
+        goto leave;
+    }
+
+  next = 0;
+  nrunning = 0;
+  while (next < count || nrunning)
+    {
+      LOCK (ctx->lock);
+      canceled = ctx->canceled;
+      UNLOCK (ctx->lock);
+
+      /* Start the next items on the idle contexts.  */
+      for (i = 0; i < njobs && next < count && !canceled; i++)
+        {
+          if (active[i])
+            continue;
+          item = next++;
+          signed_text = signed_texts? signed_texts[item] : NULL;
+          r_errors[item] = verify_start (jobs[i], 1, sigs[item], signed_text,
+                                         signed_text? NULL : discard[i]);
+          if (r_errors[item])
+            continue;
+          active[i] = jobs[i];
+          job_item[i] = item;
+          nrunning++;
+        }
+      if (canceled)
+        {
+          for (; next < count; next++)
+            r_errors[next] = gpg_error (GPG_ERR_CANCELED);
+        }
+      if (!nrunning)
+        continue;
+
+      idx = _gpgme_wait_on_any (ctx, active, njobs, &err, &op_err);
+      if (idx < 0)
+        {
+          /* All running jobs have been canceled.  */
+          for (i = 0; i < njobs; i++)
+            if (active[i])
+              r_errors[job_item[i]] = err;
+          for (; next < count; next++)
+            r_errors[next] = err;
+          goto leave;
+        }
+
+      item = job_item[idx];
+      r_errors[item] = err? err : op_err;
+      r_results[item] = gpgme_op_verify_result (jobs[idx]);
+      if (r_results[item])
+        gpgme_result_ref (r_results[item]);
+      active[idx] = NULL;
+      nrunning--;
+      err = 0;
+    }
+
+ leave:
+  /* A cancel of CTX, even one issued before the batch was started,
+     stops only this batch.  */
+  LOCK (ctx->lock);
+  ctx->canceled = 0;
+  UNLOCK (ctx->lock);
+  for (i = 0; i < njobs; i++)
+    {
+      if (jobs)
+        gpgme_release (jobs[i]);
+      if (discard)
+        gpgme_data_release (discard[i]);
+    }
+  free (jobs);
+  free (active);
+  free (job_item);
+  free (discard);
+  return TRACE_ERR (err);
+}
+
+
 /* Compatibility interfaces.  */
 
 /* Get the key used to create signature IDX in CTX and return it in
@@ -35,7 +35,7 @@
 #include "debug.h"
 #include "context.h"
 
-/* For _gpgme_sema_subsystem_init and _gpgme_status_init.  */
+/* For _gpgme_sema_subsystem_init.  */
 #include "sema.h"
 #include "util.h"
 
@@ -76,7 +76,6 @@ do_subsystem_inits (void)
 
   _gpgme_debug_subsystem_init ();
   _gpgme_io_subsystem_init ();
-  _gpgme_status_init ();
 
   done = 1;
 }
@@ -313,6 +312,11 @@ _gpgme_get_program_version (const char *const file_name)
 
   if (!file_name)
     return NULL;
+
+  mark = _gpgme_engine_cache_get ("version", file_name, NULL);
+  if (mark)
+    return mark;
+
   argv[0] = (char *) file_name;
 
   if (_gpgme_io_pipe (rp, 1) < 0)
@@ -363,6 +367,7 @@ _gpgme_get_program_version (const char *const file_name)
 	return NULL;
       memcpy (mark, s, len);
       mark[len] = 0;
+      _gpgme_engine_cache_put ("version", file_name, NULL, mark);
       return mark;
     }
 
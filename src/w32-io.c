@@ -1309,6 +1309,15 @@ _gpgme_io_set_nonblocking (int fd)
 }
 
 
+int
+_gpgme_io_set_pipe_size (int fd, size_t size)
+{
+  TRACE (DEBUG_SYSIO, "_gpgme_io_set_pipe_size", fd, "size=%zu", size);
+  errno = ENOSYS;
+  return -1;
+}
+
+
 static char *
 build_commandline (char **argv)
 {
@@ -1805,6 +1814,115 @@ _gpgme_io_subsystem_init (void)
 }
 
 
+/* Persistent select sets are not supported; the callers fall back to
+   _gpgme_io_select.  */
+int
+_gpgme_io_select_set_new (io_select_set_t *r_set)
+{
+  (void)r_set;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+void
+_gpgme_io_select_set_release (io_select_set_t set)
+{
+  (void)set;
+}
+
+
+int
+_gpgme_io_select_set_add (io_select_set_t set,
+                          struct io_select_fd_s *fds, int idx)
+{
+  (void)set;
+  (void)fds;
+  (void)idx;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+int
+_gpgme_io_select_set_del (io_select_set_t set,
+                          struct io_select_fd_s *fds, int idx)
+{
+  (void)set;
+  (void)fds;
+  (void)idx;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+int
+_gpgme_io_select_set_wait (io_select_set_t set,
+                           struct io_select_fd_s *fds, size_t nfds,
+                           int nonblock)
+{
+  (void)set;
+  (void)fds;
+  (void)nfds;
+  (void)nonblock;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+int
+_gpgme_io_select_set_poll (io_select_set_t set, int *ready, int nready,
+                           int nonblock)
+{
+  (void)set;
+  (void)ready;
+  (void)nready;
+  (void)nonblock;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+int
+_gpgme_io_select_set_add_wakeup (io_select_set_t set, int fd)
+{
+  (void)set;
+  (void)fd;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+int
+_gpgme_io_wakeup_new (int fds[2])
+{
+  fds[0] = fds[1] = -1;
+  gpg_err_set_errno (ENOSYS);
+  return -1;
+}
+
+
+void
+_gpgme_io_wakeup_release (int fds[2])
+{
+  fds[0] = fds[1] = -1;
+}
+
+
+void
+_gpgme_io_wakeup_signal (int fd)
+{
+  (void)fd;
+}
+
+
+void
+_gpgme_io_wakeup_clear (int fd)
+{
+  (void)fd;
+}
+
+
 /* Write the printable version of FD to BUFFER which has an allocated
  * length of BUFLEN.  The printable version is the representation on
  * the command line that the child process expects.  Note that this
@@ -41,21 +41,27 @@
 
    A context sets up its initial I/O callbacks and then sends the
    GPGME_EVENT_START event.  After that, it is added to the global
-   list of active contexts.
-
-   The gpgme_wait function contains a select() loop over all file
-   descriptors in all active contexts.  If an error occurs, it closes
-   all fds in that context and moves the context to the global done
-   list.  Likewise, if a context has removed all I/O callbacks, it is
-   moved to the global done list.
+   list of active contexts and its fds are entered into the global fd
+   table.  While the context is active, the I/O callbacks it adds and
+   removes are entered into and removed from the global fd table as
+   well.  On systems with a persistent select set (epoll) the global
+   fd table is registered with such a set so that gpgme_wait neither
+   copies nor scans the fds of all active contexts.
+
+   The gpgme_wait function waits for the fds in the global fd table
+   and runs the I/O callbacks of those which are ready.  If an error
+   occurs, it closes all fds in that context and moves the context to
+   the global done list.  Likewise, if a context has removed all I/O
+   callbacks, it is moved to the global done list.
 
    All contexts in the global done list are eligible for being
    returned by gpgme_wait if requested by the caller.  */
 
-/* The ctx_list_lock protects the list of active and done contexts.
-   Insertion into any of these lists is only allowed when the lock is
-   held.  This allows a muli-threaded program to loop over gpgme_wait
-   and in parallel start asynchronous gpgme operations.
+/* The ctx_list_lock protects the list of active and done contexts
+   and the global fd table.  Insertion into any of these lists is only
+   allowed when the lock is held.  This allows a muli-threaded program
+   to loop over gpgme_wait and in parallel start asynchronous gpgme
+   operations.
 
    However, the fd tables in the contexts are not protected by this
    lock.  They are only allowed to change either before the context is
@@ -76,6 +82,16 @@ struct ctx_list_item
   /* The status is set when the ctx is moved to the done list.  */
   gpgme_error_t status;
   gpgme_error_t op_err;
+
+  /* The number of fds of the context in the global fd table.  */
+  unsigned int nfds;
+
+  /* The next item in the list of active contexts without fds.  */
+  struct ctx_list_item *next_finished;
+  int finished;
+
+  /* Set once gpgme_wait has seen that the context was canceled.  */
+  int cancel_seen;
 };
 
 /* The active list contains all contexts that are in the global event
@@ -90,17 +106,260 @@ static struct ctx_list_item *ctx_active_list;
    successful).  */
 static struct ctx_list_item *ctx_done_list;
 
-
+/* The finished list contains the active contexts which have removed
+   all their I/O callbacks.  gpgme_wait sends them the done event.  */
+static struct ctx_list_item *ctx_finished_list;
+
+
+/* The global fd table.  The opaque value of each used entry is the
+   wait item of the fd in the fd table of its context.  Unused entries
+   have an fd of -1; their indices are kept in FREE_IDX.  */
+static struct io_select_fd_s *global_fds;
+static int *global_free_idx;
+static size_t global_size;
+static size_t global_nfree;
+
+/* The number of used entries in the global fd table.  */
+static size_t global_count;
+
+/* The persistent select set for the global fd table and a flag
+   telling whether it is not available.  */
+static io_select_set_t global_set;
+static int global_no_set;
+
+/* The wakeup fds used by gpgme_cancel_async to interrupt gpgme_wait
+   and a flag telling whether they are not available.  Once created,
+   they are kept until the process ends.  */
+static int global_wakeup_fds[2] = { -1, -1 };
+static int global_no_wakeup;
+
+
+/* Mark the active context of LI as finished.  Must be called with
+   the lock held.  */
+static void
+ctx_finished (struct ctx_list_item *li)
+{
+  if (li->finished)
+    return;
+  li->finished = 1;
+  li->next_finished = ctx_finished_list;
+  ctx_finished_list = li;
+}
+
+
+/* Give up on the select set of the global fd table.  Must be called
+   with the lock held.  The set is not released because another
+   thread may still be waiting on it; this happens at most once.  */
+static void
+global_drop_set (void)
+{
+  TRACE (DEBUG_CTX, "gpgme_wait", NULL,
+         "falling back to plain select: %s", strerror (errno));
+  global_set = NULL;
+  global_no_set = 1;
+}
+
+
+/* Enter the fd with index IDX in the fd table FDT of an active
+   context into the global fd table.  Must be called with the lock
+   held.  */
+static gpgme_error_t
+global_add_fd (fd_table_t fdt, int idx)
+{
+  struct wait_item_s *item = fdt->fds[idx].opaque;
+  size_t i, newsize;
+  int gidx;
+
+  if (!global_nfree)
+    {
+      struct io_select_fd_s *newfds;
+      int *newfree;
+
+      newsize = global_size? 2 * global_size : 64;
+      newfds = realloc (global_fds, newsize * sizeof *newfds);
+      if (!newfds)
+        return gpg_error_from_syserror ();
+      global_fds = newfds;
+      newfree = realloc (global_free_idx, newsize * sizeof *newfree);
+      if (!newfree)
+        return gpg_error_from_syserror ();
+      global_free_idx = newfree;
+      /* Push the new indices so that the lowest is used first.  */
+      for (i = newsize; i > global_size; i--)
+        {
+          global_fds[i - 1].fd = -1;
+          global_fds[i - 1].opaque = NULL;
+          global_free_idx[global_nfree++] = i - 1;
+        }
+      global_size = newsize;
+    }
+
+  gidx = global_free_idx[--global_nfree];
+  global_fds[gidx] = fdt->fds[idx];
+  global_fds[gidx].signaled = 0;
+  item->global_idx = gidx;
+  global_count++;
+  fdt->global->nfds++;
+
+  if (global_wakeup_fds[0] == -1 && !global_no_wakeup
+      && _gpgme_io_wakeup_new (global_wakeup_fds))
+    global_no_wakeup = 1;
+
+  if (!global_set && !global_no_set)
+    {
+      if (_gpgme_io_select_set_new (&global_set))
+        {
+          global_set = NULL;
+          global_no_set = 1;
+        }
+      else
+        {
+          for (i = 0; i < global_size; i++)
+            if (global_fds[i].fd != -1
+                && _gpgme_io_select_set_add (global_set, global_fds, i))
+              {
+                global_drop_set ();
+                break;
+              }
+          if (global_set && global_wakeup_fds[0] != -1
+              && _gpgme_io_select_set_add_wakeup (global_set,
+                                                  global_wakeup_fds[0]))
+            global_drop_set ();
+        }
+    }
+  else if (global_set
+           && _gpgme_io_select_set_add (global_set, global_fds, gidx))
+    global_drop_set ();
+
+  return 0;
+}
+
+
+/* Remove the fd with index IDX in the fd table FDT from the global fd
+   table.  Must be called with the lock held.  */
+static void
+global_del_fd (fd_table_t fdt, int idx)
+{
+  struct wait_item_s *item = fdt->fds[idx].opaque;
+  int gidx = item->global_idx;
+
+  if (global_set && _gpgme_io_select_set_del (global_set, global_fds, gidx))
+    global_drop_set ();
+
+  global_fds[gidx].fd = -1;
+  global_fds[gidx].for_read = 0;
+  global_fds[gidx].for_write = 0;
+  global_fds[gidx].opaque = NULL;
+  global_free_idx[global_nfree++] = gidx;
+  global_count--;
+  item->global_idx = -1;
+
+  if (fdt->global && !--fdt->global->nfds)
+    ctx_finished (fdt->global);
+}
+
+
+/* Enter the fd with index IDX in the fd table FDT of a context which
+   is active in the global event loop into the global fd table.  */
+gpgme_error_t
+_gpgme_wait_global_add_fd (fd_table_t fdt, int idx)
+{
+  gpgme_error_t err;
+
+  LOCK (ctx_list_lock);
+  err = global_add_fd (fdt, idx);
+  UNLOCK (ctx_list_lock);
+  return err;
+}
+
+
+/* Remove the fd with index IDX in the fd table FDT from the global fd
+   table.  */
+void
+_gpgme_wait_global_del_fd (fd_table_t fdt, int idx)
+{
+  LOCK (ctx_list_lock);
+  global_del_fd (fdt, idx);
+  UNLOCK (ctx_list_lock);
+}
+
+
+/* Interrupt gpgme_wait if the context CTX, which has just been
+   canceled asynchronously, is active in the global event loop.  */
+void
+_gpgme_wait_global_wakeup (gpgme_ctx_t ctx)
+{
+  LOCK (ctx_list_lock);
+  if (ctx->fdt.global && global_wakeup_fds[1] != -1)
+    _gpgme_io_wakeup_signal (global_wakeup_fds[1]);
+  UNLOCK (ctx_list_lock);
+}
+
+
+/* Cancel the active contexts which have been canceled
+   asynchronously.  */
+static void
+global_cancel_contexts (void)
+{
+  struct ctx_list_item *li;
+  gpgme_ctx_t ctx;
+
+  do
+    {
+      ctx = NULL;
+      LOCK (ctx_list_lock);
+      for (li = ctx_active_list; li && !ctx; li = li->next)
+        {
+          if (li->cancel_seen)
+            continue;
+          LOCK (li->ctx->lock);
+          if (li->ctx->canceled)
+            {
+              li->cancel_seen = 1;
+              ctx = li->ctx;
+            }
+          UNLOCK (li->ctx->lock);
+        }
+      UNLOCK (ctx_list_lock);
+
+      /* This moves the context to the done list.  */
+      if (ctx)
+        _gpgme_cancel_with_err (ctx, gpg_error (GPG_ERR_CANCELED), 0);
+    }
+  while (ctx);
+}
+
+
 /* Enter the context CTX into the active list.  */
 static gpgme_error_t
 ctx_active (gpgme_ctx_t ctx)
 {
-  struct ctx_list_item *li = malloc (sizeof (struct ctx_list_item));
+  gpgme_error_t err = 0;
+  unsigned int i;
+  struct ctx_list_item *li = calloc (1, sizeof (struct ctx_list_item));
   if (!li)
     return gpg_error_from_syserror ();
   li->ctx = ctx;
 
   LOCK (ctx_list_lock);
+  ctx->fdt.global = li;
+  for (i = 0; i < ctx->fdt.size && !err; i++)
+    if (ctx->fdt.fds[i].fd != -1)
+      err = global_add_fd (&ctx->fdt, i);
+  if (err)
+    {
+      ctx->fdt.global = NULL;
+      for (i = 0; i < ctx->fdt.size; i++)
+        if (ctx->fdt.fds[i].fd != -1
+            && ((struct wait_item_s *)ctx->fdt.fds[i].opaque)->global_idx != -1)
+          global_del_fd (&ctx->fdt, i);
+      UNLOCK (ctx_list_lock);
+      free (li);
+      return err;
+    }
+  if (!li->nfds)
+    ctx_finished (li);
+
   /* Add LI to active list.  */
   li->next = ctx_active_list;
   li->prev = NULL;
@@ -116,14 +375,28 @@ ctx_active (gpgme_ctx_t ctx)
 static void
 ctx_done (gpgme_ctx_t ctx, gpgme_error_t status, gpgme_error_t op_err)
 {
-  struct ctx_list_item *li;
+  struct ctx_list_item *li, **lip;
+  unsigned int i;
 
   LOCK (ctx_list_lock);
-  li = ctx_active_list;
-  while (li && li->ctx != ctx)
-    li = li->next;
+  li = ctx->fdt.global;
   assert (li);
 
+  /* Remove the fds which are still there from the global fd table.  */
+  for (i = 0; i < ctx->fdt.size && li->nfds; i++)
+    if (ctx->fdt.fds[i].fd != -1
+        && ((struct wait_item_s *)ctx->fdt.fds[i].opaque)->global_idx != -1)
+      global_del_fd (&ctx->fdt, i);
+  ctx->fdt.global = NULL;
+
+  if (li->finished)
+    {
+      for (lip = &ctx_finished_list; *lip != li; lip = &(*lip)->next_finished)
+        ;
+      *lip = li->next_finished;
+      li->finished = 0;
+    }
+
   /* Remove LI from active list.  */
   if (li->next)
     li->next->prev = li->prev;
@@ -185,7 +458,7 @@ ctx_wait (gpgme_ctx_t ctx, gpgme_error_t *status, gpgme_error_t *op_err)
   return ctx;
 }
 
-
+
 /* Internal I/O callback functions.  */
 
 /* The add_io_cb and remove_io_cb handlers are shared with the private
@@ -236,7 +509,81 @@ _gpgme_wait_global_event_cb (void *data, gpgme_event_io_t type,
 }
 
 
-
+/* Wait for the fds in the global fd table and store the indices of
+   up to IO_SELECT_SET_POLL_MAX ready entries in READY.  The index -1
+   stands for the wakeup fd.  Returns -1 on error or the number of
+   stored indices.  */
+static int
+global_select (int *ready)
+{
+  struct io_select_fd_s fds_buffer[IO_SELECT_SET_POLL_MAX];
+  struct io_select_fd_s *fds;
+  io_select_set_t set;
+  size_t i, size;
+  int nr, n, wakeup_fd;
+
+  LOCK (ctx_list_lock);
+  if (!global_count)
+    {
+      UNLOCK (ctx_list_lock);
+      return 0;
+    }
+  set = global_set;
+  if (set)
+    {
+      UNLOCK (ctx_list_lock);
+      return _gpgme_io_select_set_poll (set, ready,
+                                        IO_SELECT_SET_POLL_MAX, 0);
+    }
+
+  /* Without a select set the used entries of the table and the
+     wakeup fd are copied, a few of them to the stack.  The opaque
+     value of a copy is the index of the entry.  */
+  wakeup_fd = global_wakeup_fds[0];
+  size = global_count + (wakeup_fd != -1);
+  if (size <= IO_SELECT_SET_POLL_MAX)
+    fds = fds_buffer;
+  else
+    {
+      fds = malloc (size * sizeof *fds);
+      if (!fds)
+        {
+          int saved_errno = errno;
+          UNLOCK (ctx_list_lock);
+          errno = saved_errno;
+          return -1;
+        }
+    }
+  for (i = 0, n = 0; i < global_size; i++)
+    if (global_fds[i].fd != -1)
+      {
+        fds[n] = global_fds[i];
+        fds[n].opaque = (void *)i;
+        n++;
+      }
+  if (wakeup_fd != -1)
+    {
+      memset (&fds[n], 0, sizeof *fds);
+      fds[n].fd = wakeup_fd;
+      fds[n].for_read = 1;
+    }
+  UNLOCK (ctx_list_lock);
+
+  nr = _gpgme_io_select (fds, size, 0);
+  for (i = 0, n = 0; nr > 0 && i < size && n < IO_SELECT_SET_POLL_MAX; i++)
+    if (fds[i].signaled)
+      ready[n++] = (wakeup_fd != -1 && i == size - 1
+                    ? -1 : (int)(size_t)fds[i].opaque);
+  if (fds != fds_buffer)
+    {
+      int saved_errno = errno;
+      free (fds);
+      errno = saved_errno;
+    }
+  return nr < 0? -1 : n;
+}
+
+
 /* Perform asynchronous operations in the global event loop (ie, any
    asynchronous operation except key listing and trustitem listing
    operations).  If CTX is not a null pointer, the function will
@@ -257,41 +604,14 @@ gpgme_wait_ext (gpgme_ctx_t ctx, gpgme_error_t *status,
 {
   do
     {
-      unsigned int i = 0;
+      int ready[IO_SELECT_SET_POLL_MAX];
       struct ctx_list_item *li;
-      struct fd_table fdt;
-      int nr;
-
-      /* Collect the active file descriptors.  */
-      LOCK (ctx_list_lock);
-      for (li = ctx_active_list; li; li = li->next)
-	i += li->ctx->fdt.size;
-      fdt.fds = malloc (i * sizeof (struct io_select_fd_s));
-      if (!fdt.fds)
-	{
-          int saved_err = gpg_error_from_syserror ();
-	  UNLOCK (ctx_list_lock);
-	  if (status)
-	    *status = saved_err;
-	  if (op_err)
-	    *op_err = 0;
-	  return NULL;
-	}
-      fdt.size = i;
-      i = 0;
-      for (li = ctx_active_list; li; li = li->next)
-	{
-	  memcpy (&fdt.fds[i], li->ctx->fdt.fds,
-		  li->ctx->fdt.size * sizeof (struct io_select_fd_s));
-	  i += li->ctx->fdt.size;
-	}
-      UNLOCK (ctx_list_lock);
+      int i, nr;
 
-      nr = _gpgme_io_select (fdt.fds, fdt.size, 0);
+      nr = global_select (ready);
       if (nr < 0)
 	{
           int saved_err = gpg_error_from_syserror ();
-	  free (fdt.fds);
 	  if (status)
 	    *status = saved_err;
 	  if (op_err)
@@ -299,74 +619,76 @@ gpgme_wait_ext (gpgme_ctx_t ctx, gpgme_error_t *status,
 	  return NULL;
 	}
 
-      for (i = 0; i < fdt.size && nr; i++)
+      for (i = 0; i < nr; i++)
 	{
-	  if (fdt.fds[i].fd != -1 && fdt.fds[i].signaled)
+	  struct io_select_fd_s fd;
+	  gpgme_ctx_t ictx;
+	  gpgme_error_t err = 0;
+	  gpgme_error_t local_op_err = 0;
+	  struct wait_item_s *item;
+
+	  if (ready[i] == -1)
 	    {
-	      gpgme_ctx_t ictx;
-	      gpgme_error_t err = 0;
-	      gpgme_error_t local_op_err = 0;
-	      struct wait_item_s *item;
-
-	      assert (nr);
-	      nr--;
-
-	      item = (struct wait_item_s *) fdt.fds[i].opaque;
-	      assert (item);
-	      ictx = item->ctx;
-	      assert (ictx);
-
-	      LOCK (ctx->lock);
-	      if (ctx->canceled)
-		err = gpg_error (GPG_ERR_CANCELED);
-	      UNLOCK (ctx->lock);
-
-	      if (!err)
-		err = _gpgme_run_io_cb (&fdt.fds[i], 0, &local_op_err);
-	      if (err || local_op_err)
-		{
-		  /* An error occurred.  Close all fds in this context,
-		     and signal it.  */
-		  _gpgme_cancel_with_err (ictx, err, local_op_err);
-
-		  /* Break out of the loop, and retry the select()
-		     from scratch, because now all fds should be
-		     gone.  */
-		  break;
-		}
+	      /* A context has been canceled asynchronously.  Like
+		 after an error, retry the select from scratch.  */
+	      _gpgme_io_wakeup_clear (global_wakeup_fds[0]);
+	      global_cancel_contexts ();
+	      break;
+	    }
+
+	  /* The entry may have been removed by an earlier callback.
+	     If it has been reused for another fd, _gpgme_run_io_cb
+	     checks whether that fd is ready.  */
+	  LOCK (ctx_list_lock);
+	  if ((size_t)ready[i] < global_size)
+	    fd = global_fds[ready[i]];
+	  else
+	    fd.fd = -1;
+	  UNLOCK (ctx_list_lock);
+	  if (fd.fd == -1)
+	    continue;
+
+	  item = (struct wait_item_s *) fd.opaque;
+	  assert (item);
+	  ictx = item->ctx;
+	  assert (ictx);
+
+	  LOCK (ictx->lock);
+	  if (ictx->canceled)
+	    err = gpg_error (GPG_ERR_CANCELED);
+	  UNLOCK (ictx->lock);
+
+	  if (!err)
+	    err = _gpgme_run_io_cb (&fd, 0, &local_op_err);
+	  if (err || local_op_err)
+	    {
+	      /* An error occurred.  Close all fds in this context,
+		 and signal it.  */
+	      _gpgme_cancel_with_err (ictx, err, local_op_err);
+
+	      /* Break out of the loop, and retry the select()
+		 from scratch, because now all fds should be
+		 gone.  */
+	      break;
 	    }
 	}
-      free (fdt.fds);
 
       /* Now some contexts might have finished successfully.  */
       LOCK (ctx_list_lock);
-    retry:
-      for (li = ctx_active_list; li; li = li->next)
+      while ((li = ctx_finished_list))
 	{
 	  gpgme_ctx_t actx = li->ctx;
+	  struct gpgme_io_event_done_data data;
 
-	  for (i = 0; i < actx->fdt.size; i++)
-	    if (actx->fdt.fds[i].fd != -1)
-	      break;
-	  if (i == actx->fdt.size)
-	    {
-	      struct gpgme_io_event_done_data data;
-	      data.err = 0;
-	      data.op_err = 0;
-
-	      /* FIXME: This does not perform too well.  We have to
-		 release the lock because the I/O event handler
-		 acquires it to remove the context from the active
-		 list.  Two alternative strategies are worth
-		 considering: Either implement the DONE event handler
-		 here in a lock-free manner, or save a list of all
-		 contexts to be released and call the DONE events
-		 afterwards.  */
-	      UNLOCK (ctx_list_lock);
-	      _gpgme_engine_io_event (actx->engine, GPGME_EVENT_DONE, &data);
-	      LOCK (ctx_list_lock);
-	      goto retry;
-	    }
+	  data.err = 0;
+	  data.op_err = 0;
+
+	  /* The I/O event handler acquires the lock to move the
+	     context to the done list and thereby removes it from the
+	     finished list.  */
+	  UNLOCK (ctx_list_lock);
+	  _gpgme_engine_io_event (actx->engine, GPGME_EVENT_DONE, &data);
+	  LOCK (ctx_list_lock);
 	}
       UNLOCK (ctx_list_lock);
 
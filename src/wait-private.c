@@ -22,6 +22,8 @@
 #if HAVE_CONFIG_H
 #include <config.h>
 #endif
+#include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include <errno.h>
 
@@ -82,10 +84,19 @@ _gpgme_wait_on_condition (gpgme_ctx_t ctx, volatile int *cond,
   if (op_err_p)
     *op_err_p = 0;
 
+  /* Create the wakeup fd so that gpgme_cancel_async interrupts the
+     wait instead of waiting for the next I/O.  Without it, a
+     cancellation is only noticed on the next I/O.  */
+  LOCK (ctx->lock);
+  if (ctx->fdt.wakeup_fds[0] == -1)
+    _gpgme_io_wakeup_new (ctx->fdt.wakeup_fds);
+  UNLOCK (ctx->lock);
+
   do
     {
-      int nr = _gpgme_io_select (ctx->fdt.fds, ctx->fdt.size, 0);
+      int nr = _gpgme_fd_table_select (&ctx->fdt, 0);
       unsigned int i;
+      int canceled;
 
       if (nr < 0)
 	{
@@ -97,6 +108,17 @@ _gpgme_wait_on_condition (gpgme_ctx_t ctx, volatile int *cond,
 	  return err;
 	}
 
+      LOCK (ctx->lock);
+      canceled = ctx->canceled;
+      UNLOCK (ctx->lock);
+      if (canceled)
+	{
+	  err = gpg_error (GPG_ERR_CANCELED);
+	  _gpgme_cancel_with_err (ctx, err, 0);
+
+	  return err;
+	}
+
       for (i = 0; i < ctx->fdt.size && nr; i++)
 	{
 	  if (ctx->fdt.fds[i].fd != -1 && ctx->fdt.fds[i].signaled)
@@ -107,13 +129,7 @@ _gpgme_wait_on_condition (gpgme_ctx_t ctx, volatile int *cond,
 	      assert (nr);
 	      nr--;
 
-	      LOCK (ctx->lock);
-	      if (ctx->canceled)
-		err = gpg_error (GPG_ERR_CANCELED);
-	      UNLOCK (ctx->lock);
-
-	      if (!err)
-		err = _gpgme_run_io_cb (&ctx->fdt.fds[i], 0, &op_err);
+	      err = _gpgme_run_io_cb (&ctx->fdt.fds[i], 0, &op_err);
 	      if (err)
 		{
 		  /* An error occurred.  Close all fds in this context,
@@ -178,3 +194,181 @@ _gpgme_wait_one_ext (gpgme_ctx_t ctx, gpgme_error_t *op_err)
 {
   return _gpgme_wait_on_condition (ctx, NULL, op_err);
 }
+
+
+
+/* Return true if no I/O callbacks of CTX are active.  */
+static int
+ctx_finished (gpgme_ctx_t ctx)
+{
+  unsigned int i;
+
+  for (i = 0; i < ctx->fdt.size; i++)
+    if (ctx->fdt.fds[i].fd != -1)
+      return 0;
+  return 1;
+}
+
+
+/* Run the blocking operations of the NCTXS contexts in CTXS in a
+   common event loop until one of them finished.  NULL entries in CTXS
+   are ignored.  Returns the index of the finished context and stores
+   the error values of its operation at R_ERR and R_OP_ERR.  If CTX
+   has been canceled or the loop itself fails, all operations are
+   canceled, the error is stored at R_ERR and -1 is returned.  */
+int
+_gpgme_wait_on_any (gpgme_ctx_t ctx, gpgme_ctx_t *ctxs, unsigned int nctxs,
+                    gpgme_error_t *r_err, gpgme_error_t *r_op_err)
+{
+  struct io_select_fd_s *fds = NULL;
+  unsigned int *fdctx = NULL;  /* The index into CTXS of FDS[i].  */
+  unsigned int *fdidx = NULL;  /* The index into the fd table of FDS[i].  */
+  unsigned int nfds, maxfds, i, j;
+  gpgme_ctx_t jctx;
+  gpgme_error_t err, op_err;
+  int canceled;
+  int nr;
+
+  *r_err = 0;
+  *r_op_err = 0;
+
+  /* Let gpgme_cancel_async interrupt the wait.  */
+  LOCK (ctx->lock);
+  if (ctx->fdt.wakeup_fds[0] == -1)
+    _gpgme_io_wakeup_new (ctx->fdt.wakeup_fds);
+  UNLOCK (ctx->lock);
+
+  maxfds = 0;
+  for (;;)
+    {
+      LOCK (ctx->lock);
+      canceled = ctx->canceled;
+      UNLOCK (ctx->lock);
+      if (canceled)
+        {
+          err = gpg_error (GPG_ERR_CANCELED);
+          goto leave;
+        }
+
+      /* Return the first context which has finished.  */
+      nfds = 0;
+      for (j = 0; j < nctxs; j++)
+        {
+          if (!(jctx = ctxs[j]))
+            continue;
+          if (ctx_finished (jctx))
+            {
+              struct gpgme_io_event_done_data data;
+              data.err = 0;
+              data.op_err = 0;
+              _gpgme_engine_io_event (jctx->engine, GPGME_EVENT_DONE, &data);
+              free (fds);
+              return j;
+            }
+          nfds += jctx->fdt.size;
+        }
+      if (!nfds)
+        {
+          err = gpg_error (GPG_ERR_INV_VALUE);
+          goto leave;
+        }
+
+      /* Collect the active file descriptors of all contexts and the
+         wakeup fd of CTX.  The tables are copied because the handlers
+         may change them.  The buffer is only enlarged when the fd
+         tables have grown.  */
+      if (nfds + 1 > maxfds)
+        {
+          free (fds);
+          maxfds = nfds + 1;
+          fds = malloc (maxfds * (sizeof *fds + sizeof *fdctx
+                                  + sizeof *fdidx));
+          if (!fds)
+            {
+              err = gpg_error_from_syserror ();
+              goto leave;
+            }
+          fdctx = (unsigned int *) (fds + maxfds);
+          fdidx = fdctx + maxfds;
+        }
+      nfds = 0;
+      for (j = 0; j < nctxs; j++)
+        {
+          if (!(jctx = ctxs[j]))
+            continue;
+          for (i = 0; i < jctx->fdt.size; i++)
+            if (jctx->fdt.fds[i].fd != -1)
+              {
+                fds[nfds] = jctx->fdt.fds[i];
+                fds[nfds].signaled = 0;
+                fdctx[nfds] = j;
+                fdidx[nfds] = i;
+                nfds++;
+              }
+        }
+      if (ctx->fdt.wakeup_fds[0] != -1)
+        {
+          memset (&fds[nfds], 0, sizeof *fds);
+          fds[nfds].fd = ctx->fdt.wakeup_fds[0];
+          fds[nfds].for_read = 1;
+          fdctx[nfds] = nctxs;
+          nfds++;
+        }
+
+      nr = _gpgme_io_select (fds, nfds, 0);
+      if (nr < 0)
+        {
+          err = gpg_error_from_syserror ();
+          goto leave;
+        }
+
+      for (i = 0; i < nfds && nr; i++)
+        {
+          struct io_select_fd_s *an_fds;
+
+          if (!fds[i].signaled)
+            continue;
+          nr--;
+          j = fdctx[i];
+          if (j == nctxs)
+            {
+              /* CTX has been canceled; this is checked above.  */
+              _gpgme_io_wakeup_clear (fds[i].fd);
+              continue;
+            }
+          jctx = ctxs[j];
+          an_fds = &jctx->fdt.fds[fdidx[i]];
+          /* Skip callbacks removed by an earlier handler.  */
+          if (an_fds->fd != fds[i].fd || an_fds->opaque != fds[i].opaque)
+            continue;
+
+          err = 0;
+          op_err = 0;
+          LOCK (jctx->lock);
+          if (jctx->canceled)
+            err = gpg_error (GPG_ERR_CANCELED);
+          UNLOCK (jctx->lock);
+
+          if (!err)
+            err = _gpgme_run_io_cb (an_fds, 0, &op_err);
+          if (err || op_err)
+            {
+              /* Cancel the operation of this context as
+                 _gpgme_wait_on_condition does.  */
+              _gpgme_cancel_with_err (jctx, err, err? 0 : op_err);
+              *r_err = err;
+              *r_op_err = op_err;
+              free (fds);
+              return j;
+            }
+        }
+    }
+
+ leave:
+  free (fds);
+  for (j = 0; j < nctxs; j++)
+    if (ctxs[j])
+      _gpgme_cancel_with_err (ctxs[j], err, 0);
+  *r_err = err;
+  return -1;
+}
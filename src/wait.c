@@ -45,13 +45,134 @@ _gpgme_fd_table_init (fd_table_t fdt)
 {
   fdt->fds = NULL;
   fdt->size = 0;
+  fdt->set = NULL;
+  fdt->no_set = 0;
+  fdt->global = NULL;
+  fdt->wakeup_fds[0] = fdt->wakeup_fds[1] = -1;
+  fdt->wakeup_in_set = 0;
 }
 
 void
 _gpgme_fd_table_deinit (fd_table_t fdt)
 {
+  if (fdt->set)
+    _gpgme_io_select_set_release (fdt->set);
   if (fdt->fds)
     free (fdt->fds);
+  _gpgme_io_wakeup_release (fdt->wakeup_fds);
+}
+
+
+/* Give up on the select set of FDT and use plain _gpgme_io_select
+   from now on.  */
+static void
+fd_table_drop_set (fd_table_t fdt)
+{
+  TRACE (DEBUG_CTX, "fd_table_drop_set", fdt,
+         "falling back to plain select: %s", strerror (errno));
+  _gpgme_io_select_set_release (fdt->set);
+  fdt->set = NULL;
+  fdt->no_set = 1;
+  fdt->wakeup_in_set = 0;
+}
+
+
+/* Wait on the fds in FDT and its wakeup fd using _gpgme_io_select.  */
+static int
+fd_table_select_plain (fd_table_t fdt, int nonblock)
+{
+  struct io_select_fd_s buffer[16];
+  struct io_select_fd_s *fds;
+  size_t i;
+  int nr;
+
+  if (fdt->wakeup_fds[0] == -1)
+    return _gpgme_io_select (fdt->fds, fdt->size, nonblock);
+
+  /* Append the wakeup fd to a copy of the table.  */
+  if (fdt->size + 1 <= DIM (buffer))
+    fds = buffer;
+  else
+    {
+      fds = malloc ((fdt->size + 1) * sizeof *fds);
+      if (!fds)
+        return -1;
+    }
+  memcpy (fds, fdt->fds, fdt->size * sizeof *fds);
+  memset (&fds[fdt->size], 0, sizeof *fds);
+  fds[fdt->size].fd = fdt->wakeup_fds[0];
+  fds[fdt->size].for_read = 1;
+
+  nr = _gpgme_io_select (fds, fdt->size + 1, nonblock);
+  if (nr > 0)
+    {
+      for (i = 0; i < fdt->size; i++)
+        fdt->fds[i].signaled = fds[i].signaled;
+      if (fds[fdt->size].signaled)
+        {
+          _gpgme_io_wakeup_clear (fdt->wakeup_fds[0]);
+          nr--;
+        }
+    }
+
+  if (fds != buffer)
+    free (fds);
+  return nr;
+}
+
+
+/* Wait on the fds in FDT and mark those which are ready.  This uses
+   a persistent select set so that the interest set is not rebuilt
+   on each call.  If the wakeup fd of FDT has been created, a call to
+   _gpgme_fd_table_wakeup interrupts the wait.  Returns -1 on error,
+   or the number of signaled fds, which may be 0 after a timeout or a
+   wakeup.  */
+int
+_gpgme_fd_table_select (fd_table_t fdt, int nonblock)
+{
+  unsigned int i;
+
+  if (!fdt->set && !fdt->no_set)
+    {
+      if (_gpgme_io_select_set_new (&fdt->set))
+        {
+          fdt->set = NULL;
+          fdt->no_set = 1;
+        }
+      else
+        {
+          for (i = 0; i < fdt->size; i++)
+            if (fdt->fds[i].fd != -1
+                && _gpgme_io_select_set_add (fdt->set, fdt->fds, i))
+              {
+                fd_table_drop_set (fdt);
+                break;
+              }
+        }
+    }
+
+  if (fdt->set && fdt->wakeup_fds[0] != -1 && !fdt->wakeup_in_set)
+    {
+      if (_gpgme_io_select_set_add_wakeup (fdt->set, fdt->wakeup_fds[0]))
+        fd_table_drop_set (fdt);
+      else
+        fdt->wakeup_in_set = 1;
+    }
+
+  if (fdt->set)
+    return _gpgme_io_select_set_wait (fdt->set, fdt->fds, fdt->size,
+                                      nonblock);
+  return fd_table_select_plain (fdt, nonblock);
+}
+
+
+/* Interrupt a thread waiting in _gpgme_fd_table_select on FDT.  This
+   must be called with the lock of the context owning FDT held.  */
+void
+_gpgme_fd_table_wakeup (fd_table_t fdt)
+{
+  if (fdt->wakeup_fds[1] != -1)
+    _gpgme_io_wakeup_signal (fdt->wakeup_fds[1]);
 }
 
 
@@ -86,6 +207,8 @@ fd_table_put (fd_table_t fdt, int fd, int dir, void *opaque, int *idx)
   fdt->fds[i].for_write = (dir == 0);
   fdt->fds[i].signaled = 0;
   fdt->fds[i].opaque = opaque;
+  if (fdt->set && _gpgme_io_select_set_add (fdt->set, fdt->fds, i))
+    fd_table_drop_set (fdt);
   *idx = i;
   return 0;
 }
@@ -127,6 +250,7 @@ _gpgme_add_io_cb (void *data, int fd, int dir, gpgme_io_cb_t fnc,
   item->dir = dir;
   item->handler = fnc;
   item->handler_value = fnc_data;
+  item->global_idx = -1;
 
   err = fd_table_put (fdt, fd, dir, item, &tag->idx);
   if (err)
@@ -135,6 +259,18 @@ _gpgme_add_io_cb (void *data, int fd, int dir, gpgme_io_cb_t fnc,
       free (item);
       return err;
     }
+  if (fdt->global)
+    {
+      err = _gpgme_wait_global_add_fd (fdt, tag->idx);
+      if (err)
+        {
+          fdt->fds[tag->idx].fd = -1;
+          fdt->fds[tag->idx].opaque = NULL;
+          free (tag);
+          free (item);
+          return err;
+        }
+    }
 
   TRACE (DEBUG_CTX, "_gpgme_add_io_cb", ctx,
 	  "fd=%d, dir=%d -> tag=%p", fd, dir, tag);
@@ -163,6 +299,11 @@ _gpgme_remove_io_cb (void *data)
 	  "setting fd 0x%x (item=%p) done", fdt->fds[idx].fd,
 	  fdt->fds[idx].opaque);
 
+  if (fdt->set && _gpgme_io_select_set_del (fdt->set, fdt->fds, idx))
+    fd_table_drop_set (fdt);
+  if (((struct wait_item_s *)fdt->fds[idx].opaque)->global_idx != -1)
+    _gpgme_wait_global_del_fd (fdt, idx);
+
   free (fdt->fds[idx].opaque);
   free (tag);
 
@@ -29,6 +29,27 @@ struct fd_table
 {
   struct io_select_fd_s *fds;
   size_t size;
+
+  /* The persistent select set mirroring FDS.  It is created on the
+     first call to _gpgme_fd_table_select and then kept up to date by
+     adding and removing I/O callbacks.  */
+  struct io_select_set_s *set;
+
+  /* Set if the select set is not available and _gpgme_io_select is
+     to be used instead.  */
+  int no_set;
+
+  /* The entry of the context in the global event loop while it is
+     active there.  */
+  struct ctx_list_item *global;
+
+  /* The wakeup fds used by gpgme_cancel_async to interrupt a thread
+     waiting on this table, or -1 if not yet created.  They are
+     created and signaled under the context lock.  */
+  int wakeup_fds[2];
+
+  /* Set if the wakeup fd is registered with SET.  */
+  int wakeup_in_set;
 };
 typedef struct fd_table *fd_table_t;
 
@@ -40,6 +61,9 @@ struct wait_item_s
   gpgme_io_cb_t handler;
   void *handler_value;
   int dir;
+
+  /* The index into the fd table of the global event loop or -1.  */
+  int global_idx;
 };
 
 /* A registered fd handler is removed later using the tag that
@@ -59,6 +83,8 @@ struct tag
 
 void _gpgme_fd_table_init (fd_table_t fdt);
 void _gpgme_fd_table_deinit (fd_table_t fdt);
+int _gpgme_fd_table_select (fd_table_t fdt, int nonblock);
+void _gpgme_fd_table_wakeup (fd_table_t fdt);
 
 gpgme_error_t _gpgme_add_io_cb (void *data, int fd, int dir,
 			     gpgme_io_cb_t fnc, void *fnc_data, void **r_tag);
@@ -67,6 +93,9 @@ void _gpgme_wait_private_event_cb (void *data, gpgme_event_io_t type,
 				   void *type_data);
 void _gpgme_wait_global_event_cb (void *data, gpgme_event_io_t type,
 				  void *type_data);
+gpgme_error_t _gpgme_wait_global_add_fd (fd_table_t fdt, int idx);
+void _gpgme_wait_global_del_fd (fd_table_t fdt, int idx);
+void _gpgme_wait_global_wakeup (gpgme_ctx_t ctx);
 
 gpgme_error_t _gpgme_wait_user_add_io_cb (void *data, int fd, int dir,
 					  gpgme_io_cb_t fnc, void *fnc_data,
@@ -0,0 +1,187 @@
+/* t-encrypt-fd.c - Regression test for file descriptor based data.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <gpgme.h>
+
+#include "t-support.h"
+
+
+/* Size of the plaintext; large enough to require several pipe
+   buffers if the data would be pumped through gpgme.  */
+#define PLAIN_SIZE (300 * 1024 + 17)
+
+
+static int
+tmp_fd (void)
+{
+  FILE *fp = tmpfile ();
+
+  if (!fp)
+    {
+      fprintf (stderr, "%s:%d: tmpfile failed\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  /* Leak FP so that the file stays open.  */
+  return fileno (fp);
+}
+
+
+/* Encrypt and decrypt using data objects backed by files.  If
+   NONBLOCK is set the file descriptors are put into non-blocking
+   mode which makes gpgme fall back to pumping the data itself.  */
+static void
+check_roundtrip (gpgme_ctx_t ctx, gpgme_key_t *keys, const char *plain,
+                 int nonblock)
+{
+  gpgme_error_t err;
+  gpgme_data_t in, out, result;
+  gpgme_encrypt_result_t enc_result;
+  int in_fd, out_fd, result_fd;
+  char *buffer;
+  ssize_t n;
+
+  in_fd = tmp_fd ();
+  out_fd = tmp_fd ();
+  result_fd = tmp_fd ();
+  if (nonblock)
+    {
+      fcntl (in_fd, F_SETFL, fcntl (in_fd, F_GETFL) | O_NONBLOCK);
+      fcntl (out_fd, F_SETFL, fcntl (out_fd, F_GETFL) | O_NONBLOCK);
+      fcntl (result_fd, F_SETFL, fcntl (result_fd, F_GETFL) | O_NONBLOCK);
+    }
+
+  if (write (in_fd, plain, PLAIN_SIZE) != PLAIN_SIZE)
+    {
+      fprintf (stderr, "%s:%d: write failed\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  lseek (in_fd, 0, SEEK_SET);
+
+  err = gpgme_data_new_from_fd (&in, in_fd);
+  fail_if_err (err);
+  err = gpgme_data_new_from_fd (&out, out_fd);
+  fail_if_err (err);
+
+  err = gpgme_op_encrypt (ctx, keys, GPGME_ENCRYPT_ALWAYS_TRUST, in, out);
+  fail_if_err (err);
+  enc_result = gpgme_op_encrypt_result (ctx);
+  if (enc_result->invalid_recipients)
+    {
+      fprintf (stderr, "Invalid recipient encountered: %s\n",
+	       enc_result->invalid_recipients->fpr);
+      exit (1);
+    }
+  if (lseek (in_fd, 0, SEEK_CUR) != PLAIN_SIZE)
+    {
+      fprintf (stderr, "%s:%d: plaintext not fully consumed\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+
+  gpgme_data_seek (out, 0, SEEK_SET);
+  err = gpgme_data_new_from_fd (&result, result_fd);
+  fail_if_err (err);
+  err = gpgme_op_decrypt (ctx, out, result);
+  fail_if_err (err);
+
+  buffer = malloc (PLAIN_SIZE + 1);
+  if (!buffer)
+    {
+      fprintf (stderr, "%s:%d: out of core\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  if (nonblock)
+    fcntl (result_fd, F_SETFL, fcntl (result_fd, F_GETFL) & ~O_NONBLOCK);
+  lseek (result_fd, 0, SEEK_SET);
+  n = read (result_fd, buffer, PLAIN_SIZE + 1);
+  if (n != PLAIN_SIZE || memcmp (buffer, plain, PLAIN_SIZE))
+    {
+      fprintf (stderr, "%s:%d: decrypted data does not match (%ld bytes)\n",
+               __FILE__, __LINE__, (long)n);
+      exit (1);
+    }
+
+  free (buffer);
+  gpgme_data_release (in);
+  gpgme_data_release (out);
+  gpgme_data_release (result);
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  gpgme_ctx_t ctx;
+  gpgme_error_t err;
+  gpgme_key_t key[3] = { NULL, NULL, NULL };
+  char *agent_info;
+  char *plain;
+  int i;
+
+  (void)argc;
+  (void)argv;
+
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  gpgme_set_armor (ctx, 1);
+
+  agent_info = getenv("GPG_AGENT_INFO");
+  if (!(agent_info && strchr (agent_info, ':')))
+    gpgme_set_passphrase_cb (ctx, passphrase_cb, NULL);
+
+  err = gpgme_get_key (ctx, "A0FF4590BB6122EDEF6E3C542D727CC768697734",
+		       &key[0], 0);
+  fail_if_err (err);
+  err = gpgme_get_key (ctx, "D695676BDCEDCC2CDD6152BCFE180B1DA9E3B0B2",
+		       &key[1], 0);
+  fail_if_err (err);
+
+  plain = malloc (PLAIN_SIZE);
+  if (!plain)
+    {
+      fprintf (stderr, "%s:%d: out of core\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  for (i = 0; i < PLAIN_SIZE; i++)
+    plain[i] = "0123456789abcdef\n"[i % 17];
+
+  check_roundtrip (ctx, key, plain, 0);
+  check_roundtrip (ctx, key, plain, 1);
+
+  free (plain);
+  gpgme_key_unref (key[0]);
+  gpgme_key_unref (key[1]);
+  gpgme_release (ctx);
+  return 0;
+}
@@ -0,0 +1,160 @@
+/* t-get-keys.c - Regression test for gpgme_get_keys.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gpgme.h>
+
+#include "t-support.h"
+
+
+#define ALPHA_FPR    "A0FF4590BB6122EDEF6E3C542D727CC768697734"
+#define ALPHA_SUBFPR "3B3FBC948FE59301ED629EFB6AE6D7EE46A871F8"
+#define BRAVO_FPR    "D695676BDCEDCC2CDD6152BCFE180B1DA9E3B0B2"
+#define MISSING_FPR  "0123456789ABCDEF0123456789ABCDEF01234567"
+
+
+/* The expected result for each requested name; NULL if no key shall
+   be returned.  Only Alpha Test has a secret key.  */
+static struct
+{
+  const char *name;
+  const char *fpr;
+  int has_secret;
+} names[] =
+  {
+    { ALPHA_FPR,            ALPHA_FPR, 1 },
+    { MISSING_FPR,          NULL,      0 },
+    { BRAVO_FPR,            BRAVO_FPR, 0 },
+    { ALPHA_SUBFPR,         ALPHA_FPR, 1 },
+    { "0x2d727cc768697734", ALPHA_FPR, 1 },
+    { "A9E3B0B2",           BRAVO_FPR, 0 },
+    { BRAVO_FPR,            BRAVO_FPR, 0 },
+    { "DEADBEEFDEADBEEF",   NULL,      0 }
+  };
+#define NNAMES (sizeof names / sizeof names[0])
+
+
+static void
+check_keys (gpgme_key_t *keys, int secret, int line)
+{
+  unsigned int i;
+
+  for (i = 0; i < NNAMES; i++)
+    {
+      if (!names[i].fpr || (secret && !names[i].has_secret))
+        {
+          if (keys[i])
+            {
+              fprintf (stderr, "%s:%d: unexpected key for %s\n",
+                       __FILE__, line, names[i].name);
+              exit (1);
+            }
+          continue;
+        }
+      if (!keys[i] || strcmp (keys[i]->subkeys->fpr, names[i].fpr))
+        {
+          fprintf (stderr, "%s:%d: wrong or missing key for %s\n",
+                   __FILE__, line, names[i].name);
+          exit (1);
+        }
+      if (!!keys[i]->secret != secret)
+        {
+          fprintf (stderr, "%s:%d: wrong secret flag for %s\n",
+                   __FILE__, line, names[i].name);
+          exit (1);
+        }
+    }
+}
+
+
+static void
+release_keys (gpgme_key_t *keys)
+{
+  unsigned int i;
+
+  for (i = 0; i < NNAMES; i++)
+    gpgme_key_unref (keys[i]);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+  const char *fprs[NNAMES + 1];
+  gpgme_key_t keys[NNAMES];
+  const char *short_fprs[] = { ALPHA_FPR, "1234567", NULL };
+  unsigned int i;
+
+  (void)argc;
+  (void)argv;
+
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+
+  for (i = 0; i < NNAMES; i++)
+    fprs[i] = names[i].name;
+  fprs[i] = NULL;
+
+  err = gpgme_get_keys (ctx, fprs, keys, 0);
+  fail_if_err (err);
+  check_keys (keys, 0, __LINE__);
+  release_keys (keys);
+
+  err = gpgme_get_keys (ctx, fprs, keys, GPGME_GET_KEYS_SECRET);
+  fail_if_err (err);
+  check_keys (keys, 1, __LINE__);
+  release_keys (keys);
+
+  /* With the key cache the second call is served from the cache.  */
+  err = gpgme_set_ctx_flag (ctx, "key-cache", "1");
+  fail_if_err (err);
+  for (i = 0; i < 2; i++)
+    {
+      err = gpgme_get_keys (ctx, fprs, keys, 0);
+      fail_if_err (err);
+      check_keys (keys, 0, __LINE__);
+      release_keys (keys);
+    }
+
+  /* Names shorter than a key ID are rejected.  */
+  err = gpgme_get_keys (ctx, short_fprs, keys, 0);
+  if (gpgme_err_code (err) != GPG_ERR_INV_VALUE)
+    {
+      fprintf (stderr, "%s:%d: short key ID not rejected\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+
+  gpgme_release (ctx);
+  return 0;
+}
@@ -383,6 +383,27 @@ main (void)
   }
   fprintf (stderr, "\n");
 
+  /* Load only one component and compare it with the full list.  */
+  {
+    gpgme_conf_comp_t conf2;
+    gpgme_conf_opt_t opt, opt2;
+
+    err = gpgme_op_conf_load_component (ctx, "dirmngr", &conf2);
+    fail_if_err (err);
+    test (conf2 && !conf2->next && !strcmp (conf2->name, "dirmngr"));
+    if (lookup (conf, "dirmngr", "keyserver", &comp, &opt))
+      {
+        test (lookup (conf2, "dirmngr", "keyserver", &comp, &opt2));
+        test (opt2->value && opt2->value->value.string);
+        test (!strcmp (opt2->value->value.string,
+                       opt->value->value.string));
+      }
+    gpgme_conf_release (conf2);
+
+    err = gpgme_op_conf_load_component (ctx, "no-such-component", &conf2);
+    test (gpgme_err_code (err) == GPG_ERR_NOT_FOUND);
+  }
+
   gpgme_conf_release (conf);
   gpgme_release (ctx);
   return 0;
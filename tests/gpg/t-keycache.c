@@ -0,0 +1,232 @@
+/* t-keycache.c - Regression test for the key cache.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <gpgme.h>
+
+#include "t-support.h"
+
+
+/* Alpha Test's key and the fingerprint of its subkey.  */
+#define ALPHA_FPR    "A0FF4590BB6122EDEF6E3C542D727CC768697734"
+#define ALPHA_SUBFPR "3B3FBC948FE59301ED629EFB6AE6D7EE46A871F8"
+
+/* The cache lookups are traced to this file.  */
+#define LOG_FILE "t-keycache.log"
+
+static FILE *logfp;
+
+
+/* Return true if the last lookup since the previous call has been
+   answered by the cache.  */
+static int
+last_lookup_hit (void)
+{
+  char line[4096];
+  int hit = 0;
+
+  clearerr (logfp);
+  while (fgets (line, sizeof line, logfp))
+    if (strstr (line, "_gpgme_key_cache_lookup"))
+      hit = !!strstr (line, "-> hit");
+  return hit;
+}
+
+
+static void
+check_same (gpgme_key_t a, gpgme_key_t b, int cached, int line)
+{
+  if (last_lookup_hit () != cached)
+    {
+      fprintf (stderr, "%s:%d: key was %sexpected to come from the cache\n",
+               __FILE__, line, cached? "":"not ");
+      exit (1);
+    }
+  /* Even a cached key is a copy of its own.  */
+  if (a == b || a->subkeys == b->subkeys)
+    {
+      fprintf (stderr, "%s:%d: key object is shared\n", __FILE__, line);
+      exit (1);
+    }
+  if (strcmp (a->subkeys->fpr, b->subkeys->fpr)
+      || !a->uids || !b->uids || strcmp (a->uids->uid, b->uids->uid))
+    {
+      fprintf (stderr, "%s:%d: wrong key returned\n", __FILE__, line);
+      exit (1);
+    }
+}
+
+
+/* Modify KEY like a language binding may do it.  This must not
+   affect the keys returned later from the cache.  */
+static void
+modify_key (gpgme_key_t key)
+{
+  key->uids->uid = gpgme_key_strdup (key, "Modified <modified@example.net>");
+  if (!key->uids->uid)
+    {
+      fprintf (stderr, "%s:%d: gpgme_key_strdup failed\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+  key->can_encrypt = !key->can_encrypt;
+}
+
+
+int
+main (int argc, char **argv)
+{
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+  gpgme_key_t key, key2;
+  gpgme_data_t data;
+  const char *value;
+
+  (void)argc;
+  (void)argv;
+
+  unlink (LOG_FILE);
+  if (gpgme_set_global_flag ("debug", "3:" LOG_FILE))
+    {
+      fprintf (stderr, "%s:%d: can't set the debug flag\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+  logfp = fopen (LOG_FILE, "r");
+  if (!logfp)
+    {
+      fprintf (stderr, "%s:%d: can't open the log file\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+
+  /* Without the flag each lookup creates a new key object.  */
+  err = gpgme_get_key (ctx, ALPHA_FPR, &key, 0);
+  fail_if_err (err);
+  err = gpgme_get_key (ctx, ALPHA_FPR, &key2, 0);
+  fail_if_err (err);
+  check_same (key, key2, 0, __LINE__);
+  gpgme_key_unref (key);
+  gpgme_key_unref (key2);
+
+  err = gpgme_set_ctx_flag (ctx, "key-cache", "1");
+  fail_if_err (err);
+  value = gpgme_get_ctx_flag (ctx, "key-cache");
+  if (!value || strcmp (value, "1"))
+    {
+      fprintf (stderr, "%s:%d: flag not set\n", __FILE__, __LINE__);
+      exit (1);
+    }
+
+  /* The second lookup is served from the cache, also by the subkey's
+     fingerprint, the key ID and in lowercase.  */
+  err = gpgme_get_key (ctx, ALPHA_FPR, &key, 0);
+  fail_if_err (err);
+  err = gpgme_get_key (ctx, ALPHA_FPR, &key2, 0);
+  fail_if_err (err);
+  check_same (key, key2, 1, __LINE__);
+  modify_key (key2);
+  gpgme_key_unref (key2);
+  err = gpgme_get_key (ctx, ALPHA_SUBFPR, &key2, 0);
+  fail_if_err (err);
+  check_same (key, key2, 1, __LINE__);
+  gpgme_key_unref (key2);
+  err = gpgme_get_key (ctx, "2d727cc768697734", &key2, 0);
+  fail_if_err (err);
+  check_same (key, key2, 1, __LINE__);
+  gpgme_key_unref (key2);
+
+  /* Secret keys and other keylist modes are cached separately.  */
+  err = gpgme_get_key (ctx, ALPHA_FPR, &key2, 1);
+  fail_if_err (err);
+  check_same (key, key2, 0, __LINE__);
+  gpgme_key_unref (key2);
+  err = gpgme_set_keylist_mode (ctx, (GPGME_KEYLIST_MODE_LOCAL
+                                      | GPGME_KEYLIST_MODE_SIGS));
+  fail_if_err (err);
+  err = gpgme_get_key (ctx, ALPHA_FPR, &key2, 0);
+  fail_if_err (err);
+  check_same (key, key2, 0, __LINE__);
+  gpgme_key_unref (key2);
+  err = gpgme_set_keylist_mode (ctx, GPGME_KEYLIST_MODE_LOCAL);
+  fail_if_err (err);
+
+  /* An import through gpgme flushes the cache.  */
+  err = gpgme_data_new (&data);
+  fail_if_err (err);
+  err = gpgme_op_export (ctx, ALPHA_FPR, 0, data);
+  fail_if_err (err);
+  gpgme_data_seek (data, 0, SEEK_SET);
+  err = gpgme_op_import (ctx, data);
+  fail_if_err (err);
+  gpgme_data_release (data);
+  err = gpgme_get_key (ctx, ALPHA_FPR, &key2, 0);
+  fail_if_err (err);
+  check_same (key, key2, 0, __LINE__);
+  gpgme_key_unref (key);
+  key = key2;
+
+  /* Keys returned by a keylist operation are cached as well.  The
+     caller gets its own copy.  */
+  err = gpgme_op_keylist_start (ctx, NULL, 0);
+  fail_if_err (err);
+  while (!(err = gpgme_op_keylist_next (ctx, &key2)))
+    {
+      if (!strcmp (key2->subkeys->fpr, ALPHA_FPR))
+        {
+          gpgme_key_unref (key);
+          key = key2;
+        }
+      else
+        gpgme_key_unref (key2);
+    }
+  if (gpgme_err_code (err) != GPG_ERR_EOF)
+    fail_if_err (err);
+  err = gpgme_get_key (ctx, ALPHA_FPR, &key2, 0);
+  fail_if_err (err);
+  check_same (key, key2, 1, __LINE__);
+  modify_key (key);
+  gpgme_key_unref (key);
+  key = key2;
+  err = gpgme_get_key (ctx, ALPHA_FPR, &key2, 0);
+  fail_if_err (err);
+  check_same (key, key2, 1, __LINE__);
+  gpgme_key_unref (key2);
+
+  gpgme_key_unref (key);
+  gpgme_release (ctx);
+  fclose (logfp);
+  unlink (LOG_FILE);
+  return 0;
+}
@@ -0,0 +1,137 @@
+/* t-many-fds.c - Regression test for file descriptors >= FD_SETSIZE.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/select.h>
+#include <sys/resource.h>
+
+#include <gpgme.h>
+
+#include "t-support.h"
+
+
+/* Number of fds we occupy so that all fds gpgme creates are above
+   FD_SETSIZE.  */
+#define FILLER_FDS (FD_SETSIZE + 16)
+
+
+int
+main (int argc, char *argv[])
+{
+  gpgme_ctx_t ctx;
+  gpgme_error_t err;
+  gpgme_data_t in, out, plain;
+  gpgme_key_t key[2] = { NULL, NULL };
+  gpgme_encrypt_result_t result;
+  struct rlimit rl;
+  char *agent_info;
+  char buf[100];
+  int nread;
+  int fd, i;
+
+  (void)argc;
+  (void)argv;
+
+  if (getrlimit (RLIMIT_NOFILE, &rl))
+    return 77;
+  if (rl.rlim_cur < FILLER_FDS + 64)
+    {
+      if (rl.rlim_max != RLIM_INFINITY && rl.rlim_max < FILLER_FDS + 64)
+        {
+          fprintf (stderr, "%s: hard fd limit too low - skipped\n", __FILE__);
+          return 77;
+        }
+      rl.rlim_cur = FILLER_FDS + 64;
+      if (setrlimit (RLIMIT_NOFILE, &rl))
+        return 77;
+    }
+
+  fd = open ("/dev/null", O_RDONLY);
+  if (fd == -1)
+    return 77;
+  for (i = 0; i < FILLER_FDS; i++)
+    if (dup (fd) == -1)
+      {
+        fprintf (stderr, "%s: dup failed - skipped\n", __FILE__);
+        return 77;
+      }
+
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  gpgme_set_armor (ctx, 1);
+
+  agent_info = getenv("GPG_AGENT_INFO");
+  if (!(agent_info && strchr (agent_info, ':')))
+    gpgme_set_passphrase_cb (ctx, passphrase_cb, NULL);
+
+  err = gpgme_data_new_from_mem (&in, "Hallo Leute\n", 12, 0);
+  fail_if_err (err);
+  err = gpgme_data_new (&out);
+  fail_if_err (err);
+  err = gpgme_data_new (&plain);
+  fail_if_err (err);
+
+  err = gpgme_get_key (ctx, "A0FF4590BB6122EDEF6E3C542D727CC768697734",
+		       &key[0], 0);
+  fail_if_err (err);
+
+  err = gpgme_op_encrypt (ctx, key, GPGME_ENCRYPT_ALWAYS_TRUST, in, out);
+  fail_if_err (err);
+  result = gpgme_op_encrypt_result (ctx);
+  if (result->invalid_recipients)
+    {
+      fprintf (stderr, "Invalid recipient encountered: %s\n",
+	       result->invalid_recipients->fpr);
+      exit (1);
+    }
+
+  gpgme_data_seek (out, 0, SEEK_SET);
+  err = gpgme_op_decrypt (ctx, out, plain);
+  fail_if_err (err);
+
+  gpgme_data_seek (plain, 0, SEEK_SET);
+  nread = gpgme_data_read (plain, buf, sizeof buf - 1);
+  if (nread != 12 || memcmp (buf, "Hallo Leute\n", 12))
+    {
+      fprintf (stderr, "%s:%d: decrypted data does not match\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+
+  gpgme_key_unref (key[0]);
+  gpgme_data_release (in);
+  gpgme_data_release (out);
+  gpgme_data_release (plain);
+  gpgme_release (ctx);
+  return 0;
+}
@@ -0,0 +1,170 @@
+/* t-verify-batch.c - Regression test for gpgme_op_verify_batch.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <gpgme.h>
+
+#define PGM "t-verify-batch"
+#include "t-support.h"
+
+
+#define ALPHA_FPR "A0FF4590BB6122EDEF6E3C542D727CC768697734"
+
+static const char test_text1[] = "Just GNU it!\n";
+static const char test_text1f[]= "Just GNU it?\n";
+static const char test_sig1[] =
+"-----BEGIN PGP SIGNATURE-----\n"
+"\n"
+"iN0EABECAJ0FAjoS+i9FFIAAAAAAAwA5YmFyw7bDpMO8w58gZGFzIHdhcmVuIFVt\n"
+"bGF1dGUgdW5kIGpldHp0IGVpbiBwcm96ZW50JS1aZWljaGVuNRSAAAAAAAgAJGZv\n"
+"b2Jhci4xdGhpcyBpcyBhIG5vdGF0aW9uIGRhdGEgd2l0aCAyIGxpbmVzGhpodHRw\n"
+"Oi8vd3d3Lmd1Lm9yZy9wb2xpY3kvAAoJEC1yfMdoaXc0JBIAoIiLlUsvpMDOyGEc\n"
+"dADGKXF/Hcb+AKCJWPphZCphduxSvrzH0hgzHdeQaA==\n"
+"=nts1\n"
+"-----END PGP SIGNATURE-----\n";
+
+static const char test_sig2[] =
+"-----BEGIN PGP MESSAGE-----\n"
+"\n"
+"owGbwMvMwCSoW1RzPCOz3IRxjXQSR0lqcYleSUWJTZOvjVdpcYmCu1+oQmaJIleH\n"
+"GwuDIBMDGysTSIqBi1MApi+nlGGuwDeHao53HBr+FoVGP3xX+kvuu9fCMJvl6IOf\n"
+"y1kvP4y+8D5a11ang0udywsA\n"
+"=Crq6\n"
+"-----END PGP MESSAGE-----\n";
+
+/* The items of the batch: a good detached signature, a detached
+   signature of a manipulated text and a good normal signature.  */
+#define NITEMS 11
+#define ITEM_KIND(i) ((i) % 3)
+
+
+static void
+check_result (int idx, gpgme_verify_result_t result, gpgme_error_t err)
+{
+  gpgme_error_t expected;
+
+  fail_if_err (err);
+  if (!result || !result->signatures || result->signatures->next)
+    {
+      fprintf (stderr, "%s:%i: item %d: unexpected number of signatures\n",
+               PGM, __LINE__, idx);
+      exit (1);
+    }
+  if (strcmp (result->signatures->fpr, ALPHA_FPR)
+      && strcmp (result->signatures->fpr, ALPHA_FPR + 24))
+    {
+      fprintf (stderr, "%s:%i: item %d: unexpected fingerprint: %s\n",
+               PGM, __LINE__, idx, result->signatures->fpr);
+      exit (1);
+    }
+  expected = ITEM_KIND (idx) == 1? GPG_ERR_BAD_SIGNATURE : GPG_ERR_NO_ERROR;
+  if (gpgme_err_code (result->signatures->status) != expected)
+    {
+      fprintf (stderr, "%s:%i: item %d: unexpected signature status: %s\n",
+               PGM, __LINE__, idx,
+               gpgme_strerror (result->signatures->status));
+      exit (1);
+    }
+}
+
+
+int
+main (int argc, char *argv[])
+{
+  gpgme_ctx_t ctx;
+  gpgme_error_t err;
+  gpgme_data_t sigs[NITEMS], texts[NITEMS];
+  gpgme_verify_result_t results[NITEMS];
+  gpgme_error_t errors[NITEMS];
+  int i;
+
+  (void)argc;
+  (void)argv;
+
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+
+  for (i = 0; i < NITEMS; i++)
+    {
+      switch (ITEM_KIND (i))
+        {
+        case 0:
+        case 1:
+          err = gpgme_data_new_from_mem (&sigs[i], test_sig1,
+                                         strlen (test_sig1), 0);
+          fail_if_err (err);
+          if (ITEM_KIND (i))
+            err = gpgme_data_new_from_mem (&texts[i], test_text1f,
+                                           strlen (test_text1f), 0);
+          else
+            err = gpgme_data_new_from_mem (&texts[i], test_text1,
+                                           strlen (test_text1), 0);
+          fail_if_err (err);
+          break;
+        default:
+          err = gpgme_data_new_from_mem (&sigs[i], test_sig2,
+                                         strlen (test_sig2), 0);
+          fail_if_err (err);
+          texts[i] = NULL;
+          break;
+        }
+    }
+
+  /* Run the batch with fewer jobs than items so that the contexts are
+     reused.  */
+  err = gpgme_op_verify_batch (ctx, NITEMS, sigs, texts, results, errors, 3);
+  fail_if_err (err);
+  for (i = 0; i < NITEMS; i++)
+    {
+      check_result (i, results[i], errors[i]);
+      gpgme_result_unref (results[i]);
+    }
+
+  /* The results of CTX are not changed.  */
+  if (gpgme_op_verify_result (ctx))
+    {
+      fprintf (stderr, "%s:%i: unexpected result in the context\n",
+               PGM, __LINE__);
+      exit (1);
+    }
+
+  /* An empty batch is fine.  */
+  err = gpgme_op_verify_batch (ctx, 0, NULL, NULL, NULL, NULL, 0);
+  fail_if_err (err);
+
+  for (i = 0; i < NITEMS; i++)
+    {
+      gpgme_data_release (sigs[i]);
+      gpgme_data_release (texts[i]);
+    }
+  gpgme_release (ctx);
+  return 0;
+}
@@ -0,0 +1,297 @@
+/* t-engine-pool.c - Regression test for the engine pool.
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* We need to include config.h so that we know whether we are building
+   with large file system (LFS) support. */
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <locale.h>
+#include <dirent.h>
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include <gpgme.h>
+#include "t-support.h"
+
+
+static const char fpr[] = "3CF405464F66ED4A7DF45BBDD1E4282E33BDB76E";
+
+/* Put into the environment to find the servers started by us.  */
+static char marker[40];
+
+
+/* Return the pid of the gpgsm server started by us, 0 if it can't be
+   determined and -1 if there is more than one.  */
+static long
+server_pid (void)
+{
+  DIR *dir;
+  struct dirent *de;
+  char fname[300], buf[65536], *p;
+  FILE *fp;
+  size_t n;
+  long pid = 0;
+
+  dir = opendir ("/proc");
+  if (!dir)
+    return 0;
+  while ((de = readdir (dir)))
+    {
+      if (!atol (de->d_name))
+        continue;
+      snprintf (fname, sizeof fname, "/proc/%s/comm", de->d_name);
+      fp = fopen (fname, "r");
+      if (!fp)
+        continue;
+      n = fread (buf, 1, sizeof buf - 1, fp);
+      fclose (fp);
+      buf[n] = 0;
+      if (strcmp (buf, "gpgsm\n"))
+        continue;
+
+      /* The environment of a zombie is empty.  We don't care about
+         environments larger than BUF.  */
+      snprintf (fname, sizeof fname, "/proc/%s/environ", de->d_name);
+      fp = fopen (fname, "r");
+      if (!fp)
+        continue;
+      n = fread (buf, 1, sizeof buf - 1, fp);
+      fclose (fp);
+      buf[n] = 0;
+      for (p = buf; p < buf + n && strcmp (p, marker); p += strlen (p) + 1)
+        ;
+      if (p >= buf + n)
+        continue;
+
+      pid = pid? -1 : atol (de->d_name);
+    }
+  closedir (dir);
+  return pid;
+}
+
+
+static gpgme_ctx_t
+new_context (void)
+{
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  err = gpgme_set_protocol (ctx, GPGME_PROTOCOL_CMS);
+  fail_if_err (err);
+  /* The connections of contexts with a locale are not pooled.  */
+  err = gpgme_set_locale (ctx, LC_CTYPE, NULL);
+  fail_if_err (err);
+#ifdef LC_MESSAGES
+  err = gpgme_set_locale (ctx, LC_MESSAGES, NULL);
+  fail_if_err (err);
+#endif
+  return ctx;
+}
+
+
+static void
+check_keylist (gpgme_ctx_t ctx)
+{
+  gpgme_error_t err;
+  gpgme_key_t key;
+  int count = 0;
+
+  err = gpgme_op_keylist_start (ctx, fpr, 0);
+  fail_if_err (err);
+  while (!(err = gpgme_op_keylist_next (ctx, &key)))
+    {
+      if (!key->subkeys || strcmp (key->subkeys->fpr, fpr))
+        {
+          fprintf (stderr, "Wrong key listed\n");
+          exit (1);
+        }
+      count++;
+      gpgme_key_unref (key);
+    }
+  if (gpg_err_code (err) != GPG_ERR_EOF)
+    fail_if_err (err);
+  if (count != 1)
+    {
+      fprintf (stderr, "Unexpected number of keys listed: %d\n", count);
+      exit (1);
+    }
+}
+
+
+/* Sign a message and verify the signature in a fresh context.  Check
+   that the signature is armored as requested and return its length.  */
+static size_t
+check_sign_verify (gpgme_ctx_t ctx, int armor)
+{
+  gpgme_error_t err;
+  gpgme_data_t in, sig, diag;
+  gpgme_ctx_t ctx2;
+  gpgme_verify_result_t result;
+  char buf[11];
+  size_t len;
+
+  err = gpgme_data_new_from_mem (&in, "Hallo Leute!\n", 13, 0);
+  fail_if_err (err);
+  err = gpgme_data_new (&sig);
+  fail_if_err (err);
+  err = gpgme_op_sign (ctx, in, sig, GPGME_SIG_MODE_DETACH);
+  fail_if_err (err);
+
+  len = gpgme_data_seek (sig, 0, SEEK_END);
+  gpgme_data_seek (sig, 0, SEEK_SET);
+  if (gpgme_data_read (sig, buf, 10) != 10)
+    {
+      fprintf (stderr, "Signature too short\n");
+      exit (1);
+    }
+  buf[10] = 0;
+  if (!strcmp (buf, "-----BEGIN") != !!armor)
+    {
+      fprintf (stderr, "Signature is%s armored\n", armor? " not":"");
+      exit (1);
+    }
+
+  ctx2 = new_context ();
+  gpgme_data_seek (in, 0, SEEK_SET);
+  gpgme_data_seek (sig, 0, SEEK_SET);
+  err = gpgme_op_verify (ctx2, sig, in, NULL);
+  fail_if_err (err);
+  result = gpgme_op_verify_result (ctx2);
+  if (!result->signatures || result->signatures->next
+      || gpg_err_code (result->signatures->status)
+      || strcmp (result->signatures->fpr, fpr))
+    {
+      fprintf (stderr, "Unexpected verification result\n");
+      exit (1);
+    }
+
+  /* gpgsm logs the verification.  */
+  err = gpgme_data_new (&diag);
+  fail_if_err (err);
+  err = gpgme_op_getauditlog (ctx2, diag, GPGME_AUDITLOG_DIAG);
+  fail_if_err (err);
+  gpgme_data_release (diag);
+  gpgme_release (ctx2);
+
+  gpgme_data_release (sig);
+  gpgme_data_release (in);
+  return len;
+}
+
+
+static long
+check_reuse (long pid, int reused)
+{
+  long newpid = server_pid ();
+
+  if (newpid == -1)
+    {
+      fprintf (stderr, "More than one server running\n");
+      exit (1);
+    }
+  if (pid > 0 && newpid > 0 && (pid == newpid) != reused)
+    {
+      fprintf (stderr, "Server has%s been reused\n", reused? " not":"");
+      exit (1);
+    }
+  return newpid;
+}
+
+
+int
+main (void)
+{
+  gpgme_ctx_t ctx;
+  gpgme_error_t err;
+  long pid;
+  size_t len, deflen = 0;
+  int i;
+
+  snprintf (marker, sizeof marker, "T_ENGINE_POOL=%ld", (long) getpid ());
+  putenv (marker);
+
+  if (gpgme_set_global_flag ("engine-pool", "2,60"))
+    {
+      fprintf (stderr, "Setting the engine-pool flag failed\n");
+      exit (1);
+    }
+  init_gpgme (GPGME_PROTOCOL_CMS);
+
+  /* The next context takes the server of the previous one unless a
+     locale has been set for the latter.  */
+  ctx = new_context ();
+  check_keylist (ctx);
+  pid = check_reuse (0, 0);
+  gpgme_release (ctx);
+
+  ctx = new_context ();
+  check_keylist (ctx);
+  pid = check_reuse (pid, 1);
+  gpgme_release (ctx);
+
+  ctx = new_context ();
+  err = gpgme_set_locale (ctx, LC_CTYPE, "de_DE.UTF-8");
+  fail_if_err (err);
+  check_keylist (ctx);
+  pid = check_reuse (pid, 1);
+  gpgme_release (ctx);
+
+  ctx = new_context ();
+  check_keylist (ctx);
+  pid = check_reuse (pid, 0);
+  gpgme_release (ctx);
+
+  /* Each context takes the connection released by the previous one.
+     Settings of the previous context must not leak into the next.  */
+  for (i = 0; i < 5; i++)
+    {
+      ctx = new_context ();
+      if (i == 1)
+        gpgme_set_include_certs (ctx, 1);
+      if (i == 2)
+        gpgme_set_armor (ctx, 1);
+      check_keylist (ctx);
+      len = check_sign_verify (ctx, i == 2);
+      if (!i)
+        deflen = len;
+      else if (i == 1? len <= deflen : i != 2 && len != deflen)
+        {
+          fprintf (stderr, "Signature %d has an unexpected length\n", i);
+          exit (1);
+        }
+      gpgme_release (ctx);
+    }
+
+  /* The connection can also be taken for a context which is reset.  */
+  ctx = new_context ();
+  check_keylist (ctx);
+  check_keylist (ctx);
+  gpgme_release (ctx);
+
+  return 0;
+}
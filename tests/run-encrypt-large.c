@@ -0,0 +1,290 @@
+/* run-encrypt-large.c  - Helper to measure the encryption throughput
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This runs the workload of tests/gpg/t-encrypt-large, i.e. it
+ * encrypts data provided and consumed by callbacks, and prints the
+ * throughput and the CPU time spent in this process.  Use --io-buffer-size 4096 to compare with the old
+ * fixed size pump buffers.  Example (from tests/gpg):
+ *
+ *   GNUPGHOME=. ../run-encrypt-large --size 512m --io-buffer-size 4096
+ *   GNUPGHOME=. ../run-encrypt-large --size 512m
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <gpgme.h>
+
+#define PGM "run-encrypt-large"
+
+#include "run-support.h"
+
+
+static int verbose;
+
+
+struct cb_parms
+{
+  unsigned long long bytes_to_send;
+  unsigned long long bytes_received;
+  unsigned long read_calls;
+  unsigned long write_calls;
+};
+
+
+/* The read callback used by GPGME to read data.  */
+static ssize_t
+read_cb (void *handle, void *buffer, size_t size)
+{
+  struct cb_parms *parms = handle;
+
+  parms->read_calls++;
+  if (size > parms->bytes_to_send)
+    size = parms->bytes_to_send;
+  /* Not random but we disable compression anyway.  */
+  memset (buffer, 'x', size);
+  parms->bytes_to_send -= size;
+  return size;
+}
+
+
+/* The write callback used by GPGME to write data.  */
+static ssize_t
+write_cb (void *handle, const void *buffer, size_t size)
+{
+  struct cb_parms *parms = handle;
+
+  (void)buffer;
+  parms->write_calls++;
+  parms->bytes_received += size;
+  return size;
+}
+
+
+static unsigned long long
+parse_size (const char *string)
+{
+  char *endp;
+  unsigned long long value = strtoull (string, &endp, 10);
+
+  if (*endp == 'k' || *endp == 'K')
+    value *= 1024;
+  else if (*endp == 'm' || *endp == 'M')
+    value *= 1024 * 1024;
+  else if (*endp == 'g' || *endp == 'G')
+    value *= 1024 * 1024 * 1024;
+  return value;
+}
+
+
+static double
+timestamp (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+/* Return the CPU time used by this process, i.e. by gpgme and the
+   callbacks but not by gpg.  */
+static double
+cputime (void)
+{
+  struct rusage ru;
+
+  getrusage (RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0
+          + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0);
+}
+
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options]\n\n"
+         "Options:\n"
+         "  --verbose             run in verbose mode\n"
+         "  --size N[kmg]         encrypt N bytes (default: 64m)\n"
+         "  --io-buffer-size N    set the \"io-buffer-size\" data flag\n"
+         "  --size-hint           set the \"size-hint\" data flag\n"
+         "  --repeat N            run the operation N times\n"
+         "  --key NAME            encrypt to key NAME\n"
+         , stderr);
+  exit (ex);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+  struct gpgme_data_cbs cbs;
+  gpgme_data_t in, out;
+  gpgme_key_t keys[2] = { NULL, NULL };
+  gpgme_encrypt_result_t result;
+  struct cb_parms parms;
+  unsigned long long nbytes = 64 * 1024 * 1024;
+  const char *buffer_size = NULL;
+  const char *keyname = "A0FF4590BB6122EDEF6E3C542D727CC768697734";
+  int use_size_hint = 0;
+  int repeat = 1;
+  int i;
+  double start, elapsed, cpustart, cpu;
+  char numbuf[35];
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--verbose"))
+        {
+          verbose = 1;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--size"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          nbytes = parse_size (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--io-buffer-size"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          buffer_size = *argv;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--size-hint"))
+        {
+          use_size_hint = 1;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--repeat"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          repeat = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--key"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          keyname = *argv;
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+  if (argc || repeat < 1)
+    show_usage (1);
+
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  gpgme_set_armor (ctx, 0);
+
+  err = gpgme_get_key (ctx, keyname, &keys[0], 0);
+  fail_if_err (err);
+
+  memset (&cbs, 0, sizeof cbs);
+  cbs.read = read_cb;
+  cbs.write = write_cb;
+
+  snprintf (numbuf, sizeof numbuf, "%llu", nbytes);
+  for (i = 0; i < repeat; i++)
+    {
+      memset (&parms, 0, sizeof parms);
+      parms.bytes_to_send = nbytes;
+
+      err = gpgme_data_new_from_cbs (&in, &cbs, &parms);
+      fail_if_err (err);
+      err = gpgme_data_new_from_cbs (&out, &cbs, &parms);
+      fail_if_err (err);
+      if (buffer_size)
+        {
+          fail_if_err (gpgme_data_set_flag (in, "io-buffer-size",
+                                            buffer_size));
+          fail_if_err (gpgme_data_set_flag (out, "io-buffer-size",
+                                            buffer_size));
+        }
+      if (use_size_hint)
+        fail_if_err (gpgme_data_set_flag (in, "size-hint", numbuf));
+
+      start = timestamp ();
+      cpustart = cputime ();
+      /* Disable compression to keep the costs of gpg itself low.  */
+      err = gpgme_op_encrypt (ctx, keys, (GPGME_ENCRYPT_ALWAYS_TRUST
+                                          | GPGME_ENCRYPT_NO_COMPRESS),
+                              in, out);
+      elapsed = timestamp () - start;
+      cpu = cputime () - cpustart;
+      fail_if_err (err);
+      result = gpgme_op_encrypt_result (ctx);
+      if (result->invalid_recipients)
+        {
+          fprintf (stderr, PGM ": invalid recipient encountered: %s\n",
+                   result->invalid_recipients->fpr);
+          exit (1);
+        }
+
+      printf ("plaintext=%llu bytes, ciphertext=%llu bytes, "
+              "time=%.3fs, %.1f MiB/s, gpgme cpu=%.3fs\n",
+              nbytes, parms.bytes_received, elapsed,
+              elapsed > 0? nbytes / elapsed / (1024 * 1024) : 0.0, cpu);
+      if (verbose)
+        printf ("read_cb calls=%lu, write_cb calls=%lu\n",
+                parms.read_calls, parms.write_calls);
+
+      gpgme_data_release (in);
+      gpgme_data_release (out);
+    }
+
+  gpgme_key_unref (keys[0]);
+  gpgme_release (ctx);
+  return 0;
+}
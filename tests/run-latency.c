@@ -0,0 +1,281 @@
+/* run-latency.c  - Helper to measure the latency of small operations
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This runs a small operation many times and prints the minimum,
+ * median, mean and maximum time per operation.  Such operations are
+ * dominated by the costs of starting the engine.  Example (from
+ * tests/gpg):
+ *
+ *   GNUPGHOME=. ../run-latency --repeat 200 keylist getkey verify
+ *   GNUPGHOME=. ../run-latency --repeat 200 --key-cache getkey
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <gpgme.h>
+
+#define PGM "run-latency"
+
+#include "run-support.h"
+
+
+static int verbose;
+
+
+static double
+timestamp (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static int
+cmp_double (const void *a, const void *b)
+{
+  double da = *(const double *)a;
+  double db = *(const double *)b;
+
+  return da < db? -1 : da > db;
+}
+
+
+static void
+op_keylist (gpgme_ctx_t ctx, const char *keyname)
+{
+  gpgme_error_t err;
+  gpgme_key_t key;
+  int count = 0;
+
+  err = gpgme_op_keylist_start (ctx, keyname, 0);
+  fail_if_err (err);
+  while (!(err = gpgme_op_keylist_next (ctx, &key)))
+    {
+      count++;
+      gpgme_key_unref (key);
+    }
+  if (gpg_err_code (err) != GPG_ERR_EOF)
+    fail_if_err (err);
+  if (count != 1)
+    {
+      fprintf (stderr, PGM ": %d keys found for '%s'\n", count, keyname);
+      exit (1);
+    }
+}
+
+
+static void
+op_getkey (gpgme_ctx_t ctx, const char *keyname)
+{
+  gpgme_error_t err;
+  gpgme_key_t key;
+
+  err = gpgme_get_key (ctx, keyname, &key, 0);
+  fail_if_err (err);
+  gpgme_key_unref (key);
+}
+
+
+static void
+op_verify (gpgme_ctx_t ctx, gpgme_data_t sig)
+{
+  gpgme_error_t err;
+  gpgme_data_t out;
+  gpgme_verify_result_t result;
+
+  gpgme_data_seek (sig, 0, SEEK_SET);
+  err = gpgme_data_new (&out);
+  fail_if_err (err);
+  err = gpgme_op_verify (ctx, sig, NULL, out);
+  fail_if_err (err);
+  result = gpgme_op_verify_result (ctx);
+  if (!result || !result->signatures
+      || gpg_err_code (result->signatures->status))
+    {
+      fprintf (stderr, PGM ": signature not valid\n");
+      exit (1);
+    }
+  gpgme_data_release (out);
+}
+
+
+/* Create a signed message for the verify test.  */
+static gpgme_data_t
+make_signature (gpgme_ctx_t ctx, const char *keyname)
+{
+  gpgme_error_t err;
+  gpgme_key_t key;
+  gpgme_data_t in, out;
+
+  err = gpgme_get_key (ctx, keyname, &key, 1);
+  fail_if_err (err);
+  err = gpgme_signers_add (ctx, key);
+  fail_if_err (err);
+  gpgme_key_unref (key);
+  gpgme_set_pinentry_mode (ctx, GPGME_PINENTRY_MODE_LOOPBACK);
+  gpgme_set_passphrase_cb (ctx, passphrase_cb, NULL);
+
+  err = gpgme_data_new_from_mem (&in, "Hallo Leute\n", 12, 0);
+  fail_if_err (err);
+  err = gpgme_data_new (&out);
+  fail_if_err (err);
+  err = gpgme_op_sign (ctx, in, out, GPGME_SIG_MODE_NORMAL);
+  fail_if_err (err);
+
+  gpgme_data_release (in);
+  gpgme_signers_clear (ctx);
+  return out;
+}
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options] [keylist|getkey|verify]...\n\n"
+         "Options:\n"
+         "  --verbose        print the time of each operation\n"
+         "  --repeat N       run each operation N times (default: 100)\n"
+         "  --key NAME       use key NAME\n"
+         "  --key-cache      set the \"key-cache\" context flag\n"
+         , stderr);
+  exit (ex);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+  gpgme_data_t sig = NULL;
+  const char *keyname = "A0FF4590BB6122EDEF6E3C542D727CC768697734";
+  static const char *default_ops[] = { "keylist", "getkey", "verify", NULL };
+  const char **ops;
+  int use_key_cache = 0;
+  int repeat = 100;
+  double *times, start, sum;
+  int i, opidx;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--verbose"))
+        {
+          verbose = 1;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--repeat"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          repeat = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--key"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          keyname = *argv;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--key-cache"))
+        {
+          use_key_cache = 1;
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+  if (repeat < 1)
+    show_usage (1);
+  ops = argc? (const char **)argv : default_ops;
+  for (opidx = 0; ops[opidx] && (!argc || opidx < argc); opidx++)
+    if (strcmp (ops[opidx], "keylist") && strcmp (ops[opidx], "getkey")
+        && strcmp (ops[opidx], "verify"))
+      show_usage (1);
+
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  if (use_key_cache)
+    fail_if_err (gpgme_set_ctx_flag (ctx, "key-cache", "1"));
+
+  times = calloc (repeat, sizeof *times);
+  if (!times)
+    {
+      fprintf (stderr, PGM ": out of core\n");
+      exit (1);
+    }
+
+  for (opidx = 0; ops[opidx] && (!argc || opidx < argc); opidx++)
+    {
+      if (!strcmp (ops[opidx], "verify") && !sig)
+        sig = make_signature (ctx, keyname);
+
+      sum = 0;
+      for (i = 0; i < repeat; i++)
+        {
+          start = timestamp ();
+          if (!strcmp (ops[opidx], "keylist"))
+            op_keylist (ctx, keyname);
+          else if (!strcmp (ops[opidx], "getkey"))
+            op_getkey (ctx, keyname);
+          else
+            op_verify (ctx, sig);
+          times[i] = (timestamp () - start) * 1000.0;
+          sum += times[i];
+          if (verbose)
+            printf ("%s %d: %.3fms\n", ops[opidx], i, times[i]);
+        }
+
+      qsort (times, repeat, sizeof *times, cmp_double);
+      printf ("%-8s n=%d min=%.3fms median=%.3fms mean=%.3fms max=%.3fms\n",
+              ops[opidx], repeat, times[0], times[repeat / 2],
+              sum / repeat, times[repeat - 1]);
+    }
+
+  free (times);
+  gpgme_data_release (sig);
+  gpgme_release (ctx);
+  return 0;
+}
@@ -0,0 +1,172 @@
+/* run-parse-status.c  - Helper to measure the status keyword lookup
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This maps the keywords of typical status lines to status codes
+ * many times and prints the number of status lines per second.  The
+ * lookup is internal to GPGME; thus this program is linked with the
+ * object file of src/status-table.c.  Before the measurement every
+ * known status code is mapped to its keyword and back.  Example:
+ *
+ *   ./run-parse-status --repeat 1000000
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <gpgme.h>
+
+#define PGM "run-parse-status"
+
+/* From src/status-table.c.  */
+gpgme_status_code_t _gpgme_parse_status (const char *name);
+const char *_gpgme_status_to_string (gpgme_status_code_t code);
+
+
+/* The keywords of the status lines of a verify and a decrypt
+ * operation with some progress lines and an unknown keyword.  */
+static const char *status_lines[] =
+  {
+    "NEWSIG", "KEY_CONSIDERED", "SIG_ID", "GOODSIG", "VALIDSIG",
+    "TRUST_ULTIMATE", "VERIFICATION_COMPLIANCE_MODE", "PLAINTEXT",
+    "PLAINTEXT_LENGTH", "PROGRESS", "PROGRESS", "PROGRESS",
+    "ENC_TO", "KEY_CONSIDERED", "BEGIN_DECRYPTION",
+    "DECRYPTION_COMPLIANCE_MODE", "DECRYPTION_INFO", "PINENTRY_LAUNCHED",
+    "DECRYPTION_KEY", "DECRYPTION_OKAY", "GOODMDC", "END_DECRYPTION",
+    "NOT_A_STATUS_KEYWORD", "PROGRESS", "PROGRESS", "PROGRESS"
+  };
+
+
+static double
+timestamp (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+/* Check that each status code is found by its keyword.  */
+static void
+check_table (void)
+{
+  int code;
+  const char *name;
+  int count = 0;
+
+  /* The status codes are small numbers without large gaps.  */
+  for (code = 0; code < 256; code++)
+    {
+      name = _gpgme_status_to_string (code);
+      if (!*name || !strcmp (name, "status_code_lost"))
+        continue;
+      if (_gpgme_parse_status (name) != code)
+        {
+          fprintf (stderr, PGM ": keyword '%s' not mapped to %d\n",
+                   name, code);
+          exit (1);
+        }
+      count++;
+    }
+  if (_gpgme_parse_status ("") != -1
+      || _gpgme_parse_status ("NOT_A_STATUS_KEYWORD") != -1
+      || _gpgme_parse_status ("GOODSI") != -1)
+    {
+      fprintf (stderr, PGM ": unknown keyword mapped to a status code\n");
+      exit (1);
+    }
+  if (count < 50)
+    {
+      fprintf (stderr, PGM ": only %d keywords found\n", count);
+      exit (1);
+    }
+}
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options]\n\n"
+         "Options:\n"
+         "  --repeat N       map the status lines N times (default: 200000)\n"
+         , stderr);
+  exit (ex);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  int repeat = 200000;
+  int i;
+  size_t j;
+  unsigned long long sum = 0;
+  double start, elapsed;
+  unsigned long long nlines;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--repeat"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          repeat = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+  if (argc || repeat < 1)
+    show_usage (1);
+
+  check_table ();
+
+  start = timestamp ();
+  for (i = 0; i < repeat; i++)
+    for (j = 0; j < sizeof status_lines / sizeof *status_lines; j++)
+      sum += _gpgme_parse_status (status_lines[j]);
+  elapsed = timestamp () - start;
+
+  nlines = (unsigned long long)repeat
+    * (sizeof status_lines / sizeof *status_lines);
+  printf ("lines=%llu time=%.3fs %.1f Mlines/s %.1fns/line (checksum %llu)\n",
+          nlines, elapsed, elapsed > 0? nlines / elapsed / 1e6 : 0.0,
+          nlines? elapsed * 1e9 / nlines : 0.0, sum);
+  return 0;
+}
@@ -0,0 +1,194 @@
+/* run-spawn.c  - Helper to measure the time to start a process
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This allocates and touches the given amount of memory and then
+ * runs a key listing for a non-existent key many times, which starts
+ * gpg each time.  It prints the minimum, median, mean and maximum
+ * time per run.  With a fork based spawn the time grows with the
+ * size of the process.  Example:
+ *
+ *   ./run-spawn --repeat 200 --rss 0 --rss 1024 --rss 4096
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <gpgme.h>
+
+#define PGM "run-spawn"
+
+#include "run-support.h"
+
+
+#define MAX_RSS_SIZES 8
+
+
+static double
+timestamp (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static int
+cmp_double (const void *a, const void *b)
+{
+  double da = *(const double *)a;
+  double db = *(const double *)b;
+
+  return da < db? -1 : da > db;
+}
+
+
+/* Grow the memory of the process to about MB megabytes.  */
+static void
+grow_memory (char **buffer, size_t mb)
+{
+  size_t i;
+
+  free (*buffer);
+  *buffer = NULL;
+  if (!mb)
+    return;
+  *buffer = malloc (mb * 1024 * 1024);
+  if (!*buffer)
+    {
+      fprintf (stderr, PGM ": out of core\n");
+      exit (1);
+    }
+  for (i = 0; i < mb * 1024 * 1024; i += 4096)
+    (*buffer)[i] = 1;
+}
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options]\n\n"
+         "Options:\n"
+         "  --repeat N       run the key listing N times (default: 100)\n"
+         "  --rss MB         grow the process to MB megabytes first;\n"
+         "                   may be given several times (default: 0)\n"
+         , stderr);
+  exit (ex);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+  gpgme_key_t key;
+  size_t rss[MAX_RSS_SIZES];
+  int nrss = 0;
+  char *buffer = NULL;
+  int repeat = 100;
+  double *times, start, sum;
+  int i, r;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--repeat"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          repeat = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--rss"))
+        {
+          argc--; argv++;
+          if (!argc || nrss == MAX_RSS_SIZES)
+            show_usage (1);
+          rss[nrss++] = strtoul (*argv, NULL, 10);
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+  if (argc || repeat < 1)
+    show_usage (1);
+  if (!nrss)
+    rss[nrss++] = 0;
+
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+
+  times = calloc (repeat, sizeof *times);
+  if (!times)
+    {
+      fprintf (stderr, PGM ": out of core\n");
+      exit (1);
+    }
+
+  for (r = 0; r < nrss; r++)
+    {
+      grow_memory (&buffer, rss[r]);
+      sum = 0;
+      for (i = 0; i < repeat; i++)
+        {
+          start = timestamp ();
+          err = gpgme_op_keylist_start (ctx, "run-spawn@example.invalid", 0);
+          fail_if_err (err);
+          while (!(err = gpgme_op_keylist_next (ctx, &key)))
+            gpgme_key_unref (key);
+          if (gpg_err_code (err) != GPG_ERR_EOF)
+            fail_if_err (err);
+          times[i] = (timestamp () - start) * 1000.0;
+          sum += times[i];
+        }
+
+      qsort (times, repeat, sizeof *times, cmp_double);
+      printf ("rss=%zuMB n=%d min=%.3fms median=%.3fms mean=%.3fms"
+              " max=%.3fms\n",
+              rss[r], repeat, times[0], times[repeat / 2],
+              sum / repeat, times[repeat - 1]);
+    }
+
+  free (buffer);
+  free (times);
+  gpgme_release (ctx);
+  return 0;
+}
@@ -34,6 +34,7 @@
 #include <string.h>
 #include <sys/stat.h>
 #include <sys/types.h>
+#include <sys/time.h>
 #include <fcntl.h>
 
 #include <unistd.h>
@@ -137,7 +138,9 @@ show_usage (int ex)
            "                exlusive with data-type option\n" */
          "  --threads N   use 4+N threads (4 are used for keylisting"
 " default 1)\n"
-         "  --repeat  N   do N repeats on the messages (default 1)\n\n"
+         "  --repeat  N   do N repeats on the messages (default 1)\n"
+         "  --ref-bench N do N key reference operations per thread\n"
+         "                and compare them with a global lock\n\n"
          "Note: The test does keylistings of both S/MIME and OpenPGP\n"
          "      in the background while running operations on the\n"
          "      messages, depending on their type.\n"
@@ -623,6 +626,110 @@ do_data_op (void *file_name)
 }
 
 
+/* The reference counting benchmark.  All threads take and release
+ * references to the same key; for comparison the same number of
+ * operations is done on a counter protected by a global lock, which
+ * is what gpgme_key_ref did before it used atomic operations.  */
+GPGRT_LOCK_DEFINE (ref_bench_lock);
+static volatile int ref_bench_go;
+static unsigned int ref_bench_counter;
+static int ref_bench_running;
+
+struct ref_bench_s
+{
+  gpgme_key_t key;
+  int use_lock;
+  unsigned long loops;
+};
+
+
+static THREAD_RET
+do_ref_bench (void *arg)
+{
+  struct ref_bench_s *parms = arg;
+  unsigned long i;
+
+  while (!ref_bench_go)
+    ;
+
+  for (i = 0; i < parms->loops; i++)
+    {
+      if (parms->use_lock)
+        {
+          gpgrt_lock_lock (&ref_bench_lock);
+          ref_bench_counter++;
+          gpgrt_lock_unlock (&ref_bench_lock);
+          gpgrt_lock_lock (&ref_bench_lock);
+          ref_bench_counter--;
+          gpgrt_lock_unlock (&ref_bench_lock);
+        }
+      else
+        {
+          gpgme_key_ref (parms->key);
+          gpgme_key_unref (parms->key);
+        }
+    }
+
+  gpgrt_lock_lock (&ref_bench_lock);
+  ref_bench_running--;
+  gpgrt_lock_unlock (&ref_bench_lock);
+  return 0;
+}
+
+
+static double
+ref_bench_run (struct ref_bench_s *parms, int threads)
+{
+  struct timeval start, end;
+  int running;
+
+  ref_bench_go = 0;
+  ref_bench_running = threads;
+  for (int i = 0; i < threads; i++)
+    create_thread (do_ref_bench, parms);
+
+  gettimeofday (&start, NULL);
+  ref_bench_go = 1;
+  do
+    {
+      usleep (1000);
+      gpgrt_lock_lock (&ref_bench_lock);
+      running = ref_bench_running;
+      gpgrt_lock_unlock (&ref_bench_lock);
+    }
+  while (running);
+  gettimeofday (&end, NULL);
+
+  return (end.tv_sec - start.tv_sec) + (end.tv_usec - start.tv_usec) / 1e6;
+}
+
+
+static void
+ref_bench (unsigned long loops, int threads)
+{
+  struct ref_bench_s parms;
+  gpgme_error_t err;
+  double t_lock, t_key;
+
+  err = gpgme_key_from_uid (&parms.key, "alpha@example.net");
+  fail_if_err (err);
+  parms.loops = loops;
+
+  parms.use_lock = 1;
+  t_lock = ref_bench_run (&parms, threads);
+  parms.use_lock = 0;
+  t_key = ref_bench_run (&parms, threads);
+
+  gpgme_key_unref (parms.key);
+
+  out ("%d threads, %lu ref/unref pairs per thread", threads, loops);
+  out ("global lock:    %.3fs (%.1f ns per pair)",
+       t_lock, t_lock * 1e9 / ((double)loops * threads));
+  out ("gpgme_key_ref:  %.3fs (%.1f ns per pair)",
+       t_key, t_key * 1e9 / ((double)loops * threads));
+}
+
+
 void
 start_keylistings (void)
 {
@@ -654,6 +761,7 @@ main (int argc, char **argv)
   int repeats = 1;
   int threads = 0;
   int no_list = 0;
+  unsigned long ref_bench_loops = 0;
   msg_list_t msgs = NULL;
   msg_list_t msg_it = NULL;
   stop = 0;
@@ -736,10 +844,30 @@ main (int argc, char **argv)
             }
           argc--; argv++;
         }
+      else if (!strcmp (*argv, "--ref-bench"))
+        {
+          argc--; argv++;
+          if (!argc)
+            {
+              show_usage (1);
+            }
+          ref_bench_loops = strtoul (*argv, NULL, 10);
+          if (!ref_bench_loops)
+            {
+              show_usage (1);
+            }
+          argc--; argv++;
+        }
     }
 
   init_gpgme_basic ();
 
+  if (ref_bench_loops)
+    {
+      ref_bench (ref_bench_loops, threads? threads : 1);
+      return 0;
+    }
+
   if (threads < argc)
     {
       /* Make sure we run once on each arg */
@@ -0,0 +1,183 @@
+/* run-trace.c  - Helper to measure the cost of tracing
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This creates and releases many data objects with full tracing
+ * enabled, either writing the trace messages to a file or storing
+ * them in the trace rings, and prints the time per trace message.
+ * Each round emits three trace messages.  With --dump the rings are
+ * dumped to a file at the end, which can be read with
+ * gpgme-trace-decode.  Example:
+ *
+ *   ./run-trace --mode ring --dump /tmp/trace.ring
+ *   ../src/gpgme-trace-decode /tmp/trace.ring | tail
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <gpgme.h>
+
+#define PGM "run-trace"
+
+#include "run-support.h"
+
+/* The number of trace messages per round.  */
+#define MESSAGES_PER_ROUND 3
+
+
+static double
+timestamp (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options]\n\n"
+         "Options:\n"
+         "  --mode MODE      trace to \"file\", \"ring\" or \"off\""
+         " (default: ring)\n"
+         "  --file FILE      write the trace messages to FILE"
+         " (default: /dev/null)\n"
+         "  --rounds N       run N rounds (default: 100000)\n"
+         "  --dump FILE      dump the trace rings to FILE at the end\n"
+         , stderr);
+  exit (ex);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  gpgme_error_t err;
+  gpgme_data_t data;
+  const char *mode = "ring";
+  const char *file = "/dev/null";
+  const char *dump = NULL;
+  char *debug;
+  int rounds = 100000;
+  double start, elapsed;
+  int i;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--mode"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          mode = *argv;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--file"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          file = *argv;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--rounds"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          rounds = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--dump"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          dump = *argv;
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+  if (argc || rounds < 1)
+    show_usage (1);
+
+  debug = malloc (strlen (file) + 20);
+  if (!debug)
+    exit (1);
+  if (!strcmp (mode, "file"))
+    sprintf (debug, "9:%s", file);
+  else if (!strcmp (mode, "ring"))
+    sprintf (debug, "9:%s:ring", file);
+  else if (!strcmp (mode, "off"))
+    strcpy (debug, "0");
+  else
+    show_usage (1);
+  /* This must be done before the library is initialized.  */
+  if (gpgme_set_global_flag ("debug", debug))
+    {
+      fprintf (stderr, PGM ": can't set the debug flag\n");
+      exit (1);
+    }
+  free (debug);
+
+  init_gpgme_basic ();
+
+  start = timestamp ();
+  for (i = 0; i < rounds; i++)
+    {
+      err = gpgme_data_new_from_mem (&data, "x", 1, 0);
+      fail_if_err (err);
+      gpgme_data_release (data);
+    }
+  elapsed = timestamp () - start;
+
+  printf ("mode %s: %d messages in %.3fs, %.1fns per message\n",
+          mode, rounds * MESSAGES_PER_ROUND, elapsed,
+          elapsed * 1e9 / (rounds * MESSAGES_PER_ROUND));
+
+  if (dump && gpgme_set_global_flag ("debug-dump", dump))
+    {
+      fprintf (stderr, PGM ": dumping the trace rings failed\n");
+      exit (1);
+    }
+
+  return 0;
+}
@@ -0,0 +1,265 @@
+/* run-verify-batch.c  - Helper to measure gpgme_op_verify_batch
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This verifies the same detached signature many times, first with
+ * gpgme_op_verify in a loop and then with gpgme_op_verify_batch, and
+ * prints the number of signatures per second.  Example (from
+ * tests/gpg):
+ *
+ *   GNUPGHOME=. ../run-verify-batch --count 100 --jobs 4
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+
+#include <gpgme.h>
+
+#define PGM "run-verify-batch"
+
+#include "run-support.h"
+
+
+static double
+timestamp (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static void
+check_result (gpgme_verify_result_t result, gpgme_error_t err)
+{
+  fail_if_err (err);
+  if (!result || !result->signatures
+      || gpg_err_code (result->signatures->status))
+    {
+      fprintf (stderr, PGM ": signature not valid\n");
+      exit (1);
+    }
+}
+
+
+/* Create a detached signature of TEXT.  */
+static gpgme_data_t
+make_signature (gpgme_ctx_t ctx, const char *keyname,
+                const char *text, size_t textlen)
+{
+  gpgme_error_t err;
+  gpgme_key_t key;
+  gpgme_data_t in, out;
+
+  err = gpgme_get_key (ctx, keyname, &key, 1);
+  fail_if_err (err);
+  err = gpgme_signers_add (ctx, key);
+  fail_if_err (err);
+  gpgme_key_unref (key);
+  gpgme_set_pinentry_mode (ctx, GPGME_PINENTRY_MODE_LOOPBACK);
+  gpgme_set_passphrase_cb (ctx, passphrase_cb, NULL);
+
+  err = gpgme_data_new_from_mem (&in, text, textlen, 0);
+  fail_if_err (err);
+  err = gpgme_data_new (&out);
+  fail_if_err (err);
+  err = gpgme_op_sign (ctx, in, out, GPGME_SIG_MODE_DETACH);
+  fail_if_err (err);
+
+  gpgme_data_release (in);
+  gpgme_signers_clear (ctx);
+  return out;
+}
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options]\n\n"
+         "Options:\n"
+         "  --count N        verify N signatures (default: 32)\n"
+         "  --jobs N         run N engines at once (default: one per CPU)\n"
+         "  --size N         sign N bytes (default: 4096)\n"
+         "  --key NAME       use key NAME\n"
+         "  --batch-only     skip the serial loop\n"
+         , stderr);
+  exit (ex);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  gpgme_error_t err;
+  gpgme_ctx_t ctx;
+  gpgme_data_t sig;
+  gpgme_data_t *sigs, *texts;
+  gpgme_verify_result_t *results;
+  gpgme_error_t *errors;
+  const char *keyname = "A0FF4590BB6122EDEF6E3C542D727CC768697734";
+  char *text, *sigbuf;
+  size_t textlen = 4096;
+  size_t siglen, n;
+  int count = 32;
+  int jobs = 0;
+  int batch_only = 0;
+  double start, serial = 0, batch;
+  int i;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--count"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          count = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--jobs"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          jobs = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--size"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          textlen = strtoul (*argv, NULL, 10);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--key"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          keyname = *argv;
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--batch-only"))
+        {
+          batch_only = 1;
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+  if (argc || count < 1 || jobs < 0 || !textlen)
+    show_usage (1);
+
+  init_gpgme (GPGME_PROTOCOL_OpenPGP);
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+
+  text = malloc (textlen);
+  sigs = calloc (count, sizeof *sigs);
+  texts = calloc (count, sizeof *texts);
+  results = calloc (count, sizeof *results);
+  errors = calloc (count, sizeof *errors);
+  if (!text || !sigs || !texts || !results || !errors)
+    {
+      fprintf (stderr, PGM ": out of core\n");
+      exit (1);
+    }
+  for (n = 0; n < textlen; n++)
+    text[n] = 'A' + n % 26;
+  sig = make_signature (ctx, keyname, text, textlen);
+  sigbuf = gpgme_data_release_and_get_mem (sig, &siglen);
+  if (!sigbuf)
+    {
+      fprintf (stderr, PGM ": no signature created\n");
+      exit (1);
+    }
+
+  for (i = 0; i < count; i++)
+    {
+      err = gpgme_data_new_from_mem (&sigs[i], sigbuf, siglen, 0);
+      fail_if_err (err);
+      err = gpgme_data_new_from_mem (&texts[i], text, textlen, 0);
+      fail_if_err (err);
+    }
+
+  if (!batch_only)
+    {
+      start = timestamp ();
+      for (i = 0; i < count; i++)
+        {
+          err = gpgme_op_verify (ctx, sigs[i], texts[i], NULL);
+          check_result (gpgme_op_verify_result (ctx), err);
+          gpgme_data_seek (sigs[i], 0, SEEK_SET);
+          gpgme_data_seek (texts[i], 0, SEEK_SET);
+        }
+      serial = timestamp () - start;
+      printf ("serial  n=%d time=%.3fs %.1f sigs/s\n",
+              count, serial, count / serial);
+    }
+
+  start = timestamp ();
+  err = gpgme_op_verify_batch (ctx, count, sigs, texts, results, errors,
+                               jobs);
+  fail_if_err (err);
+  batch = timestamp () - start;
+  for (i = 0; i < count; i++)
+    {
+      check_result (results[i], errors[i]);
+      gpgme_result_unref (results[i]);
+    }
+  printf ("batch   n=%d time=%.3fs %.1f sigs/s", count, batch, count / batch);
+  if (!batch_only)
+    printf (" speedup=%.2f", serial / batch);
+  putchar ('\n');
+
+  for (i = 0; i < count; i++)
+    {
+      gpgme_data_release (sigs[i]);
+      gpgme_data_release (texts[i]);
+    }
+  free (sigs);
+  free (texts);
+  free (results);
+  free (errors);
+  gpgme_free (sigbuf);
+  free (text);
+  gpgme_release (ctx);
+  return 0;
+}
@@ -0,0 +1,250 @@
+/* run-wait.c  - Helper to measure the global event loop
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This starts many asynchronous operations at once, each of which
+ * pipes data through a program, and runs them with gpgme_wait until
+ * all are done.  Optionally, many idle operations wait in the
+ * background meanwhile.  It checks the output of each operation and
+ * prints the time to start the operations, the time gpgme_wait took
+ * to run them, and the CPU time this process used meanwhile.
+ * Example:
+ *
+ *   ./run-wait --contexts 100 --idle 1000 --size 65536
+ */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+
+#include <gpgme.h>
+
+#define PGM "run-wait"
+
+#include "run-support.h"
+
+
+static double
+timestamp (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+/* Return the CPU time used by this process.  */
+static double
+cputime (void)
+{
+  struct rusage ru;
+
+  getrusage (RUSAGE_SELF, &ru);
+  return (ru.ru_utime.tv_sec + ru.ru_utime.tv_usec / 1000000.0
+          + ru.ru_stime.tv_sec + ru.ru_stime.tv_usec / 1000000.0);
+}
+
+
+static int
+show_usage (int ex)
+{
+  fputs ("usage: " PGM " [options]\n\n"
+         "Options:\n"
+         "  --contexts N     run N operations at once (default: 200)\n"
+         "  --size N         pipe N bytes through each (default: 65536)\n"
+         "  --program FILE   pipe the data through FILE (default: /bin/cat)\n"
+         "  --idle N         run N idle operations meanwhile (default: 0)\n"
+         , stderr);
+  exit (ex);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  int last_argc = -1;
+  gpgme_error_t err;
+  gpgme_ctx_t *ctxs, ctx;
+  gpgme_data_t *ins, *outs;
+  const char *program = "/bin/cat";
+  const char *pgm_argv[2];
+  const char *idle_argv[] = { "/bin/sleep", "3", NULL };
+  int ncontexts = 200;
+  int nidle = 0;
+  size_t size = 65536;
+  char *buffer, *result;
+  size_t len;
+  double start, started, elapsed, cpu;
+  int i, pending;
+
+  if (argc)
+    { argc--; argv++; }
+
+  while (argc && last_argc != argc )
+    {
+      last_argc = argc;
+      if (!strcmp (*argv, "--"))
+        {
+          argc--; argv++;
+          break;
+        }
+      else if (!strcmp (*argv, "--help"))
+        show_usage (0);
+      else if (!strcmp (*argv, "--contexts"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          ncontexts = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--size"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          size = strtoul (*argv, NULL, 10);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--idle"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          nidle = atoi (*argv);
+          argc--; argv++;
+        }
+      else if (!strcmp (*argv, "--program"))
+        {
+          argc--; argv++;
+          if (!argc)
+            show_usage (1);
+          program = *argv;
+          argc--; argv++;
+        }
+      else if (!strncmp (*argv, "--", 2))
+        show_usage (1);
+    }
+  if (argc || ncontexts < 1 || nidle < 0)
+    show_usage (1);
+
+  init_gpgme (GPGME_PROTOCOL_SPAWN);
+
+  ctxs = calloc (ncontexts + nidle, sizeof *ctxs);
+  ins = calloc (ncontexts, sizeof *ins);
+  outs = calloc (ncontexts + nidle, sizeof *outs);
+  buffer = malloc (size + 1);
+  if (!ctxs || !ins || !outs || !buffer)
+    {
+      fprintf (stderr, PGM ": out of core\n");
+      exit (1);
+    }
+  for (len = 0; len < size; len++)
+    buffer[len] = 'a' + len % 26;
+
+  /* The idle operations are started first and end with sleep.  */
+  for (i = ncontexts; i < ncontexts + nidle; i++)
+    {
+      err = gpgme_new (&ctxs[i]);
+      fail_if_err (err);
+      err = gpgme_set_protocol (ctxs[i], GPGME_PROTOCOL_SPAWN);
+      fail_if_err (err);
+      err = gpgme_data_new (&outs[i]);
+      fail_if_err (err);
+      err = gpgme_op_spawn_start (ctxs[i], idle_argv[0], idle_argv,
+                                  NULL, outs[i], NULL, 0);
+      fail_if_err (err);
+    }
+
+  pgm_argv[0] = program;
+  pgm_argv[1] = NULL;
+  start = timestamp ();
+  for (i = 0; i < ncontexts; i++)
+    {
+      err = gpgme_new (&ctxs[i]);
+      fail_if_err (err);
+      err = gpgme_set_protocol (ctxs[i], GPGME_PROTOCOL_SPAWN);
+      fail_if_err (err);
+      err = gpgme_data_new_from_mem (&ins[i], buffer, size, 0);
+      fail_if_err (err);
+      err = gpgme_data_new (&outs[i]);
+      fail_if_err (err);
+      err = gpgme_op_spawn_start (ctxs[i], program, pgm_argv,
+                                  ins[i], outs[i], NULL, 0);
+      fail_if_err (err);
+    }
+
+  started = timestamp ();
+  cpu = cputime ();
+  for (i = 0; i < ncontexts; i++)
+    {
+      ctx = gpgme_wait (ctxs[i], &err, 1);
+      fail_if_err (err);
+      if (ctx != ctxs[i])
+        {
+          fprintf (stderr, PGM ": operation %d not finished\n", i);
+          exit (1);
+        }
+    }
+  elapsed = timestamp () - started;
+  cpu = cputime () - cpu;
+
+  for (pending = nidle; pending; pending--)
+    {
+      do
+        ctx = gpgme_wait (NULL, &err, 1);
+      while (!ctx && !err);
+      fail_if_err (err);
+    }
+  started -= start;
+
+  for (i = 0; i < ncontexts; i++)
+    {
+      result = gpgme_data_release_and_get_mem (outs[i], &len);
+      if (len != size || (size && memcmp (result, buffer, size)))
+        {
+          fprintf (stderr, PGM ": wrong output of operation %d\n", i);
+          exit (1);
+        }
+      gpgme_free (result);
+      gpgme_data_release (ins[i]);
+      gpgme_release (ctxs[i]);
+    }
+  for (i = ncontexts; i < ncontexts + nidle; i++)
+    {
+      gpgme_data_release (outs[i]);
+      gpgme_release (ctxs[i]);
+    }
+
+  printf ("contexts=%d idle=%d size=%zu start=%.3fs wait=%.3fs cpu=%.3fs\n",
+          ncontexts, nidle, size, started, elapsed, cpu);
+
+  free (buffer);
+  free (outs);
+  free (ins);
+  free (ctxs);
+  return 0;
+}
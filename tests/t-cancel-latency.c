@@ -0,0 +1,155 @@
+/* t-cancel-latency.c - Check that gpgme_cancel_async is noticed at once
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This runs a program which does not produce any output for a few
+ * seconds, once with a blocking operation and once with gpgme_wait,
+ * and cancels it from another thread with gpgme_cancel_async.  It
+ * measures the time from the cancellation until the operation
+ * returns, which must be far below the run time of the program.
+ * With --verbose the times are printed.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/time.h>
+#include <pthread.h>
+
+#include <gpgme.h>
+
+#define PGM "t-cancel-latency"
+
+#include "run-support.h"
+
+/* The maximum accepted latency in milliseconds.  The program runs
+   for much longer.  */
+#define MAX_LATENCY 500
+
+static int verbose;
+
+/* The time at which the context has been canceled.  */
+static double canceled_at;
+
+
+static double
+timestamp (void)
+{
+  struct timeval tv;
+
+  gettimeofday (&tv, NULL);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+
+static void *
+thread_cancel (void *data)
+{
+  gpgme_ctx_t ctx = data;
+  gpgme_error_t err;
+
+  usleep (100000);
+  canceled_at = timestamp ();
+  err = gpgme_cancel_async (ctx);
+  fail_if_err (err);
+  return NULL;
+}
+
+
+/* Run the program and cancel it.  If WAIT is set, the operation is
+   run with gpgme_wait.  */
+static void
+run_one (int wait)
+{
+  const char *argv[] = { "/bin/sleep", "5", NULL };
+  gpgme_ctx_t ctx;
+  gpgme_data_t out;
+  gpgme_error_t err, op_err;
+  pthread_t thread;
+  double latency;
+
+  err = gpgme_new (&ctx);
+  fail_if_err (err);
+  err = gpgme_set_protocol (ctx, GPGME_PROTOCOL_SPAWN);
+  fail_if_err (err);
+  err = gpgme_data_new (&out);
+  fail_if_err (err);
+
+  if (wait)
+    {
+      err = gpgme_op_spawn_start (ctx, argv[0], argv, NULL, out, NULL, 0);
+      fail_if_err (err);
+    }
+
+  if (pthread_create (&thread, NULL, thread_cancel, ctx))
+    {
+      fprintf (stderr, PGM ": can't create thread\n");
+      exit (1);
+    }
+
+  if (wait)
+    {
+      if (gpgme_wait_ext (ctx, &err, &op_err, 1) != ctx)
+        {
+          fprintf (stderr, PGM ": gpgme_wait returned another context\n");
+          exit (1);
+        }
+    }
+  else
+    err = gpgme_op_spawn (ctx, argv[0], argv, NULL, out, NULL, 0);
+  latency = (timestamp () - canceled_at) * 1000.0;
+  pthread_join (thread, NULL);
+
+  if (gpgme_err_code (err) != GPG_ERR_CANCELED)
+    {
+      fprintf (stderr, PGM ": %s: unexpected result: %s\n",
+               wait? "gpgme_wait" : "blocking", gpgme_strerror (err));
+      exit (1);
+    }
+  if (verbose)
+    printf ("%s: cancel latency %.3fms\n",
+            wait? "gpgme_wait" : "blocking", latency);
+  if (latency > MAX_LATENCY)
+    {
+      fprintf (stderr, PGM ": %s: cancellation took %.3fms\n",
+               wait? "gpgme_wait" : "blocking", latency);
+      exit (1);
+    }
+
+  gpgme_data_release (out);
+  gpgme_release (ctx);
+}
+
+
+int
+main (int argc, char **argv)
+{
+  if (argc > 1 && !strcmp (argv[1], "--verbose"))
+    verbose = 1;
+
+  init_gpgme (GPGME_PROTOCOL_SPAWN);
+
+  run_one (0);
+  run_one (1);
+  return 0;
+}
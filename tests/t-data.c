@@ -174,6 +174,149 @@ write_test (round_t round, gpgme_data_t data)
 }
 
 
+/* Read all of DATA into a new buffer and compare it with the LENGTH
+   bytes at EXPECTED.  */
+static void
+check_data (gpgme_data_t data, const char *expected, size_t length,
+            const char *what)
+{
+  char *mem;
+  size_t n = 0;
+  int round = TEST_END;
+
+  mem = malloc (length + 1);
+  if (!mem)
+    {
+      fprintf (stderr, "%s:%d: out of core\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  while (n <= length)
+    {
+      gpgme_ssize_t amt = gpgme_data_read (data, mem + n, length + 1 - n);
+      if (amt < 0)
+        fail_if_err (gpgme_error_from_syserror ());
+      if (!amt)
+        break;
+      n += amt;
+    }
+  if (n != length || memcmp (mem, expected, length))
+    {
+      fprintf (stderr, "%s:%d: wrong data read from %s\n",
+               __FILE__, __LINE__, what);
+      exit (1);
+    }
+  free (mem);
+}
+
+
+/* Write LENGTH bytes of BUFFER to the file FNAME.  */
+static void
+write_file (const char *fname, const char *buffer, size_t length)
+{
+  FILE *fp;
+
+  fp = fopen (fname, "wb");
+  if (!fp || fwrite (buffer, length, 1, fp) != 1 || fclose (fp))
+    {
+      fprintf (stderr, "%s:%d: error writing '%s': %s\n",
+               __FILE__, __LINE__, fname, strerror (errno));
+      exit (1);
+    }
+}
+
+
+/* Check data objects for files large enough to be mapped instead of
+   read into memory.  */
+static void
+large_file_test (void)
+{
+  const char *fname = "t-data-large.tmp";
+  const size_t filesize = 200000;
+  const size_t offset = 4097;
+  const size_t length = 150000;
+  gpgme_error_t err;
+  gpgme_data_t data;
+  FILE *fp;
+  char *buffer, *mem;
+  size_t i, len;
+  int round = TEST_END;
+
+  buffer = malloc (filesize);
+  if (!buffer)
+    {
+      fprintf (stderr, "%s:%d: out of core\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  for (i = 0; i < filesize; i++)
+    buffer[i] = 'a' + (i * 7) % 26;
+  write_file (fname, buffer, filesize);
+
+  /* Without COPY the file may be mapped.  */
+  err = gpgme_data_new_from_file (&data, fname, 0);
+  fail_if_err (err);
+  check_data (data, buffer, filesize, "mapped file");
+
+  /* Modify the data and check that the file is not changed.  */
+  if (gpgme_data_seek (data, offset + 1, SEEK_SET) != offset + 1
+      || gpgme_data_write (data, "XYZ", 3) != 3)
+    {
+      fprintf (stderr, "%s:%d: error modifying the data\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+  mem = gpgme_data_release_and_get_mem (data, &len);
+  if (!mem || len != filesize || memcmp (mem + offset + 1, "XYZ", 3)
+      || memcmp (mem, buffer, offset + 1)
+      || memcmp (mem + offset + 4, buffer + offset + 4,
+                 filesize - offset - 4))
+    {
+      fprintf (stderr, "%s:%d: wrong data after modification\n",
+               __FILE__, __LINE__);
+      exit (1);
+    }
+  gpgme_free (mem);
+  err = gpgme_data_new_from_file (&data, fname, 1);
+  fail_if_err (err);
+  check_data (data, buffer, filesize, "unmodified file");
+  gpgme_data_release (data);
+
+  /* A part of the file is a copy which does not see later changes of
+     the file.  */
+  err = gpgme_data_new_from_filepart (&data, fname, NULL, offset, length);
+  fail_if_err (err);
+  mem = malloc (filesize);
+  if (!mem)
+    {
+      fprintf (stderr, "%s:%d: out of core\n", __FILE__, __LINE__);
+      exit (1);
+    }
+  memcpy (mem, buffer, filesize);
+  for (i = 0; i < filesize; i++)
+    buffer[i] ^= 0x20;
+  write_file (fname, buffer, filesize);
+  check_data (data, mem + offset, length, "file part");
+  gpgme_data_release (data);
+  free (mem);
+
+  /* Get a part of the changed file using a stream.  */
+  fp = fopen (fname, "rb");
+  if (!fp)
+    {
+      fprintf (stderr, "%s:%d: fopen: %s\n", __FILE__, __LINE__,
+               strerror (errno));
+      exit (1);
+    }
+  err = gpgme_data_new_from_filepart (&data, NULL, fp, offset, length);
+  fail_if_err (err);
+  fclose (fp);
+  check_data (data, buffer + offset, length, "stream");
+  gpgme_data_release (data);
+
+  remove (fname);
+  free (buffer);
+}
+
+
 int
 main (void)
 {
@@ -222,10 +365,6 @@ main (void)
 	  continue;
 	case TEST_INOUT_MEM_FROM_FILE_NO_COPY:
 	  err = gpgme_data_new_from_file (&data, text_filename, 0);
-	  /* This is not implemented yet.  */
-	  if (gpgme_err_code (err) == GPG_ERR_NOT_IMPLEMENTED
-	      || gpgme_err_code (err) == GPG_ERR_INV_VALUE)
-	    continue;
 	  break;
 	case TEST_INOUT_MEM_FROM_FILE_PART_BY_NAME:
 	  err = gpgme_data_new_from_filepart (&data, longer_text_filename, 0,
@@ -268,6 +407,7 @@ main (void)
       gpgme_data_release (data);
     }
  out:
+  large_file_test ();
   free (text_filename);
   free (longer_text_filename);
   return 0;
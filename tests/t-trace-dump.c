@@ -0,0 +1,234 @@
+/* t-trace-dump.c - Check dumping the trace rings while they are written
+ * Copyright (C) 2020 g10 Code GmbH
+ *
+ * This file is part of GPGME.
+ *
+ * GPGME is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Lesser General Public License as
+ * published by the Free Software Foundation; either version 2.1 of
+ * the License, or (at your option) any later version.
+ *
+ * GPGME is distributed in the hope that it will be useful, but
+ * WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this program; if not, see <https://gnu.org/licenses/>.
+ * SPDX-License-Identifier: LGPL-2.1-or-later
+ */
+
+/* This stores trace messages in small trace rings from several
+ * threads and dumps the rings from the main thread meanwhile.  Each
+ * dump must be complete: the number of records in its header must
+ * match the records which follow, and all records must be complete
+ * and refer to existing strings.  */
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <gpgme.h>
+
+#include "trace-ring.h"
+
+#define PGM "t-trace-dump"
+
+#include "run-support.h"
+
+#define DUMP_FILE "t-trace-dump.out"
+#define NTHREADS  4
+#define NDUMPS    500
+
+static pthread_mutex_t started_lock = PTHREAD_MUTEX_INITIALIZER;
+static int started;
+static volatile int stop;
+
+
+static void *
+thread_trace (void *data)
+{
+  gpgme_data_t dh;
+  gpgme_error_t err;
+
+  (void)data;
+  pthread_mutex_lock (&started_lock);
+  started++;
+  pthread_mutex_unlock (&started_lock);
+  while (!stop)
+    {
+      err = gpgme_data_new_from_mem (&dh, "x", 1, 0);
+      fail_if_err (err);
+      gpgme_data_release (dh);
+    }
+  return NULL;
+}
+
+
+static void
+die (const char *what, unsigned int dump)
+{
+  fprintf (stderr, PGM ": dump %u: %s\n", dump, what);
+  exit (1);
+}
+
+
+static uint32_t
+read_uint32 (FILE *fp, unsigned int dump)
+{
+  uint32_t value;
+
+  if (fread (&value, sizeof value, 1, fp) != 1)
+    die ("truncated", dump);
+  return value;
+}
+
+
+/* Return the number of arguments of the trace format FORMAT.  */
+static unsigned int
+count_args (const char *format)
+{
+  unsigned int n = 0;
+
+  while ((format = strchr (format, '%')))
+    {
+      format++;
+      if (*format == '%')
+        {
+          format++;
+          continue;
+        }
+      /* A '*' width or precision takes an argument as well.  */
+      for (; *format && strchr ("-+ #0123456789.*hlLjzt", *format); format++)
+        if (*format == '*')
+          n++;
+      if (*format)
+        n++;
+    }
+  return n < TRACE_RECORD_ARGS? n : TRACE_RECORD_ARGS;
+}
+
+
+/* Check the dumps in DUMP_FILE and return their number.  */
+static unsigned int
+check_dumps (void)
+{
+  struct trace_record_s rec;
+  char magic[8];
+  char **strings;
+  uint32_t nstrings, nrecords, len, i;
+  unsigned int dump;
+  FILE *fp;
+
+  fp = fopen (DUMP_FILE, "rb");
+  if (!fp)
+    die ("can't open the dump file", 0);
+
+  for (dump = 0; fread (magic, sizeof magic, 1, fp) == 1; dump++)
+    {
+      if (memcmp (magic, TRACE_DUMP_MAGIC, sizeof magic)
+          || read_uint32 (fp, dump) != TRACE_DUMP_BYTEORDER)
+        die ("bad header", dump);
+      nstrings = read_uint32 (fp, dump);
+      strings = calloc (nstrings + 1, sizeof *strings);
+      if (!strings)
+        die ("out of core", dump);
+      for (i = 0; i < nstrings; i++)
+        {
+          len = read_uint32 (fp, dump);
+          strings[i] = calloc (1, len + 1);
+          if (!strings[i])
+            die ("out of core", dump);
+          if (len && fread (strings[i], len, 1, fp) != 1)
+            die ("truncated", dump);
+        }
+
+      nrecords = read_uint32 (fp, dump);
+      if (!nrecords)
+        die ("no records", dump);
+      for (i = 0; i < nrecords; i++)
+        {
+          if (fread (&rec, sizeof rec, 1, fp) != 1)
+            die ("fewer records than announced", dump);
+          if (!rec.seq || !rec.stamp)
+            die ("incomplete record", dump);
+          if ((rec.format >= nstrings && rec.format != TRACE_NO_STRING)
+              || (rec.func >= nstrings && rec.func != TRACE_NO_STRING)
+              || (rec.tagname >= nstrings && rec.tagname != TRACE_NO_STRING))
+            die ("bad string index", dump);
+          if (rec.ptrsize != sizeof (void *)
+              || rec.nargs != (rec.format == TRACE_NO_STRING
+                               ? 0 : count_args (strings[rec.format])))
+            die ("bad record", dump);
+        }
+
+      for (i = 0; i < nstrings; i++)
+        free (strings[i]);
+      free (strings);
+    }
+  if (!feof (fp))
+    die ("read error", dump);
+  fclose (fp);
+  return dump;
+}
+
+
+int
+main (void)
+{
+  pthread_t threads[NTHREADS];
+  int i;
+
+  /* A small ring is overwritten all the time.  This must be done
+     before the library is initialized.  */
+  if (gpgme_set_global_flag ("debug", "9:/dev/null:ring=4"))
+    {
+      fprintf (stderr, PGM ": can't set the debug flag\n");
+      exit (1);
+    }
+  init_gpgme_basic ();
+
+  unlink (DUMP_FILE);
+  for (i = 0; i < NTHREADS; i++)
+    if (pthread_create (&threads[i], NULL, thread_trace, NULL))
+      {
+        fprintf (stderr, PGM ": can't create thread\n");
+        exit (1);
+      }
+
+  /* Dump only while all threads are tracing.  */
+  for (;;)
+    {
+      pthread_mutex_lock (&started_lock);
+      i = started;
+      pthread_mutex_unlock (&started_lock);
+      if (i == NTHREADS)
+        break;
+      usleep (1000);
+    }
+
+  for (i = 0; i < NDUMPS; i++)
+    if (gpgme_set_global_flag ("debug-dump", DUMP_FILE))
+      {
+        fprintf (stderr, PGM ": dumping the trace rings failed\n");
+        exit (1);
+      }
+
+  stop = 1;
+  for (i = 0; i < NTHREADS; i++)
+    pthread_join (threads[i], NULL);
+
+  if (check_dumps () != NDUMPS)
+    {
+      fprintf (stderr, PGM ": wrong number of dumps\n");
+      exit (1);
+    }
+  unlink (DUMP_FILE);
+  return 0;
+}